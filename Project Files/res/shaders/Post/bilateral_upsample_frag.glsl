@@ -0,0 +1,60 @@
+#version 420
+
+// Brings an effect that ran at a lower resolution back up to full size
+// Only what the effect changed is upsampled and added to the full resolution frame, so detail the effect didn't touch stays sharp
+// The four low resolution texels around each pixel are weighted by distance and by how close their depth is to the pixel's,
+// so changes don't bleed across edges
+
+layout(location = 0) in vec2 inUV;
+
+out vec4 frag_color;
+
+// The frame before the effect, at full resolution
+layout (binding = 0) uniform sampler2D u_FullSource;
+// The same frame shrunk down, what the effect was given
+layout (binding = 1) uniform sampler2D u_LowSource;
+// What the effect made of it
+layout (binding = 2) uniform sampler2D u_LowResult;
+// The scene's depth at full resolution
+layout (binding = 3) uniform sampler2D u_Depth;
+
+uniform bool u_HasDepth = false;
+uniform mat4 u_InverseProjection;
+// How much of the depth was drawn into (dynamic resolution)
+uniform vec2 u_DepthScale = vec2(1.0);
+
+float GetViewDepth(vec2 uv)
+{
+	vec4 position = u_InverseProjection * vec4(0.0, 0.0, texture(u_Depth, uv * u_DepthScale).r * 2.0 - 1.0, 1.0);
+	return abs(position.z / position.w);
+}
+
+void main() {
+	vec2 lowSize = vec2(textureSize(u_LowResult, 0));
+	vec2 lowCoord = inUV * lowSize - 0.5;
+	ivec2 base = ivec2(floor(lowCoord));
+	vec2 f = fract(lowCoord);
+
+	float depth = u_HasDepth ? max(GetViewDepth(inUV), 0.0001) : 0.0;
+
+	vec3 change = vec3(0.0);
+	float total = 0.0;
+	for (int i = 0; i < 4; i++) {
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		ivec2 coord = clamp(base + offset, ivec2(0), ivec2(lowSize) - 1);
+
+		vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+		float weight = bilinear.x * bilinear.y;
+		if (u_HasDepth) {
+			// Relative difference, so far away surfaces aren't held to tighter limits than near ones
+			float difference = abs(GetViewDepth((vec2(coord) + 0.5) / lowSize) - depth) / depth;
+			weight *= 1.0 / (0.01 + difference);
+		}
+
+		change += weight * (texelFetch(u_LowResult, coord, 0).rgb - texelFetch(u_LowSource, coord, 0).rgb);
+		total += weight;
+	}
+
+	vec4 source = texture(u_FullSource, inUV);
+	frag_color = vec4(source.rgb + change / max(total, 0.00001), source.a);
+}
@@ -0,0 +1,17 @@
+#version 420
+
+// Adds the bloom onto the frame, for when there's no color correction to do it as it grades
+
+layout(location = 0) in vec2 inUV;
+
+out vec4 frag_color;
+
+layout (binding = 0) uniform sampler2D s_Source;
+
+#include "post_effects.glsl"
+
+void main() 
+{
+	g_ScreenUV = inUV;
+	frag_color = AddBloom(texture(s_Source, GetSourceUV(inUV, vec2(textureSize(s_Source, 0)))));
+}
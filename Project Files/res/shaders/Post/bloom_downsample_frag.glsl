@@ -0,0 +1,44 @@
+#version 420
+
+// One step down the bloom chain with the dual filter kernel: the centre and four diagonal taps half a texel out
+// The first step also keeps only the parts brighter than the threshold (with a soft knee so it fades in)
+
+layout(location = 0) in vec2 inUV;
+
+out vec4 frag_color;
+
+layout (binding = 0) uniform sampler2D s_Source;
+
+// Size of one texel of the source
+uniform vec2  u_TexelSize;
+// How much of the source was drawn into (dynamic resolution), only used on the first step
+uniform vec2  u_SourceScale = vec2(1.0);
+uniform bool  u_Prefilter = false;
+uniform float u_Threshold = 1.0;
+uniform float u_Knee = 0.5;
+
+vec3 Sample(vec2 uv)
+{
+	return texture(s_Source, min(uv * u_SourceScale, u_SourceScale - 0.5 * u_TexelSize)).rgb;
+}
+
+vec3 Prefilter(vec3 color)
+{
+	float brightness = max(color.r, max(color.g, color.b));
+	float soft = clamp(brightness - u_Threshold + u_Knee, 0.0, 2.0 * u_Knee);
+	soft = soft * soft / (4.0 * u_Knee + 0.00001);
+	return color * max(soft, brightness - u_Threshold) / max(brightness, 0.00001);
+}
+
+void main() 
+{
+	vec2 offset = u_TexelSize * 0.5;
+	vec3 sum = Sample(inUV) * 4.0;
+	sum += Sample(inUV + vec2(-offset.x, -offset.y));
+	sum += Sample(inUV + vec2( offset.x, -offset.y));
+	sum += Sample(inUV + vec2(-offset.x,  offset.y));
+	sum += Sample(inUV + vec2( offset.x,  offset.y));
+	vec3 color = sum / 8.0;
+
+	frag_color = vec4(u_Prefilter ? Prefilter(color) : color, 1.0);
+}
@@ -0,0 +1,28 @@
+#version 420
+
+// One step up the bloom chain with the dual filter kernel: four edge taps a texel out and four diagonal ones half
+// a texel out (weighted double), it's blended on top of the level it's drawn into
+
+layout(location = 0) in vec2 inUV;
+
+out vec4 frag_color;
+
+layout (binding = 0) uniform sampler2D s_Source;
+
+// Size of one texel of the smaller level we're reading
+uniform vec2 u_TexelSize;
+
+void main() 
+{
+	vec2 offset = u_TexelSize;
+	vec3 sum = texture(s_Source, inUV + vec2(-offset.x, 0.0)).rgb;
+	sum += texture(s_Source, inUV + vec2(offset.x, 0.0)).rgb;
+	sum += texture(s_Source, inUV + vec2(0.0, -offset.y)).rgb;
+	sum += texture(s_Source, inUV + vec2(0.0, offset.y)).rgb;
+	sum += texture(s_Source, inUV + vec2(-offset.x, -offset.y) * 0.5).rgb * 2.0;
+	sum += texture(s_Source, inUV + vec2(offset.x, -offset.y) * 0.5).rgb * 2.0;
+	sum += texture(s_Source, inUV + vec2(-offset.x, offset.y) * 0.5).rgb * 2.0;
+	sum += texture(s_Source, inUV + vec2(offset.x, offset.y) * 0.5).rgb * 2.0;
+
+	frag_color = vec4(sum / 12.0, 1.0);
+}
@@ -5,14 +5,11 @@ layout(location = 0) in vec2 inUV;
 out vec4 frag_color;
 
 layout (binding = 0) uniform sampler2D u_FinishedFrame;
-layout (binding = 30) uniform sampler3D u_TexColorGrade;
 
-void main() {
-	vec4 textureColor = texture(u_FinishedFrame, inUV);
-
-	vec3 scale = vec3((64.0 - 1.0) / 64.0);
-	vec3 offset = vec3(1.0 / (2.0 * 64.0));
+#include "post_effects.glsl"
 
-	frag_color.rgb = texture(u_TexColorGrade, scale * textureColor.rgb + offset).rgb;
-	frag_color.a = textureColor.a;
-}
\ No newline at end of file
+void main() {
+	g_ScreenUV = inUV;
+	// The scene is stretched to fill the screen here when it was drawn at a lower resolution
+	frag_color = ColorGrade(texture(u_FinishedFrame, GetSourceUV(inUV, vec2(textureSize(u_FinishedFrame, 0)))));
+}
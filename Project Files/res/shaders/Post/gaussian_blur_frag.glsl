@@ -0,0 +1,38 @@
+#version 420
+
+// One direction of a separable Gaussian, run once across and once down
+// Taps are taken in pairs between texels so bilinear filtering does half the work
+
+layout(location = 0) in vec2 inUV;
+
+out vec4 frag_color;
+
+layout (binding = 0) uniform sampler2D s_Source;
+
+// One texel along the direction we're blurring
+uniform vec2  u_Direction;
+uniform float u_Sigma;
+// Texels either side of the centre
+uniform int   u_Radius;
+
+float Weight(float x)
+{
+	return exp(-(x * x) / (2.0 * u_Sigma * u_Sigma));
+}
+
+void main() 
+{
+	vec3 sum = texture(s_Source, inUV).rgb;
+	float total = 1.0;
+	for (int i = 1; i <= u_Radius; i += 2) {
+		float w0 = Weight(float(i));
+		float w1 = Weight(float(i + 1));
+		float w = w0 + w1;
+		float offset = float(i) + w1 / w;
+		sum += texture(s_Source, inUV + u_Direction * offset).rgb * w;
+		sum += texture(s_Source, inUV - u_Direction * offset).rgb * w;
+		total += 2.0 * w;
+	}
+
+	frag_color = vec4(sum / total, 1.0);
+}
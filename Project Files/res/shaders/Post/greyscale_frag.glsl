@@ -6,14 +6,9 @@ out vec4 frag_color;
 
 layout (binding = 0) uniform sampler2D s_screenTex;
 
-uniform float u_Intensity = 1.0;
+#include "post_effects.glsl"
 
 void main() 
 {
-	vec4 source = texture(s_screenTex, inUV);
-
-	float luminence = 0.2989 * source.r + 0.587 * source.g + 0.114 * source.b;
-
-	frag_color.rgb = mix(source.rgb, vec3(luminence), u_Intensity);
-    frag_color.a = source.a; 
-}
\ No newline at end of file
+	frag_color = Greyscale(texture(s_screenTex, inUV));
+}
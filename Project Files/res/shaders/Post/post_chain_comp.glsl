@@ -0,0 +1,27 @@
+#version 430
+
+// Runs a chain of per pixel post effects in one dispatch, each workgroup does a 16x16 tile of the screen
+// PostChain puts a line calling each effect (from post_effects.glsl) in place of the EFFECTS line,
+// and the target's image format (rgba8, rgba16f or r11f_g11f_b10f) in place of TARGET_FORMAT
+layout(local_size_x = 16, local_size_y = 16) in;
+
+layout (binding = 0) uniform sampler2D s_Source;
+layout (binding = 0, TARGET_FORMAT) uniform writeonly image2D u_Target;
+
+#include "post_effects.glsl"
+
+void main() 
+{
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = imageSize(u_Target);
+	if (any(greaterThanEqual(pixel, size)))
+		return;
+
+	// Sampled by UV (the same spot a fragment pass would read) in case the source is a different size, or only partly drawn
+	g_ScreenUV = (vec2(pixel) + 0.5) / vec2(size);
+	vec4 color = texture(s_Source, GetSourceUV(g_ScreenUV, vec2(textureSize(s_Source, 0))));
+
+	// EFFECTS
+
+	imageStore(u_Target, pixel, color);
+}
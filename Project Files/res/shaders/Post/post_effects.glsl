@@ -0,0 +1,76 @@
+// Per pixel post effects, shared by the fragment passes and the compute chain (post_chain_comp.glsl)
+// Each takes the color so far and returns it with the effect applied
+
+// How much of the source was drawn into (dynamic resolution only draws into the bottom left of the scene's targets)
+uniform vec2 u_SourceScale = vec2(1.0);
+
+// Moves a UV over the whole screen into the part of the source that was drawn, without filtering in what's past its edge
+vec2 GetSourceUV(vec2 uv, vec2 sourceSize)
+{
+	return min(uv * u_SourceScale, u_SourceScale - 0.5 / sourceSize);
+}
+
+// Where on the screen (0 to 1) the pixel being worked on is, set by main() before any effect runs
+vec2 g_ScreenUV;
+
+uniform float u_GreyscaleIntensity = 1.0;
+
+vec4 Greyscale(vec4 source)
+{
+	float luminence = 0.2989 * source.r + 0.587 * source.g + 0.114 * source.b;
+	return vec4(mix(source.rgb, vec3(luminence), u_GreyscaleIntensity), source.a);
+}
+
+uniform float u_SepiaIntensity = 0.6;
+
+vec4 Sepia(vec4 source)
+{
+	vec3 sepiaColor;
+	sepiaColor.r = ((source.r * 0.393) + (source.g * 0.769) + (source.b * 0.189));
+	sepiaColor.g = ((source.r * 0.349) + (source.g * 0.686) + (source.b * 0.168));
+	sepiaColor.b = ((source.r * 0.272) + (source.g * 0.534) + (source.b * 0.131));
+	return vec4(mix(source.rgb, sepiaColor, u_SepiaIntensity), source.a);
+}
+
+// Built by BloomEffect, covering the whole screen
+layout (binding = 28) uniform sampler2D u_TexBloom;
+uniform float u_BloomIntensity = 0.0;
+
+vec4 AddBloom(vec4 source)
+{
+	if (u_BloomIntensity <= 0.0)
+		return source;
+	return vec4(source.rgb + texture(u_TexBloom, g_ScreenUV).rgb * u_BloomIntensity, source.a);
+}
+
+layout (binding = 30) uniform sampler3D u_TexColorGrade;
+
+// HDR scenes are brought into 0-1 here, right before the LUT lookup, so it doesn't need a pass of its own
+// 0: none (clamps), 1: Reinhard, 2: ACES (Narkowicz's fit)
+uniform int   u_Tonemap = 0;
+uniform float u_Exposure = 1.0;
+
+// 1x1, kept up to date on the GPU by the auto exposure (u_Exposure becomes compensation on top of it)
+layout (binding = 29) uniform sampler2D u_TexAutoExposure;
+uniform bool  u_AutoExposure = false;
+
+vec3 Tonemap(vec3 color)
+{
+	color *= u_Exposure;
+	if (u_AutoExposure)
+		color *= texelFetch(u_TexAutoExposure, ivec2(0), 0).r;
+	if (u_Tonemap == 1)
+		return color / (1.0 + color);
+	if (u_Tonemap == 2)
+		return clamp((color * (2.51 * color + 0.03)) / (color * (2.43 * color + 0.59) + 0.14), 0.0, 1.0);
+	return clamp(color, 0.0, 1.0);
+}
+
+// Bloom (when there is any) goes in first so it's tonemapped with the rest of the frame
+vec4 ColorGrade(vec4 source)
+{
+	source = AddBloom(source);
+	vec3 scale = vec3((64.0 - 1.0) / 64.0);
+	vec3 offset = vec3(1.0 / (2.0 * 64.0));
+	return vec4(texture(u_TexColorGrade, scale * Tonemap(source.rgb) + offset).rgb, source.a);
+}
@@ -0,0 +1,37 @@
+#version 420
+
+// One direction of a 9 tap blur over the occlusion that leaves depth edges sharp
+// Taps are weighted down the further their view depth is from the centre's, so one surface doesn't bleed onto another
+
+layout(location = 0) in vec2 inUV;
+
+out vec4 frag_color;
+
+layout (binding = 0) uniform sampler2D s_Source;
+
+// (1, 0) or (0, 1)
+uniform vec2  u_Direction;
+// Pixels that were drawn into (dynamic resolution), taps past the edge are clamped to it
+uniform vec2  u_RenderSize;
+// Higher keeps edges sharper
+uniform float u_Sharpness = 8.0;
+
+void main() 
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	ivec2 last = ivec2(u_RenderSize) - 1;
+	vec2 center = texelFetch(s_Source, pixel, 0).rg;
+
+	float total = center.r;
+	float weight = 1.0;
+	for (int i = -4; i <= 4; i++) {
+		if (i == 0)
+			continue;
+		vec2 tap = texelFetch(s_Source, clamp(pixel + ivec2(u_Direction) * i, ivec2(0), last), 0).rg;
+		float w = exp(-float(i * i) / 8.0) * exp(-abs(tap.g - center.g) * u_Sharpness / max(center.g, 0.0001));
+		total += tap.r * w;
+		weight += w;
+	}
+
+	frag_color = vec4(total / weight, center.g, 0.0, 1.0);
+}
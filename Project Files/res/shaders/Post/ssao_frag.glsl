@@ -0,0 +1,97 @@
+#version 420
+
+// Ambient occlusion at half resolution: how much of the hemisphere above each surface is blocked by the depth around it
+// The normal is rebuilt from the neighbouring depths, and the few samples are turned by noise that changes every
+// frame so the temporal pass can average it away
+// Writes the occlusion (1 is open) and the view depth, which the temporal and blur passes compare against
+
+layout(location = 0) in vec2 inUV;
+
+out vec4 frag_color;
+
+layout (binding = 0) uniform sampler2D s_Depth;
+
+uniform mat4  u_Projection;
+uniform mat4  u_InverseProjection;
+// How much of the depth target was drawn into (dynamic resolution)
+uniform vec2  u_DepthScale = vec2(1.0);
+// Size of one texel of the depth target
+uniform vec2  u_DepthTexelSize;
+uniform int   u_SampleCount = 8;
+// View space distance the samples reach, and how far in front of a sample a surface has to be to block it
+uniform float u_Radius = 0.5;
+uniform float u_Bias = 0.025;
+uniform int   u_Frame = 0;
+
+// inUV style coordinates, 0 to 1 over the part that was drawn into
+float SampleDepth(vec2 uv)
+{
+	return textureLod(s_Depth, uv * u_DepthScale, 0.0).r;
+}
+
+vec3 ViewPosition(vec2 uv, float depth)
+{
+	vec4 view = u_InverseProjection * vec4(uv * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+	return view.xyz / view.w;
+}
+
+// Takes the nearer neighbour on each axis, so the normal doesn't bend over depth edges
+vec3 ReconstructNormal(vec2 uv, vec3 center)
+{
+	vec2 texel = u_DepthTexelSize / u_DepthScale;
+	vec3 right = ViewPosition(uv + vec2(texel.x, 0.0), SampleDepth(uv + vec2(texel.x, 0.0))) - center;
+	vec3 left = center - ViewPosition(uv - vec2(texel.x, 0.0), SampleDepth(uv - vec2(texel.x, 0.0)));
+	vec3 up = ViewPosition(uv + vec2(0.0, texel.y), SampleDepth(uv + vec2(0.0, texel.y))) - center;
+	vec3 down = center - ViewPosition(uv - vec2(0.0, texel.y), SampleDepth(uv - vec2(0.0, texel.y)));
+	vec3 dx = abs(right.z) < abs(left.z) ? right : left;
+	vec3 dy = abs(up.z) < abs(down.z) ? up : down;
+	return normalize(cross(dx, dy));
+}
+
+// Interleaved gradient noise (Jimenez 2014), offset every frame
+float Noise(vec2 pixel)
+{
+	pixel += float(u_Frame % 64) * 5.588238;
+	return fract(52.9829189 * fract(dot(pixel, vec2(0.06711056, 0.00583715))));
+}
+
+void main() 
+{
+	float depth = SampleDepth(inUV);
+	vec3 center = ViewPosition(inUV, depth);
+	// Nothing was drawn here
+	if (depth >= 1.0) {
+		frag_color = vec4(1.0, -center.z, 0.0, 1.0);
+		return;
+	}
+
+	vec3 N = ReconstructNormal(inUV, center);
+	vec3 T = normalize(cross(abs(N.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0), N));
+	vec3 B = cross(N, T);
+
+	// A spiral over the hemisphere (golden angle apart), turned and pushed out by the noise
+	float noise = Noise(gl_FragCoord.xy);
+	float rotation = noise * 6.2831853;
+	int count = clamp(u_SampleCount, 1, 16);
+	float occlusion = 0.0;
+	for (int i = 0; i < count; i++) {
+		float t = (float(i) + noise) / float(count);
+		float angle = rotation + float(i) * 2.3999632;
+		float r = sqrt(t);
+		vec3 dir = vec3(cos(angle) * r, sin(angle) * r, sqrt(max(1.0 - t, 0.0)));
+		// More samples close in, where the creases are
+		vec3 samplePos = center + (T * dir.x + B * dir.y + N * dir.z) * u_Radius * mix(0.1, 1.0, t * t);
+
+		vec4 clip = u_Projection * vec4(samplePos, 1.0);
+		vec2 uv = clip.xy / clip.w * 0.5 + 0.5;
+		if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))))
+			continue;
+
+		float sceneZ = ViewPosition(uv, SampleDepth(uv)).z;
+		// Surfaces much further in front than the radius are something else entirely, fade them out
+		float range = smoothstep(0.0, 1.0, u_Radius / max(abs(center.z - sceneZ), 0.0001));
+		occlusion += (sceneZ >= samplePos.z + u_Bias ? 1.0 : 0.0) * range;
+	}
+
+	frag_color = vec4(1.0 - occlusion / float(count), -center.z, 0.0, 1.0);
+}
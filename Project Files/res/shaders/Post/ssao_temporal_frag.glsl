@@ -0,0 +1,44 @@
+#version 420
+
+// Blends this frame's noisy occlusion into last frame's, found by reprojecting each pixel with last frame's camera
+// The history is only kept if it was the same surface (its depth is where this pixel's was last frame)
+
+layout(location = 0) in vec2 inUV;
+
+out vec4 frag_color;
+
+layout (binding = 0) uniform sampler2D s_Current;
+layout (binding = 1) uniform sampler2D s_History;
+layout (binding = 2) uniform sampler2D s_Depth;
+
+uniform mat4  u_InverseViewProjection;
+uniform mat4  u_PreviousViewProjection;
+// How much of the depth target was drawn into this frame, and of the history last frame
+uniform vec2  u_DepthScale = vec2(1.0);
+uniform vec2  u_HistoryScale = vec2(1.0);
+// How much of this frame goes in, lower is smoother but trails behind more
+uniform float u_Blend = 0.1;
+uniform bool  u_HasHistory = false;
+
+void main() 
+{
+	vec2 current = texelFetch(s_Current, ivec2(gl_FragCoord.xy), 0).rg;
+	float depth = textureLod(s_Depth, inUV * u_DepthScale, 0.0).r;
+
+	float blend = 1.0;
+	if (u_HasHistory && depth < 1.0) {
+		vec4 world = u_InverseViewProjection * vec4(inUV * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+		vec4 previous = u_PreviousViewProjection * vec4(world.xyz / world.w, 1.0);
+		vec2 uv = previous.xy / previous.w * 0.5 + 0.5;
+		if (all(greaterThanEqual(uv, vec2(0.0))) && all(lessThanEqual(uv, vec2(1.0)))) {
+			vec2 history = textureLod(s_History, uv * u_HistoryScale, 0.0).rg;
+			// w is the view depth for a perspective projection
+			if (abs(history.g - previous.w) < 0.05 * previous.w) {
+				frag_color = vec4(mix(history.r, current.r, u_Blend), current.g, 0.0, 1.0);
+				return;
+			}
+		}
+	}
+
+	frag_color = vec4(current, 0.0, 1.0);
+}
@@ -0,0 +1,24 @@
+#version 420
+
+// Shows the ambient occlusion, either on its own or multiplied over the frame
+
+layout(location = 0) in vec2 inUV;
+
+out vec4 frag_color;
+
+layout (binding = 0) uniform sampler2D s_Source;
+layout (binding = 1) uniform sampler2D s_Occlusion;
+
+// How much of the source and the occlusion were drawn into (dynamic resolution)
+uniform vec2 u_SourceScale = vec2(1.0);
+uniform vec2 u_OcclusionScale = vec2(1.0);
+uniform bool u_OcclusionOnly = false;
+
+void main() 
+{
+	float occlusion = texture(s_Occlusion, inUV * u_OcclusionScale).r;
+	if (u_OcclusionOnly)
+		frag_color = vec4(vec3(occlusion), 1.0);
+	else
+		frag_color = vec4(texture(s_Source, inUV * u_SourceScale).rgb * occlusion, 1.0);
+}
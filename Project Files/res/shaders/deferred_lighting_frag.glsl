@@ -0,0 +1,35 @@
+#version 430
+
+layout(location = 0) in vec2 inUV;
+
+out vec4 frag_color;
+
+layout (binding = 0) uniform sampler2D s_AlbedoSpec;
+layout (binding = 1) uniform sampler2D s_NormalShininess;
+layout (binding = 2) uniform sampler2D s_Depth;
+
+// Takes clip space back to world space, for rebuilding positions from depth
+uniform mat4 u_InverseViewProjection;
+
+#include "lighting.glsl"
+#include "gbuffer.glsl"
+
+void main() 
+{
+	float depth = texelFetch(s_Depth, ivec2(gl_FragCoord.xy), 0).r;
+	// Nothing was drawn here, leave the clear color
+	if (depth >= 1.0)
+		discard;
+
+	vec4 albedoSpec = texelFetch(s_AlbedoSpec, ivec2(gl_FragCoord.xy), 0);
+	vec4 normalShininess = texelFetch(s_NormalShininess, ivec2(gl_FragCoord.xy), 0);
+
+	vec4 clip = vec4(inUV * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+	vec4 world = u_InverseViewProjection * clip;
+	vec3 pos = world.xyz / world.w;
+
+	vec3 N = DecodeNormal(normalShininess.xy);
+	vec3 result = ShadeSurface(pos, N, albedoSpec.rgb, albedoSpec.a, normalShininess.z * MAX_SHININESS, depth);
+
+	frag_color = vec4(result, 1.0);
+}
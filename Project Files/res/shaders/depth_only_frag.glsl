@@ -0,0 +1,6 @@
+#version 410
+
+// Color writes are masked off, only depth comes out of here
+void main() 
+{
+}
@@ -0,0 +1,26 @@
+#version 410
+
+layout(location = 0) in vec3 inPosition;
+
+uniform mat4 u_ModelViewProjection;
+
+// Must come out bit for bit the same as vertex_shader.glsl, so the lit pass can test against our depth
+invariant gl_Position;
+
+//Features (must match the ones vertex_shader.glsl moves vertices with)
+//SIN_WAVE: ripples the surface along z over time
+#ifdef SIN_WAVE
+#include "lighting_block.glsl"
+#endif
+
+void main() {
+
+#ifdef SIN_WAVE
+    vec3 vert = inPosition;
+    vert.z = sin(vert.x * 3.0 + u_WaveTime * 0.1) * 0.25;
+    gl_Position = u_ModelViewProjection * vec4(vert, 1.0);
+#else
+    gl_Position = u_ModelViewProjection * vec4(inPosition, 1.0);
+#endif
+
+}
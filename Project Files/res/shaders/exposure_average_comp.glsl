@@ -0,0 +1,50 @@
+#version 430
+
+// Averages the luminance histogram and moves the exposure towards what it says, one invocation per bin
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 6) buffer Histogram {
+	uint s_Bins[256];
+};
+
+// 1x1, read by the color correction (post_effects.glsl) so the exposure never has to come back to the CPU
+layout(binding = 0, r32f) uniform image2D u_Exposure;
+
+uniform float u_MinLogLuminance;
+uniform float u_LogLuminanceRange;
+uniform float u_KeyValue;
+// How far to move towards the new exposure this frame
+uniform float u_Adapt;
+uniform float u_PixelCount;
+
+shared float g_Weighted[256];
+
+void main() 
+{
+	uint bin = gl_LocalInvocationIndex;
+	uint count = s_Bins[bin];
+	g_Weighted[bin] = float(count) * float(bin);
+
+	// Ready for next frame's histogram
+	s_Bins[bin] = 0;
+	barrier();
+
+	for (uint stride = 128; stride > 0; stride >>= 1) {
+		if (bin < stride)
+			g_Weighted[bin] += g_Weighted[bin + stride];
+		barrier();
+	}
+
+	// Bin 0 holds the black pixels, leaving them out keeps a dark sky from blowing everything else out
+	if (bin == 0) {
+		float lit = max(u_PixelCount - float(count), 1.0);
+		float averageBin = g_Weighted[0] / lit;
+		float logLuminance = clamp((averageBin - 1.0) / 254.0 * u_LogLuminanceRange + u_MinLogLuminance,
+			u_MinLogLuminance, u_MinLogLuminance + u_LogLuminanceRange);
+		float target = log2(u_KeyValue) - logLuminance;
+
+		// Adapt in stops so brightening and darkening feel the same
+		float previous = log2(imageLoad(u_Exposure, ivec2(0)).r);
+		imageStore(u_Exposure, ivec2(0), vec4(exp2(mix(previous, target, u_Adapt))));
+	}
+}
@@ -0,0 +1,42 @@
+#version 430
+
+// Bins the downsampled scene into a histogram of log luminance, each invocation bins one pixel
+layout(local_size_x = 16, local_size_y = 16) in;
+
+layout(binding = 0) uniform sampler2D s_Source;
+
+// Cleared by exposure_average_comp.glsl once it has read them
+layout(std430, binding = 6) buffer Histogram {
+	uint s_Bins[256];
+};
+
+uniform float u_MinLogLuminance;
+uniform float u_InverseLogLuminanceRange;
+
+// Each workgroup fills its own bins first so only 256 atomics per group touch memory
+shared uint g_Bins[256];
+
+// Matches AutoExposure::BuildHistogram, black goes in bin 0 and bins 1 to 255 cover the range
+uint GetBin(vec3 color)
+{
+	float luminance = dot(color, vec3(0.2126, 0.7152, 0.0722));
+	if (!(luminance >= 0.0001))
+		return 0;
+	float t = clamp((log2(luminance) - u_MinLogLuminance) * u_InverseLogLuminanceRange, 0.0, 1.0);
+	return uint(t * 254.0 + 1.0);
+}
+
+void main() 
+{
+	g_Bins[gl_LocalInvocationIndex] = 0;
+	barrier();
+
+	ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+	if (all(lessThan(coord, textureSize(s_Source, 0))))
+		atomicAdd(g_Bins[GetBin(texelFetch(s_Source, coord, 0).rgb)], 1);
+	barrier();
+
+	uint count = g_Bins[gl_LocalInvocationIndex];
+	if (count > 0)
+		atomicAdd(s_Bins[gl_LocalInvocationIndex], count);
+}
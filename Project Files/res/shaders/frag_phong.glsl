@@ -1,60 +1,59 @@
-#version 410
+#version 430
 
 layout(location = 0) in vec3 inPos;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec3 inNormal;
 layout(location = 3) in vec2 inUV;
 
+#include "lighting.glsl"
+
+// Features (defined by ShaderVariants)
+// GBUFFER: writes the surface into the G-buffer instead of lighting it
+// MATERIAL_ARRAYS: reads the material from MaterialBatcher's arrays instead of its own uniforms
+#ifdef MATERIAL_ARRAYS
+#include "materials.glsl"
+#else
 uniform sampler2D s_Diffuse;
 uniform sampler2D s_Specular;
 
-uniform vec3  u_AmbientCol;
-uniform float u_AmbientStrength;
-
-uniform vec3  u_LightPos;
-uniform vec3  u_LightCol;
-uniform float u_AmbientLightStrength;
-uniform float u_SpecularLightStrength;
 uniform float u_Shininess;
 
-uniform float u_LightAttenuationConstant;
-uniform float u_LightAttenuationLinear;
-uniform float u_LightAttenuationQuadratic;
+vec4 SampleMaterialDiffuse(vec2 uv) {
+	return texture(s_Diffuse, uv);
+}
 
-uniform vec3  u_CamPos;
+vec4 SampleMaterialSpecular(vec2 uv) {
+	return texture(s_Specular, uv);
+}
 
+float GetMaterialShininess() {
+	return u_Shininess;
+}
+#endif
+
+#ifdef GBUFFER
+#include "gbuffer.glsl"
+layout(location = 0) out vec4 gAlbedoSpec;
+layout(location = 1) out vec4 gNormalShininess;
+#else
 out vec4 frag_color;
+#endif
 
 void main() {
-	// Lecture 5
-	vec3 ambient = ((u_AmbientLightStrength * u_LightCol) + (u_AmbientCol * u_AmbientStrength));
-
-	// Diffuse
 	vec3 N = normalize(inNormal);
-	vec3 lightDir = normalize(u_LightPos - inPos);
-
-	float dif = max(dot(N, lightDir), 0.0);
-	vec3 diffuse = dif * u_LightCol;// add diffuse intensity
-
-	//Attenuation
-	float dist = length(u_LightPos - inPos);
-	float attenuation = 1.0f / (
-		u_LightAttenuationConstant + 
-		u_LightAttenuationLinear * dist +
-		u_LightAttenuationQuadratic * dist * dist);
-
-	// Specular
-	vec3 camPos = u_CamPos;//Pass this as a uniform from your C++ code
-	vec3 camDir = normalize(camPos - inPos);
-	vec3 reflectDir = reflect(-lightDir, N);
-	float texSpec = texture(s_Specular, inUV).x;
-	float spec = pow(max(dot(camDir, reflectDir), 0.0), u_Shininess); // Shininess coefficient (can be a uniform)
-	vec3 specular = u_SpecularLightStrength * texSpec * spec * u_LightCol; // Can also use a specular color
+	float texSpec = SampleMaterialSpecular(inUV).x;
+	float shininess = GetMaterialShininess();
 
 	// Get the albedo from the diffuse / albedo map
-	vec4 textureColor = texture(s_Diffuse, inUV);
+	vec4 textureColor = SampleMaterialDiffuse(inUV);
+	vec3 albedo = inColor * textureColor.rgb;
 
-	vec3 result = ((ambient + diffuse + specular) * attenuation) * inColor * textureColor.rgb;
+#ifdef GBUFFER
+	gAlbedoSpec = vec4(albedo, texSpec);
+	gNormalShininess = vec4(EncodeNormal(N), clamp(shininess / MAX_SHININESS, 0.0, 1.0), 0.0);
+#else
+	vec3 result = ShadeSurface(inPos, N, albedo, texSpec, shininess, gl_FragCoord.z);
 
 	frag_color = vec4(result, textureColor.a);
+#endif
 }
\ No newline at end of file
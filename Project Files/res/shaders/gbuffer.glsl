@@ -0,0 +1,25 @@
+// Packing shared by the G-buffer writer (frag_phong.glsl with GBUFFER) and the deferred lighting pass
+// Target 0: albedo (rgb), specular map (a)
+// Target 1: octahedral normal (rg), shininess / 256 (b)
+
+const float MAX_SHININESS = 256.0;
+
+vec2 OctWrap(vec2 v) {
+	return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Unit vector to [0, 1] on a square, much less error than storing xyz at the same bits
+vec2 EncodeNormal(vec3 n) {
+	n /= (abs(n.x) + abs(n.y) + abs(n.z));
+	n.xy = n.z >= 0.0 ? n.xy : OctWrap(n.xy);
+	return n.xy * 0.5 + 0.5;
+}
+
+vec3 DecodeNormal(vec2 encoded) {
+	encoded = encoded * 2.0 - 1.0;
+	vec3 n = vec3(encoded.xy, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
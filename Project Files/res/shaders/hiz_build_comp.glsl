@@ -0,0 +1,34 @@
+#version 430
+
+// Makes one level of the depth pyramid, each texel is the farthest depth under it in the level above
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(binding = 0) uniform sampler2D s_Source;
+layout(binding = 0, r32f) uniform writeonly image2D u_Destination;
+
+// Level of s_Source we're reducing
+uniform int u_SourceLevel;
+
+void main() 
+{
+	ivec2 dst = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 dstSize = imageSize(u_Destination);
+	if (any(greaterThanEqual(dst, dstSize)))
+		return;
+
+	ivec2 srcSize = textureSize(s_Source, u_SourceLevel);
+	ivec2 src = dst * 2;
+
+	// The last row and column pick up the leftover texel when the level above has an odd size
+	ivec2 footprint = ivec2(2) + ivec2(equal(dst, dstSize - 1)) * (srcSize & 1);
+
+	float farthest = 0.0;
+	for (int y = 0; y < footprint.y; y++) {
+		for (int x = 0; x < footprint.x; x++) {
+			ivec2 coord = min(src + ivec2(x, y), srcSize - 1);
+			farthest = max(farthest, texelFetch(s_Source, coord, u_SourceLevel).r);
+		}
+	}
+
+	imageStore(u_Destination, dst, vec4(farthest));
+}
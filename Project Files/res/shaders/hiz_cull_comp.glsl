@@ -0,0 +1,74 @@
+#version 430
+
+// Tests each object's world space box against the depth pyramid, one object per invocation
+layout(local_size_x = 64) in;
+
+struct Box {
+	vec4 Min;
+	vec4 Max;
+};
+
+layout(std430, binding = 4) readonly buffer Boxes {
+	Box boxes[];
+};
+
+layout(std430, binding = 5) writeonly buffer Results {
+	uint visible[];
+};
+
+layout(binding = 0) uniform sampler2D s_Pyramid;
+
+uniform mat4 u_ViewProjection;
+uniform int  u_Count;
+uniform int  u_Levels;
+// How much of the depth was drawn into (dynamic resolution), the rest is cleared to the far plane
+uniform vec2 u_UVScale = vec2(1.0);
+
+void main() 
+{
+	int id = int(gl_GlobalInvocationID.x);
+	if (id >= u_Count)
+		return;
+
+	vec3 boxMin = boxes[id].Min.xyz;
+	vec3 boxMax = boxes[id].Max.xyz;
+
+	vec3 ndcMin = vec3(1e30);
+	vec3 ndcMax = vec3(-1e30);
+	for (int i = 0; i < 8; i++) {
+		vec3 corner = mix(boxMin, boxMax, vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1));
+		vec4 clip = u_ViewProjection * vec4(corner, 1.0);
+		// Reaches behind the camera, it can't be projected so keep it
+		if (clip.w <= 0.0) {
+			visible[id] = 1u;
+			return;
+		}
+		vec3 ndc = clip.xyz / clip.w;
+		ndcMin = min(ndcMin, ndc);
+		ndcMax = max(ndcMax, ndc);
+	}
+
+	// Off screen, frustum culling isn't our job (anything partly on screen is tested on the part that is)
+	if (any(lessThan(ndcMax.xy, vec2(-1.0))) || any(greaterThan(ndcMin.xy, vec2(1.0)))) {
+		visible[id] = 1u;
+		return;
+	}
+
+	vec2 uvMin = clamp(ndcMin.xy * 0.5 + 0.5, 0.0, 1.0) * u_UVScale;
+	vec2 uvMax = clamp(ndcMax.xy * 0.5 + 0.5, 0.0, 1.0) * u_UVScale;
+	float nearest = ndcMin.z * 0.5 + 0.5;
+
+	// Pick the level where the box covers at most 2x2 texels
+	vec2 extent = (uvMax - uvMin) * vec2(textureSize(s_Pyramid, 0));
+	int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, u_Levels - 1);
+	ivec2 size = textureSize(s_Pyramid, level);
+	ivec2 lo = clamp(ivec2(uvMin * vec2(size)), ivec2(0), size - 1);
+	ivec2 hi = clamp(ivec2(uvMax * vec2(size)), ivec2(0), size - 1);
+
+	float farthest = max(
+		max(texelFetch(s_Pyramid, lo, level).r, texelFetch(s_Pyramid, ivec2(hi.x, lo.y), level).r),
+		max(texelFetch(s_Pyramid, ivec2(lo.x, hi.y), level).r, texelFetch(s_Pyramid, hi, level).r));
+
+	// Hidden if the nearest point of the box is behind everything drawn over it
+	visible[id] = nearest <= farthest ? 1u : 0u;
+}
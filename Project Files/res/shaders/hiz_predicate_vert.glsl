@@ -0,0 +1,13 @@
+#version 430
+
+// Turns the results of hiz_cull_comp.glsl into occlusion queries, so draws can wait on them with conditional rendering
+// One point per object, the first vertex of the draw picks which
+layout(std430, binding = 5) readonly buffer Results {
+	uint visible[];
+};
+
+void main() 
+{
+	// Outside the clip volume nothing gets rasterized, so a hidden object's query comes back empty
+	gl_Position = visible[gl_VertexID] != 0u ? vec4(0.0, 0.0, 0.0, 1.0) : vec4(2.0, 2.0, 2.0, 1.0);
+}
@@ -0,0 +1,150 @@
+// Scene lighting shared by the forward shader and the deferred lighting pass (pulled in with #include)
+
+#include "lighting_block.glsl"
+
+// Half resolution ambient occlusion from AmbientOcclusionEffect, drawn into the same corner as the target being lit
+layout(binding = 27) uniform sampler2D s_AmbientOcclusion;
+
+// Made from the sky by EnvironmentBaker: reflections get blurrier down the mips, irradiance is the light reaching a surface facing each way
+layout(binding = 14) uniform samplerCube s_EnvironmentReflections;
+layout(binding = 15) uniform samplerCube s_EnvironmentIrradiance;
+
+// Shadows from the scene light (ShadowAtlas): a cube of depth faces laid out 3 across and 2 down,
+// static casters in one atlas (only redrawn when they go stale) and everything that moves in the other
+layout(std140) uniform Shadows {
+	mat4 u_ShadowMatrices[6];
+	vec4 u_ShadowParams; // enabled, depth bias, normal offset, half a texel of a face
+};
+
+layout(binding = 25) uniform sampler2DShadow s_StaticShadows;
+layout(binding = 26) uniform sampler2DShadow s_DynamicShadows;
+
+uniform vec3  u_CamPos;
+
+//Point lights, assigned to clusters on the CPU by ClusteredLighting
+struct PointLight {
+	vec4 PositionRadius;
+	vec4 ColorIntensity;
+};
+
+layout(std430, binding = 1) readonly buffer PointLights {
+	PointLight u_PointLights[];
+};
+
+layout(std430, binding = 2) readonly buffer Clusters {
+	uvec4 u_ClusterGrid;   // tiles x, tiles y, slices, light count
+	vec4  u_ClusterDepth;  // near, far, slice scale, slice bias
+	vec4  u_ClusterScreen; // tile size in pixels, orthographic depth range and near plane (zero range for perspective)
+	uvec2 u_ClusterRanges[]; // offset into the index list, number of lights
+};
+
+layout(std430, binding = 3) readonly buffer ClusterLightIndices {
+	uint u_ClusterLightIndices[];
+};
+
+// Adds up the point lights in this pixel's cluster (windowDepth is the depth buffer value)
+vec3 ShadePointLights(vec3 pos, vec3 N, vec3 camDir, float texSpec, float shininess, float windowDepth) {
+	// View depth from the depth buffer value (linear for an orthographic camera)
+	float nearPlane = u_ClusterDepth.x;
+	float farPlane = u_ClusterDepth.y;
+	float depth = u_ClusterScreen.z > 0.0 ? u_ClusterScreen.w + windowDepth * u_ClusterScreen.z :
+		(2.0 * nearPlane * farPlane) / (farPlane + nearPlane - (windowDepth * 2.0 - 1.0) * (farPlane - nearPlane));
+	// The slices start at the near plane, anything closer goes in the first
+	depth = max(depth, nearPlane);
+
+	uvec3 cell;
+	cell.xy = min(uvec2(gl_FragCoord.xy / u_ClusterScreen.xy), u_ClusterGrid.xy - 1u);
+	cell.z = uint(clamp(log(depth) * u_ClusterDepth.z + u_ClusterDepth.w, 0.0, float(u_ClusterGrid.z - 1u)));
+	uvec2 range = u_ClusterRanges[cell.x + u_ClusterGrid.x * (cell.y + u_ClusterGrid.y * cell.z)];
+
+	vec3 total = vec3(0.0);
+	for (uint i = 0u; i < range.y; i++) {
+		PointLight light = u_PointLights[u_ClusterLightIndices[range.x + i]];
+		vec3 toLight = light.PositionRadius.xyz - pos;
+		float dist = length(toLight);
+		if (dist >= light.PositionRadius.w)
+			continue;
+
+		// Fades to nothing at the radius so lights don't pop at cluster edges
+		float fade = clamp(1.0 - pow(dist / light.PositionRadius.w, 4.0), 0.0, 1.0);
+		float falloff = (fade * fade) / (dist * dist + 1.0);
+
+		vec3 L = toLight / dist;
+		float dif = max(dot(N, L), 0.0);
+		float spec = pow(max(dot(camDir, reflect(-L, N)), 0.0), shininess);
+		total += (dif + u_SpecularLightStrength * texSpec * spec) * light.ColorIntensity.rgb * light.ColorIntensity.w * falloff;
+	}
+	return total;
+}
+
+// 1 where nothing blocks the ambient light, down to 0 in creases
+float SampleAmbientOcclusion() {
+	if (u_AmbientOcclusion <= 0.0)
+		return 1.0;
+	vec2 uv = gl_FragCoord.xy * 0.5 / vec2(textureSize(s_AmbientOcclusion, 0));
+	return mix(1.0, texture(s_AmbientOcclusion, uv).r, u_AmbientOcclusion);
+}
+
+// Light from the sky, what the fixed ambient color stands in for
+vec3 SampleEnvironment(vec3 N, vec3 camDir, float texSpec, float shininess) {
+	mat3 rotation = mat3(u_EnvironmentRotation);
+	// Roughness the baker used for the Phong lobe with this exponent, the mips go from 0 to 1
+	float roughness = sqrt(2.0 / (shininess + 2.0));
+	float lod = roughness * float(textureQueryLevels(s_EnvironmentReflections) - 1);
+	vec3 reflection = textureLod(s_EnvironmentReflections, rotation * reflect(-camDir, N), lod).rgb;
+	return texture(s_EnvironmentIrradiance, rotation * N).rgb + u_SpecularLightStrength * texSpec * reflection;
+}
+
+// 1 where the scene light reaches, 0 in shadow
+float SampleShadow(vec3 pos, vec3 N) {
+	if (u_ShadowParams.x <= 0.0)
+		return 1.0;
+	pos += N * u_ShadowParams.z;
+
+	// The face looking down the axis the pixel is furthest along
+	vec3 dir = pos - u_LightPos;
+	vec3 a = abs(dir);
+	int face = (a.x >= a.y && a.x >= a.z) ? (dir.x > 0.0 ? 0 : 1) : (a.y >= a.z ? (dir.y > 0.0 ? 2 : 3) : (dir.z > 0.0 ? 4 : 5));
+	vec4 clip = u_ShadowMatrices[face] * vec4(pos, 1.0);
+	vec3 p = clip.xyz / clip.w * 0.5 + 0.5;
+	// Out past the far plane
+	if (p.z >= 1.0)
+		return 1.0;
+
+	// Kept half a texel inside the face so the filtering doesn't reach into the next one
+	vec2 uv = (vec2(face % 3, face / 3) + clamp(p.xy, vec2(u_ShadowParams.w), vec2(1.0 - u_ShadowParams.w))) / vec2(3.0, 2.0);
+	vec3 coord = vec3(uv, p.z - u_ShadowParams.y);
+	// Lit only if neither atlas has something nearer the light
+	return texture(s_StaticShadows, coord) * texture(s_DynamicShadows, coord);
+}
+
+// Phong from the scene light plus the point lights, N must be normalized
+vec3 ShadeSurface(vec3 pos, vec3 N, vec3 albedo, float texSpec, float shininess, float windowDepth) {
+	vec3 camDir = normalize(u_CamPos - pos);
+
+	// Lecture 5
+	vec3 ambientCol = u_AmbientCol;
+	if (u_EnvironmentStrength > 0.0)
+		ambientCol = mix(ambientCol, SampleEnvironment(N, camDir, texSpec, shininess), u_EnvironmentStrength);
+	vec3 ambient = ((u_AmbientLightStrength * u_LightCol) + (ambientCol * u_AmbientStrength)) * SampleAmbientOcclusion();
+
+	// Diffuse
+	vec3 lightDir = normalize(u_LightPos - pos);
+
+	float dif = max(dot(N, lightDir), 0.0);
+	vec3 diffuse = dif * u_LightCol;// add diffuse intensity
+
+	//Attenuation
+	float dist = length(u_LightPos - pos);
+	float attenuation = 1.0f / (
+		u_LightAttenuationConstant + 
+		u_LightAttenuationLinear * dist +
+		u_LightAttenuationQuadratic * dist * dist);
+
+	// Specular
+	vec3 reflectDir = reflect(-lightDir, N);
+	float spec = pow(max(dot(camDir, reflectDir), 0.0), shininess); // Shininess coefficient (can be a uniform)
+	vec3 specular = u_SpecularLightStrength * texSpec * spec * u_LightCol; // Can also use a specular color
+
+	return ((ambient + (diffuse + specular) * SampleShadow(pos, N)) * attenuation + ShadePointLights(pos, N, camDir, texSpec, shininess, windowDepth)) * albedo;
+}
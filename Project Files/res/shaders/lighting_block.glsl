@@ -0,0 +1,21 @@
+// The per-frame Lighting uniform block, on its own so vertex stages can read it without the rest of lighting.glsl
+//Shared by every program that lights with it, filled once a frame by LightingBuffer
+layout(std140) uniform Lighting {
+	vec3  u_AmbientCol;
+	float u_AmbientStrength;
+	vec3  u_LightPos;
+	float u_AmbientLightStrength;
+	vec3  u_LightCol;
+	float u_SpecularLightStrength;
+	float u_LightAttenuationConstant;
+	float u_LightAttenuationLinear;
+	float u_LightAttenuationQuadratic;
+	// How much the ambient light is darkened by s_AmbientOcclusion (0 when it isn't built)
+	float u_AmbientOcclusion;
+	// How far the fixed ambient is replaced by light from the environment (0 when it isn't loaded)
+	float u_EnvironmentStrength;
+	// Time the SIN_WAVE vertex stages ripple with, here so every variant of them sees the same time
+	float u_WaveTime;
+	// Same turn the skybox is drawn with, so the lighting lines up with the sky
+	mat4  u_EnvironmentRotation;
+};
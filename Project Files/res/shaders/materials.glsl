@@ -0,0 +1,34 @@
+// Lit materials read from MaterialBatcher's texture arrays and storage buffer (frag_phong.glsl with MATERIAL_ARRAYS)
+// Every batched material's textures are layers in these arrays, u_MaterialIndex says which material is being drawn
+
+const int MAX_MATERIAL_ARRAYS = 8;
+
+struct MaterialData {
+	// Diffuse array, diffuse layer, specular array, specular layer
+	ivec4 Textures;
+	// Shininess (yzw unused)
+	vec4 Params;
+};
+
+layout(std430, binding = 7) readonly buffer Materials {
+	MaterialData u_Materials[];
+};
+
+layout(binding = 16) uniform sampler2DArray s_MaterialArrays[MAX_MATERIAL_ARRAYS];
+
+uniform int u_MaterialIndex;
+
+// The index is the same for the whole draw, so it's fine to pick the array with it
+vec4 SampleMaterialDiffuse(vec2 uv) {
+	ivec4 textures = u_Materials[u_MaterialIndex].Textures;
+	return texture(s_MaterialArrays[textures.x], vec3(uv, textures.y));
+}
+
+vec4 SampleMaterialSpecular(vec2 uv) {
+	ivec4 textures = u_Materials[u_MaterialIndex].Textures;
+	return texture(s_MaterialArrays[textures.z], vec3(uv, textures.w));
+}
+
+float GetMaterialShininess() {
+	return u_Materials[u_MaterialIndex].Params.x;
+}
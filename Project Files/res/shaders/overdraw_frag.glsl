@@ -0,0 +1,9 @@
+#version 410
+
+// Drawn with additive blending, so each pixel ends up holding the number of fragments shaded there
+out float frag_count;
+
+void main() 
+{
+	frag_count = 1.0;
+}
@@ -0,0 +1,25 @@
+#version 430
+
+layout(location = 0) in vec2 inUV;
+
+out vec4 frag_color;
+
+layout (binding = 0) uniform sampler2D s_Count;
+
+// Fragments per pixel that show up as full red
+uniform float u_Scale;
+
+void main() 
+{
+	float count = texelFetch(s_Count, ivec2(gl_FragCoord.xy), 0).r;
+	if (count < 0.5) {
+		frag_color = vec4(0.0, 0.0, 0.0, 1.0);
+		return;
+	}
+
+	// One fragment is blue, then green, yellow and red as the count climbs towards the scale
+	float t = clamp((count - 1.0) / max(u_Scale - 1.0, 1.0), 0.0, 1.0);
+	vec3 color = t < 0.5 ? mix(vec3(0.0, 0.2, 1.0), vec3(0.0, 1.0, 0.0), t * 2.0)
+	                     : mix(vec3(1.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0), t * 2.0 - 1.0);
+	frag_color = vec4(color, 1.0);
+}
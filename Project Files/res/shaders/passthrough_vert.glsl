@@ -1,12 +1,13 @@
 #version 410
 
-layout (location = 0) in vec3 inPosition;
-layout (location = 1) in vec2 inUV;
+// No vertex buffer, Framebuffer::DrawFullscreenQuad draws 3 vertices and we place them from gl_VertexID
 
 layout(location = 0) out vec2 outUV;
 
 void main()
 { 
-	outUV = inUV;
-	gl_Position = vec4(inPosition, 1.0);
-}
\ No newline at end of file
+	// (-1, -1), (3, -1) and (-1, 3), one triangle covering the screen (the parts off screen are clipped)
+	vec2 uv = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	outUV = uv;
+	gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+}
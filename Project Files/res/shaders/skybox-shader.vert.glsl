@@ -1,17 +1,21 @@
 #version 410
 
-layout(location = 0) in vec3 inPosition;
+// No vertex buffer, the three vertices of one triangle that covers the screen come from gl_VertexID
 
 layout(location = 0) out vec3 outNormal;
 
-uniform mat4 u_SkyboxMatrix;
+// Inverse of u_SkyboxMatrix (projection * the rotation of the view), takes the screen back to a direction
+uniform mat4 u_InverseSkyboxMatrix;
 uniform mat3 u_EnvironmentRotation;
 
 void main() {
-    vec4 pos = u_SkyboxMatrix * vec4(inPosition, 1.0);
-    gl_Position = pos.xyww;
+    // (-1, -1), (3, -1) and (-1, 3), the parts off screen are clipped away
+    vec2 ndc = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
 
-    // Normals
-    outNormal = u_EnvironmentRotation * inPosition;
-}
+    // Sits on the far plane, so it only passes the depth test where nothing has been drawn
+    gl_Position = vec4(ndc, 1.0, 1.0);
 
+    // w is the same everywhere on the far plane, so the direction interpolates correctly across the triangle
+    vec4 dir = u_InverseSkyboxMatrix * vec4(ndc, 1.0, 1.0);
+    outNormal = u_EnvironmentRotation * (dir.xyz / dir.w);
+}
@@ -14,11 +14,25 @@ uniform mat4 u_ModelViewProjection;
 uniform mat4 u_View;
 uniform mat4 u_Model;
 uniform mat3 u_NormalMatrix;
-uniform vec3 u_LightPos;
+
+// The depth pre-pass (depth_only_vert.glsl) has to land on exactly the same depth
+invariant gl_Position;
+
+//Features (defined by ShaderVariants, each one is its own program)
+//SIN_WAVE: ripples the surface along z over time
+#ifdef SIN_WAVE
+#include "lighting_block.glsl"
+#endif
 
 void main() {
 
+#ifdef SIN_WAVE
+    vec3 vert = inPosition;
+    vert.z = sin(vert.x * 3.0 + u_WaveTime * 0.1) * 0.25;
+    gl_Position = u_ModelViewProjection * vec4(vert, 1.0);
+#else
     gl_Position = u_ModelViewProjection * vec4(inPosition, 1.0);
+#endif
 
     outPos = (u_Model * vec4(inPosition, 1.0)).xyz;
     
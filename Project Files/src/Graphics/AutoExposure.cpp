@@ -0,0 +1,300 @@
+#include "AutoExposure.h"
+
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include "Graphics/ShaderManager.h"
+#include "Graphics/GLStateCache.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define EXPOSURE_SIMD 1
+#include <emmintrin.h>
+#else
+#define EXPOSURE_SIMD 0
+#endif
+
+//Anything darker than this goes in the first bin, which the average leaves out
+static const float BLACK_LUMINANCE = 0.0001f;
+
+void AutoExposure::Init()
+{
+	//Compute shaders need 4.3, without them we can only use the CPU path
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	_computeSupported = major > 4 || (major == 4 && minor >= 3);
+	if (_computeSupported)
+	{
+		_histogramShader = ShaderManager::LoadCompute("shaders/exposure_histogram_comp.glsl");
+		_averageShader = ShaderManager::LoadCompute("shaders/exposure_average_comp.glsl");
+	}
+	UseCompute = _computeSupported;
+
+	_small.AddColorTarget(GL_RGBA16F);
+
+	//The average shader clears the bins as it reads them, so they only need zeroing once
+	glGenBuffers(1, &_histogramBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, _histogramBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, NUM_BINS * sizeof(uint32_t), _bins, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	glGenTextures(1, &_exposureTexture);
+	GLStateCache::BindTexture(0, GL_TEXTURE_2D, _exposureTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, 1, 1);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RED, GL_FLOAT, &_exposure);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	GLStateCache::BindTexture(0, GL_TEXTURE_2D, GL_NONE);
+
+	for (Slot& slot : _slots)
+		glGenBuffers(1, &slot.pbo);
+}
+
+void AutoExposure::Unload()
+{
+	for (Slot& slot : _slots)
+	{
+		if (slot.fence != nullptr)
+			glDeleteSync(slot.fence);
+		slot.fence = nullptr;
+		glDeleteBuffers(1, &slot.pbo);
+	}
+	glDeleteBuffers(1, &_histogramBuffer);
+
+	GLStateCache::ForgetTexture(_exposureTexture);
+	glDeleteTextures(1, &_exposureTexture);
+	_exposureTexture = 0;
+
+	if (_small._width > 0)
+		_small.Unload();
+}
+
+void AutoExposure::Update(Framebuffer& scene, float deltaTime)
+{
+	if (!Enabled)
+		return;
+
+	unsigned width = std::max(scene._width / DOWNSAMPLE, 1u);
+	unsigned height = std::max(scene._height / DOWNSAMPLE, 1u);
+	if (_small._width != width || _small._height != height)
+	{
+		if (_small._width == 0)
+			_small.Init(width, height);
+		else
+			_small.Reshape(width, height);
+	}
+
+	//A linear blit averages the scene down, a quarter of the size is plenty for an average
+	scene.BlitColorTo(_small, 0, GL_LINEAR);
+
+	if (UseCompute && _computeSupported)
+		UpdateCompute(deltaTime);
+	else
+		UpdateCpu(deltaTime);
+}
+
+void AutoExposure::BindExposure(int textureSlot) const
+{
+	GLStateCache::BindTexture(textureSlot, GL_TEXTURE_2D, _exposureTexture);
+}
+
+void AutoExposure::UpdateCompute(float deltaTime)
+{
+	//Bin every pixel, each workgroup keeps its own bins in shared memory and adds them in at the end
+	GLStateCache::UseProgram(_histogramShader->GetHandle());
+	_small.BindColorAsTexture(0, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, HISTOGRAM_BINDING, _histogramBuffer);
+	_histogramShader->SetUniform("u_MinLogLuminance", MinLogLuminance);
+	_histogramShader->SetUniform("u_InverseLogLuminanceRange", 1.0f / (MaxLogLuminance - MinLogLuminance));
+	glDispatchCompute((_small._width + 15) / 16, (_small._height + 15) / 16, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	//One workgroup averages the bins and moves the exposure along, it never leaves the GPU
+	GLStateCache::UseProgram(_averageShader->GetHandle());
+	glBindImageTexture(0, _exposureTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+	_averageShader->SetUniform("u_MinLogLuminance", MinLogLuminance);
+	_averageShader->SetUniform("u_LogLuminanceRange", MaxLogLuminance - MinLogLuminance);
+	_averageShader->SetUniform("u_KeyValue", KeyValue);
+	_averageShader->SetUniform("u_Adapt", GetAdaptAmount(deltaTime));
+	_averageShader->SetUniform("u_PixelCount", float(_small._width * _small._height));
+	glDispatchCompute(1, 1, 1);
+
+	//The color correction samples the exposure next
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+	_small.UnbindTexture(0);
+	GLStateCache::UseProgram(GL_NONE);
+}
+
+void AutoExposure::UpdateCpu(float deltaTime)
+{
+	//Bin the newest read back that has finished, older ones are just let go
+	Slot* newest = nullptr;
+	for (int i = 1; i <= FRAMES_IN_FLIGHT; i++)
+	{
+		//Walking back from the slot we wrote last finds the newest first
+		Slot& slot = _slots[(_nextSlot + FRAMES_IN_FLIGHT - i) % FRAMES_IN_FLIGHT];
+		if (slot.fence == nullptr)
+			continue;
+
+		//A zero timeout only asks, it never waits
+		GLenum status = glClientWaitSync(slot.fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			continue;
+
+		glDeleteSync(slot.fence);
+		slot.fence = nullptr;
+		if (newest == nullptr)
+			newest = &slot;
+	}
+
+	if (newest != nullptr)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, newest->pbo);
+		const float* pixels = (const float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, newest->pixels * 4 * sizeof(float), GL_MAP_READ_BIT);
+		if (pixels != nullptr)
+		{
+			BuildHistogram(pixels, newest->pixels, MinLogLuminance, MaxLogLuminance, _bins);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			_target = GetTargetExposure(_bins, newest->pixels);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, GL_NONE);
+
+		_cpuTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	//Start reading this frame back, unless every slot is still waiting on the GPU
+	Slot& slot = _slots[_nextSlot];
+	if (slot.fence == nullptr)
+	{
+		slot.pixels = size_t(_small._width) * _small._height;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+		if (slot.capacity < slot.pixels)
+		{
+			slot.capacity = slot.pixels;
+			glBufferData(GL_PIXEL_PACK_BUFFER, slot.capacity * 4 * sizeof(float), nullptr, GL_STREAM_READ);
+		}
+		_small.ReadColor(0, GL_RGBA, GL_FLOAT, nullptr);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, GL_NONE);
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		_nextSlot = (_nextSlot + 1) % FRAMES_IN_FLIGHT;
+	}
+
+	//Adapt in stops so brightening and darkening feel the same
+	float logExposure = std::log2(_exposure);
+	_exposure = std::exp2(logExposure + (std::log2(_target) - logExposure) * GetAdaptAmount(deltaTime));
+	GLStateCache::BindTexture(0, GL_TEXTURE_2D, _exposureTexture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RED, GL_FLOAT, &_exposure);
+	GLStateCache::BindTexture(0, GL_TEXTURE_2D, GL_NONE);
+}
+
+float AutoExposure::GetTargetExposure(const uint32_t* bins, size_t pixels) const
+{
+	//Same as exposure_average_comp.glsl, the black bin is left out so a dark sky doesn't blow everything else out
+	double weighted = 0.0;
+	for (int i = 1; i < NUM_BINS; i++)
+		weighted += double(bins[i]) * i;
+	double lit = std::max(double(pixels) - bins[0], 1.0);
+
+	float averageBin = float(weighted / lit);
+	float logLuminance = std::clamp((averageBin - 1.0f) / (NUM_BINS - 2) * (MaxLogLuminance - MinLogLuminance) + MinLogLuminance,
+		MinLogLuminance, MaxLogLuminance);
+	return KeyValue / std::exp2(logLuminance);
+}
+
+float AutoExposure::GetAdaptAmount(float deltaTime) const
+{
+	//Framerate independent, the same fraction of the way is covered every second
+	return 1.0f - std::exp(-deltaTime * AdaptSpeed);
+}
+
+void AutoExposure::BuildHistogram(const float* pixels, size_t count, float minLogLuminance, float maxLogLuminance, uint32_t* bins)
+{
+	std::fill(bins, bins + NUM_BINS, 0u);
+	float scale = (NUM_BINS - 2) / (maxLogLuminance - minLogLuminance);
+
+	size_t done = 0;
+#if EXPOSURE_SIMD
+	__m128 lumR = _mm_set1_ps(0.2126f);
+	__m128 lumG = _mm_set1_ps(0.7152f);
+	__m128 lumB = _mm_set1_ps(0.0722f);
+	__m128 black = _mm_set1_ps(BLACK_LUMINANCE);
+	__m128 minLog = _mm_set1_ps(minLogLuminance);
+	__m128 scaleV = _mm_set1_ps(scale);
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 lastBin = _mm_set1_ps(float(NUM_BINS - 1));
+	__m128i mantissaMask = _mm_set1_epi32(0x007FFFFF);
+	__m128i bias = _mm_set1_epi32(127);
+	__m128 c1 = _mm_set1_ps(1.4234902f);
+	__m128 c2 = _mm_set1_ps(-0.5877535f);
+	__m128 c3 = _mm_set1_ps(0.1655761f);
+
+	alignas(16) int32_t index[4];
+	for (; done + 4 <= count; done += 4)
+	{
+		//Four RGBA pixels, turned around into four reds, four greens and four blues
+		__m128 p0 = _mm_loadu_ps(pixels + done * 4);
+		__m128 p1 = _mm_loadu_ps(pixels + done * 4 + 4);
+		__m128 p2 = _mm_loadu_ps(pixels + done * 4 + 8);
+		__m128 p3 = _mm_loadu_ps(pixels + done * 4 + 12);
+		_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+		__m128 luminance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p0, lumR), _mm_mul_ps(p1, lumG)), _mm_mul_ps(p2, lumB));
+		__m128 lit = _mm_cmpge_ps(luminance, black);
+		luminance = _mm_max_ps(luminance, black);
+
+		//log2 is the exponent bits plus a polynomial fit of log2 over the mantissa (good to about a thousandth of a stop)
+		__m128i bits = _mm_castps_si128(luminance);
+		__m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), bias));
+		__m128 m = _mm_sub_ps(_mm_or_ps(_mm_castsi128_ps(_mm_and_si128(bits, mantissaMask)), one), one);
+		__m128 logLuminance = _mm_add_ps(exponent, _mm_mul_ps(m, _mm_add_ps(c1, _mm_mul_ps(m, _mm_add_ps(c2, _mm_mul_ps(m, c3))))));
+
+		//Bins 1 to 255 cover the range, black pixels go in bin 0
+		__m128 bin = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(logLuminance, minLog), scaleV), one);
+		bin = _mm_min_ps(_mm_max_ps(bin, one), lastBin);
+		bin = _mm_and_ps(bin, lit);
+		_mm_store_si128((__m128i*)index, _mm_cvttps_epi32(bin));
+
+		bins[index[0]]++;
+		bins[index[1]]++;
+		bins[index[2]]++;
+		bins[index[3]]++;
+	}
+#endif
+
+	//Whatever is left over (or everything, without SSE)
+	for (; done < count; done++)
+	{
+		const float* pixel = pixels + done * 4;
+		float luminance = 0.2126f * pixel[0] + 0.7152f * pixel[1] + 0.0722f * pixel[2];
+		//Written this way around so NaNs count as black too
+		if (!(luminance >= BLACK_LUMINANCE))
+		{
+			bins[0]++;
+			continue;
+		}
+		float bin = (std::log2(luminance) - minLogLuminance) * scale + 1.0f;
+		bins[int(std::clamp(bin, 1.0f, float(NUM_BINS - 1)))]++;
+	}
+}
+
+bool AutoExposure::IsSimdSupported()
+{
+	return EXPOSURE_SIMD != 0;
+}
+
+float AutoExposure::GetExposure() const
+{
+	return _exposure;
+}
+
+double AutoExposure::GetCpuTime() const
+{
+	return _cpuTime;
+}
+
+const uint32_t* AutoExposure::GetHistogram() const
+{
+	return _bins;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+#include <Shader.h>
+
+#include "Graphics/Framebuffer.h"
+
+//Sets the exposure from how bright the scene is, like an eye adjusting to the dark
+//*The scene is shrunk to a quarter of its size and binned into a 256 bin histogram of log luminance
+//*The histogram's average (leaving out black pixels) says what exposure would put the scene at middle grey
+//*The exposure moves towards that a little each frame instead of jumping
+//*On the GPU the exposure lives in a 1x1 texture the color correction samples, nothing is read back
+//*The CPU path (for headless runs on software contexts) reads the small target back a few frames late and bins it with SIMD
+class AutoExposure
+{
+public:
+	static const int NUM_BINS = 256;
+	//Read backs that can be waiting on the GPU at once (CPU path only)
+	static const int FRAMES_IN_FLIGHT = 3;
+	//The scene is shrunk by this much on each side before it's binned
+	static const unsigned DOWNSAMPLE = 4;
+
+	//Shader storage binding point (matches the exposure compute shaders)
+	static const GLuint HISTOGRAM_BINDING = 6;
+
+	void Init();
+	void Unload();
+
+	//Bins the lit scene and moves the exposure towards where it should be, call after the scene is drawn
+	void Update(Framebuffer& scene, float deltaTime);
+	//Binds the 1x1 exposure texture for the color correction to sample
+	void BindExposure(int textureSlot) const;
+
+	//Bins pixels (RGBA floats) into a log luminance histogram, uses SSE when we have it
+	static void BuildHistogram(const float* pixels, size_t count, float minLogLuminance, float maxLogLuminance, uint32_t* bins);
+	static bool IsSimdSupported();
+
+	bool Enabled = false;
+	//Build the histogram with compute shaders, the CPU path is used when this is off (or compute isn't supported)
+	bool UseCompute = true;
+	//Range of luminance the histogram covers, in stops (anything darker counts as black)
+	float MinLogLuminance = -8.0f;
+	float MaxLogLuminance = 4.0f;
+	//The average luminance is exposed to this
+	float KeyValue = 0.18f;
+	//How quickly the exposure catches up, higher is faster
+	float AdaptSpeed = 1.5f;
+
+	//Statistics
+	//Exposure from the CPU path (the GPU one stays on the GPU)
+	float GetExposure() const;
+	//Time spent binning on the CPU (ms)
+	double GetCpuTime() const;
+	//Newest histogram from the CPU path
+	const uint32_t* GetHistogram() const;
+
+private:
+	struct Slot
+	{
+		GLuint pbo = 0;
+		size_t capacity = 0;
+		GLsync fence = nullptr;
+		size_t pixels = 0;
+	};
+
+	void UpdateCompute(float deltaTime);
+	void UpdateCpu(float deltaTime);
+	//Where the average of a histogram says the exposure should be
+	float GetTargetExposure(const uint32_t* bins, size_t pixels) const;
+	//How far to move towards the target this frame
+	float GetAdaptAmount(float deltaTime) const;
+
+	Shader::sptr _histogramShader;
+	Shader::sptr _averageShader;
+	bool _computeSupported = false;
+
+	Framebuffer _small;
+	GLuint _histogramBuffer = 0;
+	GLuint _exposureTexture = 0;
+
+	Slot _slots[FRAMES_IN_FLIGHT];
+	int _nextSlot = 0;
+	uint32_t _bins[NUM_BINS] = {};
+	float _exposure = 1.0f;
+	float _target = 1.0f;
+	double _cpuTime = 0.0;
+};
@@ -0,0 +1,192 @@
+#include "CaptureRecorder.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+
+CaptureRecorder::CaptureRecorder(unsigned numEncoders)
+	: _encoders(numEncoders), _encoded(0), _encodeMicroseconds(0)
+{
+}
+
+CaptureRecorder::~CaptureRecorder()
+{
+	_encoders.WaitIdle();
+}
+
+void CaptureRecorder::RequestScreenshot(const std::string& path, ImageWriter::Format format)
+{
+	_screenshotPath = path;
+	_screenshotFormat = format;
+}
+
+void CaptureRecorder::StartRecording(const std::string& directory, ImageWriter::Format format)
+{
+	std::filesystem::create_directories(directory);
+
+	_recordDirectory = directory;
+	_recordFormat = format;
+	_recordFrame = 0;
+	_recording = true;
+}
+
+void CaptureRecorder::StopRecording()
+{
+	_recording = false;
+}
+
+bool CaptureRecorder::IsRecording() const
+{
+	return _recording;
+}
+
+void CaptureRecorder::EndFrame(Framebuffer* finalFrame)
+{
+	bool wantFrame = _recording || !_screenshotPath.empty();
+
+	if (wantFrame)
+	{
+		//(Re)create the readback ring if the target changed size
+		if (_readback.GetWidth() != finalFrame->_width || _readback.GetHeight() != finalFrame->_height)
+		{
+			_readback.Flush();
+			_readback.Init(finalFrame->_width, finalFrame->_height,
+				[this](int frame, unsigned width, unsigned height, const unsigned char* pixels) {
+					OnFrameRead(frame, width, height, pixels);
+				});
+		}
+
+		//Work out where every file this frame goes
+		std::vector<Output>& outputs = _requests[_nextCaptureId];
+		if (!_screenshotPath.empty())
+		{
+			outputs.push_back({ _screenshotPath, _screenshotFormat, false });
+			_screenshotPath.clear();
+		}
+		if (_recording)
+		{
+			char fileName[32];
+			snprintf(fileName, sizeof(fileName), "/frame_%05d", _recordFrame++);
+			outputs.push_back({ _recordDirectory + fileName + ImageWriter::GetExtension(_recordFormat), _recordFormat, true });
+		}
+
+		_readback.Capture(finalFrame, _nextCaptureId++);
+	}
+
+	//Hand anything the GPU is done with to the encoders
+	_readback.Poll();
+}
+
+void CaptureRecorder::Flush()
+{
+	_readback.Flush();
+	_encoders.WaitIdle();
+}
+
+void CaptureRecorder::Unload()
+{
+	Flush();
+	_readback.Unload();
+}
+
+int CaptureRecorder::GetBacklog() const
+{
+	return _encoders.GetBusyCount();
+}
+
+int CaptureRecorder::GetPeakBacklog() const
+{
+	return _peakBacklog;
+}
+
+int CaptureRecorder::GetEncodedCount() const
+{
+	return _encoded;
+}
+
+int CaptureRecorder::GetDroppedCount() const
+{
+	return _dropped;
+}
+
+double CaptureRecorder::GetAverageEncodeTime() const
+{
+	int encoded = _encoded;
+	return encoded > 0 ? (double(_encodeMicroseconds) / 1000.0) / encoded : 0.0;
+}
+
+unsigned CaptureRecorder::GetEncoderCount() const
+{
+	return _encoders.GetThreadCount();
+}
+
+const FrameCapture& CaptureRecorder::GetReadback() const
+{
+	return _readback;
+}
+
+void CaptureRecorder::OnFrameRead(int frame, unsigned width, unsigned height, const unsigned char* pixels)
+{
+	auto it = _requests.find(frame);
+	if (it == _requests.end())
+		return;
+
+	std::vector<Output> outputs = it->second;
+	_requests.erase(it);
+
+	for (int i = 0; i < outputs.size(); i++)
+	{
+		Output output = outputs[i];
+
+		if (output.canDrop && _encoders.GetBusyCount() >= MaxBacklog)
+		{
+			if (DropWhenBehind)
+			{
+				_dropped++;
+				continue;
+			}
+			_encoders.WaitBelow(MaxBacklog);
+		}
+
+		//The mapped pointer is only valid until we return, so copy it out
+		size_t size = size_t(width) * height * 4;
+		std::shared_ptr<std::vector<unsigned char>> buffer = GetBuffer(size);
+		memcpy(buffer->data(), pixels, size);
+
+		_encoders.Enqueue([this, buffer, output, width, height]() {
+			auto start = std::chrono::high_resolution_clock::now();
+			ImageWriter::Write(output.format, output.path, width, height, buffer->data());
+			auto end = std::chrono::high_resolution_clock::now();
+
+			_encodeMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+			_encoded++;
+			ReturnBuffer(buffer);
+		});
+
+		int backlog = _encoders.GetBusyCount();
+		if (backlog > _peakBacklog)
+			_peakBacklog = backlog;
+	}
+}
+
+std::shared_ptr<std::vector<unsigned char>> CaptureRecorder::GetBuffer(size_t size)
+{
+	{
+		std::lock_guard<std::mutex> lock(_bufferMutex);
+		if (!_freeBuffers.empty())
+		{
+			std::shared_ptr<std::vector<unsigned char>> buffer = _freeBuffers.back();
+			_freeBuffers.pop_back();
+			buffer->resize(size);
+			return buffer;
+		}
+	}
+
+	return std::make_shared<std::vector<unsigned char>>(size);
+}
+
+void CaptureRecorder::ReturnBuffer(std::shared_ptr<std::vector<unsigned char>> buffer)
+{
+	std::lock_guard<std::mutex> lock(_bufferMutex);
+	_freeBuffers.push_back(buffer);
+}
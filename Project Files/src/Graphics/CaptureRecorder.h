@@ -0,0 +1,99 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+
+#include "Graphics/Framebuffer.h"
+#include "Graphics/FrameCapture.h"
+#include "Utilities/ThreadPool.h"
+#include "Utilities/ImageWriter.h"
+
+//Screenshots and frame sequence recording of the final post processed target
+//*Pixels come back through FrameCapture's PBO ring a few frames late
+//*Encoding happens on a pool of worker threads so the main thread never waits on disk
+class CaptureRecorder
+{
+public:
+	//Zero encoders picks a count from the hardware
+	CaptureRecorder(unsigned numEncoders = 0);
+	//Waits on everything still in flight
+	~CaptureRecorder();
+
+	//Captures the next frame into a single image
+	void RequestScreenshot(const std::string& path, ImageWriter::Format format = ImageWriter::PNG);
+	//Captures every frame from now on into the directory (frame_00000.png, ...)
+	void StartRecording(const std::string& directory, ImageWriter::Format format = ImageWriter::PNG);
+	void StopRecording();
+	bool IsRecording() const;
+
+	//Call once per frame after the final target has been drawn
+	//*Queues a read if we want this frame, and hands finished reads to the encoders
+	void EndFrame(Framebuffer* finalFrame);
+	//Waits on every outstanding read and encode
+	void Flush();
+	//Releases the GL objects (call while the context is still alive)
+	void Unload();
+
+	//Most recorded frames we let wait on the encoders
+	int MaxBacklog = 64;
+	//What to do once the backlog is full, drop frames (interactive) or wait on the encoders (headless runs)
+	bool DropWhenBehind = true;
+
+	//Metrics
+	//Frames waiting on (or being written by) the encoders
+	int GetBacklog() const;
+	int GetPeakBacklog() const;
+	int GetEncodedCount() const;
+	int GetDroppedCount() const;
+	//Average time to encode and write one frame (in milliseconds)
+	double GetAverageEncodeTime() const;
+	unsigned GetEncoderCount() const;
+	//GPU readback metrics
+	const FrameCapture& GetReadback() const;
+
+private:
+	//Where a captured frame should go
+	struct Output
+	{
+		std::string path;
+		ImageWriter::Format format;
+		//Recorded frames can be dropped when the encoders fall behind, screenshots can't
+		bool canDrop;
+	};
+
+	//Called by FrameCapture once a frame's pixels are mapped
+	void OnFrameRead(int frame, unsigned width, unsigned height, const unsigned char* pixels);
+
+	//Gets a buffer from the free list (or makes one)
+	std::shared_ptr<std::vector<unsigned char>> GetBuffer(size_t size);
+	//Puts a buffer back on the free list
+	void ReturnBuffer(std::shared_ptr<std::vector<unsigned char>> buffer);
+
+	FrameCapture _readback;
+	ThreadPool _encoders;
+
+	//Outputs waiting on their read, keyed by capture id
+	std::unordered_map<int, std::vector<Output>> _requests;
+	int _nextCaptureId = 0;
+
+	//Pending screenshot (empty if none)
+	std::string _screenshotPath;
+	ImageWriter::Format _screenshotFormat = ImageWriter::PNG;
+
+	bool _recording = false;
+	std::string _recordDirectory;
+	ImageWriter::Format _recordFormat = ImageWriter::PNG;
+	int _recordFrame = 0;
+
+	//Recycled pixel buffers so recording doesn't allocate every frame
+	std::vector<std::shared_ptr<std::vector<unsigned char>>> _freeBuffers;
+	std::mutex _bufferMutex;
+
+	std::atomic<int> _encoded;
+	std::atomic<long long> _encodeMicroseconds;
+	int _dropped = 0;
+	int _peakBacklog = 0;
+};
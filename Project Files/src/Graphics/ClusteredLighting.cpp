@@ -0,0 +1,328 @@
+#include "ClusteredLighting.h"
+
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define CLUSTER_SIMD 1
+#include <emmintrin.h>
+#else
+#define CLUSTER_SIMD 0
+#endif
+
+void ClusteredLighting::Init()
+{
+	glGenBuffers(1, &_lightBuffer);
+	glGenBuffers(1, &_clusterBuffer);
+	glGenBuffers(1, &_indexBuffer);
+
+	//Storage buffers can't be empty, start each one off with something in it
+	uint32_t zero[4] = { 0, 0, 0, 0 };
+	Upload(_lightBuffer, _lightCapacity, zero, sizeof(zero));
+	Upload(_indexBuffer, _indexCapacity, zero, sizeof(zero));
+	_clusterData.assign(sizeof(ClusterHeader) / sizeof(uint32_t) + NUM_CLUSTERS * 2, 0);
+	Upload(_clusterBuffer, _clusterCapacity, _clusterData.data(), _clusterData.size() * sizeof(uint32_t));
+
+	//Nothing else uses these binding points, so they only need binding once
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING, _lightBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BINDING, _clusterBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDEX_BINDING, _indexBuffer);
+}
+
+void ClusteredLighting::Unload()
+{
+	GLuint buffers[3] = { _lightBuffer, _clusterBuffer, _indexBuffer };
+	glDeleteBuffers(3, buffers);
+	_lightBuffer = _clusterBuffer = _indexBuffer = 0;
+	_lightCapacity = _clusterCapacity = _indexCapacity = 0;
+}
+
+void ClusteredLighting::Update(const glm::mat4& view, const glm::mat4& projection, unsigned width, unsigned height)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//Pull the clip planes back out of the projection (an orthographic one doesn't divide by depth, so its last row is 0, 0, 0, 1)
+	_orthographic = projection[2][3] == 0.0f;
+	float nearPlane, farPlane;
+	if (_orthographic)
+	{
+		nearPlane = (projection[3][2] + 1.0f) / projection[2][2];
+		farPlane = (projection[3][2] - 1.0f) / projection[2][2];
+	}
+	else
+	{
+		nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+		farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+	}
+	//An orthographic near plane can sit on (or behind) the camera, the slices are logarithmic so they start a little in front
+	float depthRange = _orthographic ? farPlane - nearPlane : 0.0f;
+	float depthOffset = _orthographic ? nearPlane : 0.0f;
+	if (_orthographic)
+		nearPlane = std::max(nearPlane, farPlane * 0.0001f);
+
+	uint32_t lightCount = uint32_t(Lights.size());
+	const size_t headerSize = sizeof(ClusterHeader) / sizeof(uint32_t);
+	ClusterHeader header;
+
+	if (!Clustered)
+	{
+		//One cluster the size of the screen that holds every light
+		header = { { 1, 1, 1, lightCount }, { nearPlane, farPlane, 0.0f, 0.0f },
+			{ float(width) + 1.0f, float(height) + 1.0f, depthRange, depthOffset } };
+		_clusterData.assign(headerSize + 2, 0);
+		_clusterData[headerSize + 1] = lightCount;
+		_indices.resize(lightCount);
+		for (uint32_t i = 0; i < lightCount; i++)
+			_indices[i] = i;
+
+		_maxLightsPerCluster = lightCount;
+		_activeClusters = lightCount > 0 ? 1 : 0;
+	}
+	else
+	{
+		//Slices get thicker further away so clusters stay roughly cube shaped
+		float logRange = std::log(farPlane / nearPlane);
+		_sliceScale = float(SLICES) / logRange;
+		_sliceBias = -float(SLICES) * std::log(nearPlane) / logRange;
+
+		header = { { TILES_X, TILES_Y, SLICES, lightCount }, { nearPlane, farPlane, _sliceScale, _sliceBias },
+			{ float(width) / TILES_X, float(height) / TILES_Y, depthRange, depthOffset } };
+
+		_bounds.resize(lightCount);
+		//The SIMD path only knows perspective
+		size_t done = UseSimd && !_orthographic ? BoundLightsSimd(view, projection, nearPlane, farPlane) : 0;
+		BoundLightsScalar(view, projection, nearPlane, farPlane, done);
+
+		//Count the lights in each cluster
+		_clusterData.assign(headerSize + NUM_CLUSTERS * 2, 0);
+		uint32_t* ranges = _clusterData.data() + headerSize;
+		for (const LightBounds& bounds : _bounds)
+			for (int z = bounds.zMin; z <= bounds.zMax; z++)
+				for (int y = bounds.yMin; y <= bounds.yMax; y++)
+					for (int x = bounds.xMin; x <= bounds.xMax; x++)
+						ranges[(x + TILES_X * (y + TILES_Y * z)) * 2 + 1]++;
+
+		//Give each cluster its own part of the index list
+		uint32_t offset = 0;
+		_maxLightsPerCluster = 0;
+		_activeClusters = 0;
+		for (int cluster = 0; cluster < NUM_CLUSTERS; cluster++)
+		{
+			uint32_t count = ranges[cluster * 2 + 1];
+			ranges[cluster * 2] = offset;
+			ranges[cluster * 2 + 1] = 0;
+			offset += count;
+			_maxLightsPerCluster = std::max(_maxLightsPerCluster, int(count));
+			_activeClusters += count > 0 ? 1 : 0;
+		}
+
+		//Fill in the lists (the counts build back up as we go)
+		_indices.resize(std::max(offset, 1u));
+		for (uint32_t light = 0; light < lightCount; light++)
+		{
+			const LightBounds& bounds = _bounds[light];
+			for (int z = bounds.zMin; z <= bounds.zMax; z++)
+				for (int y = bounds.yMin; y <= bounds.yMax; y++)
+					for (int x = bounds.xMin; x <= bounds.xMax; x++)
+					{
+						uint32_t* range = ranges + (x + TILES_X * (y + TILES_Y * z)) * 2;
+						_indices[range[0] + range[1]++] = light;
+					}
+		}
+		_indices.resize(offset);
+	}
+
+	memcpy(_clusterData.data(), &header, sizeof(header));
+
+	_assignTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	if (lightCount > 0)
+		Upload(_lightBuffer, _lightCapacity, Lights.data(), lightCount * sizeof(PointLight));
+	if (!_indices.empty())
+		Upload(_indexBuffer, _indexCapacity, _indices.data(), _indices.size() * sizeof(uint32_t));
+	Upload(_clusterBuffer, _clusterCapacity, _clusterData.data(), _clusterData.size() * sizeof(uint32_t));
+}
+
+void ClusteredLighting::BoundLightsScalar(const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane, size_t first)
+{
+	for (size_t i = first; i < Lights.size(); i++)
+	{
+		const PointLight& light = Lights[i];
+		LightBounds& bounds = _bounds[i];
+		bounds = { 0, -1, 0, -1, 1, 0 };
+
+		glm::vec4 center = view * glm::vec4(light.Position, 1.0f);
+		float depthMin = -center.z - light.Radius;
+		float depthMax = -center.z + light.Radius;
+		if (depthMax <= nearPlane || depthMin >= farPlane)
+			continue;
+		float depthNear = std::max(depthMin, nearPlane);
+
+		//The box around the sphere is widest on screen at one of its two depths
+		float xLo = (center.x - light.Radius) * projection[0][0];
+		float xHi = (center.x + light.Radius) * projection[0][0];
+		float yLo = (center.y - light.Radius) * projection[1][1];
+		float yHi = (center.y + light.Radius) * projection[1][1];
+		float ndcXMin, ndcXMax, ndcYMin, ndcYMax;
+		if (_orthographic)
+		{
+			//Same size at every depth, but the box doesn't have to be centered
+			ndcXMin = xLo + projection[3][0];
+			ndcXMax = xHi + projection[3][0];
+			ndcYMin = yLo + projection[3][1];
+			ndcYMax = yHi + projection[3][1];
+		}
+		else
+		{
+			ndcXMin = std::min(xLo / depthNear, xLo / depthMax);
+			ndcXMax = std::max(xHi / depthNear, xHi / depthMax);
+			ndcYMin = std::min(yLo / depthNear, yLo / depthMax);
+			ndcYMax = std::max(yHi / depthNear, yHi / depthMax);
+		}
+		if (ndcXMax < -1.0f || ndcXMin > 1.0f || ndcYMax < -1.0f || ndcYMin > 1.0f)
+			continue;
+
+		bounds.xMin = std::clamp(int((ndcXMin * 0.5f + 0.5f) * TILES_X), 0, TILES_X - 1);
+		bounds.xMax = std::clamp(int((ndcXMax * 0.5f + 0.5f) * TILES_X), 0, TILES_X - 1);
+		bounds.yMin = std::clamp(int((ndcYMin * 0.5f + 0.5f) * TILES_Y), 0, TILES_Y - 1);
+		bounds.yMax = std::clamp(int((ndcYMax * 0.5f + 0.5f) * TILES_Y), 0, TILES_Y - 1);
+		SetSlices(bounds, depthNear, depthMax, nearPlane, farPlane);
+	}
+}
+
+size_t ClusteredLighting::BoundLightsSimd(const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane)
+{
+#if CLUSTER_SIMD
+	size_t count = Lights.size() & ~size_t(3);
+
+	__m128 m00 = _mm_set1_ps(view[0][0]), m10 = _mm_set1_ps(view[1][0]), m20 = _mm_set1_ps(view[2][0]), m30 = _mm_set1_ps(view[3][0]);
+	__m128 m01 = _mm_set1_ps(view[0][1]), m11 = _mm_set1_ps(view[1][1]), m21 = _mm_set1_ps(view[2][1]), m31 = _mm_set1_ps(view[3][1]);
+	__m128 m02 = _mm_set1_ps(view[0][2]), m12 = _mm_set1_ps(view[1][2]), m22 = _mm_set1_ps(view[2][2]), m32 = _mm_set1_ps(view[3][2]);
+	__m128 p00 = _mm_set1_ps(projection[0][0]);
+	__m128 p11 = _mm_set1_ps(projection[1][1]);
+	__m128 nearV = _mm_set1_ps(nearPlane);
+	__m128 farV = _mm_set1_ps(farPlane);
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 minusOne = _mm_set1_ps(-1.0f);
+	__m128 zero = _mm_setzero_ps();
+	__m128 halfTilesX = _mm_set1_ps(TILES_X * 0.5f);
+	__m128 halfTilesY = _mm_set1_ps(TILES_Y * 0.5f);
+	__m128 lastTileX = _mm_set1_ps(float(TILES_X - 1));
+	__m128 lastTileY = _mm_set1_ps(float(TILES_Y - 1));
+
+	alignas(16) int tiles[4][4];
+	alignas(16) float depths[2][4];
+
+	for (size_t i = 0; i < count; i += 4)
+	{
+		const PointLight* light = &Lights[i];
+		__m128 px = _mm_setr_ps(light[0].Position.x, light[1].Position.x, light[2].Position.x, light[3].Position.x);
+		__m128 py = _mm_setr_ps(light[0].Position.y, light[1].Position.y, light[2].Position.y, light[3].Position.y);
+		__m128 pz = _mm_setr_ps(light[0].Position.z, light[1].Position.z, light[2].Position.z, light[3].Position.z);
+		__m128 radius = _mm_setr_ps(light[0].Radius, light[1].Radius, light[2].Radius, light[3].Radius);
+
+		//Into view space
+		__m128 cx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, px), _mm_mul_ps(m10, py)), _mm_add_ps(_mm_mul_ps(m20, pz), m30));
+		__m128 cy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m01, px), _mm_mul_ps(m11, py)), _mm_add_ps(_mm_mul_ps(m21, pz), m31));
+		__m128 cz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m02, px), _mm_mul_ps(m12, py)), _mm_add_ps(_mm_mul_ps(m22, pz), m32));
+
+		__m128 depth = _mm_sub_ps(zero, cz);
+		__m128 depthMin = _mm_sub_ps(depth, radius);
+		__m128 depthMax = _mm_add_ps(depth, radius);
+		__m128 visible = _mm_and_ps(_mm_cmpgt_ps(depthMax, nearV), _mm_cmplt_ps(depthMin, farV));
+		__m128 depthNear = _mm_max_ps(depthMin, nearV);
+		__m128 invNear = _mm_div_ps(one, depthNear);
+		__m128 invFar = _mm_div_ps(one, depthMax);
+
+		//The box around the sphere is widest on screen at one of its two depths
+		__m128 xLo = _mm_mul_ps(_mm_sub_ps(cx, radius), p00);
+		__m128 xHi = _mm_mul_ps(_mm_add_ps(cx, radius), p00);
+		__m128 yLo = _mm_mul_ps(_mm_sub_ps(cy, radius), p11);
+		__m128 yHi = _mm_mul_ps(_mm_add_ps(cy, radius), p11);
+		__m128 ndcXMin = _mm_min_ps(_mm_mul_ps(xLo, invNear), _mm_mul_ps(xLo, invFar));
+		__m128 ndcXMax = _mm_max_ps(_mm_mul_ps(xHi, invNear), _mm_mul_ps(xHi, invFar));
+		__m128 ndcYMin = _mm_min_ps(_mm_mul_ps(yLo, invNear), _mm_mul_ps(yLo, invFar));
+		__m128 ndcYMax = _mm_max_ps(_mm_mul_ps(yHi, invNear), _mm_mul_ps(yHi, invFar));
+		visible = _mm_and_ps(visible, _mm_and_ps(_mm_cmpge_ps(ndcXMax, minusOne), _mm_cmple_ps(ndcXMin, one)));
+		visible = _mm_and_ps(visible, _mm_and_ps(_mm_cmpge_ps(ndcYMax, minusOne), _mm_cmple_ps(ndcYMin, one)));
+
+		//Clamped to the grid before truncating, so truncating is the same as flooring
+		__m128 txMin = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(ndcXMin, halfTilesX), halfTilesX), zero), lastTileX);
+		__m128 txMax = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(ndcXMax, halfTilesX), halfTilesX), zero), lastTileX);
+		__m128 tyMin = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(ndcYMin, halfTilesY), halfTilesY), zero), lastTileY);
+		__m128 tyMax = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(ndcYMax, halfTilesY), halfTilesY), zero), lastTileY);
+		_mm_store_si128((__m128i*)tiles[0], _mm_cvttps_epi32(txMin));
+		_mm_store_si128((__m128i*)tiles[1], _mm_cvttps_epi32(txMax));
+		_mm_store_si128((__m128i*)tiles[2], _mm_cvttps_epi32(tyMin));
+		_mm_store_si128((__m128i*)tiles[3], _mm_cvttps_epi32(tyMax));
+		_mm_store_ps(depths[0], depthNear);
+		_mm_store_ps(depths[1], depthMax);
+		int mask = _mm_movemask_ps(visible);
+
+		for (int lane = 0; lane < 4; lane++)
+		{
+			LightBounds& bounds = _bounds[i + lane];
+			if (!(mask & (1 << lane)))
+			{
+				bounds = { 0, -1, 0, -1, 1, 0 };
+				continue;
+			}
+			bounds.xMin = tiles[0][lane];
+			bounds.xMax = tiles[1][lane];
+			bounds.yMin = tiles[2][lane];
+			bounds.yMax = tiles[3][lane];
+			SetSlices(bounds, depths[0][lane], depths[1][lane], nearPlane, farPlane);
+		}
+	}
+	return count;
+#else
+	return 0;
+#endif
+}
+
+void ClusteredLighting::SetSlices(LightBounds& bounds, float depthMin, float depthMax, float nearPlane, float farPlane) const
+{
+	depthMax = std::min(depthMax, farPlane);
+	bounds.zMin = std::clamp(int(std::log(depthMin) * _sliceScale + _sliceBias), 0, SLICES - 1);
+	bounds.zMax = std::clamp(int(std::log(depthMax) * _sliceScale + _sliceBias), 0, SLICES - 1);
+}
+
+void ClusteredLighting::Upload(GLuint buffer, size_t& capacity, const void* data, size_t size)
+{
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	if (size > capacity)
+	{
+		//Grow by half again so adding lights one at a time doesn't reallocate every frame
+		capacity = std::max(size, capacity + capacity / 2);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, capacity, nullptr, GL_DYNAMIC_DRAW);
+	}
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, data);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+double ClusteredLighting::GetAssignTime() const
+{
+	return _assignTime;
+}
+
+int ClusteredLighting::GetMaxLightsPerCluster() const
+{
+	return _maxLightsPerCluster;
+}
+
+int ClusteredLighting::GetActiveClusters() const
+{
+	return _activeClusters;
+}
+
+int ClusteredLighting::GetIndexCount() const
+{
+	return int(_indices.size());
+}
+
+bool ClusteredLighting::IsSimdSupported()
+{
+	return CLUSTER_SIMD != 0;
+}
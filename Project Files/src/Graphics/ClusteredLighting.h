@@ -0,0 +1,115 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <glad/glad.h>
+#include <GLM/glm.hpp>
+
+//A light the clustered shader can use (std430, matches PointLight in frag_phong.glsl)
+struct PointLight
+{
+	glm::vec3 Position = glm::vec3(0.0f);
+	//Nothing past this distance is lit
+	float     Radius = 3.0f;
+	glm::vec3 Color = glm::vec3(1.0f);
+	float     Intensity = 1.0f;
+};
+
+//Clustered forward lighting for lots of point lights
+//*The view frustum is cut into a grid of clusters (screen tiles split into slices by depth)
+//*Every frame the CPU works out which lights touch which clusters, four lights at a time with SSE
+//*The lights, the range of each cluster and the light lists all go to the GPU in shader storage buffers,
+//*so each fragment only loops over the lights in its own cluster
+class ClusteredLighting
+{
+public:
+	//Size of the cluster grid
+	static const int TILES_X = 16;
+	static const int TILES_Y = 9;
+	static const int SLICES = 24;
+	static const int NUM_CLUSTERS = TILES_X * TILES_Y * SLICES;
+
+	//Shader storage binding points (match the blocks in frag_phong.glsl)
+	static const GLuint LIGHT_BINDING = 1;
+	static const GLuint CLUSTER_BINDING = 2;
+	static const GLuint INDEX_BINDING = 3;
+
+	//Makes the buffers and binds them
+	void Init();
+	void Unload();
+
+	//Assigns the lights to the clusters of this camera and uploads everything
+	//*width and height are the size of the target being rendered to
+	//*Works with perspective and orthographic projections (depth slices stay logarithmic for both)
+	void Update(const glm::mat4& view, const glm::mat4& projection, unsigned width, unsigned height);
+
+	std::vector<PointLight> Lights;
+
+	//Turned off every fragment loops over every light (for comparing against)
+	bool Clustered = true;
+	//Turned off the lights are bounded one at a time
+	bool UseSimd = true;
+
+	//Statistics from the last update
+	//CPU time spent assigning lights (ms)
+	double GetAssignTime() const;
+	//Lights in the busiest cluster
+	int GetMaxLightsPerCluster() const;
+	//Clusters with at least one light
+	int GetActiveClusters() const;
+	//Entries in the light index list
+	int GetIndexCount() const;
+
+	//Is the SIMD path compiled in
+	static bool IsSimdSupported();
+
+private:
+	//Clusters a light touches (inclusive), empty if zMin > zMax
+	struct LightBounds
+	{
+		int xMin, xMax;
+		int yMin, yMax;
+		int zMin, zMax;
+	};
+
+	//What the shader needs to find a fragment's cluster (sits in front of the ranges in the cluster buffer)
+	struct ClusterHeader
+	{
+		//Tiles x, tiles y, slices, number of lights
+		uint32_t Grid[4];
+		//Near plane, far plane, slice scale and slice bias (slice = log(depth) * scale + bias)
+		float Depth[4];
+		//Size of a tile in pixels, then for orthographic projections the depth range and near plane
+		//(view depth is linear in the depth buffer there, zero range means perspective)
+		float Screen[4];
+	};
+
+	//Finds the clusters each light from first on touches
+	void BoundLightsScalar(const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane, size_t first);
+	//Same as the scalar version four lights at a time, returns how many lights it did
+	size_t BoundLightsSimd(const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane);
+	//Turns the view depth range of a light into slices
+	void SetSlices(LightBounds& bounds, float depthMin, float depthMax, float nearPlane, float farPlane) const;
+	//Uploads data to a buffer, growing it if it's too small
+	static void Upload(GLuint buffer, size_t& capacity, const void* data, size_t size);
+
+	GLuint _lightBuffer = 0;
+	GLuint _clusterBuffer = 0;
+	GLuint _indexBuffer = 0;
+	size_t _lightCapacity = 0;
+	size_t _clusterCapacity = 0;
+	size_t _indexCapacity = 0;
+
+	//Slice lookup for this frame
+	bool _orthographic = false;
+	float _sliceScale = 0.0f;
+	float _sliceBias = 0.0f;
+
+	std::vector<LightBounds> _bounds;
+	//Header followed by an (offset, count) pair per cluster
+	std::vector<uint32_t> _clusterData;
+	std::vector<uint32_t> _indices;
+
+	double _assignTime = 0.0;
+	int _maxLightsPerCluster = 0;
+	int _activeClusters = 0;
+};
@@ -0,0 +1,166 @@
+#include "DepthPrepass.h"
+
+#include "Graphics/ShaderManager.h"
+
+void DepthPrepass::Init(const ShaderVariants::sptr& lit)
+{
+	_lit = lit;
+	//Both share the position only vertex stage, ShaderManager only compiles it once
+	_depth = ShaderVariants::Create("shaders/depth_only_vert.glsl", "shaders/depth_only_frag.glsl");
+	_count = ShaderVariants::Create("shaders/depth_only_vert.glsl", "shaders/overdraw_frag.glsl");
+	_viewShader = ShaderManager::Load("shaders/passthrough_vert.glsl", "shaders/overdraw_view_frag.glsl");
+
+	_counts.AddColorTarget(GL_R16F);
+	_counts.AddDepthTarget();
+
+	glGenQueries(FRAMES_IN_FLIGHT, _queries);
+	for (int slot = 0; slot < FRAMES_IN_FLIGHT; slot++)
+	{
+		_issued[slot] = -1;
+		_pixels[slot] = 0;
+	}
+}
+
+void DepthPrepass::Unload()
+{
+	glDeleteQueries(FRAMES_IN_FLIGHT, _queries);
+	//The heat map target is only made the first time it's drawn
+	if (_counts._width > 0)
+		_counts.Unload();
+}
+
+Shader::sptr DepthPrepass::GetDepthShader(const ShaderMaterial::sptr& material)
+{
+	return GetVariant(_depth, material);
+}
+
+Shader::sptr DepthPrepass::GetCountShader(const ShaderMaterial::sptr& material)
+{
+	return GetVariant(_count, material);
+}
+
+void DepthPrepass::BeginDepth()
+{
+	GLStateCache::ColorMask(false, false, false, false);
+}
+
+void DepthPrepass::EndDepth()
+{
+	GLStateCache::ColorMask(true, true, true, true);
+}
+
+void DepthPrepass::BeginShading(unsigned width, unsigned height)
+{
+	_frame++;
+
+	//Pick up any counts the GPU has finished
+	for (int slot = 0; slot < FRAMES_IN_FLIGHT; slot++)
+	{
+		if (_issued[slot] < 0)
+			continue;
+
+		GLint available = 0;
+		glGetQueryObjectiv(_queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			continue;
+
+		GLuint64 samples = 0;
+		glGetQueryObjectui64v(_queries[slot], GL_QUERY_RESULT, &samples);
+		_issued[slot] = -1;
+
+		double perPixel = double(samples) / double(_pixels[slot]);
+		_fragmentsPerPixel = _fragmentsPerPixel > 0.0 ? _fragmentsPerPixel + (perPixel - _fragmentsPerPixel) * 0.1 : perPixel;
+	}
+
+	//The pre-pass already wrote the depth, nothing behind it passes and we don't need to write it again
+	if (Enabled)
+		GLStateCache::DepthMask(false);
+
+	//The GPU is more than FRAMES_IN_FLIGHT behind, skip counting this frame rather than wait on it
+	int slot = int(_frame % FRAMES_IN_FLIGHT);
+	if (_issued[slot] >= 0 || width * height == 0)
+		return;
+
+	//With early depth testing every sample that passes is a fragment we shaded
+	glBeginQuery(GL_SAMPLES_PASSED, _queries[slot]);
+	_issued[slot] = -2;
+	_pixels[slot] = width * height;
+}
+
+void DepthPrepass::EndShading()
+{
+	GLStateCache::DepthMask(true);
+
+	int slot = int(_frame % FRAMES_IN_FLIGHT);
+	if (_issued[slot] != -2)
+		return;
+
+	glEndQuery(GL_SAMPLES_PASSED);
+	_issued[slot] = _frame;
+}
+
+void DepthPrepass::DrawCounts(unsigned width, unsigned height, const SceneDraw& draw)
+{
+	if (_counts._width != width || _counts._height != height)
+	{
+		if (_counts._width == 0)
+			_counts.Init(width, height);
+		else
+			_counts.Reshape(width, height);
+	}
+
+	//Always counted at full resolution, whatever the scene was drawn at
+	_counts.Bind();
+	_counts.SetViewport();
+	const float zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const float one = 1.0f;
+	glClearBufferfv(GL_COLOR, 0, zero);
+	glClearBufferfv(GL_DEPTH, 0, &one);
+
+	if (Enabled)
+	{
+		BeginDepth();
+		draw([this](const ShaderMaterial::sptr& material) { return GetDepthShader(material); });
+		EndDepth();
+		GLStateCache::DepthMask(false);
+	}
+
+	//Every fragment that gets through the depth test adds one
+	GLStateCache::Enable(GL_BLEND);
+	GLStateCache::BlendFunc(GL_ONE, GL_ONE);
+	draw([this](const ShaderMaterial::sptr& material) { return GetCountShader(material); });
+	GLStateCache::BlendFunc(GL_ONE, GL_ZERO);
+	GLStateCache::Disable(GL_BLEND);
+
+	GLStateCache::DepthMask(true);
+	_counts.Unbind();
+}
+
+void DepthPrepass::DrawOverdraw(Framebuffer* target)
+{
+	GLStateCache::UseProgram(_viewShader->GetHandle());
+	_viewShader->SetUniform("u_Scale", OverdrawScale);
+	_counts.BindColorAsTexture(0, 0);
+
+	GLStateCache::Disable(GL_DEPTH_TEST);
+	target->SetViewport();
+	target->Bind();
+	Framebuffer::DrawFullscreenQuad();
+	target->Unbind();
+	GLStateCache::Enable(GL_DEPTH_TEST);
+
+	_counts.UnbindTexture(0);
+}
+
+double DepthPrepass::GetFragmentsPerPixel() const
+{
+	return _fragmentsPerPixel;
+}
+
+Shader::sptr DepthPrepass::GetVariant(const ShaderVariants::sptr& variants, const ShaderMaterial::sptr& material)
+{
+	std::string key;
+	if (!_lit->FindKey(material->Shader, key))
+		return nullptr;
+	return variants->Get(key);
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <functional>
+#include <glad/glad.h>
+#include <Shader.h>
+#include <ShaderMaterial.h>
+
+#include "Graphics/Framebuffer.h"
+#include "Graphics/ShaderVariants.h"
+
+//Lays down the depth of the lit surfaces before they're shaded, so every pixel runs the expensive
+//fragment shader once (for the surface that ends up in front) instead of once per surface drawn over it
+//*The depth pass uses a position only shader, the lit pass then tests with GL_LEQUAL and doesn't write depth
+//*Counts the fragments the lit pass shades with an occlusion query, read a few frames late so we never stall
+//*Can also draw a heat map of how many fragments were shaded in each pixel
+class DepthPrepass
+{
+public:
+	//Picks the program a material is drawn with, nullptr to skip it
+	typedef std::function<Shader::sptr(const ShaderMaterial::sptr&)> ShaderPicker;
+	//Draws the scene with whatever programs the picker hands back
+	typedef std::function<void(const ShaderPicker&)> SceneDraw;
+
+	//Frames a query can be in flight before its slot is reused
+	static const int FRAMES_IN_FLIGHT = 4;
+
+	//lit is where the materials we pre-pass get their shaders from, anything else is left alone
+	void Init(const ShaderVariants::sptr& lit);
+	void Unload();
+
+	//The depth only program for a material, nullptr if the pre-pass skips it
+	Shader::sptr GetDepthShader(const ShaderMaterial::sptr& material);
+	//The program that counts a material's fragments for the heat map, nullptr if it isn't counted
+	Shader::sptr GetCountShader(const ShaderMaterial::sptr& material);
+
+	//Wrap the depth pass in these (masks off color writes)
+	void BeginDepth();
+	void EndDepth();
+	//Wrap the lit pass in these (tests against the pre-pass when it's on, and counts what gets shaded)
+	//*width and height are the size of the target, for the per pixel average
+	void BeginShading(unsigned width, unsigned height);
+	void EndShading();
+
+	//Draws the scene again into the heat map, adding one for every fragment a lit surface shades
+	//*Does its own depth pass first when the pre-pass is on, so the counts match what the lit pass shaded
+	void DrawCounts(unsigned width, unsigned height, const SceneDraw& draw);
+	//Draws the heat map over target
+	void DrawOverdraw(Framebuffer* target);
+
+	//Average fragments shaded per pixel in the lit pass (one means nothing was shaded twice)
+	double GetFragmentsPerPixel() const;
+
+	bool Enabled = false;
+	bool ShowOverdraw = false;
+	//Fragments in a pixel that show up red in the heat map
+	float OverdrawScale = 8.0f;
+
+private:
+	//Maps a material to the variant with the same key, nullptr if the material isn't lit
+	Shader::sptr GetVariant(const ShaderVariants::sptr& variants, const ShaderMaterial::sptr& material);
+
+	ShaderVariants::sptr _lit;
+	ShaderVariants::sptr _depth;
+	ShaderVariants::sptr _count;
+	Shader::sptr _viewShader;
+
+	//Additive count of fragments (R16F) and the depth they're tested against
+	Framebuffer _counts;
+
+	GLuint _queries[FRAMES_IN_FLIGHT];
+	//Frame each slot was issued on, -1 if it has nothing waiting
+	long long _issued[FRAMES_IN_FLIGHT];
+	unsigned _pixels[FRAMES_IN_FLIGHT];
+	long long _frame = 0;
+	double _fragmentsPerPixel = 0.0;
+};
@@ -0,0 +1,81 @@
+#include "DynamicResolution.h"
+
+#include <cmath>
+#include <algorithm>
+#include "Graphics/GpuProfiler.h"
+
+void DynamicResolution::Update(double gpuTime)
+{
+	if (gpuTime > 0.0)
+		_smoothed = _smoothed <= 0.0 ? gpuTime : _smoothed + (gpuTime - _smoothed) * Smoothing;
+
+	if (_scaleHistory.size() >= HISTORY_SIZE)
+	{
+		_scaleHistory.erase(_scaleHistory.begin());
+		_timeHistory.erase(_timeHistory.begin());
+	}
+	_scaleHistory.push_back(_scale);
+	_timeHistory.push_back(float(gpuTime));
+
+	if (!Enabled)
+	{
+		_scale = 1.0f;
+		return;
+	}
+	if (_cooldown > 0)
+	{
+		_cooldown--;
+		return;
+	}
+	if (_smoothed <= 0.0)
+		return;
+
+	//GPU time goes roughly with the number of pixels, so with the square of the scale
+	float ideal = _scale * float(std::sqrt(TargetTime / _smoothed));
+	float next = _scale;
+	if (_smoothed > TargetTime)
+		next = std::floor(ideal / STEP + 0.001f) * STEP;
+	else if (_smoothed < TargetTime * Headroom && ideal >= _scale + STEP)
+		next = _scale + STEP;
+	next = std::clamp(next, MinScale, MaxScale);
+
+	if (std::abs(next - _scale) < STEP * 0.5f)
+		return;
+
+	//Guess the time at the new scale so the smoothing doesn't have to catch up from the old one
+	_smoothed *= (next * next) / (_scale * _scale);
+	_scale = next;
+	_changes++;
+	//Results come back a few frames late, the next ones were still drawn at the old scale
+	_cooldown = GpuProfiler::FRAMES_IN_FLIGHT + 2;
+}
+
+float DynamicResolution::GetScale() const
+{
+	return _scale;
+}
+
+unsigned DynamicResolution::Scale(unsigned size) const
+{
+	return std::max(unsigned(size * _scale + 0.5f), 1u);
+}
+
+double DynamicResolution::GetSmoothedTime() const
+{
+	return _smoothed;
+}
+
+int DynamicResolution::GetChangeCount() const
+{
+	return _changes;
+}
+
+const std::vector<float>& DynamicResolution::GetScaleHistory() const
+{
+	return _scaleHistory;
+}
+
+const std::vector<float>& DynamicResolution::GetTimeHistory() const
+{
+	return _timeHistory;
+}
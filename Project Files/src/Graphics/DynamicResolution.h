@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+
+//Picks the resolution the scene is drawn at to keep the GPU inside a frame budget
+//*Fed the GPU time of each frame, which GpuProfiler hands back a few frames late
+//*The time is smoothed so one slow frame doesn't make the resolution jump
+//*Drops straight to the scale that should fit when over budget, and only steps back up when there's headroom,
+//*so it doesn't flip back and forth around the target
+//*After a change it waits for timings drawn at the new scale before changing again
+class DynamicResolution
+{
+public:
+	//Frames of history kept for the debug UI
+	static const int HISTORY_SIZE = 120;
+	//Scales are multiples of this
+	static constexpr float STEP = 0.05f;
+
+	//Feeds in the GPU time of the newest finished frame (ms) and picks the scale for the next one
+	void Update(double gpuTime);
+	//Fraction of the full resolution to draw at on each side
+	float GetScale() const;
+	//A size at the current scale
+	unsigned Scale(unsigned size) const;
+
+	bool Enabled = false;
+	//GPU time we're aiming for (ms)
+	float TargetTime = 16.6f;
+	float MinScale = 0.5f;
+	float MaxScale = 1.0f;
+	//Only step back up once the time is under this much of the target
+	float Headroom = 0.85f;
+	//How much of each new time goes into the smoothed time
+	float Smoothing = 0.1f;
+
+	//Statistics
+	double GetSmoothedTime() const;
+	//Times the scale has changed
+	int GetChangeCount() const;
+	//Scale and GPU time (ms) for the last HISTORY_SIZE frames, oldest first
+	const std::vector<float>& GetScaleHistory() const;
+	const std::vector<float>& GetTimeHistory() const;
+
+private:
+	float _scale = 1.0f;
+	double _smoothed = 0.0;
+	//Frames left before the timings reflect the last change
+	int _cooldown = 0;
+	int _changes = 0;
+
+	std::vector<float> _scaleHistory;
+	std::vector<float> _timeHistory;
+};
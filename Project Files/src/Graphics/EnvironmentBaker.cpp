@@ -0,0 +1,516 @@
+#include "EnvironmentBaker.h"
+
+#include <filesystem>
+#include <fstream>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+
+#include "Graphics/GLStateCache.h"
+#include "Graphics/TextureCache.h"
+#include "Graphics/TextureCompressor.h"
+#include "Graphics/GLExtensions.h"
+#include "Utilities/Util.h"
+
+namespace
+{
+	const char* FACE_NAMES[6] = { "pos_x", "neg_x", "pos_y", "neg_y", "pos_z", "neg_z" };
+	//"ENVC"
+	const uint32_t CACHE_MAGIC = 0x43564E45;
+	//Bump whenever the way the cubes are made changes, older files are then stale
+	const uint32_t CACHE_VERSION = 1;
+	const float PI = 3.14159265f;
+
+	struct CacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t stampLength;
+		//Face size and levels of the sky, reflections and irradiance (zero for cubes that weren't made)
+		uint32_t sizes[3];
+		uint32_t levels[3];
+		uint32_t skyCompressed;
+	};
+
+	//Mirrors the bits after the point, spreads the samples evenly around the lobe
+	float RadicalInverse(uint32_t bits)
+	{
+		bits = (bits << 16u) | (bits >> 16u);
+		bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+		bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+		bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+		bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+		return float(bits) * 2.3283064365386963e-10f;
+	}
+
+	size_t GetLevelBytes(const CubeMapImage& image, unsigned level)
+	{
+		unsigned size = TextureCompressor::GetLevelSize(image.Size, level);
+		return image.Compressed ? TextureCompressor::GetCompressedSize(size, size, TextureCompressor::BC1) : size_t(size) * size * 4;
+	}
+
+	void WritePixel(uint8_t* pixel, const glm::vec3& color)
+	{
+		for (int i = 0; i < 3; i++)
+			pixel[i] = uint8_t(std::clamp(color[i] * 255.0f + 0.5f, 0.0f, 255.0f));
+		pixel[3] = 255;
+	}
+}
+
+std::string EnvironmentBaker::_cacheDirectory;
+bool EnvironmentBaker::UseDiskCache = true;
+
+std::atomic<int> EnvironmentBaker::_cacheHits(0);
+std::atomic<long long> EnvironmentBaker::_bakeMicroseconds(0);
+
+void EnvironmentBaker::Init(const std::string& cacheDirectory)
+{
+	_cacheDirectory = cacheDirectory;
+	std::error_code error;
+	std::filesystem::create_directories(_cacheDirectory, error);
+
+	//Filters across the edges between faces, the blurry reflection levels would show their seams without it
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+}
+
+bool EnvironmentBaker::ReadCache(const std::string& path, BakedEnvironment& environment)
+{
+	if (!UseDiskCache)
+		return false;
+	std::string stamp = GetSourceStamp(path, environment.Lighting);
+	if (stamp.empty())
+		return false;
+	std::ifstream stream(GetCachePath(path, environment.Lighting), std::ios::binary);
+	if (!stream)
+		return false;
+
+	CacheHeader header;
+	if (!stream.read((char*)&header, sizeof(header)) || header.magic != CACHE_MAGIC || header.version != CACHE_VERSION ||
+		header.stampLength != stamp.size())
+		return false;
+	std::string cachedStamp(header.stampLength, '\0');
+	if (!stream.read(&cachedStamp[0], cachedStamp.size()) || cachedStamp != stamp)
+		return false;
+	//Made with compression we don't have any more
+	if (header.skyCompressed && !TextureCache::IsSupported())
+		return false;
+
+	CubeMapImage cubes[3];
+	for (int cube = 0; cube < 3; cube++)
+	{
+		CubeMapImage& image = cubes[cube];
+		image.Size = header.sizes[cube];
+		//Anything this big is a broken file, not a sky
+		if (image.Size > 16384)
+			return false;
+		image.Compressed = cube == 0 && header.skyCompressed;
+		//The irradiance only has one level
+		unsigned levels = image.Size == 0 ? 0 : (cube == 2 ? 1 : TextureCompressor::GetLevelCount(image.Size, image.Size));
+		if (header.levels[cube] != levels || (cube > 0 && environment.Lighting != (levels > 0)))
+			return false;
+		for (int face = 0; face < 6; face++)
+		{
+			image.Faces[face].resize(levels);
+			for (unsigned level = 0; level < levels; level++)
+			{
+				image.Faces[face][level].resize(GetLevelBytes(image, level));
+				if (!stream.read((char*)image.Faces[face][level].data(), image.Faces[face][level].size()))
+					return false;
+			}
+		}
+	}
+	if (cubes[0].Size == 0)
+		return false;
+
+	environment.Sky = std::move(cubes[0]);
+	environment.Reflections = std::move(cubes[1]);
+	environment.Irradiance = std::move(cubes[2]);
+	environment.FromCache = true;
+	_cacheHits++;
+	return true;
+}
+
+bool EnvironmentBaker::DecodeFace(const std::string& path, int face, BakedEnvironment& environment)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::string facePath = GetFacePath(path, face);
+	unsigned width, height;
+	std::vector<uint8_t> pixels;
+	//Cube map faces aren't flipped, their first row is the top
+	if (!TextureCache::ReadPixels(facePath, false, width, height, pixels))
+		return false;
+	if (width != height || width == 0)
+	{
+		printf("%s isn't square\n", facePath.c_str());
+		return false;
+	}
+
+	//The sky keeps every level (compressed when we can), the lighting is filtered from copies of the small ones
+	bool compress = TextureCache::IsSupported();
+	unsigned levels = TextureCompressor::GetLevelCount(width, width);
+	std::vector<std::vector<uint8_t>>& sky = environment.Sky.Faces[face];
+	std::vector<std::vector<uint8_t>>& source = environment.Source.Faces[face];
+	sky.resize(levels);
+	source.clear();
+	std::vector<uint8_t> next;
+	for (unsigned level = 0; level < levels; level++)
+	{
+		unsigned size = TextureCompressor::GetLevelSize(width, level);
+		if (level > 0)
+		{
+			unsigned previous = TextureCompressor::GetLevelSize(width, level - 1);
+			next.resize(size_t(size) * size * 4);
+			TextureCompressor::Downsample(pixels.data(), previous, previous, next.data());
+			pixels.swap(next);
+		}
+		//The first level this keeps is GetFilterSize(width) across, the rest follow on from it
+		if (environment.Lighting && size <= FILTER_SIZE)
+			source.push_back(pixels);
+		if (compress)
+		{
+			sky[level].resize(TextureCompressor::GetCompressedSize(size, size, TextureCompressor::BC1));
+			TextureCompressor::Encode(pixels.data(), size, size, TextureCompressor::BC1, sky[level].data());
+		}
+		else
+			sky[level] = pixels;
+	}
+	environment.FaceSizes[face] = width;
+
+	_bakeMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+	return true;
+}
+
+void EnvironmentBaker::FilterFace(int face, BakedEnvironment& environment)
+{
+	//Finish reports faces that don't fit together, there's just nothing to filter
+	for (int i = 1; i < 6; i++)
+	{
+		if (environment.FaceSizes[i] != environment.FaceSizes[0] || environment.FaceSizes[i] == 0)
+			return;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const CubeMapImage& source = environment.Source;
+	unsigned sourceSize = GetFilterSize(environment.FaceSizes[0]);
+	unsigned sourceLevels = TextureCompressor::GetLevelCount(sourceSize, sourceSize);
+
+	//Reflections, a mirror at the top down to a rough surface at the bottom
+	std::vector<std::vector<uint8_t>>& reflections = environment.Reflections.Faces[face];
+	reflections.assign(sourceLevels, std::vector<uint8_t>());
+	reflections[0] = source.Faces[face][0];
+	for (unsigned level = 1; level < sourceLevels; level++)
+	{
+		unsigned size = TextureCompressor::GetLevelSize(sourceSize, level);
+		float roughness = float(level) / float(sourceLevels - 1);
+		//Phong exponent with about the same spread
+		float exponent = std::max(2.0f / (roughness * roughness) - 2.0f, 0.0f);
+
+		//Each sample covers its share of the lobe, reading from texels about that size keeps the sum from flickering
+		float sampleArea = 2.0f * PI / (exponent + 1.0f) / REFLECTION_SAMPLES;
+		float idealSize = std::sqrt(4.0f * PI / (6.0f * sampleArea));
+		unsigned from = 0;
+		while (from + 1 < sourceLevels && TextureCompressor::GetLevelSize(sourceSize, from + 1) >= idealSize)
+			from++;
+		unsigned fromSize = TextureCompressor::GetLevelSize(sourceSize, from);
+
+		//The lobe around +z, spread out by how often each direction would be picked
+		glm::vec3 samples[REFLECTION_SAMPLES];
+		for (int i = 0; i < REFLECTION_SAMPLES; i++)
+		{
+			float cosTheta = std::pow((i + 0.5f) / REFLECTION_SAMPLES, 1.0f / (exponent + 1.0f));
+			float sinTheta = std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+			float phi = 2.0f * PI * RadicalInverse(uint32_t(i));
+			samples[i] = glm::vec3(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta);
+		}
+
+		std::vector<uint8_t>& result = reflections[level];
+		result.resize(size_t(size) * size * 4);
+		for (unsigned y = 0; y < size; y++)
+		{
+			for (unsigned x = 0; x < size; x++)
+			{
+				glm::vec3 normal = glm::normalize(GetDirection(face, (x + 0.5f) / size * 2.0f - 1.0f, (y + 0.5f) / size * 2.0f - 1.0f));
+				glm::vec3 tangent = glm::normalize(glm::cross(std::abs(normal.z) < 0.999f ? glm::vec3(0, 0, 1) : glm::vec3(1, 0, 0), normal));
+				glm::vec3 bitangent = glm::cross(normal, tangent);
+				glm::vec3 sum(0.0f);
+				for (const glm::vec3& sample : samples)
+					sum += Sample(source, from, fromSize, tangent * sample.x + bitangent * sample.y + normal * sample.z);
+				WritePixel(&result[(size_t(y) * size + x) * 4], sum / float(REFLECTION_SAMPLES));
+			}
+		}
+	}
+
+	//Every texel of the small level as a direction, how much of the sphere it covers and its color
+	unsigned from = 0;
+	while (from + 1 < sourceLevels && TextureCompressor::GetLevelSize(sourceSize, from) > IRRADIANCE_SOURCE_SIZE)
+		from++;
+	unsigned fromSize = TextureCompressor::GetLevelSize(sourceSize, from);
+	std::vector<glm::vec3> directions;
+	std::vector<glm::vec3> radiance;
+	for (int sourceFace = 0; sourceFace < 6; sourceFace++)
+	{
+		const uint8_t* pixels = source.Faces[sourceFace][from].data();
+		for (unsigned y = 0; y < fromSize; y++)
+		{
+			for (unsigned x = 0; x < fromSize; x++)
+			{
+				float u = (x + 0.5f) / fromSize * 2.0f - 1.0f;
+				float v = (y + 0.5f) / fromSize * 2.0f - 1.0f;
+				//Texels near the corners are further away and cover less
+				float distanceSquared = 1.0f + u * u + v * v;
+				float solidAngle = (4.0f / (fromSize * fromSize)) / (distanceSquared * std::sqrt(distanceSquared));
+				const uint8_t* pixel = pixels + (size_t(y) * fromSize + x) * 4;
+				directions.push_back(glm::normalize(GetDirection(sourceFace, u, v)));
+				radiance.push_back(glm::vec3(pixel[0], pixel[1], pixel[2]) / 255.0f * solidAngle);
+			}
+		}
+	}
+
+	//Cosine weighted over every direction, divided by pi so it lights an albedo the way a light of that color would
+	std::vector<std::vector<uint8_t>>& irradiance = environment.Irradiance.Faces[face];
+	irradiance.assign(1, std::vector<uint8_t>(size_t(IRRADIANCE_SIZE) * IRRADIANCE_SIZE * 4));
+	for (unsigned y = 0; y < IRRADIANCE_SIZE; y++)
+	{
+		for (unsigned x = 0; x < IRRADIANCE_SIZE; x++)
+		{
+			glm::vec3 normal = glm::normalize(GetDirection(face, (x + 0.5f) / IRRADIANCE_SIZE * 2.0f - 1.0f, (y + 0.5f) / IRRADIANCE_SIZE * 2.0f - 1.0f));
+			glm::vec3 sum(0.0f);
+			for (size_t i = 0; i < directions.size(); i++)
+				sum += radiance[i] * std::max(glm::dot(normal, directions[i]), 0.0f);
+			WritePixel(&irradiance[0][(size_t(y) * IRRADIANCE_SIZE + x) * 4], sum / PI);
+		}
+	}
+
+	_bakeMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool EnvironmentBaker::Finish(const std::string& path, BakedEnvironment& environment)
+{
+	if (environment.FromCache)
+		return true;
+
+	unsigned size = environment.FaceSizes[0];
+	for (int face = 0; face < 6; face++)
+	{
+		if (environment.FaceSizes[face] == 0 || environment.FaceSizes[face] != size)
+		{
+			printf("The faces of %s don't make a cube map\n", path.c_str());
+			return false;
+		}
+	}
+
+	environment.Sky.Size = size;
+	environment.Sky.Compressed = TextureCache::IsSupported();
+	if (environment.Lighting)
+	{
+		environment.Reflections.Size = GetFilterSize(size);
+		environment.Irradiance.Size = IRRADIANCE_SIZE;
+	}
+	//The filtering is done with it
+	environment.Source = CubeMapImage();
+
+	if (!UseDiskCache)
+		return true;
+	std::string stamp = GetSourceStamp(path, environment.Lighting);
+	if (stamp.empty())
+		return true;
+
+	std::vector<char> out;
+	CacheHeader header = {};
+	header.magic = CACHE_MAGIC;
+	header.version = CACHE_VERSION;
+	header.stampLength = uint32_t(stamp.size());
+	header.skyCompressed = environment.Sky.Compressed ? 1 : 0;
+	const CubeMapImage* cubes[3] = { &environment.Sky, &environment.Reflections, &environment.Irradiance };
+	for (int cube = 0; cube < 3; cube++)
+	{
+		header.sizes[cube] = cubes[cube]->Size;
+		header.levels[cube] = uint32_t(cubes[cube]->Faces[0].size());
+	}
+	out.insert(out.end(), (const char*)&header, (const char*)&header + sizeof(header));
+	out.insert(out.end(), stamp.begin(), stamp.end());
+	for (const CubeMapImage* cube : cubes)
+	{
+		for (int face = 0; face < 6; face++)
+		{
+			for (const std::vector<uint8_t>& level : cube->Faces[face])
+				out.insert(out.end(), level.begin(), level.end());
+		}
+	}
+
+	//Written under another name and moved into place, so a half written file is never read
+	std::string file = GetCachePath(path, environment.Lighting);
+	std::string temporary = file + ".tmp";
+	{
+		std::ofstream stream(temporary, std::ios::binary);
+		if (!stream || !stream.write(out.data(), out.size()))
+		{
+			printf("Could not write %s to the environment cache\n", path.c_str());
+			return true;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(temporary, file, error);
+	return true;
+}
+
+TextureCubeMap::sptr EnvironmentBaker::Upload(const CubeMapImage& image)
+{
+	GLenum format = image.Compressed ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGBA8;
+	GLsizei levels = GLsizei(image.Faces[0].size());
+
+	//Swap whatever texture the base made for ours, same as the compressed 2D textures
+	TextureCubeMap::sptr texture = TextureCubeMap::Create();
+	GLuint& handle = texture->GetHandle();
+	if (handle != 0)
+	{
+		GLStateCache::ForgetTexture(handle);
+		glDeleteTextures(1, &handle);
+	}
+	glGenTextures(1, &handle);
+
+	GLStateCache::BindTexture(0, GL_TEXTURE_CUBE_MAP, handle);
+	glTexStorage2D(GL_TEXTURE_CUBE_MAP, levels, format, image.Size, image.Size);
+	for (int face = 0; face < 6; face++)
+	{
+		for (GLsizei level = 0; level < levels; level++)
+		{
+			unsigned size = TextureCompressor::GetLevelSize(image.Size, unsigned(level));
+			const std::vector<uint8_t>& data = image.Faces[face][level];
+			if (image.Compressed)
+				glCompressedTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, 0, 0, size, size, format, GLsizei(data.size()), data.data());
+			else
+				glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+		}
+	}
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	GLStateCache::BindTexture(0, GL_TEXTURE_CUBE_MAP, GL_NONE);
+
+	return texture;
+}
+
+void EnvironmentBaker::Bind(const EnvironmentMaps& maps)
+{
+	if (maps.Reflections != nullptr)
+		GLStateCache::BindTexture(REFLECTION_SLOT, GL_TEXTURE_CUBE_MAP, maps.Reflections->GetHandle());
+	if (maps.Irradiance != nullptr)
+		GLStateCache::BindTexture(IRRADIANCE_SLOT, GL_TEXTURE_CUBE_MAP, maps.Irradiance->GetHandle());
+}
+
+int EnvironmentBaker::GetCacheHits()
+{
+	return _cacheHits;
+}
+
+double EnvironmentBaker::GetBakeTime()
+{
+	return _bakeMicroseconds / 1000.0;
+}
+
+std::string EnvironmentBaker::GetSourceStamp(const std::string& path, bool lighting)
+{
+	std::string stamp = lighting ? "lighting" : "sky";
+	for (int face = 0; face < 6; face++)
+	{
+		std::string facePath = GetFacePath(path, face);
+		std::error_code error;
+		uintmax_t size = std::filesystem::file_size(facePath, error);
+		if (error)
+			return "";
+		auto modified = std::filesystem::last_write_time(facePath, error);
+		if (error)
+			return "";
+		stamp += " " + std::to_string(size) + ":" + std::to_string((long long)modified.time_since_epoch().count());
+	}
+	return stamp;
+}
+
+std::string EnvironmentBaker::GetCachePath(const std::string& path, bool lighting)
+{
+	char name[40];
+	snprintf(name, sizeof(name), "%016llx.env", Util::Hash(path + (lighting ? " lighting" : "")));
+	return _cacheDirectory + "/" + name;
+}
+
+std::string EnvironmentBaker::GetFacePath(const std::string& path, int face)
+{
+	std::filesystem::path file(path);
+	file.replace_filename(file.stem().string() + "_" + FACE_NAMES[face] + file.extension().string());
+	return file.string();
+}
+
+unsigned EnvironmentBaker::GetFilterSize(unsigned faceSize)
+{
+	unsigned level = 0;
+	while (TextureCompressor::GetLevelSize(faceSize, level) > FILTER_SIZE)
+		level++;
+	return TextureCompressor::GetLevelSize(faceSize, level);
+}
+
+glm::vec3 EnvironmentBaker::GetDirection(int face, float u, float v)
+{
+	switch (face)
+	{
+	case 0: return glm::vec3(1.0f, -v, -u);
+	case 1: return glm::vec3(-1.0f, -v, u);
+	case 2: return glm::vec3(u, 1.0f, v);
+	case 3: return glm::vec3(u, -1.0f, -v);
+	case 4: return glm::vec3(u, -v, 1.0f);
+	default: return glm::vec3(-u, -v, -1.0f);
+	}
+}
+
+glm::vec3 EnvironmentBaker::Sample(const CubeMapImage& image, unsigned level, unsigned size, const glm::vec3& direction)
+{
+	//Which face it hits and where, the inverse of GetDirection
+	glm::vec3 a = glm::abs(direction);
+	int face;
+	float u, v, major;
+	if (a.x >= a.y && a.x >= a.z)
+	{
+		face = direction.x > 0.0f ? 0 : 1;
+		major = a.x;
+		u = direction.x > 0.0f ? -direction.z : direction.z;
+		v = -direction.y;
+	}
+	else if (a.y >= a.z)
+	{
+		face = direction.y > 0.0f ? 2 : 3;
+		major = a.y;
+		u = direction.x;
+		v = direction.y > 0.0f ? direction.z : -direction.z;
+	}
+	else
+	{
+		face = direction.z > 0.0f ? 4 : 5;
+		major = a.z;
+		u = direction.z > 0.0f ? direction.x : -direction.x;
+		v = -direction.y;
+	}
+
+	//Kept inside the face, seamless filtering on the GPU hides the difference at the edges
+	float x = std::clamp((u / major * 0.5f + 0.5f) * size - 0.5f, 0.0f, float(size - 1));
+	float y = std::clamp((v / major * 0.5f + 0.5f) * size - 0.5f, 0.0f, float(size - 1));
+	unsigned x0 = unsigned(x);
+	unsigned y0 = unsigned(y);
+	unsigned x1 = std::min(x0 + 1, size - 1);
+	unsigned y1 = std::min(y0 + 1, size - 1);
+	float fx = x - x0;
+	float fy = y - y0;
+
+	const uint8_t* pixels = image.Faces[face][level].data();
+	auto texel = [&](unsigned tx, unsigned ty) {
+		const uint8_t* pixel = pixels + (size_t(ty) * size + tx) * 4;
+		return glm::vec3(pixel[0], pixel[1], pixel[2]);
+	};
+	glm::vec3 top = glm::mix(texel(x0, y0), texel(x1, y0), fx);
+	glm::vec3 bottom = glm::mix(texel(x0, y1), texel(x1, y1), fx);
+	return glm::mix(top, bottom, fy) / 255.0f;
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <glad/glad.h>
+#include <GLM/glm.hpp>
+#include <TextureCubeMap.h>
+
+//Every level of the six faces of a cube map
+struct CubeMapImage
+{
+	unsigned Size = 0;
+	//BC1 blocks instead of RGBA8 pixels
+	bool Compressed = false;
+	//Each face's levels, in the order OpenGL numbers the faces (+x, -x, +y, -y, +z, -z)
+	std::vector<std::vector<uint8_t>> Faces[6];
+};
+
+//A sky and everything made from it, filled in a step at a time by the AssetLoader's workers
+struct BakedEnvironment
+{
+	//Make the lighting cubes as well as the sky
+	bool Lighting = false;
+	//Read from the disk cache, there's nothing left to decode or filter
+	bool FromCache = false;
+
+	CubeMapImage Sky;
+	//Mips get blurrier for rougher surfaces, level 0 is a mirror
+	CubeMapImage Reflections;
+	//Light arriving at a surface facing each way, for the ambient
+	CubeMapImage Irradiance;
+
+	//RGBA8 levels of the sky from FILTER_SIZE down, what the lighting cubes are filtered from
+	CubeMapImage Source;
+	//Size of each face as it was decoded, they all have to match
+	unsigned FaceSizes[6] = {};
+};
+
+//The uploaded cubes
+struct EnvironmentMaps
+{
+	TextureCubeMap::sptr Sky;
+	TextureCubeMap::sptr Reflections;
+	TextureCubeMap::sptr Irradiance;
+};
+
+//Turns a sky's six face images into cube maps, with the work split so AssetLoader can spread it over its workers
+//*Each face is decoded and has its mips built (and is BC1 compressed when we can) on its own
+//*The lighting cubes come from the sky's small levels, a face at a time once all six are decoded:
+//*the reflection mips are the sky blurred by wider and wider Phong lobes (64 samples a texel, each read from
+//*the level whose texels are about the size of a sample), the irradiance is the sky cosine weighted over every direction
+//*Everything ends up in one file in the cache, later launches just read it and upload
+class EnvironmentBaker abstract
+{
+public:
+	//Largest face of the reflection cube (and the largest level the lighting is filtered from)
+	static const unsigned FILTER_SIZE = 128;
+	static const unsigned IRRADIANCE_SIZE = 32;
+	//The irradiance is summed over every texel of this level
+	static const unsigned IRRADIANCE_SOURCE_SIZE = 16;
+	static const int REFLECTION_SAMPLES = 64;
+
+	//Texture slots the lit shaders read the lighting cubes from (matches lighting.glsl)
+	static const int REFLECTION_SLOT = 14;
+	static const int IRRADIANCE_SLOT = 15;
+
+	//Call once the context is up
+	static void Init(const std::string& cacheDirectory = "environment_cache");
+
+	//The steps, in order (path is the one the faces are named after, "sky.jpg" has "sky_pos_x.jpg" and so on)
+	//Fills the environment from the cache if it's there and up to date
+	static bool ReadCache(const std::string& path, BakedEnvironment& environment);
+	//Decodes one face and builds its mips, returns false if the image couldn't be read
+	static bool DecodeFace(const std::string& path, int face, BakedEnvironment& environment);
+	//Makes one face of the lighting cubes, needs every face decoded
+	static void FilterFace(int face, BakedEnvironment& environment);
+	//Checks the faces fit together and saves to the cache, returns false if there's nothing to upload
+	static bool Finish(const std::string& path, BakedEnvironment& environment);
+
+	//Makes a cube map with every level of image
+	static TextureCubeMap::sptr Upload(const CubeMapImage& image);
+	//Binds the lighting cubes for the lit shaders
+	static void Bind(const EnvironmentMaps& maps);
+
+	//Lets the disk cache be turned off to measure cold starts
+	static bool UseDiskCache;
+
+	//Statistics
+	//Skies read from the cache
+	static int GetCacheHits();
+	//Time spent decoding, building mips and filtering, added up over every worker (ms)
+	static double GetBakeTime();
+
+private:
+	//What we know about the face images, a cached file made from anything else is stale
+	static std::string GetSourceStamp(const std::string& path, bool lighting);
+	static std::string GetCachePath(const std::string& path, bool lighting);
+	static std::string GetFacePath(const std::string& path, int face);
+
+	//Size of the largest level of a face that's no bigger than FILTER_SIZE, where the lighting starts from
+	//*Faces that aren't a power of two get there with a size of their own (a 1000 pixel face gives 125)
+	static unsigned GetFilterSize(unsigned faceSize);
+
+	//Direction through the middle of a texel ([-1, 1] across the face)
+	static glm::vec3 GetDirection(int face, float u, float v);
+	//Bilinear sample of an RGBA8 level (size across) in a direction, only filters inside a face
+	static glm::vec3 Sample(const CubeMapImage& image, unsigned level, unsigned size, const glm::vec3& direction);
+
+	static std::string _cacheDirectory;
+
+	static std::atomic<int> _cacheHits;
+	static std::atomic<long long> _bakeMicroseconds;
+};
@@ -0,0 +1,186 @@
+#include "FrameCapture.h"
+
+#include <chrono>
+
+FrameCapture::FrameCapture()
+{
+}
+
+FrameCapture::~FrameCapture()
+{
+	Unload();
+}
+
+void FrameCapture::Init(unsigned width, unsigned height, Callback onFrame, int ringSize)
+{
+	//Start again if we were already set up
+	Unload();
+
+	_width = width;
+	_height = height;
+	_onFrame = onFrame;
+	_next = 0;
+
+	_slots.resize(ringSize);
+	for (int i = 0; i < ringSize; i++)
+	{
+		glGenBuffers(1, &_slots[i].pbo);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, _slots[i].pbo);
+		//Stream read, we fill it on the GPU and read it once on the CPU
+		glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(_width) * _height * 4, nullptr, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, GL_NONE);
+}
+
+void FrameCapture::Unload()
+{
+	for (int i = 0; i < _slots.size(); i++)
+	{
+		if (_slots[i].fence != nullptr)
+			glDeleteSync(_slots[i].fence);
+		glDeleteBuffers(1, &_slots[i].pbo);
+	}
+	_slots.clear();
+}
+
+void FrameCapture::Capture(Framebuffer* source, int frame)
+{
+	if (_slots.empty())
+		return;
+
+	Slot& slot = _slots[_next];
+
+	//The ring is full, we have to wait on the oldest read before reusing its buffer
+	if (slot.pending)
+		Resolve(slot, true);
+
+	//Read into the PBO, this returns right away since the data stays on the GPU
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+	source->ReadColor(0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, GL_NONE);
+
+	//Lets us know when the GPU has actually finished the copy
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.frame = frame;
+	slot.sequence = _captured++;
+	slot.pending = true;
+
+	_next = (_next + 1) % int(_slots.size());
+}
+
+void FrameCapture::Poll()
+{
+	//Go oldest to newest so frames come out in order
+	for (int i = 0; i < _slots.size(); i++)
+	{
+		Slot& slot = _slots[(_next + i) % _slots.size()];
+
+		if (!slot.pending)
+			continue;
+
+		//Stop at the first read that isn't done so we never deliver out of order
+		if (!Resolve(slot, false))
+			break;
+	}
+}
+
+void FrameCapture::Flush()
+{
+	for (int i = 0; i < _slots.size(); i++)
+	{
+		Slot& slot = _slots[(_next + i) % _slots.size()];
+
+		if (slot.pending)
+			Resolve(slot, true);
+	}
+}
+
+int FrameCapture::GetPendingCount() const
+{
+	int count = 0;
+	for (int i = 0; i < _slots.size(); i++)
+	{
+		if (_slots[i].pending)
+			count++;
+	}
+	return count;
+}
+
+unsigned FrameCapture::GetWidth() const
+{
+	return _width;
+}
+
+unsigned FrameCapture::GetHeight() const
+{
+	return _height;
+}
+
+int FrameCapture::GetCapturedCount() const
+{
+	return _captured;
+}
+
+int FrameCapture::GetStallCount() const
+{
+	return _stalls;
+}
+
+double FrameCapture::GetStallTime() const
+{
+	return _stallTime;
+}
+
+float FrameCapture::GetAverageLatency() const
+{
+	return _resolved > 0 ? float(double(_totalLatency) / _resolved) : 0.0f;
+}
+
+void FrameCapture::ResetMetrics()
+{
+	_resolved = 0;
+	_stalls = 0;
+	_stallTime = 0.0;
+	_totalLatency = 0;
+}
+
+bool FrameCapture::Resolve(Slot& slot, bool wait)
+{
+	//Check on the fence without blocking first
+	GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (status == GL_TIMEOUT_EXPIRED)
+	{
+		if (!wait)
+			return false;
+
+		//The GPU isn't done and we need the buffer, this is a pipeline stall
+		auto start = std::chrono::high_resolution_clock::now();
+		glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		_stalls++;
+		_stallTime += std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	//Captures since this one was queued
+	_totalLatency += _captured - 1 - slot.sequence;
+	_resolved++;
+
+	glDeleteSync(slot.fence);
+	slot.fence = nullptr;
+	slot.pending = false;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+	const unsigned char* pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+		GLsizeiptr(_width) * _height * 4, GL_MAP_READ_BIT);
+
+	if (pixels != nullptr)
+	{
+		if (_onFrame)
+			_onFrame(slot.frame, _width, _height, pixels);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, GL_NONE);
+
+	return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <functional>
+#include <glad/glad.h>
+
+#include "Graphics/Framebuffer.h"
+
+//Reads framebuffers back to the CPU without stalling the pipeline
+//*glReadPixels goes into a ring of pixel buffer objects guarded by fences
+//*A read is only mapped once the GPU has finished it (a few frames later)
+class FrameCapture
+{
+public:
+	//Receives the finished pixels (RGBA8, bottom row first)
+	typedef std::function<void(int frame, unsigned width, unsigned height, const unsigned char* pixels)> Callback;
+
+	FrameCapture();
+	~FrameCapture();
+
+	//Creates the ring of PBOs for frames of the given size
+	void Init(unsigned width, unsigned height, Callback onFrame, int ringSize = 3);
+	//Deletes the PBOs and fences (any outstanding reads are dropped)
+	void Unload();
+
+	//Queues an async read of the first color target of the framebuffer
+	//*If the ring is full the oldest read is waited on first
+	void Capture(Framebuffer* source, int frame);
+	//Hands every read the GPU has finished to the callback, never waits
+	void Poll();
+	//Waits on every outstanding read and hands them to the callback
+	void Flush();
+
+	//Number of reads that are still in flight
+	int GetPendingCount() const;
+
+	//Size of the frames being read
+	unsigned GetWidth() const;
+	unsigned GetHeight() const;
+
+	//Metrics
+	//*A stall is when we had to block on a read the GPU hadn't finished yet
+	int GetCapturedCount() const;
+	int GetStallCount() const;
+	//Total time spent blocked on the GPU (in milliseconds)
+	double GetStallTime() const;
+	//How many frames later reads are mapped on average
+	float GetAverageLatency() const;
+	void ResetMetrics();
+
+private:
+	struct Slot
+	{
+		GLuint pbo = GL_NONE;
+		GLsync fence = nullptr;
+		int frame = -1;
+		//Which capture this was, used to work out how late it was mapped
+		int sequence = 0;
+		bool pending = false;
+	};
+
+	//Maps the slot and passes it to the callback, waits on the fence if wait is true
+	//*Returns false if the read isn't finished and we didn't want to wait
+	bool Resolve(Slot& slot, bool wait);
+
+	std::vector<Slot> _slots;
+	//The slot the next capture goes into (also the oldest pending read)
+	int _next = 0;
+
+	unsigned _width = 0;
+	unsigned _height = 0;
+
+	//Metrics
+	int _captured = 0;
+	int _resolved = 0;
+	int _stalls = 0;
+	double _stallTime = 0.0;
+	long long _totalLatency = 0;
+
+	Callback _onFrame;
+};
@@ -1,6 +1,5 @@
 #include "Framebuffer.h"
 
-GLuint Framebuffer::_fullscreenQuadVBO = 0;
 GLuint Framebuffer::_fullscreenQuadVAO = 0;
 
 int Framebuffer::_maxColorAttachments = 0;
@@ -14,10 +13,18 @@ DepthTarget::~DepthTarget()
 
 void DepthTarget::Unload()
 {
+	//Make sure the state cache doesn't think it's still bound
+	GLStateCache::ForgetTexture(_texture.GetHandle());
 	//Deletes the texture at the specific handle
 	glDeleteTextures(1, &_texture.GetHandle());
 }
 
+GLuint DepthTarget::GetHandle() const
+{
+	//Texture2D only hands its handle out by reference (so it can be generated into), reading it changes nothing
+	return const_cast<Texture2D&>(_texture).GetHandle();
+}
+
 ColorTarget::~ColorTarget()
 {
 	//Unloads the color target
@@ -26,9 +33,18 @@ ColorTarget::~ColorTarget()
 
 void ColorTarget::Unload()
 {
+	//Make sure the state cache doesn't think they're still bound
+	for (unsigned i = 0; i < _numAttachments; i++)
+		GLStateCache::ForgetTexture(_textures[i].GetHandle());
+
 	glDeleteTextures(_numAttachments, &_textures[0].GetHandle());
 }
 
+GLuint ColorTarget::GetHandle(unsigned index) const
+{
+	return const_cast<Texture2D&>(_textures[index]).GetHandle();
+}
+
 Framebuffer::Framebuffer()
 {
 }
@@ -40,6 +56,8 @@ Framebuffer::~Framebuffer()
 
 void Framebuffer::Unload()
 {
+	//Make sure the state cache doesn't think it's still bound
+	GLStateCache::ForgetFramebuffer(_FBO);
 	//Deletes the framebuffer
 	glDeleteFramebuffers(1, &_FBO);
 	//Sets init to false
@@ -60,7 +78,7 @@ void Framebuffer::Init()
 	//Generates the FBO
 	glGenFramebuffers(1, &_FBO);
 	//Bind it
-	glBindFramebuffer(GL_FRAMEBUFFER, _FBO);
+	GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, _FBO);
 
 	if (_depthActive)
 	{
@@ -70,7 +88,7 @@ void Framebuffer::Init()
 		//Generate the texture
 		glGenTextures(1, &_depth._texture.GetHandle());
 		//Binds the texture
-		glBindTexture(GL_TEXTURE_2D, _depth._texture.GetHandle());
+		GLStateCache::BindTexture(0, GL_TEXTURE_2D, _depth._texture.GetHandle());
 		//Sets the texture data
 		glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, _width, _height);
 
@@ -83,7 +101,7 @@ void Framebuffer::Init()
 		//Sets up as a framebuffer texture
 		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, _depth._texture.GetHandle(), 0);
 
-		glBindTexture(GL_TEXTURE_2D, GL_NONE);
+		GLStateCache::BindTexture(0, GL_TEXTURE_2D, GL_NONE);
 	}
 
 	//If there is more than zero color attachments
@@ -103,7 +121,7 @@ void Framebuffer::Init()
 			_color._textures[i].GetHandle() = textureHandles[i];
 
 			//Binds the texture
-			glBindTexture(GL_TEXTURE_2D, _color._textures[i].GetHandle());
+			GLStateCache::BindTexture(0, GL_TEXTURE_2D, _color._textures[i].GetHandle());
 			//Sets the texture storage
 			glTexStorage2D(GL_TEXTURE_2D, 1, _color._formats[i], _width, _height);
 
@@ -118,12 +136,17 @@ void Framebuffer::Init()
 		}
 
 		delete[] textureHandles;
+
+		GLStateCache::BindTexture(0, GL_TEXTURE_2D, GL_NONE);
+
+		//Draw buffers are part of the framebuffer's state, so we only need to set them once
+		glDrawBuffers(_color._numAttachments, &_color._buffers[0]);
 	}
 
 	//Make sure it's set up right
 	CheckFBO();
 	//Unbind buffer
-	glBindFramebuffer(GL_FRAMEBUFFER, GL_NONE);
+	GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, GL_NONE);
 	//Set init to true
 	_isInit = true;
 }
@@ -151,21 +174,56 @@ void Framebuffer::AddColorTarget(GLenum format)
 	_color._numAttachments++;
 }
 
+void Framebuffer::SetColorFormat(unsigned colorBuffer, GLenum format)
+{
+	if (_color._formats[colorBuffer] == format)
+		return;
+
+	_color._formats[colorBuffer] = format;
+	if (_isInit)
+		Reshape(_width, _height);
+}
+
+GLenum Framebuffer::GetColorFormat(unsigned colorBuffer) const
+{
+	return _color._formats[colorBuffer];
+}
+
+unsigned Framebuffer::GetBytesPerPixel(GLenum format)
+{
+	switch (format)
+	{
+	case GL_R16F: return 2;
+	case GL_RGBA8:
+	case GL_RGB10_A2:
+	case GL_R11F_G11F_B10F:
+	case GL_R32F:
+	case GL_DEPTH_COMPONENT24: return 4;
+	case GL_RGBA16F: return 8;
+	case GL_RGBA32F: return 16;
+	default: return 0;
+	}
+}
+
 void Framebuffer::BindDepthAsTexture(int textureSlot) const
 {
-	_depth._texture.Bind(textureSlot);
+	GLStateCache::BindTexture(textureSlot, GL_TEXTURE_2D, _depth.GetHandle());
 }
 
 void Framebuffer::BindColorAsTexture(unsigned colorBuffer, int textureSlot) const
 {
-	_color._textures[colorBuffer].Bind(textureSlot);
+	GLStateCache::BindTexture(textureSlot, GL_TEXTURE_2D, _color.GetHandle(colorBuffer));
+}
+
+void Framebuffer::BindColorAsImage(unsigned colorBuffer, GLuint unit, GLenum access) const
+{
+	glBindImageTexture(unit, _color.GetHandle(colorBuffer), 0, GL_FALSE, 0, access, _color._formats[colorBuffer]);
 }
 
 void Framebuffer::UnbindTexture(int textureSlot) const
 {
 	//Binds textures to GL_NONE
-	glActiveTexture(GL_TEXTURE0 + textureSlot);
-	glBindTexture(GL_TEXTURE_2D, GL_NONE);
+	GLStateCache::BindTexture(textureSlot, GL_TEXTURE_2D, GL_NONE);
 }
 
 void Framebuffer::Reshape(unsigned width, unsigned height)
@@ -187,26 +245,49 @@ void Framebuffer::SetSize(unsigned width, unsigned height)
 	//Sets the width and height
 	_width = width;
 	_height = height;
+	_renderWidth = width;
+	_renderHeight = height;
 }
 
 void Framebuffer::SetViewport() const
 {
-	glViewport(0, 0, _width, _height);
+	GLStateCache::Viewport(0, 0, _renderWidth, _renderHeight);
 }
 
-void Framebuffer::Bind() const
+void Framebuffer::SetRenderSize(unsigned width, unsigned height)
+{
+	_renderWidth = glm::clamp(width, 1u, _width);
+	_renderHeight = glm::clamp(height, 1u, _height);
+}
+
+unsigned Framebuffer::GetRenderWidth() const
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, _FBO);
+	return _renderWidth;
+}
 
-	if (_color._numAttachments)
-	{
-		glDrawBuffers(_color._numAttachments, &_color._buffers[0]);
-	}
+unsigned Framebuffer::GetRenderHeight() const
+{
+	return _renderHeight;
+}
+
+glm::vec2 Framebuffer::GetRenderScale() const
+{
+	return glm::vec2(float(_renderWidth) / _width, float(_renderHeight) / _height);
+}
+
+void Framebuffer::SetFilter(GLenum filter)
+{
+	_filter = filter;
+}
+
+void Framebuffer::Bind() const
+{
+	GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, _FBO);
 }
 
 void Framebuffer::Unbind() const
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, GL_NONE);
+	GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, GL_NONE);
 }
 
 void Framebuffer::RenderToFSQ() const
@@ -221,21 +302,62 @@ void Framebuffer::RenderToFSQ() const
 	Unbind();
 }
 
+void Framebuffer::RenderToFSQ(int x, int y, unsigned width, unsigned height) const
+{
+	//The viewport stays the whole target so the UVs line up with a full pass, the scissor keeps the rest from being shaded
+	SetViewport();
+	Bind();
+	GLStateCache::Enable(GL_SCISSOR_TEST);
+	glScissor(x, y, width, height);
+	DrawFullscreenQuad();
+	GLStateCache::Disable(GL_SCISSOR_TEST);
+	Unbind();
+}
+
 void Framebuffer::DrawToBackbuffer()
 {
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, _FBO);
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GL_NONE);
+	GLStateCache::BindFramebuffer(GL_READ_FRAMEBUFFER, _FBO);
+	GLStateCache::BindFramebuffer(GL_DRAW_FRAMEBUFFER, GL_NONE);
 
 	//Blits the framebuffer to the back buffer
 	glBlitFramebuffer(0, 0, _width, _height, 0, 0, _width, _height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, GL_NONE);
+	GLStateCache::BindFramebuffer(GL_READ_FRAMEBUFFER, GL_NONE);
+}
+
+void Framebuffer::BlitColorTo(const Framebuffer& target, unsigned colorBuffer, GLenum filter) const
+{
+	GLStateCache::BindFramebuffer(GL_READ_FRAMEBUFFER, _FBO);
+	GLStateCache::BindFramebuffer(GL_DRAW_FRAMEBUFFER, target._FBO);
+	glReadBuffer(GL_COLOR_ATTACHMENT0 + colorBuffer);
+
+	//Stretches if the sizes don't match
+	glBlitFramebuffer(0, 0, _renderWidth, _renderHeight, 0, 0, target._renderWidth, target._renderHeight, GL_COLOR_BUFFER_BIT, filter);
+	GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, GL_NONE);
+}
+
+void Framebuffer::BlitDepthTo(const Framebuffer& target) const
+{
+	GLStateCache::BindFramebuffer(GL_READ_FRAMEBUFFER, _FBO);
+	GLStateCache::BindFramebuffer(GL_DRAW_FRAMEBUFFER, target._FBO);
+
+	//Depth can only be blitted with nearest filtering
+	glBlitFramebuffer(0, 0, _renderWidth, _renderHeight, 0, 0, target._renderWidth, target._renderHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, GL_NONE);
+}
+
+void Framebuffer::ReadColor(unsigned colorBuffer, GLenum format, GLenum type, void* pixels) const
+{
+	GLStateCache::BindFramebuffer(GL_READ_FRAMEBUFFER, _FBO);
+	glReadBuffer(GL_COLOR_ATTACHMENT0 + colorBuffer);
+	glReadPixels(0, 0, _renderWidth, _renderHeight, format, type, pixels);
+	GLStateCache::BindFramebuffer(GL_READ_FRAMEBUFFER, GL_NONE);
 }
 
 void Framebuffer::Clear()
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, _FBO);
+	GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, _FBO);
 	glClear(_clearFlag);
-	glBindFramebuffer(GL_FRAMEBUFFER, GL_NONE);
+	GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, GL_NONE);
 }
 
 bool Framebuffer::CheckFBO()
@@ -253,67 +375,17 @@ bool Framebuffer::CheckFBO()
 
 void Framebuffer::InitFullscreenQuad()
 {
-	//A vbo with Uvs and verts from
-	//-1 to 1 for verts
-	//0 to 1 for UVs
-	float VBO_DATA[]
-	{
-		-1.f, -1.f, 0.f,
-		1.f, -1.f, 0.f,
-		-1.f, 1.f, 0.f,
-
-		1.f, 1.f, 0.f,
-		-1.f, 1.f, 0.f,
-		1.f, -1.f, 0.f,
-
-		0.f, 0.f,
-		1.f, 0.f,
-		0.f, 1.f,
-
-		1.f, 1.f,
-		0.f, 1.f,
-		1.f, 0.f
-	};
-	//Vertex size is 6pts * 3 data points * sizeof (float)
-	int vertexSize = 6 * 3 * sizeof(float);
-	//texcoord size = 6pts * 2 data points * sizeof(float)
-	int texCoordSize = 6 * 2 * sizeof(float);
-
-	//Generates vertex array
+	//The corners come from gl_VertexID (see passthrough_vert.glsl) so there's nothing to put in a buffer,
+	//but core profile won't draw without a vertex array bound
 	glGenVertexArrays(1, &_fullscreenQuadVAO);
-	//Binds VAO
-	glBindVertexArray(_fullscreenQuadVAO);
-
-	//Enables 2 vertex attrib array slots
-	glEnableVertexAttribArray(0); //Vertices
-	glEnableVertexAttribArray(1); //UVS
-
-	//Generates VBO
-	glGenBuffers(1, &_fullscreenQuadVBO);
-
-	//Binds the VBO
-	glBindBuffer(GL_ARRAY_BUFFER, _fullscreenQuadVBO);
-	//Buffers the vbo data
-	glBufferData(GL_ARRAY_BUFFER, vertexSize + texCoordSize, VBO_DATA, GL_STATIC_DRAW);
-
-#pragma warning(push)
-#pragma warning(disable : 4312)
-	//Sets first attrib array to point to the beginning of the data
-	glVertexAttribPointer((GLuint)0, 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<void*>(0));
-	//Sets the second attrib array to point to an offset in the data
-	glVertexAttribPointer((GLuint)1, 2, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<void*>(vertexSize));
-#pragma warning(pop)
-
-	glBindBuffer(GL_ARRAY_BUFFER, GL_NONE);
-	glBindVertexArray(GL_NONE);
+	_isInitFSQ = true;
 }
 
 void Framebuffer::DrawFullscreenQuad()
 {
-	glBindVertexArray(_fullscreenQuadVAO);
-	glDrawArrays(GL_TRIANGLES, 0, 6);
-	glBindVertexArray(GL_NONE);
+	//One triangle that covers the whole screen, two triangles shade the pixel quads along their diagonal twice
+	//*We leave the vertex array bound, the state cache skips the rebind on the next pass
+	GLStateCache::BindVertexArray(_fullscreenQuadVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
 }
 
-
-
@@ -1,8 +1,11 @@
 #pragma once
 #include <vector>
+#include <GLM/glm.hpp>
 #include <Texture2D.h>
 #include <Shader.h>
 
+#include "Graphics/GLStateCache.h"
+
 struct DepthTarget
 {
 	//Deconstructor for Depth Target
@@ -10,6 +13,8 @@ struct DepthTarget
 	~DepthTarget();
 	//Deletes the texture of the depth target
 	void Unload();
+	//The depth texture's GL handle
+	GLuint GetHandle() const;
 	//Holds the depth texture
 	Texture2D _texture;
 };
@@ -21,6 +26,8 @@ struct ColorTarget
 	~ColorTarget();
 	//Deletes the texture of the color targets
 	void Unload();
+	//A color texture's GL handle
+	GLuint GetHandle(unsigned index) const;
 	//Holds the color textures
 	std::vector<Texture2D> _textures;
 	std::vector<GLenum> _formats;
@@ -51,11 +58,18 @@ public:
 	//Adds a color target
 	//**You can have as many as you want**//
 	void AddColorTarget(GLenum format);
+	//Changes the format of a color target (remakes the targets if we're already initialized)
+	void SetColorFormat(unsigned colorBuffer, GLenum format);
+	GLenum GetColorFormat(unsigned colorBuffer) const;
+	//Size of one pixel in a format we use for targets (0 if we don't know it)
+	static unsigned GetBytesPerPixel(GLenum format);
 	
 	//Binds our depth buffer as a texture to specified slot
 	void BindDepthAsTexture(int textureSlot) const;
 	//Binds our color buffer as a texture to specified slot
 	void BindColorAsTexture(unsigned colorBuffer, int textureSlot) const;
+	//Binds a color buffer as an image for compute shaders to write to (in its own format)
+	void BindColorAsImage(unsigned colorBuffer, GLuint unit, GLenum access) const;
 	//Unbinds texture from a specific texture slot
 	void UnbindTexture(int textureSlot) const;
 
@@ -64,8 +78,18 @@ public:
 	//Sets the size of the framebuffer
 	void SetSize(unsigned width, unsigned height);
 
-	//Sets the viewport to fullscreen (using the size of framebuffer)
+	//Sets the viewport to the part of the framebuffer being drawn into (all of it unless SetRenderSize says otherwise)
 	void SetViewport() const;
+
+	//Draws into just the bottom left corner of the targets, so the resolution can change without reallocating anything
+	//*The viewport, blits and ReadColor use the render size, Init and Reshape set it back to the full size
+	void SetRenderSize(unsigned width, unsigned height);
+	unsigned GetRenderWidth() const;
+	unsigned GetRenderHeight() const;
+	//Render size over the full size, what UVs need scaling by to read only the part that was drawn
+	glm::vec2 GetRenderScale() const;
+	//Filter used when the targets are sampled (set before Init)
+	void SetFilter(GLenum filter);
 	
 	//Binds the framebuffer
 	void Bind() const;
@@ -74,9 +98,20 @@ public:
 
 	//Renders the framebuffer to our FullScreenQuad
 	void RenderToFSQ() const;
+	//Renders to our FullScreenQuad, but only the pixels inside this rectangle get shaded
+	void RenderToFSQ(int x, int y, unsigned width, unsigned height) const;
 
 	//Draws the contents of the framebuffer to the back buffer
 	void DrawToBackbuffer();
+	//Copies a color target into another framebuffer's color targets without running a shader
+	//*Use this for passes that would only copy, it never touches the fragment shader
+	void BlitColorTo(const Framebuffer& target, unsigned colorBuffer = 0, GLenum filter = GL_NEAREST) const;
+	//Copies the depth buffer into another framebuffer (both need a depth target)
+	void BlitDepthTo(const Framebuffer& target) const;
+
+	//Reads a color target into client memory, or into the bound GL_PIXEL_PACK_BUFFER
+	//*When a pack buffer is bound pixels is an offset into it
+	void ReadColor(unsigned colorBuffer, GLenum format, GLenum type, void* pixels) const;
 
 	//Clears the framebuffer using our clear flag
 	void Clear();
@@ -84,15 +119,18 @@ public:
 	bool CheckFBO();
 
 	//Initializes fullscreen quad
-	//*Creates VAO for full screen quad
-	//*covers -1 to 1 range
+	//*Creates an empty VAO, the vertex shader makes the corners itself
+	//*It's one triangle covering -1 to 3, clipped down to the -1 to 1 range
 	static void InitFullscreenQuad();
-	//Draws our fullscreen quad
+	//Draws our fullscreen quad (3 vertices, use passthrough_vert.glsl with it)
 	static void DrawFullscreenQuad();
 
 	//Initial width and height is zero
 	unsigned int _width = 0;
 	unsigned int _height = 0;
+	//Part of the targets being drawn into
+	unsigned int _renderWidth = 0;
+	unsigned int _renderHeight = 0;
 protected:
 	//OpenGL framebuffer handle
 	GLuint _FBO;
@@ -114,8 +152,6 @@ protected:
 	//Depth attachment?
 	bool _depthActive = false;
 
-	//Full screen quad VBO handle
-	static GLuint _fullscreenQuadVBO;
 	//Full screen quad VAO handle
 	static GLuint _fullscreenQuadVAO;
 
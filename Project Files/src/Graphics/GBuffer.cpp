@@ -0,0 +1,37 @@
+#include "GBuffer.h"
+
+void GBuffer::Init(unsigned width, unsigned height)
+{
+	AddColorTarget(GL_RGBA8);
+	AddColorTarget(GL_RGB10_A2);
+	AddDepthTarget();
+	Framebuffer::Init(width, height);
+
+	_lightingShader = ShaderManager::Load("shaders/passthrough_vert.glsl", "shaders/deferred_lighting_frag.glsl");
+}
+
+void GBuffer::DrawLighting(Framebuffer* target, const glm::mat4& view, const glm::mat4& projection)
+{
+	GLStateCache::UseProgram(_lightingShader->GetHandle());
+	_lightingShader->SetUniformMatrix("u_InverseViewProjection", glm::inverse(projection * view));
+	glm::vec3 camPos = glm::inverse(view) * glm::vec4(0, 0, 0, 1);
+	_lightingShader->SetUniform("u_CamPos", camPos);
+
+	BindColorAsTexture(0, 0);
+	BindColorAsTexture(1, 1);
+	BindDepthAsTexture(2);
+
+	//Every pixel is only touched once, there's nothing to depth test against
+	GLStateCache::Disable(GL_DEPTH_TEST);
+	target->SetViewport();
+	target->Bind();
+	DrawFullscreenQuad();
+	target->Unbind();
+	GLStateCache::Enable(GL_DEPTH_TEST);
+
+	UnbindTexture(0);
+	UnbindTexture(1);
+	UnbindTexture(2);
+
+	BlitDepthTo(*target);
+}
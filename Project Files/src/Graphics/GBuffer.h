@@ -0,0 +1,26 @@
+#pragma once
+#include <GLM/glm.hpp>
+
+#include "Graphics/Framebuffer.h"
+#include "Graphics/ShaderManager.h"
+
+//The deferred renderer draws the surfaces of the scene in here, then lights each pixel once
+//*0: albedo and specular map (RGBA8)
+//*1: octahedral normal and shininess (RGB10_A2)
+//*Depth is a 24 bit texture, positions are rebuilt from it
+//*The packing is in res/shaders/gbuffer.glsl
+class GBuffer : public Framebuffer
+{
+public:
+	void Init(unsigned width, unsigned height) override;
+
+	//Lights every pixel with something in it into target, then copies the depth across
+	//so anything drawn forward afterwards (the skybox) still sits behind the scene
+	void DrawLighting(Framebuffer* target, const glm::mat4& view, const glm::mat4& projection);
+
+	//Bytes the geometry pass writes per pixel (both color targets and depth)
+	static const int BYTES_PER_PIXEL = 12;
+
+private:
+	Shader::sptr _lightingShader;
+};
@@ -0,0 +1,368 @@
+#include "GLStateCache.h"
+
+bool GLStateCache::Enabled = true;
+
+GLuint GLStateCache::_program = GLStateCache::UNKNOWN;
+GLuint GLStateCache::_readFramebuffer = GLStateCache::UNKNOWN;
+GLuint GLStateCache::_drawFramebuffer = GLStateCache::UNKNOWN;
+GLuint GLStateCache::_vertexArray = GLStateCache::UNKNOWN;
+int GLStateCache::_activeTexture = -1;
+GLuint GLStateCache::_textures[GLStateCache::MAX_TEXTURE_UNITS][GLStateCache::NUM_TEXTURE_TARGETS];
+
+int GLStateCache::_capabilities[GLStateCache::NUM_CAPABILITIES] = { -1, -1, -1, -1, -1 };
+
+GLint GLStateCache::_viewport[4] = { 0, 0, 0, 0 };
+float GLStateCache::_clearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+float GLStateCache::_clearDepth = 1.0f;
+GLenum GLStateCache::_depthFunc = GL_LESS;
+bool GLStateCache::_depthMask = true;
+bool GLStateCache::_colorMask[4] = { true, true, true, true };
+GLenum GLStateCache::_blendFunc[2] = { GL_ONE, GL_ZERO };
+bool GLStateCache::_clearColorKnown = false;
+bool GLStateCache::_clearDepthKnown = false;
+bool GLStateCache::_depthFuncKnown = false;
+bool GLStateCache::_viewportKnown = false;
+bool GLStateCache::_depthMaskKnown = false;
+bool GLStateCache::_colorMaskKnown = false;
+bool GLStateCache::_blendFuncKnown = false;
+
+int GLStateCache::_issued[GLStateCache::NUM_CALL_TYPES] = { 0 };
+int GLStateCache::_skipped[GLStateCache::NUM_CALL_TYPES] = { 0 };
+int GLStateCache::_lastIssued[GLStateCache::NUM_CALL_TYPES] = { 0 };
+int GLStateCache::_lastSkipped[GLStateCache::NUM_CALL_TYPES] = { 0 };
+
+void GLStateCache::NewFrame()
+{
+	//Store this frame's counts so the UI can show a complete frame
+	for (int i = 0; i < NUM_CALL_TYPES; i++)
+	{
+		_lastIssued[i] = _issued[i];
+		_lastSkipped[i] = _skipped[i];
+		_issued[i] = 0;
+		_skipped[i] = 0;
+	}
+}
+
+void GLStateCache::Invalidate()
+{
+	InvalidateProgram();
+	InvalidateTextures();
+	InvalidateVertexArray();
+	InvalidateFramebuffers();
+
+	for (int i = 0; i < NUM_CAPABILITIES; i++)
+		_capabilities[i] = -1;
+
+	_clearColorKnown = false;
+	_clearDepthKnown = false;
+	_depthFuncKnown = false;
+	_viewportKnown = false;
+	_depthMaskKnown = false;
+	_colorMaskKnown = false;
+	_blendFuncKnown = false;
+}
+
+void GLStateCache::InvalidateProgram()
+{
+	_program = UNKNOWN;
+}
+
+void GLStateCache::InvalidateTextures()
+{
+	_activeTexture = -1;
+	for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+		for (int j = 0; j < NUM_TEXTURE_TARGETS; j++)
+			_textures[i][j] = UNKNOWN;
+}
+
+void GLStateCache::InvalidateVertexArray()
+{
+	_vertexArray = UNKNOWN;
+}
+
+void GLStateCache::InvalidateFramebuffers()
+{
+	_readFramebuffer = UNKNOWN;
+	_drawFramebuffer = UNKNOWN;
+}
+
+void GLStateCache::ForgetFramebuffer(GLuint framebuffer)
+{
+	//GL reverts bindings of a deleted framebuffer to the default framebuffer
+	if (_readFramebuffer == framebuffer)
+		_readFramebuffer = GL_NONE;
+	if (_drawFramebuffer == framebuffer)
+		_drawFramebuffer = GL_NONE;
+}
+
+void GLStateCache::ForgetTexture(GLuint texture)
+{
+	//GL reverts any unit the deleted texture was bound to back to zero
+	for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+		for (int j = 0; j < NUM_TEXTURE_TARGETS; j++)
+			if (_textures[i][j] == texture)
+				_textures[i][j] = GL_NONE;
+}
+
+void GLStateCache::UseProgram(GLuint program)
+{
+	if (Record(PROGRAM, _program == program))
+	{
+		glUseProgram(program);
+		_program = program;
+	}
+}
+
+void GLStateCache::BindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	bool redundant = false;
+	if (target == GL_FRAMEBUFFER)
+		redundant = (_readFramebuffer == framebuffer && _drawFramebuffer == framebuffer);
+	else if (target == GL_READ_FRAMEBUFFER)
+		redundant = (_readFramebuffer == framebuffer);
+	else if (target == GL_DRAW_FRAMEBUFFER)
+		redundant = (_drawFramebuffer == framebuffer);
+
+	if (Record(FRAMEBUFFER, redundant))
+	{
+		glBindFramebuffer(target, framebuffer);
+
+		if (target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER)
+			_readFramebuffer = framebuffer;
+		if (target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER)
+			_drawFramebuffer = framebuffer;
+	}
+}
+
+void GLStateCache::BindTexture(int textureSlot, GLenum target, GLuint texture)
+{
+	int targetIndex = TargetIndex(target);
+
+	//Untracked targets or slots go straight through
+	if (targetIndex < 0 || textureSlot < 0 || textureSlot >= MAX_TEXTURE_UNITS)
+	{
+		Record(TEXTURE, false);
+		glActiveTexture(GL_TEXTURE0 + textureSlot);
+		glBindTexture(target, texture);
+		_activeTexture = textureSlot;
+		return;
+	}
+
+	if (Record(TEXTURE, _textures[textureSlot][targetIndex] == texture))
+	{
+		ActiveTexture(textureSlot);
+		glBindTexture(target, texture);
+		_textures[textureSlot][targetIndex] = texture;
+	}
+}
+
+void GLStateCache::ActiveTexture(int textureSlot)
+{
+	if (Record(TEXTURE, _activeTexture == textureSlot))
+	{
+		glActiveTexture(GL_TEXTURE0 + textureSlot);
+		_activeTexture = textureSlot;
+	}
+}
+
+void GLStateCache::BindVertexArray(GLuint vao)
+{
+	if (Record(VERTEX_ARRAY, _vertexArray == vao))
+	{
+		glBindVertexArray(vao);
+		_vertexArray = vao;
+	}
+}
+
+void GLStateCache::Enable(GLenum capability)
+{
+	int index = CapabilityIndex(capability);
+
+	if (Record(CAPABILITY, index >= 0 && _capabilities[index] == 1))
+	{
+		glEnable(capability);
+		if (index >= 0)
+			_capabilities[index] = 1;
+	}
+}
+
+void GLStateCache::Disable(GLenum capability)
+{
+	int index = CapabilityIndex(capability);
+
+	if (Record(CAPABILITY, index >= 0 && _capabilities[index] == 0))
+	{
+		glDisable(capability);
+		if (index >= 0)
+			_capabilities[index] = 0;
+	}
+}
+
+void GLStateCache::Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	bool redundant = _viewportKnown && _viewport[0] == x && _viewport[1] == y &&
+		_viewport[2] == width && _viewport[3] == height;
+
+	if (Record(VIEWPORT, redundant))
+	{
+		glViewport(x, y, width, height);
+		_viewport[0] = x;
+		_viewport[1] = y;
+		_viewport[2] = width;
+		_viewport[3] = height;
+		_viewportKnown = true;
+	}
+}
+
+void GLStateCache::ClearColor(float r, float g, float b, float a)
+{
+	bool redundant = _clearColorKnown && _clearColor[0] == r && _clearColor[1] == g &&
+		_clearColor[2] == b && _clearColor[3] == a;
+
+	if (Record(CLEAR_STATE, redundant))
+	{
+		glClearColor(r, g, b, a);
+		_clearColor[0] = r;
+		_clearColor[1] = g;
+		_clearColor[2] = b;
+		_clearColor[3] = a;
+		_clearColorKnown = true;
+	}
+}
+
+void GLStateCache::ClearDepth(float depth)
+{
+	if (Record(CLEAR_STATE, _clearDepthKnown && _clearDepth == depth))
+	{
+		glClearDepth(depth);
+		_clearDepth = depth;
+		_clearDepthKnown = true;
+	}
+}
+
+void GLStateCache::DepthFunc(GLenum func)
+{
+	if (Record(CLEAR_STATE, _depthFuncKnown && _depthFunc == func))
+	{
+		glDepthFunc(func);
+		_depthFunc = func;
+		_depthFuncKnown = true;
+	}
+}
+
+void GLStateCache::DepthMask(bool write)
+{
+	if (Record(WRITE_STATE, _depthMaskKnown && _depthMask == write))
+	{
+		glDepthMask(write ? GL_TRUE : GL_FALSE);
+		_depthMask = write;
+		_depthMaskKnown = true;
+	}
+}
+
+void GLStateCache::ColorMask(bool r, bool g, bool b, bool a)
+{
+	bool redundant = _colorMaskKnown && _colorMask[0] == r && _colorMask[1] == g &&
+		_colorMask[2] == b && _colorMask[3] == a;
+
+	if (Record(WRITE_STATE, redundant))
+	{
+		glColorMask(r ? GL_TRUE : GL_FALSE, g ? GL_TRUE : GL_FALSE, b ? GL_TRUE : GL_FALSE, a ? GL_TRUE : GL_FALSE);
+		_colorMask[0] = r;
+		_colorMask[1] = g;
+		_colorMask[2] = b;
+		_colorMask[3] = a;
+		_colorMaskKnown = true;
+	}
+}
+
+void GLStateCache::BlendFunc(GLenum source, GLenum destination)
+{
+	if (Record(WRITE_STATE, _blendFuncKnown && _blendFunc[0] == source && _blendFunc[1] == destination))
+	{
+		glBlendFunc(source, destination);
+		_blendFunc[0] = source;
+		_blendFunc[1] = destination;
+		_blendFuncKnown = true;
+	}
+}
+
+int GLStateCache::GetIssuedCalls(CallType type)
+{
+	return _lastIssued[type];
+}
+
+int GLStateCache::GetSkippedCalls(CallType type)
+{
+	return _lastSkipped[type];
+}
+
+int GLStateCache::GetTotalIssuedCalls()
+{
+	int total = 0;
+	for (int i = 0; i < NUM_CALL_TYPES; i++)
+		total += _lastIssued[i];
+	return total;
+}
+
+int GLStateCache::GetTotalSkippedCalls()
+{
+	int total = 0;
+	for (int i = 0; i < NUM_CALL_TYPES; i++)
+		total += _lastSkipped[i];
+	return total;
+}
+
+const char* GLStateCache::GetCallTypeName(CallType type)
+{
+	switch (type)
+	{
+	case PROGRAM: return "Program";
+	case FRAMEBUFFER: return "Framebuffer";
+	case TEXTURE: return "Texture";
+	case VERTEX_ARRAY: return "Vertex Array";
+	case CAPABILITY: return "Enable/Disable";
+	case VIEWPORT: return "Viewport";
+	case CLEAR_STATE: return "Clear/Depth State";
+	case WRITE_STATE: return "Mask/Blend State";
+	default: return "Unknown";
+	}
+}
+
+int GLStateCache::TargetIndex(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D: return 0;
+	case GL_TEXTURE_3D: return 1;
+	case GL_TEXTURE_CUBE_MAP: return 2;
+	case GL_TEXTURE_2D_ARRAY: return 3;
+	default: return -1;
+	}
+}
+
+int GLStateCache::CapabilityIndex(GLenum capability)
+{
+	switch (capability)
+	{
+	case GL_DEPTH_TEST: return 0;
+	case GL_CULL_FACE: return 1;
+	case GL_BLEND: return 2;
+	case GL_SCISSOR_TEST: return 3;
+	case GL_FRAMEBUFFER_SRGB: return 4;
+	default: return -1;
+	}
+}
+
+bool GLStateCache::Record(CallType type, bool redundant)
+{
+	//When disabled everything is issued so the two modes can be compared
+	if (redundant && Enabled)
+	{
+		_skipped[type]++;
+		return false;
+	}
+
+	_issued[type]++;
+	return true;
+}
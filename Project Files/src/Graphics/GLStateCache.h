@@ -0,0 +1,131 @@
+#pragma once
+#include <glad/glad.h>
+
+//Shadows the OpenGL state we touch every frame so redundant binds and state changes
+//never reach the driver
+//*Anything that changes GL state behind our back (ShaderMaterial::Apply, VAO renders, ImGui)
+//*must be followed by the matching Invalidate call so we never skip a call we needed
+class GLStateCache abstract
+{
+public:
+	//The kinds of calls we filter (used to index the statistics)
+	enum CallType
+	{
+		PROGRAM = 0,
+		FRAMEBUFFER,
+		TEXTURE,
+		VERTEX_ARRAY,
+		CAPABILITY,
+		VIEWPORT,
+		CLEAR_STATE,
+		WRITE_STATE,
+		NUM_CALL_TYPES
+	};
+
+	//Number of texture units we shadow (the LUT lives in slot 30)
+	static const int MAX_TEXTURE_UNITS = 32;
+
+	//Moves this frame's counters into the last frame's counters and resets them
+	//*Call once at the start of every frame
+	static void NewFrame();
+
+	//Forgets everything, the next call of every kind will be issued
+	static void Invalidate();
+	//Forgets the bound program
+	static void InvalidateProgram();
+	//Forgets all texture bindings (and the active unit)
+	static void InvalidateTextures();
+	//Forgets the bound vertex array
+	static void InvalidateVertexArray();
+	//Forgets the bound framebuffers
+	static void InvalidateFramebuffers();
+
+	//Deleting an object that is bound reverts that binding to zero, call these before deleting
+	static void ForgetFramebuffer(GLuint framebuffer);
+	static void ForgetTexture(GLuint texture);
+
+	//Binds a shader program
+	static void UseProgram(GLuint program);
+	//Binds a framebuffer (GL_FRAMEBUFFER sets both the read and draw target)
+	static void BindFramebuffer(GLenum target, GLuint framebuffer);
+	//Binds a texture to a texture slot
+	//*Supports GL_TEXTURE_2D, GL_TEXTURE_3D, GL_TEXTURE_CUBE_MAP and GL_TEXTURE_2D_ARRAY
+	static void BindTexture(int textureSlot, GLenum target, GLuint texture);
+	//Sets the active texture slot
+	static void ActiveTexture(int textureSlot);
+	//Binds a vertex array
+	static void BindVertexArray(GLuint vao);
+
+	//Enables or disables a capability
+	//*Untracked capabilities are always issued
+	static void Enable(GLenum capability);
+	static void Disable(GLenum capability);
+
+	//Sets the viewport
+	static void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	//Clear values
+	static void ClearColor(float r, float g, float b, float a);
+	static void ClearDepth(float depth);
+	static void DepthFunc(GLenum func);
+
+	//What gets written, and how it's blended in
+	static void DepthMask(bool write);
+	static void ColorMask(bool r, bool g, bool b, bool a);
+	static void BlendFunc(GLenum source, GLenum destination);
+
+	//Calls that reached the driver / were filtered out last frame
+	static int GetIssuedCalls(CallType type);
+	static int GetSkippedCalls(CallType type);
+	static int GetTotalIssuedCalls();
+	static int GetTotalSkippedCalls();
+	static const char* GetCallTypeName(CallType type);
+
+	//Lets the cache be turned off to measure the difference (every call is issued)
+	static bool Enabled;
+
+private:
+	//Returns the index of a texture target in our shadow table (or -1 if untracked)
+	static int TargetIndex(GLenum target);
+	//Returns the index of a capability in our shadow table (or -1 if untracked)
+	static int CapabilityIndex(GLenum capability);
+	//Records a call as either issued or skipped, returns true if it must be issued
+	static bool Record(CallType type, bool redundant);
+
+	//Number of texture targets we shadow per unit
+	static const int NUM_TEXTURE_TARGETS = 4;
+	//Number of capabilities we shadow
+	static const int NUM_CAPABILITIES = 5;
+	//Value used for "we don't know what's bound"
+	static const GLuint UNKNOWN = 0xFFFFFFFF;
+
+	static GLuint _program;
+	static GLuint _readFramebuffer;
+	static GLuint _drawFramebuffer;
+	static GLuint _vertexArray;
+	static int _activeTexture;
+	static GLuint _textures[MAX_TEXTURE_UNITS][NUM_TEXTURE_TARGETS];
+
+	//0 = disabled, 1 = enabled, -1 = unknown
+	static int _capabilities[NUM_CAPABILITIES];
+
+	static GLint _viewport[4];
+	static float _clearColor[4];
+	static float _clearDepth;
+	static GLenum _depthFunc;
+	static bool _depthMask;
+	static bool _colorMask[4];
+	static GLenum _blendFunc[2];
+	static bool _clearColorKnown;
+	static bool _clearDepthKnown;
+	static bool _depthFuncKnown;
+	static bool _viewportKnown;
+	static bool _depthMaskKnown;
+	static bool _colorMaskKnown;
+	static bool _blendFuncKnown;
+
+	static int _issued[NUM_CALL_TYPES];
+	static int _skipped[NUM_CALL_TYPES];
+	static int _lastIssued[NUM_CALL_TYPES];
+	static int _lastSkipped[NUM_CALL_TYPES];
+};
@@ -0,0 +1,115 @@
+#include "GpuProfiler.h"
+
+bool GpuProfiler::Enabled = true;
+double GpuProfiler::Smoothing = 0.1;
+
+std::vector<GpuProfiler::Scope> GpuProfiler::_scopes;
+std::vector<std::string> GpuProfiler::_names;
+std::unordered_map<std::string, int> GpuProfiler::_indices;
+long long GpuProfiler::_frame = 0;
+
+void GpuProfiler::Unload()
+{
+	for (Scope& scope : _scopes)
+	{
+		glDeleteQueries(FRAMES_IN_FLIGHT, scope.start);
+		glDeleteQueries(FRAMES_IN_FLIGHT, scope.end);
+	}
+	_scopes.clear();
+	_names.clear();
+	_indices.clear();
+}
+
+void GpuProfiler::NewFrame()
+{
+	_frame++;
+
+	for (Scope& scope : _scopes)
+	{
+		for (int slot = 0; slot < FRAMES_IN_FLIGHT; slot++)
+		{
+			if (scope.issued[slot] < 0)
+				continue;
+
+			//Only ask for the result once it's there, asking early waits on the GPU
+			GLint available = 0;
+			glGetQueryObjectiv(scope.end[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				continue;
+
+			GLuint64 start = 0, end = 0;
+			glGetQueryObjectui64v(scope.start[slot], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(scope.end[slot], GL_QUERY_RESULT, &end);
+			scope.issued[slot] = -1;
+
+			scope.last = double(end - start) / 1000000.0;
+			scope.average = scope.hasResult ? scope.average + (scope.last - scope.average) * Smoothing : scope.last;
+			scope.hasResult = true;
+		}
+	}
+}
+
+void GpuProfiler::Begin(const std::string& name)
+{
+	if (!Enabled)
+		return;
+
+	Scope* scope = GetScope(name);
+	int slot = int(_frame % FRAMES_IN_FLIGHT);
+	//The GPU is more than FRAMES_IN_FLIGHT behind, drop this sample rather than wait on it
+	if (scope->issued[slot] >= 0)
+		return;
+
+	glQueryCounter(scope->start[slot], GL_TIMESTAMP);
+	scope->issued[slot] = -2;
+}
+
+void GpuProfiler::End(const std::string& name)
+{
+	if (!Enabled)
+		return;
+
+	Scope* scope = GetScope(name);
+	int slot = int(_frame % FRAMES_IN_FLIGHT);
+	//Only end scopes that began this frame
+	if (scope->issued[slot] != -2)
+		return;
+
+	glQueryCounter(scope->end[slot], GL_TIMESTAMP);
+	scope->issued[slot] = _frame;
+}
+
+double GpuProfiler::GetTime(const std::string& name)
+{
+	auto it = _indices.find(name);
+	return it == _indices.end() ? 0.0 : _scopes[it->second].average;
+}
+
+double GpuProfiler::GetLastTime(const std::string& name)
+{
+	auto it = _indices.find(name);
+	return it == _indices.end() ? 0.0 : _scopes[it->second].last;
+}
+
+const std::vector<std::string>& GpuProfiler::GetScopeNames()
+{
+	return _names;
+}
+
+GpuProfiler::Scope* GpuProfiler::GetScope(const std::string& name)
+{
+	auto it = _indices.find(name);
+	if (it != _indices.end())
+		return &_scopes[it->second];
+
+	Scope scope;
+	glGenQueries(FRAMES_IN_FLIGHT, scope.start);
+	glGenQueries(FRAMES_IN_FLIGHT, scope.end);
+	for (int slot = 0; slot < FRAMES_IN_FLIGHT; slot++)
+		scope.issued[slot] = -1;
+
+	_indices[name] = int(_scopes.size());
+	_names.push_back(name);
+	_scopes.push_back(scope);
+	return &_scopes.back();
+}
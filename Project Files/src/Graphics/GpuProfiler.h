@@ -0,0 +1,56 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <glad/glad.h>
+
+//Times sections of the frame on the GPU with timestamp queries
+//*Results are read a few frames late so we never stall waiting on the GPU
+//*Scopes can be nested or overlap, each one is a pair of timestamps
+class GpuProfiler abstract
+{
+public:
+	//Frames a query can be in flight before its slot is reused
+	static const int FRAMES_IN_FLIGHT = 4;
+
+	//Deletes every query
+	static void Unload();
+
+	//Collects any results the GPU has finished, call once at the start of every frame
+	static void NewFrame();
+
+	//Marks the start and end of a scope (created the first time it's used)
+	static void Begin(const std::string& name);
+	static void End(const std::string& name);
+
+	//Smoothed time of a scope (ms), zero until its first result comes back
+	static double GetTime(const std::string& name);
+	//Time of the most recent result for a scope (ms)
+	static double GetLastTime(const std::string& name);
+	//Every scope in the order they were first used
+	static const std::vector<std::string>& GetScopeNames();
+
+	//Lets the profiler be turned off (Begin and End do nothing)
+	static bool Enabled;
+	//How much of each new result goes into the smoothed time
+	static double Smoothing;
+
+private:
+	struct Scope
+	{
+		GLuint start[FRAMES_IN_FLIGHT];
+		GLuint end[FRAMES_IN_FLIGHT];
+		//Frame each slot was issued on, -1 if it has nothing waiting
+		long long issued[FRAMES_IN_FLIGHT];
+		double last = 0.0;
+		double average = 0.0;
+		bool hasResult = false;
+	};
+
+	static Scope* GetScope(const std::string& name);
+
+	static std::vector<Scope> _scopes;
+	static std::vector<std::string> _names;
+	static std::unordered_map<std::string, int> _indices;
+	static long long _frame;
+};
@@ -10,10 +10,24 @@ LUT3D::LUT3D(std::string path)
 }
 
 void LUT3D::loadFromFile(std::string path)
+{
+	if (parse(path))
+		upload();
+}
+
+bool LUT3D::parse(std::string path)
 {
 	std::string filePath = path;
 	std::ifstream LUTstream;
 	LUTstream.open(filePath);
+	if (!LUTstream)
+	{
+		printf("Could not open %s\n", filePath.c_str());
+		return false;
+	}
+
+	data.clear();
+	data.reserve(64 * 64 * 64);
 
 	while (!LUTstream.eof())
 	{
@@ -28,6 +42,17 @@ void LUT3D::loadFromFile(std::string path)
 			data.push_back(lineData);
 	}
 
+	if (data.size() < 64 * 64 * 64)
+	{
+		printf("%s isn't a 64x64x64 LUT\n", filePath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+void LUT3D::upload()
+{
 	glEnable(GL_TEXTURE_3D);
 
 	glGenTextures(1, &_handle);
@@ -42,26 +67,31 @@ void LUT3D::loadFromFile(std::string path)
 	unbind();
 
 	glDisable(GL_TEXTURE_3D);
+
+	//The GPU has its own copy now
+	data.clear();
+	data.shrink_to_fit();
 }
 
 void LUT3D::bind()
 {
+	//Binds to whichever slot is currently active
 	glBindTexture(GL_TEXTURE_3D, _handle);
+	GLStateCache::InvalidateTextures();
 }
 
 void LUT3D::unbind()
 {
 	glBindTexture(GL_TEXTURE_3D, GL_NONE);
+	GLStateCache::InvalidateTextures();
 }
 
 void LUT3D::bind(int textureSlot)
 {
-	glActiveTexture(GL_TEXTURE0 + textureSlot);
-	bind();
+	GLStateCache::BindTexture(textureSlot, GL_TEXTURE_3D, _handle);
 }
 
 void LUT3D::unbind(int textureSlot)
 {
-	glActiveTexture(GL_TEXTURE0 + textureSlot);
-	unbind();
+	GLStateCache::BindTexture(textureSlot, GL_TEXTURE_3D, GL_NONE);
 }
\ No newline at end of file
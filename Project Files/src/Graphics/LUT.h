@@ -5,12 +5,18 @@
 #include <glad/glad.h>
 #include "glm/common.hpp"
 
+#include "Graphics/GLStateCache.h"
+
 class LUT3D
 {
 public:
 	LUT3D();
 	LUT3D(std::string path);
 	void loadFromFile(std::string path);
+	//Reads the .cube file without touching OpenGL (safe on worker threads)
+	bool parse(std::string path);
+	//Sends what parse read to the GPU, then lets go of the CPU copy
+	void upload();
 	void bind();
 	void unbind();
 
@@ -0,0 +1,39 @@
+#include "LightingBuffer.h"
+
+#include <cstring>
+
+#include "Graphics/ShaderManager.h"
+
+void LightingBuffer::Init()
+{
+	glGenBuffers(1, &_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, _buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(Data), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, _buffer);
+
+	ShaderManager::RegisterUniformBlock("Lighting", BINDING);
+	_dirty = true;
+}
+
+void LightingBuffer::Unload()
+{
+	if (_buffer)
+	{
+		glDeleteBuffers(1, &_buffer);
+		_buffer = 0;
+	}
+}
+
+void LightingBuffer::Upload()
+{
+	if (!_dirty && memcmp(&Values, &_uploaded, sizeof(Data)) == 0)
+		return;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, _buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Data), &Values);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	_uploaded = Values;
+	_dirty = false;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <glad/glad.h>
+#include <GLM/glm.hpp>
+
+//The scene's light settings in one uniform buffer that every lit program reads from
+//*Set once a frame instead of pushing each uniform into each shader (and each variant of it)
+class LightingBuffer
+{
+public:
+	//Matches the Lighting block in lighting_block.glsl (std140, so every vec3 gets a float after it)
+	struct Data
+	{
+		glm::vec3 AmbientCol = glm::vec3(1.0f);
+		float     AmbientStrength = 0.1f;
+		glm::vec3 LightPos = glm::vec3(0.0f);
+		float     AmbientLightStrength = 0.05f;
+		glm::vec3 LightCol = glm::vec3(1.0f);
+		float     SpecularLightStrength = 1.0f;
+		float     AttenuationConstant = 1.0f;
+		float     AttenuationLinear = 0.09f;
+		float     AttenuationQuadratic = 0.032f;
+		//How much the ambient light is darkened by the occlusion (0 when there isn't any)
+		float     AmbientOcclusion = 0.0f;
+		//How far the ambient color is replaced by the environment's lighting cubes (0 when there aren't any)
+		float     EnvironmentStrength = 0.0f;
+		//Time the SIN_WAVE vertex stages ripple with
+		float     WaveTime = 0.0f;
+		float     Padding[2] = {};
+		//Turns the lighting cubes the same way the skybox is turned
+		glm::mat4 EnvironmentRotation = glm::mat4(1.0f);
+	};
+
+	//Uniform buffer binding point the block is attached to
+	static const GLuint BINDING = 0;
+
+	//Makes the buffer and points the Lighting block of every program at it
+	void Init();
+	void Unload();
+
+	//Sends Values to the GPU, skipped if nothing changed since the last upload
+	void Upload();
+
+	Data Values;
+
+private:
+	GLuint _buffer = 0;
+	Data _uploaded;
+	bool _dirty = true;
+};
@@ -0,0 +1,194 @@
+#include "MaterialBatcher.h"
+
+#include <cstdio>
+#include <algorithm>
+
+#include "Graphics/GLStateCache.h"
+
+void MaterialBatcher::Init()
+{
+	glGenBuffers(1, &_materialBuffer);
+
+	//Storage buffers can't be empty, start it off with something in it
+	MaterialData empty = {};
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, _materialBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(empty), &empty, GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	//Nothing else uses this binding point, so it only needs binding once
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BINDING, _materialBuffer);
+}
+
+void MaterialBatcher::Unload()
+{
+	for (TextureArray& array : _arrays)
+	{
+		GLStateCache::ForgetTexture(array.handle);
+		glDeleteTextures(1, &array.handle);
+	}
+	_arrays.clear();
+	_entries.clear();
+	_indices.clear();
+
+	glDeleteBuffers(1, &_materialBuffer);
+	_materialBuffer = 0;
+}
+
+void MaterialBatcher::Add(const ShaderMaterial::sptr& material, const Texture2D::sptr& diffuse, const Texture2D::sptr& specular, float shininess)
+{
+	//Anything that failed to load can't be batched
+	if (material == nullptr || diffuse == nullptr || specular == nullptr)
+		return;
+	_entries.push_back({ material, diffuse, specular, shininess });
+}
+
+void MaterialBatcher::Build()
+{
+	std::vector<MaterialData> materials;
+	for (const Entry& entry : _entries)
+	{
+		GLuint textures[2] = { entry.diffuse->GetHandle(), entry.specular->GetHandle() };
+		TextureArray descriptions[2];
+		int found[2];
+		for (int i = 0; i < 2; i++)
+		{
+			Describe(textures[i], descriptions[i]);
+			found[i] = FindArray(descriptions[i], textures[i]);
+		}
+		//Arrays this material would add (both textures go in the same new one when they can)
+		size_t needed = (found[0] < 0 ? 1 : 0) + (found[1] < 0 && !(found[0] < 0 && Matches(descriptions[0], descriptions[1])) ? 1 : 0);
+		if (_arrays.size() + needed > MAX_ARRAYS)
+		{
+			printf("Not enough texture arrays to batch a material, it will be drawn on its own\n");
+			continue;
+		}
+
+		MaterialData data = {};
+		for (int i = 0; i < 2; i++)
+		{
+			int array = FindArray(descriptions[i], textures[i]);
+			if (array < 0)
+			{
+				array = int(_arrays.size());
+				_arrays.push_back(descriptions[i]);
+			}
+			std::vector<GLuint>& layers = _arrays[array].layers;
+			auto layer = std::find(layers.begin(), layers.end(), textures[i]);
+			if (layer == layers.end())
+				layer = layers.insert(layers.end(), textures[i]);
+			data.Textures[i * 2] = array;
+			data.Textures[i * 2 + 1] = int32_t(layer - layers.begin());
+		}
+		data.Params[0] = entry.shininess;
+
+		_indices[entry.material.get()] = int(materials.size());
+		materials.push_back(data);
+	}
+
+	//Copy every texture into its layer, mips and all (the copies stay on the GPU)
+	for (TextureArray& array : _arrays)
+	{
+		glGenTextures(1, &array.handle);
+		GLStateCache::BindTexture(0, GL_TEXTURE_2D_ARRAY, array.handle);
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, array.levels, array.format, array.width, array.height, GLsizei(array.layers.size()));
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, array.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		GLStateCache::BindTexture(0, GL_TEXTURE_2D_ARRAY, GL_NONE);
+
+		for (size_t layer = 0; layer < array.layers.size(); layer++)
+		{
+			for (GLsizei level = 0; level < array.levels; level++)
+			{
+				GLsizei width = std::max(array.width >> level, 1);
+				GLsizei height = std::max(array.height >> level, 1);
+				glCopyImageSubData(array.layers[layer], GL_TEXTURE_2D, level, 0, 0, 0,
+					array.handle, GL_TEXTURE_2D_ARRAY, level, 0, 0, GLint(layer), width, height, 1);
+			}
+		}
+	}
+
+	if (!materials.empty())
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, _materialBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, materials.size() * sizeof(MaterialData), materials.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+	_entries.clear();
+}
+
+int MaterialBatcher::GetIndex(const ShaderMaterial::sptr& material) const
+{
+	auto it = _indices.find(material.get());
+	return it == _indices.end() ? -1 : it->second;
+}
+
+void MaterialBatcher::Bind() const
+{
+	for (size_t i = 0; i < _arrays.size(); i++)
+		GLStateCache::BindTexture(FIRST_SLOT + int(i), GL_TEXTURE_2D_ARRAY, _arrays[i].handle);
+}
+
+int MaterialBatcher::GetMaterialCount() const
+{
+	return int(_indices.size());
+}
+
+int MaterialBatcher::GetArrayCount() const
+{
+	return int(_arrays.size());
+}
+
+int MaterialBatcher::GetLayerCount() const
+{
+	int layers = 0;
+	for (const TextureArray& array : _arrays)
+		layers += int(array.layers.size());
+	return layers;
+}
+
+void MaterialBatcher::Describe(GLuint texture, TextureArray& description)
+{
+	GLint format = 0, width = 0, height = 0;
+	GLStateCache::BindTexture(0, GL_TEXTURE_2D, texture);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+
+	//Count the levels that are actually there, some textures get a full chain and some only the top
+	GLint levels = 1;
+	while ((width >> levels) > 0 || (height >> levels) > 0)
+	{
+		GLint levelWidth = 0;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, levels, GL_TEXTURE_WIDTH, &levelWidth);
+		if (levelWidth == 0)
+			break;
+		levels++;
+	}
+	GLStateCache::BindTexture(0, GL_TEXTURE_2D, GL_NONE);
+
+	description.format = GLenum(format);
+	description.width = width;
+	description.height = height;
+	description.levels = levels;
+}
+
+int MaterialBatcher::FindArray(const TextureArray& description, GLuint texture) const
+{
+	int match = -1;
+	for (size_t i = 0; i < _arrays.size(); i++)
+	{
+		const TextureArray& array = _arrays[i];
+		if (std::find(array.layers.begin(), array.layers.end(), texture) != array.layers.end())
+			return int(i);
+		if (match < 0 && Matches(array, description))
+			match = int(i);
+	}
+	return match;
+}
+
+bool MaterialBatcher::Matches(const TextureArray& a, const TextureArray& b)
+{
+	return a.format == b.format && a.width == b.width && a.height == b.height && a.levels == b.levels;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <glad/glad.h>
+#include <Texture2D.h>
+#include <ShaderMaterial.h>
+
+//Lets the lit materials draw one after another without binding anything of their own
+//*Textures with the same size, format and number of mips are copied into the layers of one GL_TEXTURE_2D_ARRAY
+//*Everything else about a material (which arrays and layers, shininess) sits in a shader storage buffer
+//*The arrays and the buffer stay bound, so a draw only has to say which material it is (u_MaterialIndex)
+//*and every object sharing a shader draws as one run whatever its material
+//*Materials whose textures would need more than MAX_ARRAYS arrays keep drawing the old way
+class MaterialBatcher
+{
+public:
+	//Arrays the shader can sample (matches materials.glsl), bound to the slots from FIRST_SLOT up
+	static const int MAX_ARRAYS = 8;
+	static const int FIRST_SLOT = 16;
+	//Shader storage binding point (matches materials.glsl)
+	static const GLuint MATERIAL_BINDING = 7;
+
+	void Init();
+	void Unload();
+
+	//Adds a material to batch, the textures are what it has in s_Diffuse and s_Specular
+	//*Call Build once they're all added
+	void Add(const ShaderMaterial::sptr& material, const Texture2D::sptr& diffuse, const Texture2D::sptr& specular, float shininess);
+	//Copies the textures into their arrays and uploads the materials
+	void Build();
+
+	//Where the material is in the storage buffer, -1 if it isn't batched
+	int GetIndex(const ShaderMaterial::sptr& material) const;
+
+	//Binds the arrays, call before drawing anything batched
+	void Bind() const;
+
+	bool Enabled = true;
+
+	//Statistics
+	int GetMaterialCount() const;
+	int GetArrayCount() const;
+	//Textures copied into the arrays
+	int GetLayerCount() const;
+
+private:
+	struct Entry
+	{
+		ShaderMaterial::sptr material;
+		Texture2D::sptr diffuse;
+		Texture2D::sptr specular;
+		float shininess;
+	};
+
+	//One material in the storage buffer (std430, matches MaterialData in materials.glsl)
+	struct MaterialData
+	{
+		//Diffuse array, diffuse layer, specular array, specular layer
+		int32_t Textures[4];
+		//Shininess, the rest is padding
+		float Params[4];
+	};
+
+	//Textures that can share an array
+	struct TextureArray
+	{
+		GLenum format;
+		GLsizei width;
+		GLsizei height;
+		GLsizei levels;
+		//The textures in each layer
+		std::vector<GLuint> layers;
+		GLuint handle = 0;
+	};
+
+	//Reads the size, format and mip count of a texture
+	static void Describe(GLuint texture, TextureArray& description);
+	//Can the two share an array
+	static bool Matches(const TextureArray& a, const TextureArray& b);
+	//Finds the array a texture already has a layer in, or that it could be added to (-1 if there's none)
+	int FindArray(const TextureArray& description, GLuint texture) const;
+
+	std::vector<Entry> _entries;
+	std::unordered_map<const ShaderMaterial*, int> _indices;
+	std::vector<TextureArray> _arrays;
+	GLuint _materialBuffer = 0;
+};
@@ -0,0 +1,284 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include "Graphics/ShaderManager.h"
+
+void OcclusionCuller::Init()
+{
+	_buildShader = ShaderManager::LoadCompute("shaders/hiz_build_comp.glsl");
+	_cullShader = ShaderManager::LoadCompute("shaders/hiz_cull_comp.glsl");
+	_predicateShader = ShaderManager::Load("shaders/hiz_predicate_vert.glsl", "shaders/depth_only_frag.glsl");
+
+	glGenBuffers(1, &_boxBuffer);
+	glGenBuffers(1, &_resultBuffer);
+	glGenVertexArrays(1, &_emptyVao);
+	for (Slot& slot : _slots)
+		glGenBuffers(1, &slot.results);
+}
+
+void OcclusionCuller::Unload()
+{
+	for (Slot& slot : _slots)
+	{
+		if (slot.fence != nullptr)
+			glDeleteSync(slot.fence);
+		slot.fence = nullptr;
+		glDeleteBuffers(1, &slot.results);
+	}
+	glDeleteBuffers(1, &_boxBuffer);
+	glDeleteBuffers(1, &_resultBuffer);
+
+	//Make sure the state cache doesn't think it's still bound
+	GLStateCache::InvalidateVertexArray();
+	glDeleteVertexArrays(1, &_emptyVao);
+	_emptyVao = 0;
+
+	if (!_queries.empty())
+		glDeleteQueries(GLsizei(_queries.size()), _queries.data());
+	_queries.clear();
+	_retested.clear();
+
+	if (_pyramid != 0)
+	{
+		GLStateCache::ForgetTexture(_pyramid);
+		glDeleteTextures(1, &_pyramid);
+		_pyramid = 0;
+	}
+}
+
+void OcclusionCuller::NewFrame()
+{
+	_frame++;
+	_boxes.clear();
+	_entities.clear();
+	_retested.clear();
+
+	if (!Enabled)
+	{
+		_hidden.clear();
+		_tested = 0;
+		return;
+	}
+
+	//Only the newest finished test is worth reading, older ones are just let go
+	Slot* newest = nullptr;
+	for (Slot& slot : _slots)
+	{
+		if (slot.fence == nullptr)
+			continue;
+
+		//A zero timeout only asks, it never waits
+		GLenum status = glClientWaitSync(slot.fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			continue;
+
+		glDeleteSync(slot.fence);
+		slot.fence = nullptr;
+		if (newest == nullptr || slot.issued > newest->issued)
+			newest = &slot;
+	}
+	if (newest == nullptr)
+		return;
+
+	//The fence has passed so this copies straight out, the GPU is already done with it
+	_readback.resize(newest->entities.size());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, newest->results);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, _readback.size() * sizeof(GLuint), _readback.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	_hidden.clear();
+	for (size_t i = 0; i < _readback.size(); i++)
+	{
+		if (_readback[i] == 0)
+			_hidden.insert(newest->entities[i]);
+	}
+	_tested = int(_readback.size());
+	_latency = int(_frame - newest->issued);
+}
+
+bool OcclusionCuller::IsVisible(entt::entity entity) const
+{
+	return !Enabled || _hidden.find(entity) == _hidden.end();
+}
+
+bool OcclusionCuller::IsRetested(entt::entity entity) const
+{
+	return _retested.find(entity) != _retested.end();
+}
+
+void OcclusionCuller::BeginRetested(entt::entity entity)
+{
+	auto query = _retested.find(entity);
+	if (query == _retested.end())
+		return;
+
+	//The GPU holds the draws back until the point has been counted, the CPU never waits
+	glBeginConditionalRender(query->second, GL_QUERY_WAIT);
+	_conditional = true;
+}
+
+void OcclusionCuller::EndRetested()
+{
+	if (!_conditional)
+		return;
+
+	glEndConditionalRender();
+	_conditional = false;
+}
+
+void OcclusionCuller::AddObject(entt::entity entity, const glm::vec3& min, const glm::vec3& max, const glm::mat4& transform)
+{
+	//Move the box into the world and fit a new box around it (the centre moves, the extent is spread by the rotation and scale)
+	glm::vec3 center = transform * glm::vec4((min + max) * 0.5f, 1.0f);
+	glm::vec3 extent = (max - min) * 0.5f;
+	glm::vec3 worldExtent;
+	for (int i = 0; i < 3; i++)
+		worldExtent[i] = glm::abs(transform[0][i]) * extent.x + glm::abs(transform[1][i]) * extent.y + glm::abs(transform[2][i]) * extent.z;
+
+	_boxes.push_back({ glm::vec4(center - worldExtent, 1.0f), glm::vec4(center + worldExtent, 1.0f) });
+	_entities.push_back(entity);
+}
+
+void OcclusionCuller::Test(Framebuffer& depthSource, const glm::mat4& viewProjection)
+{
+	if (!Enabled || _boxes.empty())
+		return;
+
+	if (depthSource._width / 2 != _pyramidWidth || depthSource._height / 2 != _pyramidHeight || _pyramid == 0)
+		ResizePyramid(depthSource._width, depthSource._height);
+
+	//Level 0 is half the size of the depth target, every level after is half the one before
+	depthSource.Unbind();
+	GLStateCache::UseProgram(_buildShader->GetHandle());
+	depthSource.BindDepthAsTexture(0);
+	for (int level = 0; level < _levels; level++)
+	{
+		if (level > 0)
+		{
+			glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+			GLStateCache::BindTexture(0, GL_TEXTURE_2D, _pyramid);
+		}
+		_buildShader->SetUniform("u_SourceLevel", level > 0 ? level - 1 : 0);
+		glBindImageTexture(0, _pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+		unsigned width = std::max(_pyramidWidth >> level, 1u);
+		unsigned height = std::max(_pyramidHeight >> level, 1u);
+		glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+	}
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	//Orphan both buffers so we never write over ones last frame's draws or a read back are still using
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, _boxBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, _boxes.size() * sizeof(Box), _boxes.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, _resultBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, _boxes.size() * sizeof(GLuint), nullptr, GL_STREAM_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BOX_BINDING, _boxBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RESULT_BINDING, _resultBuffer);
+
+	GLStateCache::UseProgram(_cullShader->GetHandle());
+	GLStateCache::BindTexture(0, GL_TEXTURE_2D, _pyramid);
+	_cullShader->SetUniformMatrix("u_ViewProjection", viewProjection);
+	_cullShader->SetUniform("u_Count", int(_boxes.size()));
+	_cullShader->SetUniform("u_Levels", _levels);
+	_cullShader->SetUniform("u_UVScale", depthSource.GetRenderScale());
+	glDispatchCompute(GLuint(_boxes.size() + 63) / 64, 1, 1);
+	GLStateCache::BindTexture(0, GL_TEXTURE_2D, 0);
+
+	//Turn the results of what phase one didn't draw into queries, one point each that only lands on screen if it was
+	//found in view, the draws in phase two wait on them
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+	depthSource.Bind();
+	depthSource.SetViewport();
+	GLStateCache::Disable(GL_DEPTH_TEST);
+	GLStateCache::DepthMask(false);
+	GLStateCache::ColorMask(false, false, false, false);
+	GLStateCache::UseProgram(_predicateShader->GetHandle());
+	GLStateCache::BindVertexArray(_emptyVao);
+	for (size_t i = 0; i < _entities.size(); i++)
+	{
+		if (_hidden.find(_entities[i]) == _hidden.end())
+			continue;
+
+		if (_retested.size() == _queries.size())
+		{
+			_queries.push_back(0);
+			glGenQueries(1, &_queries.back());
+		}
+		GLuint query = _queries[_retested.size()];
+		_retested[_entities[i]] = query;
+
+		//The first vertex picks the object's result
+		glBeginQuery(GL_ANY_SAMPLES_PASSED, query);
+		glDrawArrays(GL_POINTS, GLint(i), 1);
+		glEndQuery(GL_ANY_SAMPLES_PASSED);
+	}
+	GLStateCache::Enable(GL_DEPTH_TEST);
+	GLStateCache::DepthMask(true);
+	GLStateCache::ColorMask(true, true, true, true);
+
+	//Copy the results out for the read back, then drop a fence to know when they're there
+	//*Every slot still has a read back on the GPU, skip this one rather than wait
+	Slot& slot = _slots[_nextSlot];
+	if (slot.fence == nullptr)
+	{
+		_nextSlot = (_nextSlot + 1) % FRAMES_IN_FLIGHT;
+		glBindBuffer(GL_COPY_READ_BUFFER, _resultBuffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, slot.results);
+		if (slot.capacity < _boxes.size())
+		{
+			slot.capacity = _boxes.size();
+			glBufferData(GL_COPY_WRITE_BUFFER, slot.capacity * sizeof(GLuint), nullptr, GL_DYNAMIC_READ);
+		}
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, _boxes.size() * sizeof(GLuint));
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		slot.issued = _frame;
+		slot.entities.swap(_entities);
+	}
+}
+
+int OcclusionCuller::GetTestedCount() const
+{
+	return _tested;
+}
+
+int OcclusionCuller::GetOccludedCount() const
+{
+	return int(_hidden.size());
+}
+
+int OcclusionCuller::GetRetestedCount() const
+{
+	return int(_retested.size());
+}
+
+int OcclusionCuller::GetLatency() const
+{
+	return _latency;
+}
+
+void OcclusionCuller::ResizePyramid(unsigned width, unsigned height)
+{
+	if (_pyramid != 0)
+	{
+		GLStateCache::ForgetTexture(_pyramid);
+		glDeleteTextures(1, &_pyramid);
+	}
+
+	_pyramidWidth = std::max(width / 2, 1u);
+	_pyramidHeight = std::max(height / 2, 1u);
+	_levels = 1;
+	while ((std::max(_pyramidWidth, _pyramidHeight) >> _levels) > 0)
+		_levels++;
+
+	glGenTextures(1, &_pyramid);
+	GLStateCache::BindTexture(0, GL_TEXTURE_2D, _pyramid);
+	glTexStorage2D(GL_TEXTURE_2D, _levels, GL_R32F, _pyramidWidth, _pyramidHeight);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
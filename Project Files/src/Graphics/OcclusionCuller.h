@@ -0,0 +1,110 @@
+#pragma once
+#include <vector>
+#include <unordered_set>
+#include <unordered_map>
+#include <glad/glad.h>
+#include <GLM/glm.hpp>
+#include <Scene.h>
+#include <Shader.h>
+
+#include "Graphics/Framebuffer.h"
+
+//Skips drawing objects that are hidden behind other ones, in two phases every frame
+//*Phase one draws what was in view in the newest results we read back, then its depth is reduced into a pyramid
+//*(each level keeps the farthest depth of the one above)
+//*Every object's bounding box is tested against that pyramid on the GPU, a few texels per object
+//*Phase two draws what was hidden, each inside a conditional render the test decides, so an object that comes out
+//*from behind something is drawn the same frame without the CPU waiting on the result
+//*The results are also read back a few frames later, once a fence says they're done, to pick the next phase one
+class OcclusionCuller
+{
+public:
+	//Read backs that can be waiting on the GPU at once, a frame's read back is skipped if they're all busy
+	static const int FRAMES_IN_FLIGHT = 4;
+
+	//Shader storage binding points (match hiz_cull_comp.glsl)
+	static const GLuint BOX_BINDING = 4;
+	static const GLuint RESULT_BINDING = 5;
+
+	void Init();
+	void Unload();
+
+	//Picks up the newest finished read back, call once a frame before drawing
+	void NewFrame();
+	//Phase one draws the objects that were visible in the newest results (anything that wasn't tested is)
+	bool IsVisible(entt::entity entity) const;
+	//Phase two draws the hidden objects that this frame's test has looked at again
+	bool IsRetested(entt::entity entity) const;
+	//Wrap the draws of a retested object, the GPU skips them unless the test found it in view
+	void BeginRetested(entt::entity entity);
+	void EndRetested();
+
+	//Adds an object to this frame's test, min and max are its mesh's box and transform puts it in the world
+	void AddObject(entt::entity entity, const glm::vec3& min, const glm::vec3& max, const glm::mat4& transform);
+	//Builds the pyramid from the depth phase one drew and tests the objects that were added
+	//*Leaves depthSource bound with its viewport, depth testing on and every write mask on
+	void Test(Framebuffer& depthSource, const glm::mat4& viewProjection);
+
+	bool Enabled = true;
+
+	//Statistics from the newest results
+	//Objects that were tested
+	int GetTestedCount() const;
+	//Objects that were hidden
+	int GetOccludedCount() const;
+	//Hidden objects that were tested again this frame
+	int GetRetestedCount() const;
+	//Frames between the test being issued and the results coming back
+	int GetLatency() const;
+
+private:
+	//std430, matches Box in hiz_cull_comp.glsl
+	struct Box
+	{
+		glm::vec4 min;
+		glm::vec4 max;
+	};
+
+	struct Slot
+	{
+		GLuint results = 0;
+		size_t capacity = 0;
+		GLsync fence = nullptr;
+		long long issued = 0;
+		//Which entity each result belongs to
+		std::vector<entt::entity> entities;
+	};
+
+	//Makes the pyramid texture for a depth target of this size
+	void ResizePyramid(unsigned width, unsigned height);
+
+	Shader::sptr _buildShader;
+	Shader::sptr _cullShader;
+	Shader::sptr _predicateShader;
+
+	GLuint _pyramid = 0;
+	unsigned _pyramidWidth = 0;
+	unsigned _pyramidHeight = 0;
+	int _levels = 0;
+
+	GLuint _boxBuffer = 0;
+	GLuint _resultBuffer = 0;
+	std::vector<Box> _boxes;
+	std::vector<entt::entity> _entities;
+
+	//Points are drawn from gl_VertexID alone, core profile still wants a vertex array bound
+	GLuint _emptyVao = 0;
+	//One occlusion query per retested object, reused every frame
+	std::vector<GLuint> _queries;
+	std::unordered_map<entt::entity, GLuint> _retested;
+	bool _conditional = false;
+
+	Slot _slots[FRAMES_IN_FLIGHT];
+	int _nextSlot = 0;
+	long long _frame = 0;
+
+	std::unordered_set<entt::entity> _hidden;
+	std::vector<GLuint> _readback;
+	int _tested = 0;
+	int _latency = 0;
+};
@@ -0,0 +1,192 @@
+#include "AmbientOcclusionEffect.h"
+
+#include <algorithm>
+
+void AmbientOcclusionEffect::Init(unsigned width, unsigned height)
+{
+	int index = int(m_buffers.size());
+	m_buffers.push_back(new Framebuffer());
+	m_buffers[index]->AddColorTarget(GL_RGBA8);
+	m_buffers[index]->Init(width, height);
+
+	InitTarget(_raw, Half(width), Half(height));
+	for (int i = 0; i < 2; i++)
+	{
+		InitTarget(_history[i], Half(width), Half(height));
+		InitTarget(_blurred[i], Half(width), Half(height));
+	}
+
+	m_shaders.push_back(ShaderManager::Load("shaders/passthrough_vert.glsl", "shaders/Post/ssao_frag.glsl"));
+	m_shaders.push_back(ShaderManager::Load("shaders/passthrough_vert.glsl", "shaders/Post/ssao_temporal_frag.glsl"));
+	m_shaders.push_back(ShaderManager::Load("shaders/passthrough_vert.glsl", "shaders/Post/ssao_blur_frag.glsl"));
+	m_shaders.push_back(ShaderManager::Load("shaders/passthrough_vert.glsl", "shaders/Post/ssao_view_frag.glsl"));
+}
+
+void AmbientOcclusionEffect::Reshape(unsigned width, unsigned height)
+{
+	PostEffect::Reshape(width, height);
+
+	_raw.Reshape(Half(width), Half(height));
+	for (int i = 0; i < 2; i++)
+	{
+		_history[i].Reshape(Half(width), Half(height));
+		_blurred[i].Reshape(Half(width), Half(height));
+	}
+	_result = nullptr;
+	ResetHistory();
+}
+
+void AmbientOcclusionEffect::Apply(Framebuffer* source, Framebuffer* target)
+{
+	if (_result == nullptr)
+	{
+		source->BlitColorTo(*target);
+		return;
+	}
+
+	BindShader(3);
+	m_shaders[3]->SetUniform("u_OcclusionOnly", 0);
+	m_shaders[3]->SetUniform("u_SourceScale", source->GetRenderScale());
+	m_shaders[3]->SetUniform("u_OcclusionScale", _result->GetRenderScale());
+
+	source->BindColorAsTexture(0, 0);
+	_result->BindColorAsTexture(0, 1);
+
+	target->RenderToFSQ();
+
+	_result->UnbindTexture(1);
+	source->UnbindTexture(0);
+
+	UnbindShader();
+}
+
+void AmbientOcclusionEffect::DrawOcclusion(Framebuffer* target, float split)
+{
+	if (_result == nullptr)
+		return;
+
+	BindShader(3);
+	m_shaders[3]->SetUniform("u_OcclusionOnly", 1);
+	m_shaders[3]->SetUniform("u_OcclusionScale", _result->GetRenderScale());
+
+	_result->BindColorAsTexture(0, 1);
+	//The scissor keeps the left of the frame, the UVs are the same as a full pass so the two halves line up
+	unsigned left = unsigned(glm::clamp(split, 0.0f, 1.0f) * target->GetRenderWidth());
+	if (left > 0)
+		target->RenderToFSQ(int(left), 0, target->GetRenderWidth() - left, target->GetRenderHeight());
+	else
+		target->RenderToFSQ();
+	_result->UnbindTexture(1);
+
+	UnbindShader();
+}
+
+void AmbientOcclusionEffect::Build(Framebuffer* depth, const glm::mat4& view, const glm::mat4& projection)
+{
+	//Everything runs in the same corner of the half size targets as the depth was drawn into
+	unsigned width = Half(depth->GetRenderWidth());
+	unsigned height = Half(depth->GetRenderHeight());
+	_raw.SetRenderSize(width, height);
+	for (int i = 0; i < 2; i++)
+	{
+		_history[i].SetRenderSize(width, height);
+		_blurred[i].SetRenderSize(width, height);
+	}
+
+	glm::mat4 viewProjection = projection * view;
+	depth->BindDepthAsTexture(0);
+
+	//The noisy occlusion
+	BindShader(0);
+	const Shader::sptr& ssao = m_shaders[0];
+	ssao->SetUniformMatrix("u_Projection", projection);
+	ssao->SetUniformMatrix("u_InverseProjection", glm::inverse(projection));
+	ssao->SetUniform("u_DepthScale", depth->GetRenderScale());
+	ssao->SetUniform("u_DepthTexelSize", glm::vec2(1.0f / depth->_width, 1.0f / depth->_height));
+	ssao->SetUniform("u_SampleCount", std::clamp(Samples, 1, MAX_SAMPLES));
+	ssao->SetUniform("u_Radius", Radius);
+	ssao->SetUniform("u_Bias", Bias);
+	//The noise only moves when there's a history to average it with
+	ssao->SetUniform("u_Frame", Temporal ? _frame : 0);
+	_raw.RenderToFSQ();
+	_result = &_raw;
+
+	//Into this frame's history, blending in last frame's
+	if (Temporal)
+	{
+		Framebuffer& history = _history[_current];
+		Framebuffer& previous = _history[1 - _current];
+
+		BindShader(1);
+		const Shader::sptr& temporal = m_shaders[1];
+		temporal->SetUniformMatrix("u_InverseViewProjection", glm::inverse(viewProjection));
+		temporal->SetUniformMatrix("u_PreviousViewProjection", _previousViewProjection);
+		temporal->SetUniform("u_DepthScale", depth->GetRenderScale());
+		temporal->SetUniform("u_HistoryScale", _previousScale);
+		temporal->SetUniform("u_Blend", TemporalBlend);
+		temporal->SetUniform("u_HasHistory", int(_hasHistory));
+		_raw.BindColorAsTexture(0, 0);
+		previous.BindColorAsTexture(0, 1);
+		depth->BindDepthAsTexture(2);
+		history.RenderToFSQ();
+		UnbindTexture(2);
+		UnbindTexture(1);
+
+		_result = &history;
+		_previousViewProjection = viewProjection;
+		_previousScale = history.GetRenderScale();
+		_hasHistory = true;
+		_current = 1 - _current;
+	}
+	else
+		ResetHistory();
+
+	//Across and then down, the history keeps the unblurred result so it doesn't get blurrier every frame
+	if (Blur)
+	{
+		BindShader(2);
+		const Shader::sptr& blur = m_shaders[2];
+		blur->SetUniform("u_RenderSize", glm::vec2(float(width), float(height)));
+		blur->SetUniform("u_Sharpness", BlurSharpness);
+		blur->SetUniform("u_Direction", glm::vec2(1.0f, 0.0f));
+		_result->BindColorAsTexture(0, 0);
+		_blurred[0].RenderToFSQ();
+		blur->SetUniform("u_Direction", glm::vec2(0.0f, 1.0f));
+		_blurred[0].BindColorAsTexture(0, 0);
+		_blurred[1].RenderToFSQ();
+		_result = &_blurred[1];
+	}
+
+	UnbindTexture(0);
+	UnbindShader();
+	_frame++;
+}
+
+void AmbientOcclusionEffect::BindOcclusion(int textureSlot)
+{
+	if (_result != nullptr)
+		_result->BindColorAsTexture(0, textureSlot);
+}
+
+void AmbientOcclusionEffect::UnbindOcclusion(int textureSlot) const
+{
+	GLStateCache::BindTexture(textureSlot, GL_TEXTURE_2D, GL_NONE);
+}
+
+void AmbientOcclusionEffect::ResetHistory()
+{
+	_hasHistory = false;
+}
+
+void AmbientOcclusionEffect::InitTarget(Framebuffer& target, unsigned width, unsigned height)
+{
+	//Filtered so the lighting (and the reprojection) can sample between texels
+	target.SetFilter(GL_LINEAR);
+	target.AddColorTarget(GL_RG16F);
+	target.Init(width, height);
+}
+
+unsigned AmbientOcclusionEffect::Half(unsigned size)
+{
+	return std::max(size / 2, 1u);
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <GLM/glm.hpp>
+
+#include "Graphics/Post/PostEffect.h"
+
+//Screen space ambient occlusion, darkening the ambient light in creases and under things
+//*Worked out at half resolution from the depth of the lit surfaces, with the normals rebuilt from that depth
+//*A few samples a pixel, turned by noise that changes every frame, then averaged over frames by reprojecting
+//*last frame's result (history from a different surface is thrown away by comparing depths)
+//*Blurred across and down after that, without blurring over depth edges
+//*Build it once the depth is down but before the lit surfaces are shaded, the lighting reads it from OCCLUSION_SLOT
+//*(set LightingBuffer::Data::AmbientOcclusion to Strength while it's bound)
+//*Apply multiplies a frame by whatever was built last and DrawOcclusion shows it alone (or beside the frame), to see what it's doing
+class AmbientOcclusionEffect : public PostEffect
+{
+public:
+	static const int MAX_SAMPLES = 16;
+
+	void Init(unsigned width, unsigned height) override;
+	void Reshape(unsigned width, unsigned height) override;
+
+	void Apply(Framebuffer* source, Framebuffer* target) override;
+	//Draws the occlusion in greyscale over target
+	//*Only right of split (a fraction of the width) is drawn over, the frame stays on the left to compare against
+	void DrawOcclusion(Framebuffer* target, float split = 0.0f);
+
+	//Works out the occlusion from the depth target of depth (it needs to have one), from the camera it was drawn with
+	void Build(Framebuffer* depth, const glm::mat4& view, const glm::mat4& projection);
+	//Binds the result for the lighting to sample
+	void BindOcclusion(int textureSlot);
+	void UnbindOcclusion(int textureSlot) const;
+	//Forgets the history, so the next frame doesn't blend in the last one (after a cut)
+	void ResetHistory();
+
+	//Samples a pixel (up to MAX_SAMPLES)
+	int Samples = 8;
+	//How far out the samples reach, in world units
+	float Radius = 0.5f;
+	//How far in front of a sample a surface has to be to block it, stops flat surfaces darkening themselves
+	float Bias = 0.025f;
+	//How much of the ambient light the occlusion can take away
+	float Strength = 1.0f;
+
+	bool Temporal = true;
+	//How much of each new frame goes into the history, lower is smoother but trails behind more
+	float TemporalBlend = 0.1f;
+	bool Blur = true;
+	//Higher keeps the blur from crossing smaller depth steps
+	float BlurSharpness = 8.0f;
+
+	//Texture slot the lighting reads the occlusion from (matches lighting.glsl)
+	static const int OCCLUSION_SLOT = 27;
+
+private:
+	void InitTarget(Framebuffer& target, unsigned width, unsigned height);
+	//Half size, at least one pixel
+	static unsigned Half(unsigned size);
+
+	//Occlusion and view depth (RG16F), all at half resolution
+	Framebuffer _raw;
+	Framebuffer _history[2];
+	Framebuffer _blurred[2];
+	//Whichever of the above the last Build finished in
+	Framebuffer* _result = nullptr;
+
+	int _current = 0;
+	bool _hasHistory = false;
+	glm::mat4 _previousViewProjection = glm::mat4(1.0f);
+	glm::vec2 _previousScale = glm::vec2(1.0f);
+	int _frame = 0;
+};
@@ -0,0 +1,187 @@
+#include "BloomEffect.h"
+
+#include <cmath>
+#include <algorithm>
+
+void BloomEffect::Init(unsigned width, unsigned height)
+{
+	int index = int(m_buffers.size());
+	m_buffers.push_back(new Framebuffer());
+	m_buffers[index]->AddColorTarget(GL_RGBA8);
+	m_buffers[index]->Init(width, height);
+
+	m_shaders.push_back(ShaderManager::Load("shaders/passthrough_vert.glsl", "shaders/Post/bloom_downsample_frag.glsl"));
+	m_shaders.push_back(ShaderManager::Load("shaders/passthrough_vert.glsl", "shaders/Post/bloom_upsample_frag.glsl"));
+	m_shaders.push_back(ShaderManager::Load("shaders/passthrough_vert.glsl", "shaders/Post/gaussian_blur_frag.glsl"));
+	m_shaders.push_back(ShaderManager::Load("shaders/passthrough_vert.glsl", "shaders/Post/bloom_composite_frag.glsl"));
+}
+
+void BloomEffect::Apply(Framebuffer* source, Framebuffer* target)
+{
+	Build(source);
+
+	BindShader(3);
+	SetupComposite(m_shaders[3], BLOOM_SLOT);
+	m_shaders[3]->SetUniform("u_SourceScale", source->GetRenderScale());
+
+	source->BindColorAsTexture(0, 0);
+
+	target->RenderToFSQ();
+
+	UnbindTexture(BLOOM_SLOT);
+	source->UnbindTexture(0);
+
+	UnbindShader();
+	Release();
+}
+
+const char* BloomEffect::GetComputeFunction() const
+{
+	return "AddBloom";
+}
+
+void BloomEffect::SetupCompute(const Shader::sptr& shader)
+{
+	//The chain's source isn't handed to us here, so in a compute chain it has to be built beforehand
+	SetupComposite(shader, BLOOM_SLOT);
+}
+
+bool BloomEffect::CanUpscale() const
+{
+	return true;
+}
+
+void BloomEffect::Build(Framebuffer* source)
+{
+	Release();
+	if (Method == GAUSSIAN)
+		BuildGaussian(source);
+	else
+		BuildDualFilter(source);
+}
+
+void BloomEffect::SetupComposite(const Shader::sptr& shader, int textureSlot) const
+{
+	shader->SetUniform("u_BloomIntensity", _result != nullptr ? _compositeIntensity : 0.0f);
+	if (_result != nullptr)
+		_result->BindColorAsTexture(0, textureSlot);
+}
+
+float BloomEffect::GetRadius(unsigned sourceHeight) const
+{
+	//The widest level's kernel reaches about one and a half of its texels, everything narrower sits inside that
+	unsigned baseWidth, baseHeight;
+	GetBaseSize(sourceHeight, sourceHeight, baseWidth, baseHeight);
+	float texel = float(sourceHeight) / baseHeight * float(1 << (std::clamp(Levels, 1, MAX_LEVELS) - 1));
+	return 1.5f * texel;
+}
+
+void BloomEffect::GetBaseSize(unsigned width, unsigned height, unsigned& baseWidth, unsigned& baseHeight) const
+{
+	baseWidth = std::max(width / 2, 1u);
+	baseHeight = std::max(height / 2, 1u);
+	if (baseHeight > MAX_BASE_HEIGHT)
+	{
+		baseWidth = std::max(unsigned(float(baseWidth) * MAX_BASE_HEIGHT / baseHeight), 1u);
+		baseHeight = MAX_BASE_HEIGHT;
+	}
+}
+
+void BloomEffect::BuildDualFilter(Framebuffer* source)
+{
+	unsigned width, height;
+	GetBaseSize(source->GetRenderWidth(), source->GetRenderHeight(), width, height);
+
+	//Only HDR needs the range, but R11G11B10F is half the bandwidth of RGBA16F and blends just as well
+	for (int i = 0; i < std::clamp(Levels, 1, MAX_LEVELS) && width >= 2 && height >= 2; i++)
+	{
+		_targets.push_back(RenderTargetPool::Get(width, height, GL_R11F_G11F_B10F));
+		width /= 2;
+		height /= 2;
+	}
+	if (_targets.empty())
+		return;
+
+	//Down the chain, the first step keeps only what's over the threshold
+	BindShader(0);
+	const Shader::sptr& down = m_shaders[0];
+	down->SetUniform("u_Threshold", Threshold);
+	down->SetUniform("u_Knee", Knee);
+	Framebuffer* input = source;
+	for (size_t i = 0; i < _targets.size(); i++)
+	{
+		down->SetUniform("u_Prefilter", int(i == 0));
+		down->SetUniform("u_SourceScale", i == 0 ? source->GetRenderScale() : glm::vec2(1.0f));
+		down->SetUniform("u_TexelSize", glm::vec2(1.0f / input->_width, 1.0f / input->_height));
+		input->BindColorAsTexture(0, 0);
+		_targets[i]->RenderToFSQ();
+		input = _targets[i];
+	}
+
+	//Back up it, adding each level onto the one above
+	BindShader(1);
+	const Shader::sptr& up = m_shaders[1];
+	GLStateCache::Enable(GL_BLEND);
+	GLStateCache::BlendFunc(GL_ONE, GL_ONE);
+	for (size_t i = _targets.size() - 1; i > 0; i--)
+	{
+		up->SetUniform("u_TexelSize", glm::vec2(1.0f / _targets[i]->_width, 1.0f / _targets[i]->_height));
+		_targets[i]->BindColorAsTexture(0, 0);
+		_targets[i - 1]->RenderToFSQ();
+	}
+	GLStateCache::BlendFunc(GL_ONE, GL_ZERO);
+	GLStateCache::Disable(GL_BLEND);
+
+	UnbindTexture(0);
+	UnbindShader();
+
+	//Every level ends up summed into the first, so share the intensity out between them
+	_result = _targets[0];
+	_compositeIntensity = Intensity / float(_targets.size());
+}
+
+void BloomEffect::BuildGaussian(Framebuffer* source)
+{
+	unsigned width = source->GetRenderWidth();
+	unsigned height = source->GetRenderHeight();
+	_targets.push_back(RenderTargetPool::Get(width, height, GL_R11F_G11F_B10F));
+	_targets.push_back(RenderTargetPool::Get(width, height, GL_R11F_G11F_B10F));
+
+	//The same threshold as the first step of the chain, only without shrinking
+	BindShader(0);
+	const Shader::sptr& down = m_shaders[0];
+	down->SetUniform("u_Threshold", Threshold);
+	down->SetUniform("u_Knee", Knee);
+	down->SetUniform("u_Prefilter", 1);
+	down->SetUniform("u_SourceScale", source->GetRenderScale());
+	down->SetUniform("u_TexelSize", glm::vec2(1.0f / source->_width, 1.0f / source->_height));
+	source->BindColorAsTexture(0, 0);
+	_targets[0]->RenderToFSQ();
+
+	//Three sigmas covers the radius, across into the second target and down back into the first
+	float radius = GetRadius(height);
+	BindShader(2);
+	const Shader::sptr& blur = m_shaders[2];
+	blur->SetUniform("u_Sigma", radius / 3.0f);
+	blur->SetUniform("u_Radius", int(std::ceil(radius)));
+	blur->SetUniform("u_Direction", glm::vec2(1.0f / width, 0.0f));
+	_targets[0]->BindColorAsTexture(0, 0);
+	_targets[1]->RenderToFSQ();
+	blur->SetUniform("u_Direction", glm::vec2(0.0f, 1.0f / height));
+	_targets[1]->BindColorAsTexture(0, 0);
+	_targets[0]->RenderToFSQ();
+
+	UnbindTexture(0);
+	UnbindShader();
+
+	_result = _targets[0];
+	_compositeIntensity = Intensity;
+}
+
+void BloomEffect::Release()
+{
+	for (Framebuffer* target : _targets)
+		RenderTargetPool::Release(target);
+	_targets.clear();
+	_result = nullptr;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <vector>
+
+#include "Graphics/Post/PostEffect.h"
+#include "Graphics/RenderTargetPool.h"
+
+//Glow around the bright parts of the frame, for about the same cost at any resolution
+//*The bright parts are downsampled through a chain of smaller and smaller pooled targets with the dual filter
+//*(Kawase) kernel, then upsampled back up the chain, each level added onto the one above
+//*The chain starts at half resolution, but no taller than MAX_BASE_HEIGHT, so bigger screens only cost more in the composite
+//*Hand it to ColorCorrectionEffect::SetBloom and it's added in as the frame is graded, with no pass of its own
+//*(Build it before the chain runs and Release it after, and don't put it in the chain as well)
+//*In a chain by itself it builds and composites in Apply (in a compute chain it needs building beforehand)
+//*GAUSSIAN blurs at full resolution with a separable Gaussian of the same radius instead, to compare against
+class BloomEffect : public PostEffect
+{
+public:
+	enum Filter
+	{
+		DUAL_FILTER = 0,
+		GAUSSIAN
+	};
+
+	static const unsigned MAX_BASE_HEIGHT = 540;
+	static const int MAX_LEVELS = 8;
+
+	void Init(unsigned width, unsigned height) override;
+
+	void Apply(Framebuffer* source, Framebuffer* target) override;
+
+	const char* GetComputeFunction() const override;
+	void SetupCompute(const Shader::sptr& shader) override;
+	bool CanUpscale() const override;
+
+	//Blurs the bright parts of source into pooled targets, used by whatever composites it until Release
+	void Build(Framebuffer* source);
+	//Gives the targets back to the pool
+	void Release();
+	//Binds what was built, and sets how strongly it's added on (zero if nothing was built)
+	void SetupComposite(const Shader::sptr& shader, int textureSlot) const;
+
+	//How far the glow spreads (pixels of a source this tall), the Gaussian is sized to match
+	float GetRadius(unsigned sourceHeight) const;
+
+	Filter Method = DUAL_FILTER;
+	//Steps down the chain, more spreads the glow wider
+	int Levels = 6;
+	//Brightness the glow starts at, and how far below that it fades in
+	float Threshold = 0.8f;
+	float Knee = 0.5f;
+	float Intensity = 0.5f;
+
+	//Texture slot the composite reads the bloom from (matches post_effects.glsl)
+	static const int BLOOM_SLOT = 28;
+
+private:
+	//Size of the first level of the chain for a source this size
+	void GetBaseSize(unsigned width, unsigned height, unsigned& baseWidth, unsigned& baseHeight) const;
+	void BuildDualFilter(Framebuffer* source);
+	void BuildGaussian(Framebuffer* source);
+
+	std::vector<Framebuffer*> _targets;
+	Framebuffer* _result = nullptr;
+	//How strongly the result is added on
+	float _compositeIntensity = 0.0f;
+};
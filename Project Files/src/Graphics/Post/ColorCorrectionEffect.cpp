@@ -0,0 +1,78 @@
+#include "ColorCorrectionEffect.h"
+
+void ColorCorrectionEffect::Init(unsigned width, unsigned height)
+{
+	int index = int(m_buffers.size());
+	m_buffers.push_back(new Framebuffer());
+	m_buffers[index]->AddColorTarget(GL_RGBA8);
+	m_buffers[index]->Init(width, height);
+
+	//Set up shaders
+	m_shaders.push_back(ShaderManager::Load("shaders/passthrough_vert.glsl", "shaders/Post/color_correction_frag.glsl"));
+}
+
+void ColorCorrectionEffect::Apply(Framebuffer* source, Framebuffer* target)
+{
+	BindShader(0);
+	SetUniforms(m_shaders[0]);
+	m_shaders[0]->SetUniform("u_SourceScale", source->GetRenderScale());
+
+	source->BindColorAsTexture(0, 0);
+	_lut->bind(30);
+
+	target->RenderToFSQ();
+
+	_lut->unbind(30);
+	GLStateCache::BindTexture(BloomEffect::BLOOM_SLOT, GL_TEXTURE_2D, GL_NONE);
+	GLStateCache::BindTexture(AUTO_EXPOSURE_SLOT, GL_TEXTURE_2D, GL_NONE);
+	source->UnbindTexture(0);
+
+	UnbindShader();
+}
+
+const char* ColorCorrectionEffect::GetComputeFunction() const
+{
+	return "ColorGrade";
+}
+
+void ColorCorrectionEffect::SetupCompute(const Shader::sptr& shader)
+{
+	SetUniforms(shader);
+	_lut->bind(30);
+}
+
+bool ColorCorrectionEffect::CanUpscale() const
+{
+	return true;
+}
+
+void ColorCorrectionEffect::SetLUT(LUT3D* lut)
+{
+	_lut = lut;
+}
+
+void ColorCorrectionEffect::SetAutoExposure(AutoExposure* exposure)
+{
+	_autoExposure = exposure;
+}
+
+void ColorCorrectionEffect::SetBloom(BloomEffect* bloom)
+{
+	_bloom = bloom;
+}
+
+void ColorCorrectionEffect::SetUniforms(const Shader::sptr& shader)
+{
+	shader->SetUniform("u_Tonemap", int(Tonemap));
+	shader->SetUniform("u_Exposure", Exposure);
+
+	bool autoExposure = _autoExposure != nullptr && _autoExposure->Enabled;
+	shader->SetUniform("u_AutoExposure", int(autoExposure));
+	if (autoExposure)
+		_autoExposure->BindExposure(AUTO_EXPOSURE_SLOT);
+
+	if (_bloom != nullptr && _bloom->Enabled)
+		_bloom->SetupComposite(shader, BloomEffect::BLOOM_SLOT);
+	else
+		shader->SetUniform("u_BloomIntensity", 0.0f);
+}
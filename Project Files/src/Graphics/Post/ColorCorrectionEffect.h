@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Graphics/Post/PostEffect.h"
+#include "Graphics/LUT.h"
+#include "Graphics/AutoExposure.h"
+#include "Graphics/Post/BloomEffect.h"
+
+//Grades the frame through a 3D LUT, tonemapping it first so HDR scenes don't need a pass of their own
+//*Bloom is added on before tonemapping when there is one, also without a pass of its own
+class ColorCorrectionEffect : public PostEffect
+{
+public:
+	//How HDR colors are brought down to 0-1 (matches u_Tonemap in post_effects.glsl)
+	enum Tonemapper
+	{
+		NONE = 0,
+		REINHARD,
+		ACES
+	};
+
+	void Init(unsigned width, unsigned height) override;
+
+	void Apply(Framebuffer* source, Framebuffer* target) override;
+
+	const char* GetComputeFunction() const override;
+	void SetupCompute(const Shader::sptr& shader) override;
+	//Dynamic resolution scenes are stretched back to full size as they're graded
+	bool CanUpscale() const override;
+
+	//The LUT is read every time the effect runs, so it can be swapped by changing what lut points at
+	void SetLUT(LUT3D* lut);
+	//Exposure comes from this while it's enabled, Exposure is multiplied in as compensation (null to set it by hand)
+	void SetAutoExposure(AutoExposure* exposure);
+	//Whatever this last built is added on while it's enabled (null for no bloom)
+	void SetBloom(BloomEffect* bloom);
+
+	Tonemapper Tonemap = NONE;
+	//Scene colors are multiplied by this before tonemapping
+	float Exposure = 1.0f;
+
+	//Texture slot the auto exposure is read from (matches post_effects.glsl)
+	static const int AUTO_EXPOSURE_SLOT = 29;
+
+private:
+	void SetUniforms(const Shader::sptr& shader);
+
+	LUT3D* _lut = nullptr;
+	AutoExposure* _autoExposure = nullptr;
+	BloomEffect* _bloom = nullptr;
+};
@@ -5,31 +5,35 @@ void GreyscaleEffect::Init(unsigned width, unsigned height)
 	int index = int(m_buffers.size());
 	m_buffers.push_back(new Framebuffer());
 	m_buffers[index]->AddColorTarget(GL_RGBA8);
-	m_buffers[index]->AddDepthTarget();
 	m_buffers[index]->Init(width, height);
 
-	index = int(m_shaders.size());
-	m_shaders.push_back(Shader::Create());
-	m_shaders[index]->LoadShaderPartFromFile("shaders/passthrough_vert.glsl", GL_VERTEX_SHADER);
-	m_shaders[index]->LoadShaderPartFromFile("shaders/Post/greyscale_frag.glsl", GL_FRAGMENT_SHADER);
-	m_shaders[index]->Link();
+	m_shaders.push_back(ShaderManager::Load("shaders/passthrough_vert.glsl", "shaders/Post/greyscale_frag.glsl"));
 }
 
-void GreyscaleEffect::ApplyEffect(PostEffect* buffer)
+void GreyscaleEffect::Apply(Framebuffer* source, Framebuffer* target)
 {
 	BindShader(0);
+	m_shaders[0]->SetUniform("u_GreyscaleIntensity", _intensity);
 
-	m_shaders[0]->SetUniform("u_Intensity", _intensity);
+	source->BindColorAsTexture(0, 0);
 
-	buffer->BindColorAsTexture(0, 0, 0);
+	target->RenderToFSQ();
 
-	m_buffers[0]->RenderToFSQ();
-
-	buffer->UnbindTexture(0);
+	source->UnbindTexture(0);
 
 	UnbindShader();
 }
 
+const char* GreyscaleEffect::GetComputeFunction() const
+{
+	return "Greyscale";
+}
+
+void GreyscaleEffect::SetupCompute(const Shader::sptr& shader)
+{
+	shader->SetUniform("u_GreyscaleIntensity", _intensity);
+}
+
 float GreyscaleEffect::GetIntensity() const
 {
 	return _intensity;
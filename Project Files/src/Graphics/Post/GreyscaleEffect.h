@@ -7,7 +7,10 @@ class GreyscaleEffect : public PostEffect
 public:
 	void Init(unsigned width, unsigned height) override;
 
-	void ApplyEffect(PostEffect* buffer) override;
+	void Apply(Framebuffer* source, Framebuffer* target) override;
+
+	const char* GetComputeFunction() const override;
+	void SetupCompute(const Shader::sptr& shader) override;
 
 	float GetIntensity() const;
 
@@ -0,0 +1,222 @@
+#include "PostChain.h"
+
+#include <algorithm>
+#include <cstring>
+
+void PostChain::Add(PostEffect* effect)
+{
+	_effects.push_back(effect);
+}
+
+void PostChain::Apply(Framebuffer* source, Framebuffer* target)
+{
+	_fragmentPasses = 0;
+	_computeDispatches = 0;
+	_upsamples = 0;
+
+	_active.clear();
+	for (PostEffect* effect : _effects)
+	{
+		if (effect->Enabled)
+			_active.push_back(effect);
+	}
+
+	if (_active.empty())
+	{
+		source->BlitColorTo(*target, 0, GL_LINEAR);
+		return;
+	}
+
+	//Dynamic resolution only drew into part of the source, stretch it out first unless the first effect does that as it goes
+	Framebuffer* input = source;
+	Framebuffer* upscaled = nullptr;
+	glm::vec2 scale = source->GetRenderScale();
+	if ((scale.x < 1.0f || scale.y < 1.0f) && !CanUpscale(_active[0]))
+	{
+		upscaled = RenderTargetPool::Get(source->_width, source->_height, source->GetColorFormat(0));
+		source->BlitColorTo(*upscaled, 0, GL_LINEAR);
+		input = upscaled;
+	}
+
+	size_t i = 0;
+	while (i < _active.size())
+	{
+		//Gather every compute effect in a row that runs at the same resolution
+		unsigned divisor = std::max(_active[i]->ResolutionDivisor, 1u);
+		_run.clear();
+		while (i < _active.size() && _active[i]->UseCompute && _active[i]->GetComputeFunction() != nullptr &&
+			std::max(_active[i]->ResolutionDivisor, 1u) == divisor)
+			_run.push_back(_active[i++]);
+
+		//Otherwise it's a fragment effect on its own
+		bool compute = !_run.empty();
+		if (!compute)
+			_run.push_back(_active[i++]);
+
+		Framebuffer* output = i == _active.size() ? target : _run.back()->GetBuffer();
+		if (divisor > 1)
+			RunScaled(_run, compute, divisor, input, output);
+		else
+			Run(_run, compute, input, output);
+		input = output;
+	}
+
+	if (upscaled != nullptr)
+		RenderTargetPool::Release(upscaled);
+}
+
+bool PostChain::CanUpscale(PostEffect* effect)
+{
+	//Lower resolution effects shrink their source with a blit, which doesn't know about the render size
+	if (effect->ResolutionDivisor > 1)
+		return false;
+	return (effect->UseCompute && effect->GetComputeFunction() != nullptr) || effect->CanUpscale();
+}
+
+void PostChain::SetDepth(Framebuffer* depth, const glm::mat4& projection)
+{
+	_depth = depth;
+	_inverseProjection = glm::inverse(projection);
+}
+
+int PostChain::GetFragmentPasses() const
+{
+	return _fragmentPasses;
+}
+
+int PostChain::GetComputeDispatches() const
+{
+	return _computeDispatches;
+}
+
+int PostChain::GetUpsamples() const
+{
+	return _upsamples;
+}
+
+void PostChain::Run(const std::vector<PostEffect*>& effects, bool compute, Framebuffer* source, Framebuffer* target)
+{
+	if (compute)
+		ApplyCompute(effects, source, target);
+	else
+	{
+		effects[0]->Apply(source, target);
+		_fragmentPasses++;
+	}
+}
+
+void PostChain::RunScaled(const std::vector<PostEffect*>& effects, bool compute, unsigned divisor, Framebuffer* source, Framebuffer* target)
+{
+	if (_upsampleShader == nullptr)
+	{
+		_upsampleShader = ShaderManager::Load("shaders/passthrough_vert.glsl", "shaders/Post/bilateral_upsample_frag.glsl");
+		//Report any errors now rather than at the next Finish
+		ShaderManager::Finish();
+	}
+
+	//Both keep the formats of what they stand in for, so the effect sees (and the upsample adds back) the same range as at full size
+	unsigned width = std::max(target->_width / divisor, 1u);
+	unsigned height = std::max(target->_height / divisor, 1u);
+	Framebuffer* lowSource = RenderTargetPool::Get(width, height, source->GetColorFormat(0));
+	Framebuffer* lowResult = RenderTargetPool::Get(width, height, target->GetColorFormat(0));
+
+	source->BlitColorTo(*lowSource, 0, GL_LINEAR);
+	Run(effects, compute, lowSource, lowResult);
+
+	GLStateCache::UseProgram(_upsampleShader->GetHandle());
+	_upsampleShader->SetUniform("u_HasDepth", int(_depth != nullptr));
+	_upsampleShader->SetUniformMatrix("u_InverseProjection", _inverseProjection);
+	if (_depth != nullptr)
+		_upsampleShader->SetUniform("u_DepthScale", _depth->GetRenderScale());
+	source->BindColorAsTexture(0, 0);
+	lowSource->BindColorAsTexture(0, 1);
+	lowResult->BindColorAsTexture(0, 2);
+	if (_depth != nullptr)
+		_depth->BindDepthAsTexture(3);
+
+	target->RenderToFSQ();
+
+	for (int slot = 0; slot < 4; slot++)
+		GLStateCache::BindTexture(slot, GL_TEXTURE_2D, GL_NONE);
+	GLStateCache::UseProgram(GL_NONE);
+	_upsamples++;
+
+	RenderTargetPool::Release(lowSource);
+	RenderTargetPool::Release(lowResult);
+}
+
+void PostChain::ApplyCompute(const std::vector<PostEffect*>& effects, Framebuffer* source, Framebuffer* target)
+{
+	Shader::sptr shader = GetComputeShader(effects, target->GetColorFormat(0));
+	if (shader == nullptr)
+		return;
+
+	GLStateCache::UseProgram(shader->GetHandle());
+	for (PostEffect* effect : effects)
+		effect->SetupCompute(shader);
+	shader->SetUniform("u_SourceScale", source->GetRenderScale());
+
+	source->BindColorAsTexture(0, 0);
+	target->BindColorAsImage(0, 0, GL_WRITE_ONLY);
+	glDispatchCompute((target->_width + 15) / 16, (target->_height + 15) / 16, 1);
+	source->UnbindTexture(0);
+
+	//Whatever comes next might sample it, blit it or read it back
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+	GLStateCache::UseProgram(GL_NONE);
+	_computeDispatches++;
+}
+
+Shader::sptr PostChain::GetComputeShader(const std::vector<PostEffect*>& effects, GLenum format)
+{
+	const char* imageFormat = GetImageFormat(format);
+	if (imageFormat == nullptr)
+	{
+		printf("The post chain can't write to this target's format\n");
+		return nullptr;
+	}
+
+	std::string key = std::string(imageFormat) + ": ";
+	for (PostEffect* effect : effects)
+		key += std::string(effect->GetComputeFunction()) + " ";
+
+	auto existing = _computeShaders.find(key);
+	if (existing != _computeShaders.end())
+		return existing->second;
+
+	if (_computeSource.empty() && !ShaderManager::ReadSource("shaders/Post/post_chain_comp.glsl", _computeSource))
+		return nullptr;
+
+	//Swap the marker for a call to each effect's function, in order
+	std::string calls;
+	for (PostEffect* effect : effects)
+		calls += "\tcolor = " + std::string(effect->GetComputeFunction()) + "(color);\n";
+	std::string source = _computeSource;
+	size_t marker = source.find("// EFFECTS");
+	if (marker == std::string::npos)
+	{
+		printf("post_chain_comp.glsl is missing its EFFECTS line\n");
+		return nullptr;
+	}
+	source.replace(marker, source.find('\n', marker) - marker, calls);
+	size_t formatMarker = source.find("TARGET_FORMAT");
+	if (formatMarker != std::string::npos)
+		source.replace(formatMarker, strlen("TARGET_FORMAT"), imageFormat);
+
+	Shader::sptr shader = ShaderManager::LoadComputeFromSource("post chain (" + key + ")", source);
+	//Report any errors now rather than at the next Finish
+	ShaderManager::Finish();
+	_computeShaders[key] = shader;
+	return shader;
+}
+
+const char* PostChain::GetImageFormat(GLenum format)
+{
+	switch (format)
+	{
+	case GL_RGBA8: return "rgba8";
+	case GL_RGBA16F: return "rgba16f";
+	case GL_R11F_G11F_B10F: return "r11f_g11f_b10f";
+	default: return nullptr;
+	}
+}
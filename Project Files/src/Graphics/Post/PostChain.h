@@ -0,0 +1,64 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <GLM/glm.hpp>
+
+#include "Graphics/Post/PostEffect.h"
+#include "Graphics/RenderTargetPool.h"
+
+//Runs post effects one after another, each as a fragment pass or in a compute dispatch
+//*Effects in a row with UseCompute on are folded into one compute shader, so the chain reads and writes
+//*the screen once instead of once per effect
+//*Compute workgroups are 16x16 tiles of pixels, effects pass each pixel's colour to the next so only pointwise effects
+//*(no neighbour reads) can be folded
+//*Effects with a ResolutionDivisor run on a shrunk copy of the frame in pooled targets, then what they changed is
+//*upsampled with the scene's depth keeping it from bleeding across edges (bilateral_upsample_frag.glsl)
+class PostChain
+{
+public:
+	//Effects run in the order they're added
+	void Add(PostEffect* effect);
+
+	//Runs every enabled effect from source into target (a copy if nothing is enabled)
+	//*Effects write into their own buffer, apart from the last one which writes straight into target
+	void Apply(Framebuffer* source, Framebuffer* target);
+
+	//The depth (and the projection it was drawn with) that lower resolution effects are upsampled against
+	//*Without it they're upsampled bilinearly
+	void SetDepth(Framebuffer* depth, const glm::mat4& projection);
+
+	//Statistics from the last Apply
+	int GetFragmentPasses() const;
+	int GetComputeDispatches() const;
+	int GetUpsamples() const;
+
+private:
+	//Can the effect read a partly drawn source as the first in the chain
+	static bool CanUpscale(PostEffect* effect);
+	//Runs a row of compute effects as one dispatch, or a single fragment effect
+	void Run(const std::vector<PostEffect*>& effects, bool compute, Framebuffer* source, Framebuffer* target);
+	//Runs them on a shrunk copy of source and upsamples the result into target
+	void RunScaled(const std::vector<PostEffect*>& effects, bool compute, unsigned divisor, Framebuffer* source, Framebuffer* target);
+	//Runs a row of compute effects as one dispatch
+	void ApplyCompute(const std::vector<PostEffect*>& effects, Framebuffer* source, Framebuffer* target);
+	//Builds (or finds) the compute shader that runs these effects in order, writing to a target of this format
+	Shader::sptr GetComputeShader(const std::vector<PostEffect*>& effects, GLenum format);
+	//The GLSL image format qualifier for a color target format, nullptr if the chain can't write it
+	static const char* GetImageFormat(GLenum format);
+
+	std::vector<PostEffect*> _effects;
+	std::vector<PostEffect*> _active;
+	std::vector<PostEffect*> _run;
+
+	std::string _computeSource;
+	std::unordered_map<std::string, Shader::sptr> _computeShaders;
+
+	Shader::sptr _upsampleShader;
+	Framebuffer* _depth = nullptr;
+	glm::mat4 _inverseProjection = glm::mat4(1.0f);
+
+	int _fragmentPasses = 0;
+	int _computeDispatches = 0;
+	int _upsamples = 0;
+};
@@ -5,40 +5,23 @@ void PostEffect::Init(unsigned width, unsigned height)
 	int index = int(m_buffers.size());
 	m_buffers.push_back(new Framebuffer());
 	m_buffers[index]->AddColorTarget(GL_RGBA8);
-	m_buffers[index]->AddDepthTarget();
 	m_buffers[index]->Init(width, height);
-
-	index = int(m_shaders.size());
-	m_shaders.push_back(Shader::Create());
-	m_shaders[index]->LoadShaderPartFromFile("shaders/passthrough_vert.glsl", GL_VERTEX_SHADER);
-	m_shaders[index]->LoadShaderPartFromFile("shaders/passthrough_frag.glsl", GL_FRAGMENT_SHADER);
-	m_shaders[index]->Link();
 }
 
 void PostEffect::ApplyEffect(PostEffect* previousBuffer)
 {
-	BindShader(0);
-
-	previousBuffer->BindColorAsTexture(0, 0, 0);
-
-	m_buffers[0]->RenderToFSQ();
-
-	previousBuffer->UnbindTexture(0);
+	Apply(previousBuffer->m_buffers[0], m_buffers[0]);
+}
 
-	UnbindShader();
+void PostEffect::Apply(Framebuffer* source, Framebuffer* target)
+{
+	//The basic effect only copies, a blit does that without shading anything
+	source->BlitColorTo(*target);
 }
 
 void PostEffect::DrawToScreen()
 {
-	BindShader(0);
-
-	BindColorAsTexture(0, 0, 0);
-
-	m_buffers[0]->DrawFullscreenQuad();
-
-	UnbindTexture(0);
-
-	UnbindShader();
+	m_buffers[0]->DrawToBackbuffer();
 }
 
 void PostEffect::Reshape(unsigned width, unsigned height)
@@ -74,7 +57,7 @@ void PostEffect::BindBuffer(int index)
 
 void PostEffect::UnbindBuffer()
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, GL_NONE);
+	GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, GL_NONE);
 }
 
 void PostEffect::BindColorAsTexture(int index, int colorBuffer, int textureSlot)
@@ -89,16 +72,34 @@ void PostEffect::BindDepthAsTexture(int index, int textureSlot)
 
 void PostEffect::UnbindTexture(int textureSlot)
 {
-	glActiveTexture(GL_TEXTURE0 + textureSlot);
-	glBindTexture(GL_TEXTURE_2D, GL_NONE);
+	GLStateCache::BindTexture(textureSlot, GL_TEXTURE_2D, GL_NONE);
 }
 
 void PostEffect::BindShader(int index)
 {
-	m_shaders[index]->Bind();
+	GLStateCache::UseProgram(m_shaders[index]->GetHandle());
 }
 
 void PostEffect::UnbindShader()
 {
-	glUseProgram(GL_NONE);
+	GLStateCache::UseProgram(GL_NONE);
+}
+
+Framebuffer* PostEffect::GetBuffer() const
+{
+	return m_buffers[0];
+}
+
+const char* PostEffect::GetComputeFunction() const
+{
+	return nullptr;
+}
+
+void PostEffect::SetupCompute(const Shader::sptr& shader)
+{
+}
+
+bool PostEffect::CanUpscale() const
+{
+	return false;
 }
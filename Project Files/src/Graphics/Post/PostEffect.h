@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Graphics/Framebuffer.h"
+#include "Graphics/ShaderManager.h"
 #include "Shader.h"
 
 class PostEffect
@@ -9,6 +10,8 @@ public:
 	virtual void Init(unsigned width, unsigned height);
 
 	virtual void ApplyEffect(PostEffect* previousBuffer);
+	//Runs the effect as a fragment pass from source into target
+	virtual void Apply(Framebuffer* source, Framebuffer* target);
 	virtual void DrawToScreen();
 
 	virtual void Reshape(unsigned width, unsigned height);
@@ -27,6 +30,27 @@ public:
 	void BindShader(int index);
 	void UnbindShader();
 
+	//The framebuffer the effect writes into when something comes after it
+	Framebuffer* GetBuffer() const;
+
+	//Compute backend (see PostChain)
+	//The function in res/shaders/Post/post_effects.glsl that does this effect to one pixel, nullptr if it can't run in a compute chain
+	virtual const char* GetComputeFunction() const;
+	//Sets the uniforms and textures the compute function reads
+	virtual void SetupCompute(const Shader::sptr& shader);
+
+	//Can Apply read a source that was only partly drawn into (Framebuffer::SetRenderSize) and stretch it over the target
+	//*PostChain stretches the source out with a blit first for effects that can't
+	virtual bool CanUpscale() const;
+
+	//PostChain skips the effect when it's off
+	bool Enabled = true;
+	//PostChain runs the effect in its compute dispatch instead of as a fragment pass (when it has a compute function)
+	bool UseCompute = false;
+	//PostChain runs the effect at 1/ResolutionDivisor of the size on each side (1, 2 or 4) and upsamples what it changed
+	//*Only worth it for effects that change things smoothly across the screen
+	unsigned ResolutionDivisor = 1;
+
 protected:
 	std::vector<Framebuffer*> m_buffers;
 
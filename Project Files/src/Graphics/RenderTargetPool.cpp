@@ -0,0 +1,87 @@
+#include "RenderTargetPool.h"
+
+std::vector<RenderTargetPool::Entry> RenderTargetPool::_entries;
+long long RenderTargetPool::_frame = 0;
+
+Framebuffer* RenderTargetPool::Get(unsigned width, unsigned height, GLenum format)
+{
+	for (Entry& entry : _entries)
+	{
+		if (!entry.inUse && entry.format == format && entry.target->_width == width && entry.target->_height == height)
+		{
+			entry.inUse = true;
+			entry.lastUsed = _frame;
+			return entry.target;
+		}
+	}
+
+	//Filtered so passes can sample between texels (texelFetch doesn't mind)
+	Framebuffer* target = new Framebuffer();
+	target->SetFilter(GL_LINEAR);
+	target->AddColorTarget(format);
+	target->Init(width, height);
+	_entries.push_back({ target, format, true, _frame });
+	return target;
+}
+
+void RenderTargetPool::Release(Framebuffer* target)
+{
+	for (Entry& entry : _entries)
+	{
+		if (entry.target == target)
+		{
+			entry.inUse = false;
+			return;
+		}
+	}
+	printf("Released a target that didn't come from the pool\n");
+}
+
+void RenderTargetPool::NewFrame()
+{
+	_frame++;
+
+	for (size_t i = 0; i < _entries.size();)
+	{
+		Entry& entry = _entries[i];
+		if (!entry.inUse && _frame - entry.lastUsed > MAX_UNUSED_FRAMES)
+		{
+			//Deleting it unloads its framebuffer and textures
+			delete entry.target;
+			_entries[i] = _entries.back();
+			_entries.pop_back();
+		}
+		else
+			i++;
+	}
+}
+
+void RenderTargetPool::Unload()
+{
+	for (Entry& entry : _entries)
+	{
+		delete entry.target;
+	}
+	_entries.clear();
+}
+
+int RenderTargetPool::GetTargetCount()
+{
+	return int(_entries.size());
+}
+
+int RenderTargetPool::GetTargetsInUse()
+{
+	int count = 0;
+	for (const Entry& entry : _entries)
+		count += entry.inUse ? 1 : 0;
+	return count;
+}
+
+size_t RenderTargetPool::GetMemory()
+{
+	size_t bytes = 0;
+	for (const Entry& entry : _entries)
+		bytes += size_t(entry.target->_width) * entry.target->_height * Framebuffer::GetBytesPerPixel(entry.format);
+	return bytes;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include <glad/glad.h>
+
+#include "Graphics/Framebuffer.h"
+
+//Hands out framebuffers to passes that only need them for a little while
+//*A released target goes back in the pool and is handed to the next pass asking for the same size and format
+//*Targets are kept between frames, so once things settle nothing is allocated
+//*Targets nobody has asked for in a while (say the window was resized) are deleted
+class RenderTargetPool abstract
+{
+public:
+	//Frames a target can sit unused before it's deleted
+	static const int MAX_UNUSED_FRAMES = 120;
+
+	//Gets a target with one color buffer of this size and format, give it back with Release once you're done
+	static Framebuffer* Get(unsigned width, unsigned height, GLenum format);
+	static void Release(Framebuffer* target);
+
+	//Deletes targets that haven't been used in a while, call once a frame
+	static void NewFrame();
+	//Deletes every target
+	static void Unload();
+
+	//Statistics
+	static int GetTargetCount();
+	//Targets handed out right now
+	static int GetTargetsInUse();
+	//Memory used by every target (bytes)
+	static size_t GetMemory();
+
+private:
+	struct Entry
+	{
+		Framebuffer* target;
+		GLenum format;
+		bool inUse;
+		long long lastUsed;
+	};
+
+	static std::vector<Entry> _entries;
+	static long long _frame;
+};
@@ -0,0 +1,499 @@
+#include "ShaderManager.h"
+
+#include <GLFW/glfw3.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstring>
+
+#include "Graphics/GLExtensions.h"
+#include "Utilities/Util.h"
+
+typedef void (APIENTRY* MaxShaderCompilerThreadsFunc)(GLuint count);
+
+//Lets the manager hand out programs it linked (or loaded) itself as regular shaders
+class ManagedShader : public Shader
+{
+public:
+	ManagedShader(GLuint program)
+	{
+		//Swap whatever program the base made for ours
+		glDeleteProgram(_handle);
+		_handle = program;
+	}
+};
+
+//What a cache file starts with
+struct BinaryHeader
+{
+	char magic[4];
+	unsigned version;
+	unsigned long long driverHash;
+	unsigned long long key;
+	GLenum format;
+	unsigned length;
+};
+static const unsigned BINARY_VERSION = 1;
+
+std::string ShaderManager::_cacheDirectory = "shader_cache";
+unsigned long long ShaderManager::_driverHash = 0;
+bool ShaderManager::_parallelCompile = false;
+bool ShaderManager::_binarySupported = false;
+bool ShaderManager::UseDiskCache = true;
+
+std::unordered_map<unsigned long long, GLuint> ShaderManager::_stages;
+std::unordered_map<unsigned long long, Shader::sptr> ShaderManager::_programs;
+std::vector<ShaderManager::Pending> ShaderManager::_pending;
+std::vector<std::pair<std::string, GLuint>> ShaderManager::_uniformBlocks;
+
+int ShaderManager::_cacheHits = 0;
+int ShaderManager::_stagesCompiled = 0;
+int ShaderManager::_stagesReused = 0;
+int ShaderManager::_programsReused = 0;
+double ShaderManager::_buildTime = 0.0;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+void ShaderManager::Init(const std::string& cacheDirectory)
+{
+	_cacheDirectory = cacheDirectory;
+
+	//Anything that changes the driver changes what binaries it accepts
+	std::string driver;
+	const char* strings[] = {
+		(const char*)glGetString(GL_VENDOR),
+		(const char*)glGetString(GL_RENDERER),
+		(const char*)glGetString(GL_VERSION)
+	};
+	for (const char* string : strings)
+	{
+		if (string != nullptr)
+			driver += std::string(string) + "\n";
+	}
+	_driverHash = Util::Hash(driver);
+
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	_binarySupported = formats > 0;
+
+	//Look for the parallel compile extension (the ARB one has the same enums)
+	_parallelCompile = false;
+	GLint extensions = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+	for (GLint i = 0; i < extensions; i++)
+	{
+		const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (name != nullptr && (strcmp(name, "GL_KHR_parallel_shader_compile") == 0 || strcmp(name, "GL_ARB_parallel_shader_compile") == 0))
+		{
+			_parallelCompile = true;
+			break;
+		}
+	}
+
+	if (_parallelCompile)
+	{
+		//Let the driver use as many threads as it likes
+		MaxShaderCompilerThreadsFunc maxThreads = (MaxShaderCompilerThreadsFunc)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+		if (maxThreads == nullptr)
+			maxThreads = (MaxShaderCompilerThreadsFunc)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+		if (maxThreads != nullptr)
+			maxThreads(0xFFFFFFFF);
+	}
+
+	if (_binarySupported)
+		std::filesystem::create_directories(_cacheDirectory);
+}
+
+void ShaderManager::Unload()
+{
+	Finish();
+
+	for (auto& stage : _stages)
+		glDeleteShader(stage.second);
+	_stages.clear();
+	_programs.clear();
+}
+
+Shader::sptr ShaderManager::Load(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines)
+{
+	std::string vertex, fragment;
+	if (!ReadSource(vertexPath, vertex) || !ReadSource(fragmentPath, fragment))
+		return nullptr;
+
+	return LoadFromSource(vertexPath + " + " + fragmentPath, vertex, fragment, defines);
+}
+
+bool ShaderManager::ReadSource(const std::string& path, std::string& source)
+{
+	return ReadSource(path, source, 0);
+}
+
+bool ShaderManager::ReadSource(const std::string& path, std::string& source, int depth)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		printf("Could not open %s\n", path.c_str());
+		return false;
+	}
+
+	std::string directory = std::filesystem::path(path).parent_path().string();
+	source.clear();
+	std::string line;
+	while (std::getline(file, line))
+	{
+		size_t start = line.find_first_not_of(" \t");
+		if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+		{
+			source += line;
+			source += '\n';
+			continue;
+		}
+
+		size_t open = line.find('"', start);
+		size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+		//Anything this deep is a file including itself
+		if (close == std::string::npos || depth >= 8)
+		{
+			printf("Bad #include in %s: %s\n", path.c_str(), line.c_str());
+			return false;
+		}
+
+		std::string name = line.substr(open + 1, close - open - 1);
+		std::string included;
+		if (!ReadSource(directory.empty() ? name : directory + "/" + name, included, depth + 1))
+			return false;
+		source += included;
+	}
+	return true;
+}
+
+Shader::sptr ShaderManager::LoadFromSource(const std::string& name, const std::string& vertexSource, const std::string& fragmentSource,
+	const std::vector<std::string>& defines)
+{
+	if (!defines.empty())
+		return LoadFromSource(name, AddDefines(vertexSource, defines), AddDefines(fragmentSource, defines));
+
+	Clock::time_point start = Clock::now();
+
+	//The program is only ever as unique as its source
+	unsigned long long key = Util::Hash(fragmentSource, Util::Hash(vertexSource));
+	Shader::sptr result;
+	GLuint program;
+	if (StartProgram(key, result, program))
+	{
+		_buildTime += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		return result;
+	}
+
+	//Start the link but don't wait on it, Finish checks how it went
+	GLuint vertex = GetStage(GL_VERTEX_SHADER, vertexSource);
+	GLuint fragment = GetStage(GL_FRAGMENT_SHADER, fragmentSource);
+	glAttachShader(program, vertex);
+	glAttachShader(program, fragment);
+	if (_binarySupported)
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(program);
+
+	_pending.push_back({ name, program, vertex, fragment, key });
+	_buildTime += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	return result;
+}
+
+Shader::sptr ShaderManager::LoadCompute(const std::string& computePath, const std::vector<std::string>& defines)
+{
+	std::string compute;
+	if (!ReadSource(computePath, compute))
+		return nullptr;
+
+	return LoadComputeFromSource(computePath, compute, defines);
+}
+
+Shader::sptr ShaderManager::LoadComputeFromSource(const std::string& name, const std::string& computeSource,
+	const std::vector<std::string>& defines)
+{
+	if (!defines.empty())
+		return LoadComputeFromSource(name, AddDefines(computeSource, defines));
+
+	Clock::time_point start = Clock::now();
+
+	//Seeded differently so a compute source can never land on the same key as a vertex + fragment pair
+	unsigned long long key = Util::Hash(computeSource, Util::Hash("compute"));
+	Shader::sptr result;
+	GLuint program;
+	if (StartProgram(key, result, program))
+	{
+		_buildTime += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		return result;
+	}
+
+	GLuint compute = GetStage(GL_COMPUTE_SHADER, computeSource);
+	glAttachShader(program, compute);
+	if (_binarySupported)
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(program);
+
+	_pending.push_back({ name, program, compute, 0, key });
+	_buildTime += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	return result;
+}
+
+bool ShaderManager::StartProgram(unsigned long long key, Shader::sptr& result, GLuint& program)
+{
+	auto existing = _programs.find(key);
+	if (existing != _programs.end())
+	{
+		_programsReused++;
+		result = existing->second;
+		return true;
+	}
+
+	program = glCreateProgram();
+	result = std::make_shared<ManagedShader>(program);
+	_programs[key] = result;
+
+	if (LoadBinary(program, key))
+	{
+		BindUniformBlocks(program);
+		_cacheHits++;
+		return true;
+	}
+	return false;
+}
+
+void ShaderManager::Finish()
+{
+	if (_pending.empty())
+		return;
+
+	Clock::time_point start = Clock::now();
+
+	//With the extension we can pick up programs in whatever order they finish, without it the first status query waits
+	std::vector<bool> done(_pending.size(), false);
+	int remaining = int(_pending.size());
+	while (remaining > 0)
+	{
+		for (int i = 0; i < _pending.size(); i++)
+		{
+			if (done[i])
+				continue;
+
+			Pending& pending = _pending[i];
+			if (_parallelCompile)
+			{
+				GLint complete = GL_FALSE;
+				glGetProgramiv(pending.program, GL_COMPLETION_STATUS_KHR, &complete);
+				if (complete == GL_FALSE)
+					continue;
+			}
+
+			done[i] = true;
+			remaining--;
+
+			GLint linked = GL_FALSE;
+			glGetProgramiv(pending.program, GL_LINK_STATUS, &linked);
+			if (linked == GL_FALSE)
+			{
+				//Point at the stage that broke if it was a compile error
+				GLuint stages[] = { pending.vertex, pending.fragment };
+				for (GLuint stage : stages)
+				{
+					if (stage == 0)
+						continue;
+					GLint compiled = GL_FALSE;
+					glGetShaderiv(stage, GL_COMPILE_STATUS, &compiled);
+					if (compiled == GL_FALSE)
+					{
+						GLint length = 0;
+						glGetShaderiv(stage, GL_INFO_LOG_LENGTH, &length);
+						std::vector<char> log(length + 1, '\0');
+						glGetShaderInfoLog(stage, length, nullptr, log.data());
+						printf("Failed to compile %s:\n%s\n", pending.name.c_str(), log.data());
+					}
+				}
+
+				GLint length = 0;
+				glGetProgramiv(pending.program, GL_INFO_LOG_LENGTH, &length);
+				std::vector<char> log(length + 1, '\0');
+				glGetProgramInfoLog(pending.program, length, nullptr, log.data());
+				printf("Failed to link %s:\n%s\n", pending.name.c_str(), log.data());
+			}
+			else
+			{
+				BindUniformBlocks(pending.program);
+				SaveBinary(pending.program, pending.key);
+			}
+
+			//The stages stay alive for other programs, they just don't need to hang off this one
+			glDetachShader(pending.program, pending.vertex);
+			if (pending.fragment != 0)
+				glDetachShader(pending.program, pending.fragment);
+		}
+	}
+
+	_pending.clear();
+	_buildTime += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void ShaderManager::RegisterUniformBlock(const std::string& name, GLuint binding)
+{
+	_uniformBlocks.push_back({ name, binding });
+
+	//Catch up the programs we already have (pending ones get it when they finish linking)
+	Finish();
+	for (auto& program : _programs)
+		BindUniformBlocks(program.second->GetHandle());
+}
+
+void ShaderManager::BindUniformBlocks(GLuint program)
+{
+	for (auto& block : _uniformBlocks)
+	{
+		GLuint index = glGetUniformBlockIndex(program, block.first.c_str());
+		if (index != GL_INVALID_INDEX)
+			glUniformBlockBinding(program, index, block.second);
+	}
+}
+
+std::string ShaderManager::AddDefines(const std::string& source, const std::vector<std::string>& defines)
+{
+	std::string lines;
+	for (const std::string& define : defines)
+	{
+		//Stages that never check for it don't need it, which keeps them shared with the other variants
+		if (source.find(define) != std::string::npos)
+			lines += "#define " + define + "\n";
+	}
+	if (lines.empty())
+		return source;
+
+	//#version has to stay first
+	size_t version = source.find("#version");
+	if (version == std::string::npos)
+		return lines + source;
+	size_t lineEnd = source.find('\n', version);
+	if (lineEnd == std::string::npos)
+		return source + "\n" + lines;
+	return source.substr(0, lineEnd + 1) + lines + source.substr(lineEnd + 1);
+}
+
+GLuint ShaderManager::GetStage(GLenum type, const std::string& source)
+{
+	unsigned long long key = Util::Hash(source, Util::Hash(std::to_string(type)));
+	auto existing = _stages.find(key);
+	if (existing != _stages.end())
+	{
+		_stagesReused++;
+		return existing->second;
+	}
+
+	//Compile but don't ask how it went yet
+	GLuint stage = glCreateShader(type);
+	const char* text = source.c_str();
+	glShaderSource(stage, 1, &text, nullptr);
+	glCompileShader(stage);
+
+	_stages[key] = stage;
+	_stagesCompiled++;
+	return stage;
+}
+
+bool ShaderManager::LoadBinary(GLuint program, unsigned long long key)
+{
+	if (!_binarySupported || !UseDiskCache)
+		return false;
+
+	std::ifstream file(GetCachePath(key), std::ios::binary);
+	if (!file)
+		return false;
+
+	BinaryHeader header;
+	if (!file.read((char*)&header, sizeof(header)) || memcmp(header.magic, "SHBN", 4) != 0 || header.version != BINARY_VERSION ||
+		header.driverHash != _driverHash || header.key != key)
+		return false;
+
+	std::vector<char> binary(header.length);
+	if (!file.read(binary.data(), header.length))
+		return false;
+
+	glProgramBinary(program, header.format, binary.data(), header.length);
+
+	//Drivers are allowed to turn down their own binaries (after an update for example), we'll just compile instead
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	return linked == GL_TRUE;
+}
+
+void ShaderManager::SaveBinary(GLuint program, unsigned long long key)
+{
+	if (!_binarySupported || !UseDiskCache)
+		return;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	BinaryHeader header;
+	memcpy(header.magic, "SHBN", 4);
+	header.version = BINARY_VERSION;
+	header.driverHash = _driverHash;
+	header.key = key;
+	glGetProgramBinary(program, length, nullptr, &header.format, binary.data());
+	header.length = unsigned(length);
+
+	std::ofstream file(GetCachePath(key), std::ios::binary);
+	if (!file)
+		return;
+	file.write((const char*)&header, sizeof(header));
+	file.write(binary.data(), length);
+}
+
+std::string ShaderManager::GetCachePath(unsigned long long key)
+{
+	char name[40];
+	snprintf(name, sizeof(name), "%016llx.bin", key ^ _driverHash);
+	return _cacheDirectory + "/" + name;
+}
+
+int ShaderManager::GetProgramCount()
+{
+	return int(_programs.size());
+}
+
+int ShaderManager::GetCacheHits()
+{
+	return _cacheHits;
+}
+
+int ShaderManager::GetStagesCompiled()
+{
+	return _stagesCompiled;
+}
+
+int ShaderManager::GetStagesReused()
+{
+	return _stagesReused;
+}
+
+int ShaderManager::GetProgramsReused()
+{
+	return _programsReused;
+}
+
+double ShaderManager::GetBuildTime()
+{
+	return _buildTime;
+}
+
+bool ShaderManager::IsParallelCompileSupported()
+{
+	return _parallelCompile;
+}
+
+bool ShaderManager::IsBinaryCacheSupported()
+{
+	return _binarySupported;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <glad/glad.h>
+#include <Shader.h>
+
+//Builds every shader program we use, without compiling anything more than once
+//*Stages with the same source are compiled once and shared between programs
+//*Compiles and links are all started before any status is asked for, so the driver can work on them in parallel
+//*(and on its own threads when GL_KHR_parallel_shader_compile is around)
+//*Linked programs are saved to disk with glGetProgramBinary, next launch they're loaded back without compiling
+class ShaderManager abstract
+{
+public:
+	//Call once the context is up
+	static void Init(const std::string& cacheDirectory = "shader_cache");
+	//Deletes the shared stages (programs live on in the shaders that were handed out)
+	static void Unload();
+
+	//Gets the program made from these two files
+	//*The shader can be used straight away, but check for errors and fill the disk cache with Finish
+	//*Each define is added as "#define NAME" to the stages that mention it
+	static Shader::sptr Load(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines = {});
+	//Same as Load but with the source already read in (name is only used for error messages)
+	static Shader::sptr LoadFromSource(const std::string& name, const std::string& vertexSource, const std::string& fragmentSource,
+		const std::vector<std::string>& defines = {});
+	//Gets a compute program, cached and shared the same way
+	static Shader::sptr LoadCompute(const std::string& computePath, const std::vector<std::string>& defines = {});
+	static Shader::sptr LoadComputeFromSource(const std::string& name, const std::string& computeSource, const std::vector<std::string>& defines = {});
+
+	//Reads a shader file, replacing #include "file" lines with that file (found next to the one including it)
+	//*Doesn't touch OpenGL so it can run on workers, returns false if a file couldn't be read
+	static bool ReadSource(const std::string& path, std::string& source);
+
+	//Every program with a uniform block of this name gets it pointed at this binding point
+	//*GLSL 410 can't say layout(binding = N) on a block, so we do it from here
+	static void RegisterUniformBlock(const std::string& name, GLuint binding);
+
+	//Waits for every program started since the last call, reports errors and saves the binaries
+	static void Finish();
+
+	//Statistics
+	static int GetProgramCount();
+	//Programs loaded from the disk cache
+	static int GetCacheHits();
+	//Stages compiled from source
+	static int GetStagesCompiled();
+	//Stages that were already compiled for another program
+	static int GetStagesReused();
+	//Programs handed out again instead of being built twice
+	static int GetProgramsReused();
+	//Time spent starting and finishing programs (ms)
+	static double GetBuildTime();
+	//Does the driver compile on its own threads
+	static bool IsParallelCompileSupported();
+	//Can we save programs to disk
+	static bool IsBinaryCacheSupported();
+
+	//Lets the disk cache be turned off to measure cold starts
+	static bool UseDiskCache;
+
+private:
+	//A program that's been started but not checked yet
+	struct Pending
+	{
+		std::string name;
+		GLuint program;
+		GLuint vertex;
+		//Zero for compute programs (vertex holds the compute stage)
+		GLuint fragment;
+		unsigned long long key;
+	};
+
+	static bool ReadSource(const std::string& path, std::string& source, int depth);
+	static GLuint GetStage(GLenum type, const std::string& source);
+	//Creates the program for a key, returns true if it came from the disk cache and needs no linking
+	static bool StartProgram(unsigned long long key, Shader::sptr& result, GLuint& program);
+	//Puts the defines after the #version line (only the ones the source actually uses)
+	static std::string AddDefines(const std::string& source, const std::vector<std::string>& defines);
+	//Points the program's uniform blocks at their registered binding points
+	static void BindUniformBlocks(GLuint program);
+	static bool LoadBinary(GLuint program, unsigned long long key);
+	static void SaveBinary(GLuint program, unsigned long long key);
+	static std::string GetCachePath(unsigned long long key);
+
+	static std::string _cacheDirectory;
+	//Identifies the driver, binaries from another driver (or version) won't load
+	static unsigned long long _driverHash;
+	static bool _parallelCompile;
+	static bool _binarySupported;
+
+	static std::unordered_map<unsigned long long, GLuint> _stages;
+	static std::unordered_map<unsigned long long, Shader::sptr> _programs;
+	static std::vector<Pending> _pending;
+	static std::vector<std::pair<std::string, GLuint>> _uniformBlocks;
+
+	static int _cacheHits;
+	static int _stagesCompiled;
+	static int _stagesReused;
+	static int _programsReused;
+	static double _buildTime;
+};
@@ -0,0 +1,100 @@
+#include "ShaderVariants.h"
+
+#include <sstream>
+#include <algorithm>
+
+#include "Graphics/ShaderManager.h"
+
+ShaderVariants::ShaderVariants(const std::string& vertexPath, const std::string& fragmentPath) :
+	_vertexPath(vertexPath), _fragmentPath(fragmentPath)
+{ }
+
+bool ShaderVariants::ReadSource()
+{
+	if (_sourceRead)
+		return true;
+
+	if (!ShaderManager::ReadSource(_vertexPath, _vertexSource) || !ShaderManager::ReadSource(_fragmentPath, _fragmentSource))
+		return false;
+
+	_sourceRead = true;
+	return true;
+}
+
+Shader::sptr ShaderVariants::Get(const std::string& key, bool wait)
+{
+	std::string normalized;
+	std::vector<std::string> defines = SplitKey(key, normalized);
+
+	auto it = _variants.find(normalized);
+	if (it != _variants.end())
+		return it->second;
+
+	if (!ReadSource())
+		return nullptr;
+
+	std::string name = _vertexPath + " + " + _fragmentPath;
+	if (!normalized.empty())
+		name += " [" + normalized + "]";
+
+	Shader::sptr result = ShaderManager::LoadFromSource(name, _vertexSource, _fragmentSource, defines);
+	if (wait)
+		ShaderManager::Finish();
+
+	_variants[normalized] = result;
+	return result;
+}
+
+void ShaderVariants::Apply(const ShaderMaterial::sptr& material, const std::string& key)
+{
+	material->Shader = Get(key);
+}
+
+bool ShaderVariants::FindKey(const Shader::sptr& shader, std::string& key) const
+{
+	for (auto& variant : _variants)
+	{
+		if (variant.second == shader)
+		{
+			key = variant.first;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ShaderVariants::Contains(const Shader::sptr& shader) const
+{
+	for (auto& variant : _variants)
+	{
+		if (variant.second == shader)
+			return true;
+	}
+	return false;
+}
+
+int ShaderVariants::GetVariantCount() const
+{
+	return int(_variants.size());
+}
+
+std::vector<std::string> ShaderVariants::SplitKey(const std::string& key, std::string& normalized)
+{
+	std::vector<std::string> names;
+	std::stringstream stream(key);
+	std::string name;
+	while (stream >> name)
+		names.push_back(name);
+
+	std::sort(names.begin(), names.end());
+	names.erase(std::unique(names.begin(), names.end()), names.end());
+
+	normalized.clear();
+	for (const std::string& feature : names)
+	{
+		if (!normalized.empty())
+			normalized += ' ';
+		normalized += feature;
+	}
+	return names;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <Shader.h>
+#include <ShaderMaterial.h>
+
+//One shader source built into a separate program for every set of features that gets used
+//*Features are #defines, so the stages test them with #ifdef instead of branching on a uniform every vertex
+//*A variant is only compiled the first time something asks for it (ShaderManager shares the unchanged stages)
+class ShaderVariants
+{
+public:
+	typedef std::shared_ptr<ShaderVariants> sptr;
+	static inline sptr Create(const std::string& vertexPath, const std::string& fragmentPath) {
+		return std::make_shared<ShaderVariants>(vertexPath, fragmentPath);
+	}
+
+	ShaderVariants(const std::string& vertexPath, const std::string& fragmentPath);
+
+	//Reads the source files, doesn't touch OpenGL so it can run on a worker
+	//*Get does this itself if it hasn't happened yet
+	bool ReadSource();
+
+	//Gets the program with these features turned on, the key is feature names split by spaces ("SIN_WAVE SKINNED")
+	//*The order of the names doesn't matter, an empty key is the plain shader
+	//*With wait off the program isn't checked until the next ShaderManager::Finish (lets startup compile in parallel)
+	Shader::sptr Get(const std::string& key = "", bool wait = true);
+	//Points the material at a variant
+	void Apply(const ShaderMaterial::sptr& material, const std::string& key = "");
+	//Finds the key of a variant we built, returns false if the shader didn't come from here
+	bool FindKey(const Shader::sptr& shader, std::string& key) const;
+	//Did the shader come from here
+	bool Contains(const Shader::sptr& shader) const;
+
+	//Number of variants built so far
+	int GetVariantCount() const;
+
+private:
+	//Sorts the names and removes duplicates so the same features always give the same key
+	static std::vector<std::string> SplitKey(const std::string& key, std::string& normalized);
+
+	std::string _vertexPath;
+	std::string _fragmentPath;
+	std::string _vertexSource;
+	std::string _fragmentSource;
+	bool _sourceRead = false;
+
+	std::unordered_map<std::string, Shader::sptr> _variants;
+};
@@ -0,0 +1,169 @@
+#include "ShadowAtlas.h"
+
+#include <GLM/gtc/matrix_transform.hpp>
+
+#include "Graphics/GLStateCache.h"
+#include "Graphics/ShaderManager.h"
+
+void ShadowAtlas::Init()
+{
+	CreateAtlas(_staticTexture, _staticFramebuffer);
+	CreateAtlas(_dynamicTexture, _dynamicFramebuffer);
+
+	glGenBuffers(1, &_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, _buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(Data), &_data, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, _buffer);
+
+	ShaderManager::RegisterUniformBlock("Shadows", BINDING);
+	_stale = true;
+}
+
+void ShadowAtlas::Unload()
+{
+	for (GLuint* texture : { &_staticTexture, &_dynamicTexture })
+	{
+		if (*texture)
+		{
+			GLStateCache::ForgetTexture(*texture);
+			glDeleteTextures(1, texture);
+			*texture = 0;
+		}
+	}
+	for (GLuint* framebuffer : { &_staticFramebuffer, &_dynamicFramebuffer })
+	{
+		if (*framebuffer)
+		{
+			GLStateCache::ForgetFramebuffer(*framebuffer);
+			glDeleteFramebuffers(1, framebuffer);
+			*framebuffer = 0;
+		}
+	}
+	if (_buffer)
+	{
+		glDeleteBuffers(1, &_buffer);
+		_buffer = 0;
+	}
+}
+
+void ShadowAtlas::Update(const glm::vec3& lightPos, unsigned staticVersion, const CasterDraw& draw)
+{
+	_staticRedrawn = false;
+	if (!Enabled)
+	{
+		//The lit shaders skip the lookup, only worth telling them once
+		if (_data.Params.x != 0.0f)
+		{
+			_data.Params.x = 0.0f;
+			glBindBuffer(GL_UNIFORM_BUFFER, _buffer);
+			glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Data), &_data);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		}
+		return;
+	}
+
+	if (lightPos != _lightPos || Range != _range || staticVersion != _staticVersion)
+	{
+		_lightPos = lightPos;
+		_range = Range;
+		_staticVersion = staticVersion;
+		_stale = true;
+	}
+
+	//Looking down each axis in the order the lookup picks faces (+x, -x, +y, -y, +z, -z)
+	static const glm::vec3 directions[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	static const glm::vec3 ups[6] = { { 0, -1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }, { 0, -1, 0 }, { 0, -1, 0 } };
+	glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, _range);
+	for (int i = 0; i < 6; i++)
+		_data.Matrices[i] = projection * glm::lookAt(_lightPos, _lightPos + directions[i], ups[i]);
+	_data.Params = glm::vec4(1.0f, DepthBias, NormalOffset, 0.5f / FACE_SIZE);
+
+	if (_stale || !CacheStatic)
+	{
+		DrawAtlas(_staticFramebuffer, false, draw);
+		_stale = false;
+		_staticRedraws++;
+		_staticRedrawn = true;
+	}
+	DrawAtlas(_dynamicFramebuffer, true, draw);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, _buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Data), &_data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void ShadowAtlas::Invalidate()
+{
+	_stale = true;
+}
+
+void ShadowAtlas::Bind() const
+{
+	GLStateCache::BindTexture(STATIC_SLOT, GL_TEXTURE_2D, _staticTexture);
+	GLStateCache::BindTexture(DYNAMIC_SLOT, GL_TEXTURE_2D, _dynamicTexture);
+}
+
+void ShadowAtlas::Unbind() const
+{
+	GLStateCache::BindTexture(STATIC_SLOT, GL_TEXTURE_2D, GL_NONE);
+	GLStateCache::BindTexture(DYNAMIC_SLOT, GL_TEXTURE_2D, GL_NONE);
+}
+
+int ShadowAtlas::GetStaticRedraws() const
+{
+	return _staticRedraws;
+}
+
+bool ShadowAtlas::WasStaticRedrawn() const
+{
+	return _staticRedrawn;
+}
+
+void ShadowAtlas::CreateAtlas(GLuint& texture, GLuint& framebuffer)
+{
+	//Compared in hardware, the linear filter gets us 2x2 PCF for free
+	glGenTextures(1, &texture);
+	GLStateCache::BindTexture(0, GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, FACE_SIZE * 3, FACE_SIZE * 2, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	GLStateCache::BindTexture(0, GL_TEXTURE_2D, GL_NONE);
+
+	glGenFramebuffers(1, &framebuffer);
+	GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		printf("Shadow atlas framebuffer is incomplete\n");
+	GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, GL_NONE);
+}
+
+void ShadowAtlas::DrawAtlas(GLuint framebuffer, bool dynamic, const CasterDraw& draw)
+{
+	GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	GLStateCache::Viewport(0, 0, FACE_SIZE * 3, FACE_SIZE * 2);
+	GLStateCache::DepthMask(true);
+	GLStateCache::ClearDepth(1.0f);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	GLStateCache::Enable(GL_DEPTH_TEST);
+	GLStateCache::DepthFunc(GL_LESS);
+	GLStateCache::Enable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(SlopeBias, 1.0f);
+	for (int i = 0; i < 6; i++)
+	{
+		GLStateCache::Viewport((i % 3) * FACE_SIZE, (i / 3) * FACE_SIZE, FACE_SIZE, FACE_SIZE);
+		draw(_data.Matrices[i], dynamic);
+	}
+	GLStateCache::Disable(GL_POLYGON_OFFSET_FILL);
+	//The rest of the frame counts on LEQUAL (the pre-pass shading and the sky both land on equal depths)
+	GLStateCache::DepthFunc(GL_LEQUAL);
+
+	GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, GL_NONE);
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <functional>
+#include <glad/glad.h>
+#include <GLM/glm.hpp>
+
+//Shadows from the scene light, a cube of depth faces laid out 3 across and 2 down in one texture
+//*There are two of them: static casters (the ground, the generated environment) go in one that's only redrawn
+//*when it goes stale (the light moved, or staticVersion changed), anything that moves goes in the other every frame
+//*Lookups test against both, a pixel is only lit if neither has something nearer the light
+//*The face matrices go to the Shadows uniform block in lighting.glsl
+class ShadowAtlas
+{
+public:
+	//Draws the static or the moving casters with this light view projection (depth only)
+	typedef std::function<void(const glm::mat4& viewProjection, bool dynamic)> CasterDraw;
+
+	//Matches the Shadows block in lighting.glsl (std140)
+	struct Data
+	{
+		glm::mat4 Matrices[6];
+		//Enabled, depth bias, normal offset, half a texel of a face
+		glm::vec4 Params = glm::vec4(0.0f);
+	};
+
+	//Size of each face in pixels
+	static const unsigned FACE_SIZE = 512;
+	//Uniform buffer binding point the block is attached to
+	static const GLuint BINDING = 1;
+	//Texture slots the lit shaders sample from (matches lighting.glsl)
+	static const int STATIC_SLOT = 25;
+	static const int DYNAMIC_SLOT = 26;
+
+	void Init();
+	void Unload();
+
+	//Redraws the static atlas if it's stale and the dynamic one every time, then uploads the face matrices
+	//*staticVersion should change whenever anything static does (see EnvironmentGenerator::GetGeneration)
+	void Update(const glm::vec3& lightPos, unsigned staticVersion, const CasterDraw& draw);
+	//Redraws the static atlas on the next Update
+	void Invalidate();
+
+	//Binds both atlases for the lit pass
+	void Bind() const;
+	void Unbind() const;
+
+	bool Enabled = false;
+	//Turn off to redraw the static casters every frame too, to see what the cache saves
+	bool CacheStatic = true;
+	//Far plane of the faces, nothing further from the light casts a shadow
+	float Range = 60.0f;
+	//Pulled towards the light before comparing, and along the normal before projecting
+	float DepthBias = 0.0005f;
+	float NormalOffset = 0.05f;
+	//Slope scaled polygon offset used while drawing the casters
+	float SlopeBias = 2.0f;
+
+	//Statistics
+	//Times the static atlas has been drawn
+	int GetStaticRedraws() const;
+	//Was it redrawn in the last Update
+	bool WasStaticRedrawn() const;
+
+private:
+	void CreateAtlas(GLuint& texture, GLuint& framebuffer);
+	void DrawAtlas(GLuint framebuffer, bool dynamic, const CasterDraw& draw);
+
+	GLuint _staticTexture = 0;
+	GLuint _staticFramebuffer = 0;
+	GLuint _dynamicTexture = 0;
+	GLuint _dynamicFramebuffer = 0;
+	GLuint _buffer = 0;
+
+	Data _data;
+	//What the static atlas was drawn with
+	glm::vec3 _lightPos = glm::vec3(0.0f);
+	float _range = 0.0f;
+	unsigned _staticVersion = 0;
+	bool _stale = true;
+
+	int _staticRedraws = 0;
+	bool _staticRedrawn = false;
+};
@@ -0,0 +1,20 @@
+#include "SkyPass.h"
+
+#include "Graphics/Framebuffer.h"
+
+void SkyPass::Draw(const ShaderMaterial::sptr& material, const glm::mat4& view, const glm::mat4& projection)
+{
+	//Materials bind their own shader and textures behind the state cache's back
+	material->Apply();
+	GLStateCache::InvalidateProgram();
+	GLStateCache::InvalidateTextures();
+	GLStateCache::UseProgram(material->Shader->GetHandle());
+
+	//Same matrix the old sky sphere was drawn with, only the rotation of the view so the sky never gets closer
+	material->Shader->SetUniformMatrix("u_InverseSkyboxMatrix", glm::inverse(projection * glm::mat4(glm::mat3(view))));
+
+	//Everything in front has already written its depth, the sky doesn't need to
+	GLStateCache::DepthMask(false);
+	Framebuffer::DrawFullscreenQuad();
+	GLStateCache::DepthMask(true);
+}
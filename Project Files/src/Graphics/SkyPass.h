@@ -0,0 +1,13 @@
+#pragma once
+#include <GLM/glm.hpp>
+#include <ShaderMaterial.h>
+
+//Draws the sky as one full screen triangle on the far plane, after everything else
+//*The depth test throws away every pixel something was drawn over, so only the visible sky gets shaded
+//*The view direction is rebuilt from the screen position, there's no mesh or transform behind it
+class SkyPass abstract
+{
+public:
+	//Draws the sky into whatever is bound, material holds the shader, the cube map and its rotation
+	static void Draw(const ShaderMaterial::sptr& material, const glm::mat4& view, const glm::mat4& projection);
+};
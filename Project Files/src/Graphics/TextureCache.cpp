@@ -0,0 +1,381 @@
+#include "TextureCache.h"
+
+#include <Texture2DData.h>
+#include <filesystem>
+#include <fstream>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+
+#include "Graphics/GLStateCache.h"
+#include "Graphics/GLExtensions.h"
+#include "Utilities/Util.h"
+
+namespace
+{
+	const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+	//VK_FORMAT_BC1_RGB_UNORM_BLOCK and VK_FORMAT_BC3_UNORM_BLOCK
+	const uint32_t VK_FORMAT_BC1 = 131;
+	const uint32_t VK_FORMAT_BC3 = 137;
+	//Data format descriptor color models (KHR_DF_MODEL_BC1A and KHR_DF_MODEL_BC3)
+	const uint32_t DF_MODEL_BC1A = 128;
+	const uint32_t DF_MODEL_BC3 = 130;
+	const char* STAMP_KEY = "SourceStamp";
+
+	struct Ktx2Header
+	{
+		uint8_t identifier[12];
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount;
+		uint32_t supercompressionScheme;
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		uint64_t sgdByteOffset;
+		uint64_t sgdByteLength;
+	};
+
+	struct Ktx2Level
+	{
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+	void Append32(std::vector<uint8_t>& data, uint32_t value)
+	{
+		for (int i = 0; i < 4; i++)
+			data.push_back(uint8_t(value >> (i * 8)));
+	}
+
+	void Pad(std::vector<uint8_t>& data, size_t alignment)
+	{
+		while (data.size() % alignment != 0)
+			data.push_back(0);
+	}
+}
+
+std::string TextureCache::_cacheDirectory;
+bool TextureCache::_supported = false;
+bool TextureCache::UseDiskCache = true;
+
+std::atomic<int> TextureCache::_cacheHits(0);
+std::atomic<int> TextureCache::_compressed(0);
+std::atomic<long long> TextureCache::_compressMicroseconds(0);
+size_t TextureCache::_memory = 0;
+size_t TextureCache::_uncompressedMemory = 0;
+
+void TextureCache::Init(const std::string& cacheDirectory)
+{
+	_cacheDirectory = cacheDirectory;
+
+	//S3TC has been in every desktop driver for years, but it's still an extension
+	_supported = false;
+	GLint extensions = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+	for (GLint i = 0; i < extensions; i++)
+	{
+		const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (name != nullptr && strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+		{
+			_supported = true;
+			break;
+		}
+	}
+
+	std::error_code error;
+	if (_supported)
+		std::filesystem::create_directories(_cacheDirectory, error);
+}
+
+bool TextureCache::IsSupported()
+{
+	return _supported;
+}
+
+bool TextureCache::Load(const std::string& path, TextureCompressor::Image& image)
+{
+	std::string stamp = GetSourceStamp(path);
+	std::string cachePath = GetCachePath(path);
+	if (UseDiskCache && !stamp.empty() && ReadKtx2(cachePath, stamp, image))
+	{
+		_cacheHits++;
+		return true;
+	}
+
+	unsigned width, height;
+	std::vector<uint8_t> pixels;
+	if (!ReadPixels(path, true, width, height, pixels))
+		return false;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	TextureCompressor::Compress(pixels.data(), width, height, image);
+	_compressed++;
+	_compressMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+	if (UseDiskCache && !stamp.empty() && !WriteKtx2(cachePath, stamp, image))
+		printf("Could not write %s to the texture cache\n", path.c_str());
+	return true;
+}
+
+bool TextureCache::ReadPixels(const std::string& path, bool flip, unsigned& width, unsigned& height, std::vector<uint8_t>& pixels)
+{
+	Texture2DData::sptr data = Texture2DData::LoadFromFile(path, flip);
+	if (data == nullptr)
+		return false;
+
+	width = unsigned(data->GetWidth());
+	height = unsigned(data->GetHeight());
+	unsigned channels;
+	switch (static_cast<GLenum>(data->GetFormat()))
+	{
+	case GL_RED: channels = 1; break;
+	case GL_RG: channels = 2; break;
+	case GL_RGB: channels = 3; break;
+	case GL_RGBA: channels = 4; break;
+	default:
+		printf("%s isn't in a format we can convert to RGBA8\n", path.c_str());
+		return false;
+	}
+	const uint8_t* source = static_cast<const uint8_t*>(data->GetDataPtr());
+	pixels.resize(size_t(width) * height * 4);
+	for (size_t i = 0; i < size_t(width) * height; i++)
+	{
+		const uint8_t* pixel = source + i * channels;
+		pixels[i * 4] = pixel[0];
+		pixels[i * 4 + 1] = channels >= 2 ? pixel[1] : pixel[0];
+		pixels[i * 4 + 2] = channels >= 3 ? pixel[2] : pixel[0];
+		pixels[i * 4 + 3] = channels == 4 ? pixel[3] : 255;
+	}
+	return true;
+}
+
+Texture2D::sptr TextureCache::Upload(const TextureCompressor::Image& image)
+{
+	GLenum format = image.Encoding == TextureCompressor::BC3 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+
+	//Swap whatever texture the base made for ours, immutable storage can't be given a new format
+	Texture2D::sptr texture = Texture2D::Create();
+	GLuint& handle = texture->GetHandle();
+	if (handle != 0)
+	{
+		GLStateCache::ForgetTexture(handle);
+		glDeleteTextures(1, &handle);
+	}
+	glGenTextures(1, &handle);
+
+	GLStateCache::BindTexture(0, GL_TEXTURE_2D, handle);
+	glTexStorage2D(GL_TEXTURE_2D, GLsizei(image.Levels.size()), format, image.Width, image.Height);
+	for (size_t level = 0; level < image.Levels.size(); level++)
+	{
+		unsigned width = TextureCompressor::GetLevelSize(image.Width, unsigned(level));
+		unsigned height = TextureCompressor::GetLevelSize(image.Height, unsigned(level));
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, GLint(level), 0, 0, width, height, format,
+			GLsizei(image.Levels[level].size()), image.Levels[level].data());
+		_memory += image.Levels[level].size();
+		_uncompressedMemory += size_t(width) * height * 4;
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	GLStateCache::BindTexture(0, GL_TEXTURE_2D, GL_NONE);
+
+	return texture;
+}
+
+int TextureCache::GetCacheHits()
+{
+	return _cacheHits;
+}
+
+int TextureCache::GetCompressed()
+{
+	return _compressed;
+}
+
+double TextureCache::GetCompressTime()
+{
+	return _compressMicroseconds / 1000.0;
+}
+
+size_t TextureCache::GetMemory()
+{
+	return _memory;
+}
+
+size_t TextureCache::GetUncompressedMemory()
+{
+	return _uncompressedMemory;
+}
+
+std::string TextureCache::GetSourceStamp(const std::string& path)
+{
+	std::error_code error;
+	uintmax_t size = std::filesystem::file_size(path, error);
+	if (error)
+		return "";
+	auto modified = std::filesystem::last_write_time(path, error);
+	if (error)
+		return "";
+	return std::to_string(size) + ":" + std::to_string((long long)modified.time_since_epoch().count());
+}
+
+std::string TextureCache::GetCachePath(const std::string& path)
+{
+	char name[40];
+	snprintf(name, sizeof(name), "%016llx.ktx2", Util::Hash(path));
+	return _cacheDirectory + "/" + name;
+}
+
+bool TextureCache::ReadKtx2(const std::string& file, const std::string& stamp, TextureCompressor::Image& image)
+{
+	std::ifstream stream(file, std::ios::binary);
+	if (!stream)
+		return false;
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+
+	Ktx2Header header;
+	if (data.size() < sizeof(header))
+		return false;
+	memcpy(&header, data.data(), sizeof(header));
+	if (memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0 || header.supercompressionScheme != 0 ||
+		(header.vkFormat != VK_FORMAT_BC1 && header.vkFormat != VK_FORMAT_BC3) || header.levelCount == 0 ||
+		header.levelCount != TextureCompressor::GetLevelCount(header.pixelWidth, header.pixelHeight))
+		return false;
+
+	//The level index follows the header, a truncated file might not even have all of that
+	size_t indexEnd = sizeof(header) + size_t(header.levelCount) * sizeof(Ktx2Level);
+	if (indexEnd > data.size())
+		return false;
+
+	//Stale if the stamp in the key/value data isn't the one the source has now
+	size_t kvdEnd = size_t(header.kvdByteOffset) + header.kvdByteLength;
+	if (header.kvdByteOffset < indexEnd || kvdEnd > data.size())
+		return false;
+	bool fresh = false;
+	for (size_t offset = header.kvdByteOffset; offset + 4 <= kvdEnd;)
+	{
+		uint32_t length;
+		memcpy(&length, data.data() + offset, 4);
+		if (length > kvdEnd - offset - 4)
+			return false;
+		std::string entry((const char*)data.data() + offset + 4, length);
+		size_t split = entry.find('\0');
+		if (split != std::string::npos && entry.substr(0, split) == STAMP_KEY)
+			fresh = entry.substr(split + 1) == stamp + '\0';
+		offset += 4 + ((length + 3) & ~3u);
+	}
+	if (!fresh)
+		return false;
+
+	image.Width = header.pixelWidth;
+	image.Height = header.pixelHeight;
+	image.Encoding = header.vkFormat == VK_FORMAT_BC3 ? TextureCompressor::BC3 : TextureCompressor::BC1;
+	image.Levels.resize(header.levelCount);
+	for (uint32_t level = 0; level < header.levelCount; level++)
+	{
+		Ktx2Level index;
+		memcpy(&index, data.data() + sizeof(header) + level * sizeof(index), sizeof(index));
+		size_t expected = TextureCompressor::GetCompressedSize(TextureCompressor::GetLevelSize(image.Width, level),
+			TextureCompressor::GetLevelSize(image.Height, level), image.Encoding);
+		//Checked without adding the two, a corrupt offset could wrap around
+		if (index.byteLength != expected || index.byteOffset > data.size() || index.byteLength > data.size() - index.byteOffset)
+			return false;
+		image.Levels[level].assign(data.begin() + size_t(index.byteOffset), data.begin() + size_t(index.byteOffset + index.byteLength));
+	}
+	return true;
+}
+
+bool TextureCache::WriteKtx2(const std::string& file, const std::string& stamp, const TextureCompressor::Image& image)
+{
+	bool bc3 = image.Encoding == TextureCompressor::BC3;
+	uint32_t levelCount = uint32_t(image.Levels.size());
+	size_t indexEnd = sizeof(Ktx2Header) + levelCount * sizeof(Ktx2Level);
+
+	//Data format descriptor, one basic block with a sample for each half of the block
+	std::vector<uint8_t> dfd;
+	uint32_t samples = bc3 ? 2 : 1;
+	Append32(dfd, 4 + 24 + 16 * samples);
+	Append32(dfd, 0);
+	Append32(dfd, 2 | ((24 + 16 * samples) << 16));
+	//Color model, BT.709 primaries, linear transfer (the textures were never sRGB to begin with)
+	Append32(dfd, (bc3 ? DF_MODEL_BC3 : DF_MODEL_BC1A) | (1 << 8) | (1 << 16));
+	//4x4 texel blocks
+	Append32(dfd, 3 | (3 << 8));
+	Append32(dfd, bc3 ? 16 : 8);
+	Append32(dfd, 0);
+	if (bc3)
+	{
+		//Alpha is the first 64 bits, color the second
+		Append32(dfd, 0 | (63 << 16) | (15u << 24));
+		Append32(dfd, 0);
+		Append32(dfd, 0);
+		Append32(dfd, 0xFFFFFFFF);
+		Append32(dfd, 64 | (63 << 16));
+	}
+	else
+		Append32(dfd, 0 | (63 << 16));
+	Append32(dfd, 0);
+	Append32(dfd, 0);
+	Append32(dfd, 0xFFFFFFFF);
+
+	//Key/value data, sorted by key
+	std::vector<uint8_t> kvd;
+	const std::pair<std::string, std::string> entries[] = { { "KTXwriter", "Texture cache" }, { STAMP_KEY, stamp } };
+	for (const std::pair<std::string, std::string>& entry : entries)
+	{
+		std::string pair = entry.first + '\0' + entry.second + '\0';
+		Append32(kvd, uint32_t(pair.size()));
+		kvd.insert(kvd.end(), pair.begin(), pair.end());
+		Pad(kvd, 4);
+	}
+
+	Ktx2Header header = {};
+	memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	header.vkFormat = bc3 ? VK_FORMAT_BC3 : VK_FORMAT_BC1;
+	header.typeSize = 1;
+	header.pixelWidth = image.Width;
+	header.pixelHeight = image.Height;
+	header.faceCount = 1;
+	header.levelCount = levelCount;
+	header.dfdByteOffset = uint32_t(indexEnd);
+	header.dfdByteLength = uint32_t(dfd.size());
+	header.kvdByteOffset = uint32_t(indexEnd + dfd.size());
+	header.kvdByteLength = uint32_t(kvd.size());
+
+	std::vector<uint8_t> out(indexEnd);
+	out.insert(out.end(), dfd.begin(), dfd.end());
+	out.insert(out.end(), kvd.begin(), kvd.end());
+
+	//Smallest mip first, each one lined up to a whole block
+	std::vector<Ktx2Level> levels(levelCount);
+	for (uint32_t level = levelCount; level-- > 0;)
+	{
+		Pad(out, 16);
+		levels[level].byteOffset = out.size();
+		levels[level].byteLength = image.Levels[level].size();
+		levels[level].uncompressedByteLength = image.Levels[level].size();
+		out.insert(out.end(), image.Levels[level].begin(), image.Levels[level].end());
+	}
+	memcpy(out.data(), &header, sizeof(header));
+	memcpy(out.data() + sizeof(header), levels.data(), levels.size() * sizeof(Ktx2Level));
+
+	//Written under another name and moved into place, so a worker reading it never sees half a file
+	std::string temporary = file + ".tmp";
+	{
+		std::ofstream stream(temporary, std::ios::binary);
+		if (!stream || !stream.write((const char*)out.data(), out.size()))
+			return false;
+	}
+	std::error_code error;
+	std::filesystem::rename(temporary, file, error);
+	return !error;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+#include <glad/glad.h>
+#include <Texture2D.h>
+
+#include "Graphics/TextureCompressor.h"
+
+//Loads textures as block compressed mip chains, kept in KTX2 files so each one is only compressed once
+//*The first load decodes the image, builds its mips and compresses them (TextureCompressor), then writes
+//*<cache>/<hash of the path>.ktx2, after that the file is read back and uploaded as it is
+//*A cached file is only used while the size and modification time of the image it was made from still match
+//*Load doesn't touch OpenGL so AssetLoader runs it on its workers (each texture compresses on its own thread),
+//*Upload runs on the main thread
+//*Without S3TC support textures load the old way (uncompressed, with mips made by the driver)
+class TextureCache abstract
+{
+public:
+	//Call once the context is up
+	static void Init(const std::string& cacheDirectory = "texture_cache");
+
+	//Can we upload compressed textures
+	static bool IsSupported();
+
+	//Reads path into image, from the cache when it can, returns false if the image couldn't be read
+	static bool Load(const std::string& path, TextureCompressor::Image& image);
+	//Makes a texture with every level of image
+	static Texture2D::sptr Upload(const TextureCompressor::Image& image);
+	//Decodes an image file into RGBA8 pixels, whatever channels it had (doesn't touch OpenGL either)
+	static bool ReadPixels(const std::string& path, bool flip, unsigned& width, unsigned& height, std::vector<uint8_t>& pixels);
+
+	//Lets the disk cache be turned off to measure cold starts (textures are still compressed)
+	static bool UseDiskCache;
+
+	//Statistics
+	//Textures read from the cache
+	static int GetCacheHits();
+	//Textures that had to be compressed
+	static int GetCompressed();
+	//Time spent building mips and compressing, added up over every worker (ms)
+	static double GetCompressTime();
+	//GPU memory the uploaded textures take, and what they'd take as RGBA8 with mips
+	static size_t GetMemory();
+	static size_t GetUncompressedMemory();
+
+private:
+	//What we know about the source image, a cached file made from anything else is stale
+	static std::string GetSourceStamp(const std::string& path);
+	static std::string GetCachePath(const std::string& path);
+	static bool ReadKtx2(const std::string& file, const std::string& stamp, TextureCompressor::Image& image);
+	static bool WriteKtx2(const std::string& file, const std::string& stamp, const TextureCompressor::Image& image);
+
+	static std::string _cacheDirectory;
+	static bool _supported;
+
+	static std::atomic<int> _cacheHits;
+	static std::atomic<int> _compressed;
+	static std::atomic<long long> _compressMicroseconds;
+	static size_t _memory;
+	static size_t _uncompressedMemory;
+};
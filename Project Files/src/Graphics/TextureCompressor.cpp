@@ -0,0 +1,298 @@
+#include "TextureCompressor.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define COMPRESSOR_SIMD 1
+#include <emmintrin.h>
+#else
+#define COMPRESSOR_SIMD 0
+#endif
+
+namespace
+{
+	uint16_t To565(int r, int g, int b)
+	{
+		return uint16_t(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+	}
+
+	//Back to 8 bits a channel the way the hardware does it
+	void From565(uint16_t color, int* rgb)
+	{
+		int r = (color >> 11) & 31;
+		int g = (color >> 5) & 63;
+		int b = color & 31;
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+#if COMPRESSOR_SIMD
+	//top and bottom hold four pixels each, gives the 2x2 sums of the two pixels they make (16 bits a channel)
+	__m128i SumQuads(__m128i top, __m128i bottom)
+	{
+		__m128i zero = _mm_setzero_si128();
+		__m128i low = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+		__m128i high = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+		low = _mm_add_epi16(low, _mm_srli_si128(low, 8));
+		high = _mm_add_epi16(high, _mm_srli_si128(high, 8));
+		return _mm_unpacklo_epi64(low, high);
+	}
+#endif
+}
+
+void TextureCompressor::Compress(const uint8_t* pixels, unsigned width, unsigned height, Image& result)
+{
+	result.Width = width;
+	result.Height = height;
+	result.Encoding = HasAlpha(pixels, size_t(width) * height) ? BC3 : BC1;
+	result.Levels.clear();
+
+	unsigned levels = GetLevelCount(width, height);
+	result.Levels.resize(levels);
+
+	//Two buffers to ping pong the mips between, the full size image is read straight from pixels
+	std::vector<uint8_t> current, next;
+	const uint8_t* source = pixels;
+	for (unsigned level = 0; level < levels; level++)
+	{
+		unsigned levelWidth = GetLevelSize(width, level);
+		unsigned levelHeight = GetLevelSize(height, level);
+		result.Levels[level].resize(GetCompressedSize(levelWidth, levelHeight, result.Encoding));
+		Encode(source, levelWidth, levelHeight, result.Encoding, result.Levels[level].data());
+
+		if (level + 1 < levels)
+		{
+			next.resize(size_t(GetLevelSize(width, level + 1)) * GetLevelSize(height, level + 1) * 4);
+			Downsample(source, levelWidth, levelHeight, next.data());
+			current.swap(next);
+			source = current.data();
+		}
+	}
+}
+
+void TextureCompressor::Downsample(const uint8_t* source, unsigned width, unsigned height, uint8_t* result)
+{
+	unsigned outWidth = std::max(width / 2, 1u);
+	unsigned outHeight = std::max(height / 2, 1u);
+	for (unsigned y = 0; y < outHeight; y++)
+	{
+		const uint8_t* top = source + size_t(std::min(y * 2, height - 1)) * width * 4;
+		const uint8_t* bottom = source + size_t(std::min(y * 2 + 1, height - 1)) * width * 4;
+		uint8_t* out = result + size_t(y) * outWidth * 4;
+		unsigned x = 0;
+
+#if COMPRESSOR_SIMD
+		//Four pixels out of the eight under them in each row (only while the pairs are whole)
+		if (width >= 2)
+		{
+			__m128i two = _mm_set1_epi16(2);
+			for (; x + 4 <= outWidth; x += 4)
+			{
+				const uint8_t* a = top + x * 8;
+				const uint8_t* b = bottom + x * 8;
+				__m128i first = SumQuads(_mm_loadu_si128((const __m128i*)a), _mm_loadu_si128((const __m128i*)b));
+				__m128i second = SumQuads(_mm_loadu_si128((const __m128i*)(a + 16)), _mm_loadu_si128((const __m128i*)(b + 16)));
+				first = _mm_srli_epi16(_mm_add_epi16(first, two), 2);
+				second = _mm_srli_epi16(_mm_add_epi16(second, two), 2);
+				_mm_storeu_si128((__m128i*)(out + x * 4), _mm_packus_epi16(first, second));
+			}
+		}
+#endif
+
+		for (; x < outWidth; x++)
+		{
+			unsigned left = std::min(x * 2, width - 1) * 4;
+			unsigned right = std::min(x * 2 + 1, width - 1) * 4;
+			for (int c = 0; c < 4; c++)
+				out[x * 4 + c] = uint8_t((top[left + c] + top[right + c] + bottom[left + c] + bottom[right + c] + 2) >> 2);
+		}
+	}
+}
+
+void TextureCompressor::Encode(const uint8_t* pixels, unsigned width, unsigned height, Format format, uint8_t* result)
+{
+	uint8_t block[64];
+	size_t blockBytes = format == BC3 ? 16 : 8;
+	for (unsigned by = 0; by < height; by += 4)
+	{
+		for (unsigned bx = 0; bx < width; bx += 4)
+		{
+			//Blocks hanging off the edge repeat the last row and column
+			for (unsigned y = 0; y < 4; y++)
+			{
+				const uint8_t* row = pixels + size_t(std::min(by + y, height - 1)) * width * 4;
+				for (unsigned x = 0; x < 4; x++)
+					memcpy(block + (y * 4 + x) * 4, row + std::min(bx + x, width - 1) * 4, 4);
+			}
+
+			if (format == BC3)
+			{
+				EncodeAlphaBlock(block, result);
+				EncodeColorBlock(block, result + 8);
+			}
+			else
+				EncodeColorBlock(block, result);
+			result += blockBytes;
+		}
+	}
+}
+
+size_t TextureCompressor::GetCompressedSize(unsigned width, unsigned height, Format format)
+{
+	return size_t((width + 3) / 4) * ((height + 3) / 4) * (format == BC3 ? 16 : 8);
+}
+
+unsigned TextureCompressor::GetLevelSize(unsigned size, unsigned level)
+{
+	return std::max(size >> level, 1u);
+}
+
+unsigned TextureCompressor::GetLevelCount(unsigned width, unsigned height)
+{
+	unsigned levels = 1;
+	for (unsigned size = std::max(width, height); size > 1; size /= 2)
+		levels++;
+	return levels;
+}
+
+bool TextureCompressor::HasAlpha(const uint8_t* pixels, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		if (pixels[i * 4 + 3] != 255)
+			return true;
+	}
+	return false;
+}
+
+bool TextureCompressor::IsSimdSupported()
+{
+	return COMPRESSOR_SIMD != 0;
+}
+
+void TextureCompressor::EncodeColorBlock(const uint8_t* block, uint8_t* result)
+{
+	int minColor[3] = { 255, 255, 255 };
+	int maxColor[3] = { 0, 0, 0 };
+	int mean[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			minColor[c] = std::min(minColor[c], int(block[i * 4 + c]));
+			maxColor[c] = std::max(maxColor[c], int(block[i * 4 + c]));
+			mean[c] += block[i * 4 + c];
+		}
+	}
+
+	//The bounding box diagonal only follows the colors if red and blue rise with green, flip them if they fall
+	int redGreen = 0, blueGreen = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		int r = block[i * 4] * 16 - mean[0];
+		int g = block[i * 4 + 1] * 16 - mean[1];
+		int b = block[i * 4 + 2] * 16 - mean[2];
+		redGreen += r * g;
+		blueGreen += b * g;
+	}
+	if (redGreen < 0)
+		std::swap(minColor[0], maxColor[0]);
+	if (blueGreen < 0)
+		std::swap(minColor[2], maxColor[2]);
+
+	//Pull the ends in by a sixteenth so the in between colors land closer to the pixels
+	for (int c = 0; c < 3; c++)
+	{
+		int inset = (maxColor[c] - minColor[c]) / 16;
+		maxColor[c] -= inset;
+		minColor[c] += inset;
+	}
+
+	uint16_t color0 = To565(maxColor[0], maxColor[1], maxColor[2]);
+	uint16_t color1 = To565(minColor[0], minColor[1], minColor[2]);
+	//color0 has to be the bigger one for the four color mode
+	if (color0 < color1)
+		std::swap(color0, color1);
+
+	uint32_t indices = 0;
+	if (color0 != color1)
+	{
+		int palette[4][3];
+		From565(color0, palette[0]);
+		From565(color1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (palette[0][c] * 2 + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + palette[1][c] * 2) / 3;
+		}
+
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0;
+			int bestDistance = INT32_MAX;
+			for (int p = 0; p < 4; p++)
+			{
+				int dr = block[i * 4] - palette[p][0];
+				int dg = block[i * 4 + 1] - palette[p][1];
+				int db = block[i * 4 + 2] - palette[p][2];
+				int distance = dr * dr + dg * dg + db * db;
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					best = p;
+				}
+			}
+			indices |= uint32_t(best) << (i * 2);
+		}
+	}
+
+	result[0] = uint8_t(color0);
+	result[1] = uint8_t(color0 >> 8);
+	result[2] = uint8_t(color1);
+	result[3] = uint8_t(color1 >> 8);
+	for (int i = 0; i < 4; i++)
+		result[4 + i] = uint8_t(indices >> (i * 8));
+}
+
+void TextureCompressor::EncodeAlphaBlock(const uint8_t* block, uint8_t* result)
+{
+	int alpha0 = 0, alpha1 = 255;
+	for (int i = 0; i < 16; i++)
+	{
+		alpha0 = std::max(alpha0, int(block[i * 4 + 3]));
+		alpha1 = std::min(alpha1, int(block[i * 4 + 3]));
+	}
+
+	//Eight alpha mode (alpha0 above alpha1): the two ends then six steps between them
+	uint64_t indices = 0;
+	if (alpha0 != alpha1)
+	{
+		int palette[8] = { alpha0, alpha1 };
+		for (int p = 2; p < 8; p++)
+			palette[p] = ((8 - p) * alpha0 + (p - 1) * alpha1) / 7;
+
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0;
+			int bestDistance = 256;
+			for (int p = 0; p < 8; p++)
+			{
+				int distance = std::abs(int(block[i * 4 + 3]) - palette[p]);
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					best = p;
+				}
+			}
+			indices |= uint64_t(best) << (i * 3);
+		}
+	}
+
+	result[0] = uint8_t(alpha0);
+	result[1] = uint8_t(alpha1);
+	for (int i = 0; i < 6; i++)
+		result[2 + i] = uint8_t(indices >> (i * 8));
+}
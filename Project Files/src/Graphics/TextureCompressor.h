@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+//Turns RGBA8 images into block compressed mip chains on the CPU, doesn't touch OpenGL so it can run on workers
+//*Mips are 2x2 box filtered (four pixels at a time with SSE2 when we have it), odd edges repeat their last row or column
+//*BC1 (DXT1) for opaque images at 4 bits a pixel, BC3 (DXT5) at 8 bits a pixel when there's alpha
+//*Each block's colors are fit to the diagonal of their bounding box (turned to follow how the channels move together,
+//*with the ends inset a little), good enough for albedo and specular maps and quick enough to do at load time
+class TextureCompressor abstract
+{
+public:
+	enum Format
+	{
+		BC1 = 0,
+		BC3
+	};
+
+	//An image with all of its mips, each level is the block data for that level
+	struct Image
+	{
+		unsigned Width = 0;
+		unsigned Height = 0;
+		Format Encoding = BC1;
+		std::vector<std::vector<uint8_t>> Levels;
+	};
+
+	//Compresses an RGBA8 image and every mip below it, BC3 if any pixel isn't opaque
+	static void Compress(const uint8_t* pixels, unsigned width, unsigned height, Image& result);
+
+	//Halves an RGBA8 image (each side rounds down, but never below one pixel)
+	static void Downsample(const uint8_t* source, unsigned width, unsigned height, uint8_t* result);
+	//Block compresses an RGBA8 image into GetCompressedSize bytes
+	static void Encode(const uint8_t* pixels, unsigned width, unsigned height, Format format, uint8_t* result);
+	static size_t GetCompressedSize(unsigned width, unsigned height, Format format);
+	//Size of a mip level (never below one)
+	static unsigned GetLevelSize(unsigned size, unsigned level);
+	//Levels from the full size down to 1x1
+	static unsigned GetLevelCount(unsigned width, unsigned height);
+	//Does any pixel have alpha below 255
+	static bool HasAlpha(const uint8_t* pixels, size_t count);
+	static bool IsSimdSupported();
+
+private:
+	//Blocks are 16 RGBA8 pixels, row by row
+	static void EncodeColorBlock(const uint8_t* block, uint8_t* result);
+	static void EncodeAlphaBlock(const uint8_t* block, uint8_t* result);
+};
@@ -0,0 +1,373 @@
+#include "AssetLoader.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <climits>
+#include <Texture2DData.h>
+
+#include "Utilities/ObjParser.h"
+#include "Utilities/MeshBounds.h"
+#include "Graphics/ShaderManager.h"
+#include "Graphics/TextureCache.h"
+
+AssetLoader::AssetLoader(unsigned numThreads)
+	: _pool(numThreads)
+{
+}
+
+AssetLoader::~AssetLoader()
+{
+	//Let any workers stuck on a full queue through so the pool can shut down
+	{
+		std::lock_guard<std::mutex> lock(_uploadMutex);
+		MaxPendingUploads = INT_MAX;
+	}
+	_uploadSpace.notify_all();
+	_pool.WaitIdle();
+}
+
+int AssetLoader::Add(const std::string& name, Step decode, Step upload, const std::vector<int>& dependencies)
+{
+	if (_started)
+	{
+		printf("Can't add %s, loading has already started\n", name.c_str());
+		return -1;
+	}
+
+	int id = int(_assets.size());
+	_assets.emplace_back();
+	_timings.emplace_back();
+
+	Asset& asset = _assets[id];
+	asset.decode = decode;
+	asset.upload = upload;
+	_timings[id].Name = name;
+
+	for (int dependency : dependencies)
+	{
+		//Dependencies have to be added first, which also means the graph can't have cycles
+		if (dependency < 0 || dependency >= id)
+		{
+			printf("%s depends on an asset that doesn't exist\n", name.c_str());
+			continue;
+		}
+		_assets[dependency].dependents.push_back(id);
+		asset.waitingOn++;
+	}
+
+	return id;
+}
+
+int AssetLoader::LoadTexture(const std::string& path, Texture2D::sptr& out, const std::vector<int>& dependencies)
+{
+	//Compressed with mips built here, so the upload is just a copy
+	if (TextureCache::IsSupported())
+	{
+		std::shared_ptr<TextureCompressor::Image> image = std::make_shared<TextureCompressor::Image>();
+		std::shared_ptr<bool> loaded = std::make_shared<bool>(false);
+		return Add(path,
+			[image, loaded, path]() { *loaded = TextureCache::Load(path, *image); },
+			[image, loaded, &out]() {
+				if (!*loaded)
+					return;
+				out = TextureCache::Upload(*image);
+				image->Levels.clear();
+			}, dependencies);
+	}
+
+	std::shared_ptr<Texture2DData::sptr> data = std::make_shared<Texture2DData::sptr>();
+	return Add(path,
+		[data, path]() { *data = Texture2DData::LoadFromFile(path); },
+		[data, &out]() {
+			if (*data == nullptr)
+				return;
+			out = Texture2D::Create();
+			out->LoadData(*data);
+			data->reset();
+		}, dependencies);
+}
+
+int AssetLoader::LoadCubeMap(const std::string& path, TextureCubeMap::sptr& out, const std::vector<int>& dependencies)
+{
+	return AddCubeMap(path, false, [&out](const BakedEnvironment& environment) {
+		out = EnvironmentBaker::Upload(environment.Sky);
+	}, dependencies);
+}
+
+int AssetLoader::LoadEnvironment(const std::string& path, EnvironmentMaps& out, const std::vector<int>& dependencies)
+{
+	return AddCubeMap(path, true, [&out](const BakedEnvironment& environment) {
+		out.Sky = EnvironmentBaker::Upload(environment.Sky);
+		out.Reflections = EnvironmentBaker::Upload(environment.Reflections);
+		out.Irradiance = EnvironmentBaker::Upload(environment.Irradiance);
+	}, dependencies);
+}
+
+int AssetLoader::LoadLUT(const std::string& path, LUT3D& out, const std::vector<int>& dependencies)
+{
+	std::shared_ptr<bool> parsed = std::make_shared<bool>(false);
+	return Add(path,
+		[parsed, path, &out]() { *parsed = out.parse(path); },
+		[parsed, &out]() {
+			if (*parsed)
+				out.upload();
+		}, dependencies);
+}
+
+int AssetLoader::LoadMesh(const std::string& path, VertexArrayObject::sptr& out, const std::vector<int>& dependencies)
+{
+	std::shared_ptr<ParsedMesh::sptr> mesh = std::make_shared<ParsedMesh::sptr>();
+	return Add(path,
+		[mesh, path]() { *mesh = ObjParser::Parse(path); },
+		[mesh, &out]() {
+			if (*mesh == nullptr)
+				return;
+			out = (*mesh)->Mesh.Bake();
+			//The box is gone once the mesh is baked, occlusion culling needs it later
+			MeshBounds::Set(out, (*mesh)->Min, (*mesh)->Max);
+			mesh->reset();
+		}, dependencies);
+}
+
+int AssetLoader::LoadShader(const std::string& name, Shader::sptr& out, const std::string& vertexPath, const std::string& fragmentPath,
+	const std::vector<int>& dependencies)
+{
+	//Reading the source is the only part that doesn't need the context
+	struct Source
+	{
+		std::string vertex;
+		std::string fragment;
+	};
+	std::shared_ptr<Source> source = std::make_shared<Source>();
+
+	return Add(name,
+		[source, vertexPath, fragmentPath]() {
+			if (!ShaderManager::ReadSource(vertexPath, source->vertex) || !ShaderManager::ReadSource(fragmentPath, source->fragment))
+				throw std::runtime_error("Could not open the shader source");
+		},
+		[source, name, &out]() {
+			if (source->vertex.empty())
+				return;
+			//Only starts the compile, ShaderManager::Finish waits on it
+			out = ShaderManager::LoadFromSource(name, source->vertex, source->fragment);
+		}, dependencies);
+}
+
+int AssetLoader::AddCubeMap(const std::string& path, bool lighting, std::function<void(const BakedEnvironment&)> upload,
+	const std::vector<int>& dependencies)
+{
+	static const char* FACES[6] = { "+x", "-x", "+y", "-y", "+z", "-z" };
+
+	std::shared_ptr<BakedEnvironment> environment = std::make_shared<BakedEnvironment>();
+	environment->Lighting = lighting;
+
+	int cache = Add(path + " (cache)",
+		[environment, path]() { EnvironmentBaker::ReadCache(path, *environment); },
+		nullptr, dependencies);
+
+	//Each face is its own asset so they decode side by side, they all write to different parts of the environment
+	std::vector<int> faces;
+	for (int face = 0; face < 6; face++)
+	{
+		faces.push_back(Add(path + " (" + FACES[face] + ")",
+			[environment, path, face]() {
+				if (environment->FromCache)
+					return;
+				if (!EnvironmentBaker::DecodeFace(path, face, *environment))
+					throw std::runtime_error("Could not read the cube map face");
+			}, nullptr, { cache }));
+	}
+
+	//Filtering reads every face, so it waits on all of them
+	std::vector<int> filtered = faces;
+	if (lighting)
+	{
+		filtered.clear();
+		for (int face = 0; face < 6; face++)
+		{
+			filtered.push_back(Add(path + " (" + FACES[face] + " lighting)",
+				[environment, face]() {
+					if (!environment->FromCache)
+						EnvironmentBaker::FilterFace(face, *environment);
+				}, nullptr, faces));
+		}
+	}
+
+	std::shared_ptr<bool> finished = std::make_shared<bool>(false);
+	return Add(path,
+		[environment, finished, path]() { *finished = EnvironmentBaker::Finish(path, *environment); },
+		[environment, finished, upload]() {
+			if (!*finished)
+				return;
+			upload(*environment);
+			*environment = BakedEnvironment();
+		}, filtered);
+}
+
+bool AssetLoader::Pump(int maxUploads)
+{
+	if (!_started)
+	{
+		_started = true;
+		_start = Clock::now();
+		for (int i = 0; i < _assets.size(); i++)
+		{
+			if (_assets[i].waitingOn == 0)
+				Dispatch(i);
+		}
+	}
+
+	for (int i = 0; i < maxUploads && _finished < _assets.size(); i++)
+	{
+		int id;
+		{
+			std::lock_guard<std::mutex> lock(_uploadMutex);
+			if (_uploads.empty())
+				break;
+			id = _uploads.front();
+			_uploads.pop_front();
+		}
+		_uploadSpace.notify_one();
+
+		Asset& asset = _assets[id];
+		AssetTiming& timing = _timings[id];
+
+		asset.uploadStart = Now();
+		if (asset.upload && !timing.Failed)
+		{
+			try
+			{
+				asset.upload();
+			}
+			catch (const std::exception& e)
+			{
+				printf("Failed to upload %s: %s\n", timing.Name.c_str(), e.what());
+				timing.Failed = true;
+			}
+		}
+		double uploadEnd = Now();
+
+		//Nothing gets looked at again, so the captures (and anything decoded) can go
+		asset.decode = nullptr;
+		asset.upload = nullptr;
+
+		timing.Decode = asset.decodeEnd - asset.decodeStart;
+		timing.Upload = uploadEnd - asset.uploadStart;
+		timing.Waiting = (asset.decodeStart - asset.readyAt) + (asset.uploadStart - asset.decodeEnd);
+		timing.Finished = uploadEnd;
+		//Already holds the longest critical path of our dependencies
+		timing.CriticalPath += timing.Decode + timing.Upload;
+		if (++_finished == _assets.size())
+			_totalTime = uploadEnd;
+
+		//Let anything that was waiting on us go, and hand on our critical path
+		for (int dependent : asset.dependents)
+		{
+			_timings[dependent].CriticalPath = std::max(_timings[dependent].CriticalPath, timing.CriticalPath);
+			if (--_assets[dependent].waitingOn == 0)
+				Dispatch(dependent);
+		}
+	}
+
+	return _finished == _assets.size();
+}
+
+void AssetLoader::Finish()
+{
+	while (!Pump(MaxPendingUploads))
+	{
+		//Sleep until a worker hands us something
+		std::unique_lock<std::mutex> lock(_uploadMutex);
+		_uploadReady.wait(lock, [this]() { return !_uploads.empty(); });
+	}
+}
+
+void AssetLoader::Dispatch(int id)
+{
+	Asset& asset = _assets[id];
+	asset.readyAt = Now();
+
+	if (!asset.decode)
+	{
+		asset.decodeStart = asset.decodeEnd = asset.readyAt;
+		//The main thread is the one emptying the queue, so it never waits on it
+		QueueUpload(id, false);
+		return;
+	}
+
+	_pool.Enqueue([this, id]() {
+		Asset& asset = _assets[id];
+		asset.decodeStart = Now();
+		try
+		{
+			asset.decode();
+		}
+		catch (const std::exception& e)
+		{
+			printf("Failed to load %s: %s\n", _timings[id].Name.c_str(), e.what());
+			_timings[id].Failed = true;
+		}
+		asset.decodeEnd = Now();
+		QueueUpload(id, true);
+	});
+}
+
+void AssetLoader::QueueUpload(int id, bool wait)
+{
+	{
+		std::unique_lock<std::mutex> lock(_uploadMutex);
+		if (wait)
+			_uploadSpace.wait(lock, [this]() { return int(_uploads.size()) < MaxPendingUploads; });
+		_uploads.push_back(id);
+		_peakUploads = std::max(_peakUploads, int(_uploads.size()));
+	}
+	_uploadReady.notify_one();
+}
+
+double AssetLoader::Now() const
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - _start).count();
+}
+
+double AssetLoader::GetTotalTime() const
+{
+	return _totalTime;
+}
+
+double AssetLoader::GetCriticalPath() const
+{
+	double longest = 0.0;
+	for (const AssetTiming& timing : _timings)
+		longest = std::max(longest, timing.CriticalPath);
+	return longest;
+}
+
+double AssetLoader::GetSerialTime() const
+{
+	double total = 0.0;
+	for (const AssetTiming& timing : _timings)
+		total += timing.Decode + timing.Upload;
+	return total;
+}
+
+int AssetLoader::GetPeakPendingUploads() const
+{
+	return _peakUploads;
+}
+
+const std::vector<AssetTiming>& AssetLoader::GetTimings() const
+{
+	return _timings;
+}
+
+void AssetLoader::PrintReport() const
+{
+	printf("Loaded %d assets in %.2fms on %u threads (%.2fms one at a time, %.2fms critical path, peak %d uploads waiting)\n",
+		int(_timings.size()), _totalTime, _pool.GetThreadCount(), GetSerialTime(), GetCriticalPath(), _peakUploads);
+	printf("  %-40s %9s %9s %9s %9s %9s\n", "Asset", "Decode", "Upload", "Waiting", "Finished", "Critical");
+	for (const AssetTiming& timing : _timings)
+	{
+		printf("  %-40s %9.2f %9.2f %9.2f %9.2f %9.2f%s\n", timing.Name.c_str(), timing.Decode, timing.Upload,
+			timing.Waiting, timing.Finished, timing.CriticalPath, timing.Failed ? " FAILED" : "");
+	}
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+
+#include <Shader.h>
+#include <Texture2D.h>
+#include <TextureCubeMap.h>
+#include <VertexArrayObject.h>
+
+#include "Utilities/ThreadPool.h"
+#include "Graphics/LUT.h"
+#include "Graphics/EnvironmentBaker.h"
+
+//How long one asset took (all in milliseconds)
+struct AssetTiming
+{
+	std::string Name;
+	//Time spent reading and decoding on a worker
+	double Decode = 0.0;
+	//Time spent uploading on the main thread
+	double Upload = 0.0;
+	//Time spent waiting on workers or the upload queue after it was ready to go
+	double Waiting = 0.0;
+	//When it finished, counting from the start of loading
+	double Finished = 0.0;
+	//Longest chain of decode and upload work through its dependencies, including itself
+	double CriticalPath = 0.0;
+	bool Failed = false;
+};
+
+//Loads assets as a dependency graph
+//*Decoding (image files, OBJ parsing, reading shader source) runs on a work stealing thread pool
+//*Anything that touches OpenGL goes through a bounded queue that the main thread works through
+//*An asset only starts once everything it depends on has finished uploading
+//*The outputs passed to the Load functions must stay alive until loading is done
+class AssetLoader
+{
+public:
+	typedef std::function<void()> Step;
+
+	//Zero threads picks one less than the number of hardware threads
+	AssetLoader(unsigned numThreads = 0);
+	~AssetLoader();
+
+	//Adds an asset to the graph and returns its id
+	//*decode runs on a worker and must not touch OpenGL, upload runs on the main thread (either can be null)
+	int Add(const std::string& name, Step decode, Step upload, const std::vector<int>& dependencies = {});
+
+	//Helpers for the asset types we use
+	int LoadTexture(const std::string& path, Texture2D::sptr& out, const std::vector<int>& dependencies = {});
+	int LoadCubeMap(const std::string& path, TextureCubeMap::sptr& out, const std::vector<int>& dependencies = {});
+	//A sky along with the reflection and irradiance cubes lit shaders use for their ambient
+	int LoadEnvironment(const std::string& path, EnvironmentMaps& out, const std::vector<int>& dependencies = {});
+	int LoadLUT(const std::string& path, LUT3D& out, const std::vector<int>& dependencies = {});
+	int LoadMesh(const std::string& path, VertexArrayObject::sptr& out, const std::vector<int>& dependencies = {});
+	int LoadShader(const std::string& name, Shader::sptr& out, const std::string& vertexPath, const std::string& fragmentPath,
+		const std::vector<int>& dependencies = {});
+
+	//Runs up to maxUploads of the uploads that are ready without waiting, returns true once everything has loaded
+	//*Call on the main thread, the first call starts everything that isn't waiting on something else
+	bool Pump(int maxUploads = 1);
+	//Pumps until everything has loaded
+	void Finish();
+
+	//Most decoded assets allowed to sit in the upload queue, workers wait for space when it's full
+	//*Keeps decoded images from piling up in memory faster than we can upload them
+	int MaxPendingUploads = 4;
+
+	//Wall clock time from the first pump until everything loaded (ms)
+	double GetTotalTime() const;
+	//Longest chain of dependent work in the graph, the best we could do with unlimited threads (ms)
+	double GetCriticalPath() const;
+	//What loading would have taken one asset at a time (ms)
+	double GetSerialTime() const;
+	//Most uploads that were waiting at once
+	int GetPeakPendingUploads() const;
+	const std::vector<AssetTiming>& GetTimings() const;
+	//Prints the timings of every asset to the console
+	void PrintReport() const;
+
+private:
+	typedef std::chrono::high_resolution_clock Clock;
+
+	struct Asset
+	{
+		Step decode;
+		Step upload;
+		std::vector<int> dependents;
+		int waitingOn = 0;
+		double readyAt = 0.0;
+		double decodeStart = 0.0;
+		double decodeEnd = 0.0;
+		double uploadStart = 0.0;
+	};
+
+	//Adds the cache read, a decode for each face, a filter for each face (if we want the lighting) and the upload
+	//*Returns the id of the last one, the only one anything else needs to wait on
+	int AddCubeMap(const std::string& path, bool lighting, std::function<void(const BakedEnvironment&)> upload, const std::vector<int>& dependencies);
+
+	//Starts an asset once it has nothing left to wait on (main thread only)
+	void Dispatch(int id);
+	//Hands a decoded asset to the main thread
+	void QueueUpload(int id, bool wait);
+	//Milliseconds since loading started
+	double Now() const;
+
+	ThreadPool _pool;
+	std::vector<Asset> _assets;
+	std::vector<AssetTiming> _timings;
+
+	std::mutex _uploadMutex;
+	//Wakes the main thread when an upload is queued
+	std::condition_variable _uploadReady;
+	//Wakes workers when there's room in the queue
+	std::condition_variable _uploadSpace;
+	std::deque<int> _uploads;
+	int _peakUploads = 0;
+
+	bool _started = false;
+	int _finished = 0;
+	Clock::time_point _start;
+	double _totalTime = 0.0;
+};
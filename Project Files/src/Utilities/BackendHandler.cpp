@@ -3,6 +3,18 @@
 GLFWwindow* BackendHandler::window = nullptr;
 std::vector<std::function<void()>> BackendHandler::imGuiCallbacks;
 
+bool BackendHandler::headless = false;
+int BackendHandler::headlessFrames = 300;
+float BackendHandler::headlessTimestep = 1.0f / 60.0f;
+std::string BackendHandler::headlessOutput = "capture";
+std::string BackendHandler::headlessContext = "egl";
+ImageWriter::Format BackendHandler::captureFormat = ImageWriter::PNG;
+int BackendHandler::windowWidth = 800;
+int BackendHandler::windowHeight = 800;
+unsigned int BackendHandler::randomSeed = 0;
+bool BackendHandler::seedSet = false;
+std::string BackendHandler::benchmark = "";
+
 
 void BackendHandler::GlDebugMessage(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam)
 {
@@ -28,24 +40,125 @@ void BackendHandler::GlDebugMessage(GLenum source, GLenum type, GLuint id, GLenu
 	}
 }
 
+bool BackendHandler::ParseArguments(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		//Does this option have a value after it
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--headless")
+			headless = true;
+		else if (arg == "--frames" && hasValue)
+			headlessFrames = std::atoi(argv[++i]);
+		else if (arg == "--output" && hasValue)
+			headlessOutput = argv[++i];
+		else if (arg == "--context" && hasValue)
+			headlessContext = argv[++i];
+		else if (arg == "--timestep" && hasValue)
+			headlessTimestep = float(std::atof(argv[++i]));
+		else if (arg == "--format" && hasValue)
+		{
+			std::string format = argv[++i];
+			if (format == "png")
+				captureFormat = ImageWriter::PNG;
+			else if (format == "ppm")
+				captureFormat = ImageWriter::PPM;
+			else if (format == "raw")
+				captureFormat = ImageWriter::RAW;
+			else
+			{
+				printf("Format should be png, ppm or raw\n");
+				return false;
+			}
+		}
+		else if (arg == "--size" && hasValue)
+		{
+			if (sscanf(argv[++i], "%dx%d", &windowWidth, &windowHeight) != 2)
+			{
+				printf("Size should look like 1280x720\n");
+				return false;
+			}
+		}
+		else if (arg == "--seed" && hasValue)
+		{
+			randomSeed = unsigned(std::atoi(argv[++i]));
+			seedSet = true;
+		}
+		else if (arg == "--benchmark" && hasValue)
+		{
+			benchmark = argv[++i];
+			//Headless runs only stop when the benchmark says it's done, so a name nothing runs would never exit
+			if (benchmark != "patrol" && benchmark != "lights" && benchmark != "prepass" && benchmark != "post" && benchmark != "bloom")
+			{
+				printf("Benchmark should be patrol, lights, prepass, post or bloom\n");
+				return false;
+			}
+		}
+		else if (arg == "--no-shader-cache")
+			ShaderManager::UseDiskCache = false;
+		else if (arg == "--no-texture-cache")
+		{
+			TextureCache::UseDiskCache = false;
+			EnvironmentBaker::UseDiskCache = false;
+		}
+		else
+		{
+			printf("Unknown option %s\n", arg.c_str());
+			return false;
+		}
+	}
+
+	return true;
+}
+
 bool BackendHandler::InitAll()
 {
 	Logger::Init();
-	Util::Init();
+
+	//Headless runs need to be reproducible, so they never seed from the clock
+	if (headless || seedSet)
+		Util::Init(randomSeed);
+	else
+		Util::Init();
 
 	if (!InitGLFW())
-		return 1;
+		return false;
 	if (!InitGLAD())
-		return 1;
+		return false;
+
+	//We don't know what the context did before us, so start with a clean slate
+	GLStateCache::Invalidate();
+
+	//Shared stages and the program binary cache
+	ShaderManager::Init();
+	//Compressed textures and their cache, before anything starts loading
+	TextureCache::Init();
+	//Skies and the lighting baked from them, cached the same way
+	EnvironmentBaker::Init();
 
 	Framebuffer::InitFullscreenQuad();
 
-	InitImGui();
+	//There's nothing to click on when headless
+	if (!headless)
+		InitImGui();
+
+	return true;
+}
+
+bool BackendHandler::IsRunning(int frameNumber)
+{
+	//Benchmarks stop the loop themselves once everything has been measured
+	if (headless)
+		return !benchmark.empty() || frameNumber < headlessFrames;
+
+	return !glfwWindowShouldClose(window);
 }
 
 void BackendHandler::GlfwWindowResizedCallback(GLFWwindow* window, int width, int height)
 {
-	glViewport(0, 0, width, height);
+	GLStateCache::Viewport(0, 0, width, height);
 	Application::Instance().ActiveScene->Registry().view<Camera>().each([=](Camera& cam) 
 	{
 		cam.ResizeWindow(width, height);
@@ -54,6 +167,10 @@ void BackendHandler::GlfwWindowResizedCallback(GLFWwindow* window, int width, in
 	{
 		buf.Reshape(width, height);
 	});
+	Application::Instance().ActiveScene->Registry().view<GBuffer>().each([=](GBuffer& buf)
+	{
+		buf.Reshape(width, height);
+	});
 	Application::Instance().ActiveScene->Registry().view<PostEffect>().each([=](PostEffect& buf)
 	{
 		buf.Reshape(width, height);
@@ -66,10 +183,28 @@ void BackendHandler::GlfwWindowResizedCallback(GLFWwindow* window, int width, in
 	{
 		buf.Reshape(width, height);
 	});
+	Application::Instance().ActiveScene->Registry().view<ColorCorrectionEffect>().each([=](ColorCorrectionEffect& buf)
+	{
+		buf.Reshape(width, height);
+	});
+	Application::Instance().ActiveScene->Registry().view<BloomEffect>().each([=](BloomEffect& buf)
+	{
+		buf.Reshape(width, height);
+	});
+	Application::Instance().ActiveScene->Registry().view<AmbientOcclusionEffect>().each([=](AmbientOcclusionEffect& buf)
+	{
+		buf.Reshape(width, height);
+	});
 }
 
 bool BackendHandler::InitGLFW()
 {
+#ifdef GLFW_PLATFORM_NULL
+	//GLFW 3.4+ can run without a display server at all
+	if (headless)
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+
 	if (glfwInit() == GLFW_FALSE) {
 		LOG_ERROR("Failed to initialize GLFW");
 		return false;
@@ -79,8 +214,22 @@ bool BackendHandler::InitGLFW()
 	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, true);
 #endif
 
+	if (headless) {
+		//Never show the window, we only render offscreen
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		//EGL (surfaceless on Mesa) or OSMesa (llvmpipe) so we can run without a GPU
+		if (headlessContext == "osmesa")
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+		else
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+	}
+
 	//Create a new GLFW window
-	window = glfwCreateWindow(800, 800, "INFR1350U", nullptr, nullptr);
+	window = glfwCreateWindow(windowWidth, windowHeight, "INFR1350U", nullptr, nullptr);
+	if (window == nullptr) {
+		LOG_ERROR("Failed to create a {} context", headless ? headlessContext : "window");
+		return false;
+	}
 	glfwMakeContextCurrent(window);
 
 	// Set our window resized callback
@@ -134,6 +283,9 @@ void BackendHandler::InitImGui()
 
 void BackendHandler::ShutdownImGui()
 {
+	if (headless)
+		return;
+
 	// Cleanup the ImGui implementation
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
@@ -143,6 +295,9 @@ void BackendHandler::ShutdownImGui()
 
 void BackendHandler::RenderImGui()
 {
+	if (headless)
+		return;
+
 	// Implementation new frame
 	ImGui_ImplOpenGL3_NewFrame();
 	ImGui_ImplGlfw_NewFrame();
@@ -175,6 +330,9 @@ void BackendHandler::RenderImGui()
 		// Restore our gl context
 		glfwMakeContextCurrent(window);
 	}
+
+	// ImGui sets whatever state it likes, so forget everything we knew
+	GLStateCache::Invalidate();
 }
 
 void BackendHandler::RenderVAO(const Shader::sptr& shader, const VertexArrayObject::sptr& vao, const glm::mat4& viewProjection, const Transform& transform)
@@ -183,15 +341,16 @@ void BackendHandler::RenderVAO(const Shader::sptr& shader, const VertexArrayObje
 	shader->SetUniformMatrix("u_Model", transform.WorldTransform());
 	shader->SetUniformMatrix("u_NormalMatrix", transform.WorldNormalMatrix());
 	vao->Render();
+	// The VAO binds itself, so the state cache no longer knows what's bound
+	GLStateCache::InvalidateVertexArray();
 }
 
 void BackendHandler::SetupShaderForFrame(const Shader::sptr& shader, const glm::mat4& view, const glm::mat4& projection)
 {
-	shader->Bind();
+	GLStateCache::UseProgram(shader->GetHandle());
 	// These are the uniforms that update only once per frame
 	shader->SetUniformMatrix("u_View", view);
 	shader->SetUniformMatrix("u_ViewProjection", projection * view);
-	shader->SetUniformMatrix("u_SkyboxMatrix", projection * glm::mat4(glm::mat3(view)));
 	glm::vec3 camPos = glm::inverse(view) * glm::vec4(0, 0, 0, 1);
 	shader->SetUniform("u_CamPos", camPos);
 }
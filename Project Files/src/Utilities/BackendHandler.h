@@ -2,10 +2,37 @@
 
 #include "Utilities/Util.h"
 #include "Utilities/EnvironmentGenerator.h"
+#include "Utilities/SimulationScheduler.h"
+#include "Utilities/PatrolSystem.h"
+#include "Utilities/AssetLoader.h"
+#include "Utilities/FrameBenchmark.h"
+#include "Utilities/MeshBounds.h"
 #include "Graphics/Framebuffer.h"
+#include "Graphics/GBuffer.h"
+#include "Graphics/DepthPrepass.h"
+#include "Graphics/OcclusionCuller.h"
+#include "Graphics/AutoExposure.h"
+#include "Graphics/RenderTargetPool.h"
+#include "Graphics/DynamicResolution.h"
+#include "Graphics/SkyPass.h"
+#include "Graphics/GLStateCache.h"
+#include "Graphics/ShaderManager.h"
+#include "Graphics/ShaderVariants.h"
+#include "Graphics/MaterialBatcher.h"
+#include "Graphics/TextureCache.h"
+#include "Graphics/EnvironmentBaker.h"
+#include "Graphics/LightingBuffer.h"
+#include "Graphics/ShadowAtlas.h"
+#include "Graphics/ClusteredLighting.h"
+#include "Graphics/GpuProfiler.h"
+#include "Graphics/CaptureRecorder.h"
 #include "Graphics/Post/PostEffect.h"
 #include "Graphics//Post/GreyscaleEffect.h"
 #include "Graphics/Post/SepiaEffect.h"
+#include "Graphics/Post/ColorCorrectionEffect.h"
+#include "Graphics/Post/BloomEffect.h"
+#include "Graphics/Post/AmbientOcclusionEffect.h"
+#include "Graphics/Post/PostChain.h"
 #include "Graphics/LUT.h"
 
 #include <iostream>
@@ -44,9 +71,27 @@ public:
 */
 	static void GlDebugMessage(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam);
 
+	//Reads the command line options (call before InitAll)
+	//*--headless            Render offscreen with no visible window or ImGui
+	//*--frames N            Number of frames to render when headless
+	//*--output DIR          Where the captured frames are written
+	//*--size WxH            Size of the offscreen surface
+	//*--context egl|osmesa  Which context API to use when headless
+	//*--timestep DT         Fixed timestep used when headless
+	//*--format png|ppm|raw  Image format of the captured frames
+	//*--seed S              Random seed (headless runs default to 0 so they are reproducible)
+	//*--benchmark NAME      Run a benchmark and exit (patrol, lights, prepass, post, bloom)
+	//*--no-shader-cache     Compile every shader from source (and don't save the binaries)
+	//*--no-texture-cache    Compress every texture and bake every sky again (and don't save the results)
+	static bool ParseArguments(int argc, char** argv);
+
 	//Initialize everything
 	static bool InitAll();
 
+	//Is the main loop still going
+	//*Headless runs stop after the requested number of frames
+	static bool IsRunning(int frameNumber);
+
 	//Window resize callback
 	static void GlfwWindowResizedCallback(GLFWwindow* window, int width, int height);
 
@@ -65,4 +110,19 @@ public:
 
 	static GLFWwindow* window;
 	static std::vector<std::function<void()>> imGuiCallbacks;
+
+	//Headless settings
+	static bool headless;
+	static int headlessFrames;
+	static float headlessTimestep;
+	static std::string headlessOutput;
+	static std::string headlessContext;
+	static ImageWriter::Format captureFormat;
+	static int windowWidth;
+	static int windowHeight;
+	static unsigned int randomSeed;
+	static bool seedSet;
+
+	//Which benchmark to run instead of the scene (empty for none)
+	static std::string benchmark;
 };
\ No newline at end of file
@@ -16,6 +16,8 @@ std::vector<std::vector<glm::vec2>> EnvironmentGenerator::_avoidToAll;
 //The filenames of the objects to spawn
 std::vector<std::string> EnvironmentGenerator::_objectsToSpawn;
 
+unsigned EnvironmentGenerator::_generation = 0;
+
 ////Not implemented//
 //std::vector<char> EnvironmentGenerator::_letterRepresentation;
 //std::vector<std::vector<char>> EnvironmentGenerator::_generatedMapPlacements;
@@ -56,6 +58,7 @@ void EnvironmentGenerator::GenerateEnvironment()
 		//Add object to the spawned list
 		_objectsSpawned.push_back(temp);
 	}
+	_generation++;
 }
 
 void EnvironmentGenerator::CleanEnvironment()
@@ -71,6 +74,7 @@ void EnvironmentGenerator::CleanEnvironment()
 
 	//Clear out objects spawned
 	_objectsSpawned.clear();
+	_generation++;
 }
 
 void EnvironmentGenerator::CleanUpPointers()
@@ -83,6 +87,20 @@ void EnvironmentGenerator::CleanUpPointers()
 
 void EnvironmentGenerator::AddObjectToGeneration(std::string fileName, ShaderMaterial::sptr objMat, int numToSpawn, glm::vec2 spawnFrom, 
 													glm::vec2 spawnTo, std::vector<glm::vec2> avoidFrom, std::vector<glm::vec2> avoidTo)
+{
+	//Don't load the mesh if we aren't going to use it
+	if (Util::FindInVector(fileName, _objectsToSpawn) != -1)
+	{
+		printf("Object already found in list\n");
+		return;
+	}
+
+	//Loads in the mesh and adds to list
+	AddObjectToGeneration(fileName, ObjLoader::LoadFromFile(fileName), objMat, numToSpawn, spawnFrom, spawnTo, avoidFrom, avoidTo);
+}
+
+void EnvironmentGenerator::AddObjectToGeneration(std::string fileName, VertexArrayObject::sptr vao, ShaderMaterial::sptr objMat, int numToSpawn,
+													glm::vec2 spawnFrom, glm::vec2 spawnTo, std::vector<glm::vec2> avoidFrom, std::vector<glm::vec2> avoidTo)
 {
 	//Find the filename in the list
 	int index = Util::FindInVector(fileName, _objectsToSpawn);
@@ -93,8 +111,7 @@ void EnvironmentGenerator::AddObjectToGeneration(std::string fileName, ShaderMat
 		return;
 	}
 
-	//Loads in the mesh and adds to list
-	VertexArrayObject::sptr vao = ObjLoader::LoadFromFile(fileName);
+	//Adds mesh to list
 	_vaosToSpawn.push_back(vao);
 	//Adds material to list
 	_materialsForSpawning.push_back(objMat);
@@ -109,8 +126,8 @@ void EnvironmentGenerator::AddObjectToGeneration(std::string fileName, ShaderMat
 
 	//Adds the filename to the list
 	_objectsToSpawn.push_back(fileName);
-	//Sets it as not loaded
-	_loadedIn.push_back(false);
+	//We already have the mesh, so GenerateEnvironment doesn't need to load it again
+	_loadedIn.push_back(true);
 }
 
 void EnvironmentGenerator::RemoveObjectFromGeneration(std::string fileName)
@@ -138,3 +155,8 @@ std::vector<std::string> EnvironmentGenerator::GetObjectsOnList()
 {
 	return _objectsToSpawn;
 }
+
+unsigned EnvironmentGenerator::GetGeneration()
+{
+	return _generation;
+}
@@ -25,10 +25,17 @@ public:
 	static void AddObjectToGeneration(std::string fileName, ShaderMaterial::sptr objMat, int numToSpawn, 
 										glm::vec2 spawnFrom, glm::vec2 spawnTo, std::vector<glm::vec2> avoidFrom, 
 											std::vector<glm::vec2> avoidTo);
+	//Adds object to generation using a mesh that's already loaded
+	static void AddObjectToGeneration(std::string fileName, VertexArrayObject::sptr vao, ShaderMaterial::sptr objMat, int numToSpawn,
+										glm::vec2 spawnFrom, glm::vec2 spawnTo, std::vector<glm::vec2> avoidFrom,
+											std::vector<glm::vec2> avoidTo);
 	//Removes object from generation
 	static void RemoveObjectFromGeneration(std::string fileName);
 
 	static std::vector<std::string> GetObjectsOnList();
+
+	//Goes up whenever objects are spawned or cleaned up, so anything cached from them knows it's stale
+	static unsigned GetGeneration();
 private:
 	//The gameobjects spawned here
 	static std::vector<std::vector<GameObject>> _objectsSpawned;
@@ -46,6 +53,8 @@ private:
 	//Allows us to go through and remove from list
 	static std::vector<std::string> _objectsToSpawn;
 
+	static unsigned _generation;
+
 	////////Not Implemented/////
 	//static std::vector<char> _letterRepresentation;
 	//static std::vector<std::vector<char>> _generatedMapPlacements;
@@ -0,0 +1,73 @@
+#include "FrameBenchmark.h"
+
+#include <cstdio>
+#include <glad/glad.h>
+
+FrameBenchmark::FrameBenchmark(const std::string& name, int warmupFrames, int measuredFrames) :
+	_name(name), _warmupFrames(warmupFrames), _measuredFrames(measuredFrames)
+{ }
+
+void FrameBenchmark::AddCase(const std::string& label, std::function<void()> setup)
+{
+	Case added;
+	added.label = label;
+	added.setup = setup;
+	_cases.push_back(added);
+}
+
+void FrameBenchmark::AddMetric(const std::string& name, std::function<double()> read)
+{
+	_metrics.push_back({ name, read });
+}
+
+bool FrameBenchmark::EndFrame()
+{
+	Clock::time_point now = Clock::now();
+
+	if (_current >= 0 && _current < int(_cases.size()))
+	{
+		_frame++;
+		if (_frame > _warmupFrames)
+		{
+			Case& current = _cases[_current];
+			current.frameTime += std::chrono::duration<double, std::milli>(now - _lastFrame).count();
+			current.metrics.resize(_metrics.size(), 0.0);
+			for (size_t i = 0; i < _metrics.size(); i++)
+				current.metrics[i] += _metrics[i].second();
+			current.frames++;
+		}
+	}
+
+	//Move on once this case has been measured (or to the first case on the first frame)
+	if (_current < 0 || _frame >= _warmupFrames + _measuredFrames)
+	{
+		_current++;
+		_frame = 0;
+		if (_current < int(_cases.size()) && _cases[_current].setup)
+			_cases[_current].setup();
+	}
+
+	//Time the next frame from here so the setup isn't counted
+	_lastFrame = Clock::now();
+	return _current < int(_cases.size());
+}
+
+void FrameBenchmark::PrintReport() const
+{
+	printf("%s (%d frames per case after %d to settle)\n", _name.c_str(), _measuredFrames, _warmupFrames);
+	//Results only mean anything next to the driver they came from (llvmpipe and a real GPU can rank cases differently)
+	printf("Renderer: %s\n", (const char*)glGetString(GL_RENDERER));
+	printf("%-24s %12s", "Case", "Frame ms");
+	for (auto& metric : _metrics)
+		printf(" %14s", metric.first.c_str());
+	printf("\n");
+
+	for (const Case& result : _cases)
+	{
+		double frames = result.frames > 0 ? double(result.frames) : 1.0;
+		printf("%-24s %12.3f", result.label.c_str(), result.frameTime / frames);
+		for (size_t i = 0; i < _metrics.size(); i++)
+			printf(" %14.3f", i < result.metrics.size() ? result.metrics[i] / frames : 0.0);
+		printf("\n");
+	}
+}
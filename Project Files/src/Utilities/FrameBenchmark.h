@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+
+//Runs the scene through a list of settings and reports how long frames took with each
+//*Every case gets a few frames to settle (GPU timers come back a few frames late) before it's measured
+class FrameBenchmark
+{
+public:
+	FrameBenchmark(const std::string& name, int warmupFrames = 30, int measuredFrames = 120);
+
+	//Adds a case, setup runs on the frame it starts
+	void AddCase(const std::string& label, std::function<void()> setup);
+	//Adds a number to average over each case (next to the frame time)
+	void AddMetric(const std::string& name, std::function<double()> read);
+
+	//Call once at the end of every frame, returns false once every case has been measured
+	bool EndFrame();
+	//Prints a table with a row per case
+	void PrintReport() const;
+
+private:
+	typedef std::chrono::high_resolution_clock Clock;
+
+	struct Case
+	{
+		std::string label;
+		std::function<void()> setup;
+		double frameTime = 0.0;
+		std::vector<double> metrics;
+		int frames = 0;
+	};
+
+	std::string _name;
+	int _warmupFrames;
+	int _measuredFrames;
+	std::vector<Case> _cases;
+	std::vector<std::pair<std::string, std::function<double()>>> _metrics;
+
+	int _current = -1;
+	int _frame = 0;
+	Clock::time_point _lastFrame;
+};
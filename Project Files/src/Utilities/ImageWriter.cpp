@@ -0,0 +1,306 @@
+#include "ImageWriter.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	//Deflate length codes 257-285
+	const unsigned short LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const unsigned char LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	//Deflate distance codes 0-29
+	const unsigned short DIST_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const unsigned char DIST_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	const int WINDOW_SIZE = 32768;
+	const int HASH_BITS = 15;
+	const int MIN_MATCH = 3;
+	const int MAX_MATCH = 258;
+
+	//Deflate writes bits least significant first
+	struct BitWriter
+	{
+		std::vector<unsigned char>& out;
+		unsigned int buffer = 0;
+		int count = 0;
+
+		BitWriter(std::vector<unsigned char>& output) : out(output) {}
+
+		void Bits(unsigned int value, int numBits)
+		{
+			buffer |= value << count;
+			count += numBits;
+			while (count >= 8)
+			{
+				out.push_back((unsigned char)(buffer & 0xFF));
+				buffer >>= 8;
+				count -= 8;
+			}
+		}
+
+		//Huffman codes are stored most significant bit first, so flip them
+		void Code(unsigned int code, int numBits)
+		{
+			unsigned int reversed = 0;
+			for (int i = 0; i < numBits; i++)
+				reversed |= ((code >> i) & 1) << (numBits - 1 - i);
+			Bits(reversed, numBits);
+		}
+
+		//Writes a literal/length symbol using the fixed huffman table
+		void Symbol(int symbol)
+		{
+			if (symbol < 144)
+				Code(0x30 + symbol, 8);
+			else if (symbol < 256)
+				Code(0x190 + (symbol - 144), 9);
+			else if (symbol < 280)
+				Code(symbol - 256, 7);
+			else
+				Code(0xC0 + (symbol - 280), 8);
+		}
+
+		void Flush()
+		{
+			if (count > 0)
+				out.push_back((unsigned char)(buffer & 0xFF));
+			buffer = 0;
+			count = 0;
+		}
+	};
+
+	void PutBigEndian(std::vector<unsigned char>& out, unsigned int value)
+	{
+		out.push_back((unsigned char)(value >> 24));
+		out.push_back((unsigned char)(value >> 16));
+		out.push_back((unsigned char)(value >> 8));
+		out.push_back((unsigned char)(value));
+	}
+
+	bool WriteFile(const std::string& path, const void* data, size_t size, const char* header = nullptr)
+	{
+		FILE* file = fopen(path.c_str(), "wb");
+		if (file == nullptr)
+		{
+			printf("Could not open %s for writing\n", path.c_str());
+			return false;
+		}
+
+		if (header != nullptr)
+			fputs(header, file);
+
+		bool ok = fwrite(data, 1, size, file) == size;
+		fclose(file);
+		return ok;
+	}
+}
+
+bool ImageWriter::Write(Format format, const std::string& path, unsigned width, unsigned height, const unsigned char* pixels)
+{
+	switch (format)
+	{
+	case PNG: return WritePNG(path, width, height, pixels);
+	case PPM: return WritePPM(path, width, height, pixels);
+	case RAW: return WriteRaw(path, width, height, pixels);
+	default: return false;
+	}
+}
+
+bool ImageWriter::WritePNG(const std::string& path, unsigned width, unsigned height, const unsigned char* pixels)
+{
+	//Each row gets a filter byte, we use the Sub filter since neighbouring pixels are usually close
+	size_t stride = size_t(width) * 4;
+	std::vector<unsigned char> filtered((stride + 1) * height);
+	for (unsigned y = 0; y < height; y++)
+	{
+		//Flip so the top row comes first
+		const unsigned char* src = pixels + size_t(height - 1 - y) * stride;
+		unsigned char* dst = &filtered[y * (stride + 1)];
+
+		dst[0] = 1;
+		for (size_t x = 0; x < stride; x++)
+			dst[x + 1] = (unsigned char)(src[x] - (x >= 4 ? src[x - 4] : 0));
+	}
+
+	std::vector<unsigned char> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+	//Header, 8 bits per channel RGBA
+	std::vector<unsigned char> header;
+	PutBigEndian(header, width);
+	PutBigEndian(header, height);
+	header.push_back(8);
+	header.push_back(6);
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+	WriteChunk(png, "IHDR", header);
+
+	std::vector<unsigned char> compressed;
+	Deflate(filtered, compressed);
+	WriteChunk(png, "IDAT", compressed);
+
+	WriteChunk(png, "IEND", std::vector<unsigned char>());
+
+	return WriteFile(path, png.data(), png.size());
+}
+
+bool ImageWriter::WritePPM(const std::string& path, unsigned width, unsigned height, const unsigned char* pixels)
+{
+	//Drop the alpha and flip so the top row comes first
+	std::vector<unsigned char> rgb(size_t(width) * height * 3);
+	for (unsigned y = 0; y < height; y++)
+	{
+		const unsigned char* src = pixels + size_t(height - 1 - y) * width * 4;
+		unsigned char* dst = &rgb[size_t(y) * width * 3];
+		for (unsigned x = 0; x < width; x++)
+		{
+			dst[x * 3 + 0] = src[x * 4 + 0];
+			dst[x * 3 + 1] = src[x * 4 + 1];
+			dst[x * 3 + 2] = src[x * 4 + 2];
+		}
+	}
+
+	char header[64];
+	snprintf(header, sizeof(header), "P6\n%u %u\n255\n", width, height);
+	return WriteFile(path, rgb.data(), rgb.size(), header);
+}
+
+bool ImageWriter::WriteRaw(const std::string& path, unsigned width, unsigned height, const unsigned char* pixels)
+{
+	return WriteFile(path, pixels, size_t(width) * height * 4);
+}
+
+const char* ImageWriter::GetExtension(Format format)
+{
+	switch (format)
+	{
+	case PNG: return ".png";
+	case PPM: return ".ppm";
+	case RAW: return ".raw";
+	default: return "";
+	}
+}
+
+void ImageWriter::Deflate(const std::vector<unsigned char>& data, std::vector<unsigned char>& out)
+{
+	//zlib header, deflate with a 32k window and no preset dictionary
+	out.push_back(0x78);
+	out.push_back(0x01);
+
+	BitWriter bits(out);
+	//One final block using the fixed huffman codes
+	bits.Bits(1, 1);
+	bits.Bits(1, 2);
+
+	//Most recent position each 3 byte sequence was seen at
+	std::vector<int> lastSeen(size_t(1) << HASH_BITS, -1);
+	int size = int(data.size());
+
+	int i = 0;
+	while (i < size)
+	{
+		int bestLength = 0;
+		int bestDistance = 0;
+
+		if (i + MIN_MATCH <= size)
+		{
+			unsigned int hash = ((data[i] << 16) | (data[i + 1] << 8) | data[i + 2]) * 2654435761u >> (32 - HASH_BITS);
+			int candidate = lastSeen[hash];
+			lastSeen[hash] = i;
+
+			if (candidate >= 0 && i - candidate <= WINDOW_SIZE)
+			{
+				int maxLength = size - i < MAX_MATCH ? size - i : MAX_MATCH;
+				int length = 0;
+				while (length < maxLength && data[candidate + length] == data[i + length])
+					length++;
+
+				if (length >= MIN_MATCH)
+				{
+					bestLength = length;
+					bestDistance = i - candidate;
+				}
+			}
+		}
+
+		if (bestLength == 0)
+		{
+			bits.Symbol(data[i]);
+			i++;
+			continue;
+		}
+
+		//Find the length code
+		int lengthCode = 28;
+		while (LENGTH_BASE[lengthCode] > bestLength)
+			lengthCode--;
+		bits.Symbol(257 + lengthCode);
+		bits.Bits(bestLength - LENGTH_BASE[lengthCode], LENGTH_EXTRA[lengthCode]);
+
+		//Find the distance code (always 5 bits with fixed codes)
+		int distCode = 29;
+		while (DIST_BASE[distCode] > bestDistance)
+			distCode--;
+		bits.Code(distCode, 5);
+		bits.Bits(bestDistance - DIST_BASE[distCode], DIST_EXTRA[distCode]);
+
+		//Remember the positions we skipped over so later matches can find them
+		for (int j = i + 1; j < i + bestLength && j + MIN_MATCH <= size; j++)
+		{
+			unsigned int hash = ((data[j] << 16) | (data[j + 1] << 8) | data[j + 2]) * 2654435761u >> (32 - HASH_BITS);
+			lastSeen[hash] = j;
+		}
+		i += bestLength;
+	}
+
+	//End of block
+	bits.Symbol(256);
+	bits.Flush();
+
+	//Adler-32 of the uncompressed data
+	unsigned int a = 1, b = 0;
+	for (int j = 0; j < size; j++)
+	{
+		a = (a + data[j]) % 65521;
+		b = (b + a) % 65521;
+	}
+	PutBigEndian(out, (b << 16) | a);
+}
+
+void ImageWriter::WriteChunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data)
+{
+	PutBigEndian(out, unsigned(data.size()));
+
+	size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+
+	//The crc covers the type and the data
+	PutBigEndian(out, Crc32(&out[start], out.size() - start));
+}
+
+unsigned int ImageWriter::Crc32(const unsigned char* data, size_t length, unsigned int crc)
+{
+	//Function statics are built once even with several workers writing at the same time
+	static const std::vector<unsigned int> table = []()
+	{
+		std::vector<unsigned int> result(256);
+		for (unsigned int n = 0; n < 256; n++)
+		{
+			unsigned int c = n;
+			for (int k = 0; k < 8; k++)
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			result[n] = c;
+		}
+		return result;
+	}();
+
+	crc = ~crc;
+	for (size_t i = 0; i < length; i++)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+#include <vector>
+
+//Writes RGBA8 pixels to disk
+//*Pixels are expected bottom row first (the way glReadPixels gives them to us)
+//*Everything here is safe to call from worker threads
+class ImageWriter abstract
+{
+public:
+	enum Format
+	{
+		PNG = 0,
+		PPM,
+		RAW
+	};
+
+	//Writes the pixels in the given format, returns false if the file couldn't be written
+	static bool Write(Format format, const std::string& path, unsigned width, unsigned height, const unsigned char* pixels);
+
+	//Writes a PNG (deflate with fixed huffman codes, good enough for frame dumps)
+	static bool WritePNG(const std::string& path, unsigned width, unsigned height, const unsigned char* pixels);
+	//Writes a binary PPM (RGB, no compression)
+	static bool WritePPM(const std::string& path, unsigned width, unsigned height, const unsigned char* pixels);
+	//Writes the pixels as they are (RGBA8, bottom row first) for tools that want raw frames
+	static bool WriteRaw(const std::string& path, unsigned width, unsigned height, const unsigned char* pixels);
+
+	//The file extension that goes with the format
+	static const char* GetExtension(Format format);
+
+private:
+	//Compresses data into a zlib stream
+	static void Deflate(const std::vector<unsigned char>& data, std::vector<unsigned char>& out);
+	//Appends a PNG chunk (length, type, data, crc)
+	static void WriteChunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data);
+	static unsigned int Crc32(const unsigned char* data, size_t length, unsigned int crc = 0);
+};
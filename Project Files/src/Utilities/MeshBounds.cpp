@@ -0,0 +1,32 @@
+#include "MeshBounds.h"
+
+std::unordered_map<const VertexArrayObject*, MeshBounds::Box> MeshBounds::_boxes;
+
+void MeshBounds::Set(const VertexArrayObject::sptr& mesh, const glm::vec3& min, const glm::vec3& max)
+{
+	if (mesh == nullptr)
+		return;
+	_boxes[mesh.get()] = { min, max, mesh };
+}
+
+bool MeshBounds::Get(const VertexArrayObject::sptr& mesh, glm::vec3& min, glm::vec3& max)
+{
+	auto it = _boxes.find(mesh.get());
+	if (it == _boxes.end())
+		return false;
+	//The mesh it was saved for was freed and this one took its address
+	if (it->second.mesh.owner_before(mesh) || mesh.owner_before(it->second.mesh))
+	{
+		_boxes.erase(it);
+		return false;
+	}
+
+	min = it->second.min;
+	max = it->second.max;
+	return true;
+}
+
+void MeshBounds::Clear()
+{
+	_boxes.clear();
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <unordered_map>
+#include <memory>
+#include <GLM/glm.hpp>
+#include <VertexArrayObject.h>
+
+//Remembers the bounding box of every mesh we loaded ourselves
+//*VAOs don't keep their vertices around, so the box has to be saved while the mesh is still on the CPU
+//*Boxes are dropped once their mesh is gone, so a new mesh that lands at the same address doesn't pick one up
+class MeshBounds abstract
+{
+public:
+	//Saves the box of a mesh (in the mesh's own space)
+	static void Set(const VertexArrayObject::sptr& mesh, const glm::vec3& min, const glm::vec3& max);
+	//Gets the box of a mesh, returns false if we don't know it (meshes built in code, like the skybox)
+	static bool Get(const VertexArrayObject::sptr& mesh, glm::vec3& min, glm::vec3& max);
+	//Forgets every box (call when the meshes are unloaded)
+	static void Clear();
+
+private:
+	struct Box
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+		//Tells us if the mesh the box was saved for is still the one at this address
+		std::weak_ptr<VertexArrayObject> mesh;
+	};
+
+	static std::unordered_map<const VertexArrayObject*, Box> _boxes;
+};
@@ -0,0 +1,142 @@
+#include "ObjParser.h"
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+#include <cfloat>
+
+//Turns an OBJ index (1 based, or negative to count back from the end) into a 0 based one
+static int ResolveIndex(long index, size_t count)
+{
+	if (index > 0)
+		return int(index - 1);
+	if (index < 0)
+		return int(long(count) + index);
+	return -1;
+}
+
+ParsedMesh::sptr ObjParser::Parse(const std::string& filename, const glm::vec4& color)
+{
+	//Read the whole file in one go, it's a lot faster than going line by line from disk
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		printf("Could not open %s\n", filename.c_str());
+		return nullptr;
+	}
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+	std::string text = buffer.str();
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec2> uvs;
+
+	ParsedMesh::sptr result = std::make_shared<ParsedMesh>();
+	glm::vec3 min = glm::vec3(FLT_MAX);
+	glm::vec3 max = glm::vec3(-FLT_MAX);
+	uint32_t vertexCount = 0;
+
+	//Vertices of the face we're on, reused so we aren't allocating every line
+	std::vector<uint32_t> corners;
+
+	const char* cursor = text.c_str();
+	const char* end = cursor + text.size();
+	while (cursor < end)
+	{
+		const char* lineEnd = cursor;
+		while (lineEnd < end && *lineEnd != '\n')
+			lineEnd++;
+
+		char* next;
+		if (cursor[0] == 'v' && cursor[1] == ' ')
+		{
+			glm::vec3 position;
+			position.x = strtof(cursor + 2, &next);
+			position.y = strtof(next, &next);
+			position.z = strtof(next, &next);
+			positions.push_back(position);
+		}
+		else if (cursor[0] == 'v' && cursor[1] == 'n')
+		{
+			glm::vec3 normal;
+			normal.x = strtof(cursor + 2, &next);
+			normal.y = strtof(next, &next);
+			normal.z = strtof(next, &next);
+			normals.push_back(normal);
+		}
+		else if (cursor[0] == 'v' && cursor[1] == 't')
+		{
+			glm::vec2 uv;
+			uv.x = strtof(cursor + 2, &next);
+			uv.y = strtof(next, &next);
+			uvs.push_back(uv);
+		}
+		else if (cursor[0] == 'f' && cursor[1] == ' ')
+		{
+			corners.clear();
+			const char* token = cursor + 2;
+			while (token < lineEnd)
+			{
+				//Skip to the next corner
+				while (token < lineEnd && (*token == ' ' || *token == '\t' || *token == '\r'))
+					token++;
+				if (token >= lineEnd)
+					break;
+
+				//Corners look like p, p/t, p//n or p/t/n
+				long p = strtol(token, &next, 10);
+				long t = 0;
+				long n = 0;
+				if (*next == '/')
+				{
+					if (next[1] != '/')
+						t = strtol(next + 1, &next, 10);
+					else
+						next++;
+					if (*next == '/')
+						n = strtol(next + 1, &next, 10);
+				}
+				token = next;
+
+				int pi = ResolveIndex(p, positions.size());
+				int ti = ResolveIndex(t, uvs.size());
+				int ni = ResolveIndex(n, normals.size());
+				if (pi < 0 || pi >= positions.size())
+				{
+					printf("Bad face in %s\n", filename.c_str());
+					return nullptr;
+				}
+
+				glm::vec3 position = positions[pi];
+				glm::vec3 normal = ni >= 0 && ni < normals.size() ? normals[ni] : glm::vec3(0.0f, 0.0f, 1.0f);
+				glm::vec2 uv = ti >= 0 && ti < uvs.size() ? uvs[ti] : glm::vec2(0.0f);
+
+				result->Mesh.AddVertex(VertexPosNormTexCol(position, normal, uv, color));
+				corners.push_back(vertexCount++);
+
+				min = glm::min(min, position);
+				max = glm::max(max, position);
+			}
+
+			//Fan the face out into triangles
+			for (int i = 2; i < corners.size(); i++)
+			{
+				result->Mesh.AddIndex(corners[0]);
+				result->Mesh.AddIndex(corners[i - 1]);
+				result->Mesh.AddIndex(corners[i]);
+			}
+		}
+
+		cursor = lineEnd + 1;
+	}
+
+	if (vertexCount > 0)
+	{
+		result->Min = min;
+		result->Max = max;
+	}
+
+	return result;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <GLM/glm.hpp>
+#include <MeshBuilder.h>
+#include <VertexTypes.h>
+
+//An OBJ file read into memory but not uploaded yet
+struct ParsedMesh
+{
+	typedef std::shared_ptr<ParsedMesh> sptr;
+
+	MeshBuilder<VertexPosNormTexCol> Mesh;
+	//Bounding box of every vertex in the file
+	glm::vec3 Min = glm::vec3(0.0f);
+	glm::vec3 Max = glm::vec3(0.0f);
+};
+
+//Reads OBJ files without touching OpenGL so it can run on worker threads
+//*Bake the result on the main thread to get a VAO (the same one ObjLoader would have made)
+//*Faces with more than three corners are fanned into triangles
+class ObjParser abstract
+{
+public:
+	//Returns nullptr if the file couldn't be read
+	static ParsedMesh::sptr Parse(const std::string& filename, const glm::vec4& color = glm::vec4(1.0f));
+};
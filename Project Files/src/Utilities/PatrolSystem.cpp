@@ -0,0 +1,268 @@
+#include "PatrolSystem.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+
+int PatrolSystem::AddPath(const std::vector<glm::vec2>& waypoints)
+{
+	int first = int(_segLength.size());
+
+	for (int i = 0; i < waypoints.size(); i++)
+	{
+		glm::vec2 start = waypoints[i];
+		glm::vec2 end = waypoints[(i + 1) % waypoints.size()];
+		float length = glm::length(end - start);
+
+		//Doubled up waypoints would give us a segment nobody can leave
+		if (length < 0.0001f)
+			continue;
+
+		glm::vec2 dir = (end - start) / length;
+		_segStartX.push_back(start.x);
+		_segStartY.push_back(start.y);
+		_segDirX.push_back(dir.x);
+		_segDirY.push_back(dir.y);
+		_segLength.push_back(length);
+		_segYaw.push_back(glm::degrees(std::atan2(dir.y, dir.x)));
+		_segNext.push_back(int(_segLength.size()));
+	}
+
+	int count = int(_segLength.size()) - first;
+	if (count == 0)
+	{
+		printf("Patrol path needs at least two different waypoints\n");
+		return -1;
+	}
+
+	//Close the loop
+	_segNext.back() = first;
+
+	float total = 0.0f;
+	for (int i = first; i < first + count; i++)
+		total += _segLength[i];
+
+	_pathFirstSegment.push_back(first);
+	_pathLength.push_back(total);
+	return int(_pathLength.size()) - 1;
+}
+
+int PatrolSystem::AddAgent(int path, float speed, float startDistance, float height, entt::entity entity)
+{
+	if (path < 0 || path >= _pathLength.size())
+		return -1;
+
+	//Walk to the segment we start on
+	int segment = _pathFirstSegment[path];
+	float distance = std::fmod(startDistance, _pathLength[path]);
+	if (distance < 0.0f)
+		distance += _pathLength[path];
+	while (distance >= _segLength[segment])
+	{
+		distance -= _segLength[segment];
+		segment = _segNext[segment];
+	}
+
+	_posX.push_back(0.0f);
+	_posY.push_back(0.0f);
+	_velX.push_back(0.0f);
+	_velY.push_back(0.0f);
+	_timeLeft.push_back(0.0f);
+	_segment.push_back(segment);
+	_speed.push_back(speed > 0.0f ? speed : 0.0f);
+	_height.push_back(height);
+	_yaw.push_back(0.0f);
+	_entity.push_back(entity);
+
+	int agent = int(_segment.size()) - 1;
+	EnterSegment(agent, segment, distance);
+	return agent;
+}
+
+void PatrolSystem::Clear()
+{
+	_pathFirstSegment.clear();
+	_pathLength.clear();
+
+	_segStartX.clear();
+	_segStartY.clear();
+	_segDirX.clear();
+	_segDirY.clear();
+	_segLength.clear();
+	_segYaw.clear();
+	_segNext.clear();
+
+	_posX.clear();
+	_posY.clear();
+	_velX.clear();
+	_velY.clear();
+	_timeLeft.clear();
+	_segment.clear();
+	_speed.clear();
+	_height.clear();
+	_yaw.clear();
+	_entity.clear();
+}
+
+void PatrolSystem::Update(float deltaTime)
+{
+	int count = int(_segment.size());
+
+	float* posX = _posX.data();
+	float* posY = _posY.data();
+	const float* velX = _velX.data();
+	const float* velY = _velY.data();
+	float* timeLeft = _timeLeft.data();
+
+	//Move everyone forward (no branches, the compiler vectorises this)
+	for (int i = 0; i < count; i++)
+	{
+		posX[i] += velX[i] * deltaTime;
+		posY[i] += velY[i] * deltaTime;
+		timeLeft[i] -= deltaTime;
+	}
+
+	//Turn anyone who reached a corner onto their next segment
+	//*Only agents at a corner go in here, everyone else drops straight through
+	for (int i = 0; i < count; i++)
+	{
+		if (timeLeft[i] > 0.0f)
+			continue;
+
+		//Carry on down the next segment for however long we overshot the corner by
+		float overshoot = -timeLeft[i];
+		int segment = _segment[i];
+		float distance = overshoot * _speed[i];
+		do
+		{
+			segment = _segNext[segment];
+			if (distance < _segLength[segment])
+				break;
+			distance -= _segLength[segment];
+		} while (true);
+
+		EnterSegment(i, segment, distance);
+	}
+}
+
+void PatrolSystem::EnterSegment(int agent, int segment, float distance)
+{
+	float speed = _speed[agent];
+
+	_segment[agent] = segment;
+	_posX[agent] = _segStartX[segment] + _segDirX[segment] * distance;
+	_posY[agent] = _segStartY[segment] + _segDirY[segment] * distance;
+	_velX[agent] = _segDirX[segment] * speed;
+	_velY[agent] = _segDirY[segment] * speed;
+	//Agents that aren't moving never reach the corner
+	_timeLeft[agent] = speed > 0.0f ? (_segLength[segment] - distance) / speed : INFINITY;
+	_yaw[agent] = _segYaw[segment];
+}
+
+void PatrolSystem::WriteTransforms(entt::registry& registry) const
+{
+	for (int i = 0; i < _entity.size(); i++)
+	{
+		if (_entity[i] == entt::null || !registry.valid(_entity[i]))
+			continue;
+
+		Transform& transform = registry.get<Transform>(_entity[i]);
+		transform.SetLocalPosition(_posX[i], _posY[i], _height[i]);
+		transform.SetLocalRotation(0.0f, 0.0f, _yaw[i] + FacingOffset);
+	}
+}
+
+int PatrolSystem::GetAgentCount() const
+{
+	return int(_segment.size());
+}
+
+glm::vec3 PatrolSystem::GetPosition(int agent) const
+{
+	return glm::vec3(_posX[agent], _posY[agent], _height[agent]);
+}
+
+float PatrolSystem::GetYaw(int agent) const
+{
+	return _yaw[agent] + FacingOffset;
+}
+
+void PatrolSystem::RunBenchmark()
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const int steps = 600;
+	const float deltaTime = 1.0f / 60.0f;
+
+	//What the monkeys used to do, one object at a time
+	struct BranchingAgent
+	{
+		glm::vec3 position;
+		glm::vec3 rotation;
+		bool firstHalf;
+		bool secondHalf;
+	};
+
+	const int counts[] = { 10000, 100000 };
+	for (int count : counts)
+	{
+		//Everyone walks the same square the monkeys do, spread out along it
+		PatrolSystem system;
+		int path = system.AddPath({ glm::vec2(-10.0f, 10.0f), glm::vec2(10.0f, 10.0f), glm::vec2(10.0f, -10.0f), glm::vec2(-10.0f, -10.0f) });
+		for (int i = 0; i < count; i++)
+			system.AddAgent(path, 1.0f + (i % 7) * 0.25f, float(i % 80), 5.0f);
+
+		Clock::time_point start = Clock::now();
+		for (int step = 0; step < steps; step++)
+			system.Update(deltaTime);
+		double soaTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		std::vector<BranchingAgent> agents(count);
+		for (int i = 0; i < count; i++)
+			agents[i] = { glm::vec3(system._posX[i], system._posY[i], 5.0f), glm::vec3(0.0f), false, true };
+
+		start = Clock::now();
+		for (int step = 0; step < steps; step++)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				BranchingAgent& agent = agents[i];
+				float move = (1.0f + (i % 7) * 0.25f) * deltaTime;
+				if (agent.position.x < 10 && agent.secondHalf) {
+					agent.rotation = glm::vec3(0.0f, 0.0f, -90.0f);
+					agent.position.x += move;
+				}
+				else if (agent.position.y > -10 && agent.secondHalf) {
+					agent.rotation = glm::vec3(0.0f, 0.0f, 180.0f);
+					agent.position.y -= move;
+				}
+				else {
+					agent.firstHalf = true;
+					agent.secondHalf = false;
+				}
+
+				if (agent.position.x > -10 && agent.firstHalf) {
+					agent.rotation = glm::vec3(0.0f, 0.0f, 90.0f);
+					agent.position.x -= move;
+				}
+				else if (agent.position.y < 10 && agent.firstHalf) {
+					agent.rotation = glm::vec3(0.0f, 0.0f, 0.0f);
+					agent.position.y += move;
+				}
+				else {
+					agent.secondHalf = true;
+					agent.firstHalf = false;
+				}
+			}
+		}
+		double branchingTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		//Use the results so none of the work gets optimised away
+		float checksum = 0.0f;
+		for (int i = 0; i < count; i++)
+			checksum += system._posX[i] + system._yaw[i] + agents[i].position.x + agents[i].rotation.z;
+
+		printf("Patrol benchmark, %d agents, %d steps (checksum %.1f)\n", count, steps, checksum);
+		printf("  Patrol system: %8.3f ms per step, %6.2f ns per agent\n", soaTime / steps, soaTime * 1000000.0 / (double(steps) * count));
+		printf("  Branching:     %8.3f ms per step, %6.2f ns per agent\n", branchingTime / steps, branchingTime * 1000000.0 / (double(steps) * count));
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+#include <GLM/glm.hpp>
+#include <Scene.h>
+#include <Transform.h>
+
+//Moves agents around looping waypoint paths
+//*Everything is kept in flat arrays (one per field) so an update is a few tight loops over memory
+//*Each path segment knows its own heading, so facing the way you travel is a lookup instead of a branch
+class PatrolSystem
+{
+public:
+	//Adds a closed path (the last waypoint joins back up with the first), returns its index
+	int AddPath(const std::vector<glm::vec2>& waypoints);
+	//Adds an agent to a path, returns its index
+	//*startDistance is how far along the path it starts, height is its fixed z
+	//*Speed is in units per second and can't be negative
+	int AddAgent(int path, float speed, float startDistance = 0.0f, float height = 0.0f, entt::entity entity = entt::null);
+	//Removes every agent and path
+	void Clear();
+
+	//Moves every agent along its path
+	//*Agents can cover more than one segment in a step, but it's cheapest when they don't
+	//*Positions are stepped forward and snapped back onto the path at every corner, so error doesn't build up
+	void Update(float deltaTime);
+	//Copies agent positions and headings onto the transforms of the entities they were added with
+	void WriteTransforms(entt::registry& registry) const;
+
+	int GetAgentCount() const;
+	glm::vec3 GetPosition(int agent) const;
+	//Rotation about z (in degrees) including FacingOffset
+	float GetYaw(int agent) const;
+
+	//Added to every heading, lines up models that don't face down +x
+	float FacingOffset = 0.0f;
+
+	//Times updates at 10k and 100k agents against the per object branching it replaces
+	static void RunBenchmark();
+
+private:
+	//Paths, the segments of every path are stored back to back
+	std::vector<int> _pathFirstSegment;
+	std::vector<float> _pathLength;
+
+	//Segments
+	std::vector<float> _segStartX;
+	std::vector<float> _segStartY;
+	std::vector<float> _segDirX;
+	std::vector<float> _segDirY;
+	std::vector<float> _segLength;
+	std::vector<float> _segYaw;
+	//The segment that comes after this one (wraps back around to the start of the path)
+	std::vector<int> _segNext;
+
+	//Puts an agent a distance along a segment and points it down the segment
+	void EnterSegment(int agent, int segment, float distance);
+
+	//Agents
+	//*Velocity and time left are all the per step update touches, the rest only changes at corners
+	std::vector<float> _posX;
+	std::vector<float> _posY;
+	std::vector<float> _velX;
+	std::vector<float> _velY;
+	std::vector<float> _timeLeft;
+	std::vector<int> _segment;
+	std::vector<float> _speed;
+	std::vector<float> _height;
+	std::vector<float> _yaw;
+	std::vector<entt::entity> _entity;
+};
@@ -0,0 +1,83 @@
+#include "SimulationScheduler.h"
+
+SimulationScheduler::SimulationScheduler(float fixedStep, int maxStepsPerFrame)
+	: FixedStep(fixedStep), MaxStepsPerFrame(maxStepsPerFrame)
+{
+}
+
+int SimulationScheduler::Advance(float frameTime)
+{
+	_accumulator += frameTime;
+
+	_stepsThisFrame = 0;
+	while (_accumulator >= FixedStep && _stepsThisFrame < MaxStepsPerFrame)
+	{
+		_accumulator -= FixedStep;
+		_stepsThisFrame++;
+	}
+
+	//We couldn't catch up, drop the extra time instead of owing it to the next frame
+	if (_accumulator >= FixedStep)
+	{
+		_droppedTime += _accumulator - FixedStep;
+		_accumulator = FixedStep * 0.999;
+	}
+
+	_totalSteps += _stepsThisFrame;
+	return _stepsThisFrame;
+}
+
+float SimulationScheduler::GetAlpha() const
+{
+	return float(_accumulator / FixedStep);
+}
+
+int SimulationScheduler::GetStepsThisFrame() const
+{
+	return _stepsThisFrame;
+}
+
+long long SimulationScheduler::GetTotalSteps() const
+{
+	return _totalSteps;
+}
+
+double SimulationScheduler::GetDroppedTime() const
+{
+	return _droppedTime;
+}
+
+void SimulationScheduler::BeginStep(entt::registry& registry)
+{
+	registry.view<InterpolatedTransform, Transform>().each([](entt::entity entity, InterpolatedTransform& interp, Transform& transform) {
+		interp.PreviousPosition = transform.GetLocalPosition();
+		interp.PreviousRotation = transform.GetLocalRotation();
+		interp.HasPrevious = true;
+	});
+}
+
+void SimulationScheduler::ApplyInterpolation(entt::registry& registry, float alpha)
+{
+	registry.view<InterpolatedTransform, Transform>().each([=](entt::entity entity, InterpolatedTransform& interp, Transform& transform) {
+		//Remember where the simulation has it so we can put it back after rendering
+		interp.CurrentPosition = transform.GetLocalPosition();
+		interp.CurrentRotation = transform.GetLocalRotation();
+
+		if (!interp.HasPrevious)
+			return;
+
+		transform.SetLocalPosition(glm::mix(interp.PreviousPosition, interp.CurrentPosition, alpha));
+		transform.SetLocalRotation(glm::slerp(interp.PreviousRotation, interp.CurrentRotation, alpha));
+	});
+}
+
+void SimulationScheduler::RestoreSimulation(entt::registry& registry)
+{
+	registry.view<InterpolatedTransform, Transform>().each([](entt::entity entity, InterpolatedTransform& interp, Transform& transform) {
+		if (!interp.HasPrevious)
+			return;
+
+		transform.SetLocalPosition(interp.CurrentPosition);
+		transform.SetLocalRotation(interp.CurrentRotation);
+	});
+}
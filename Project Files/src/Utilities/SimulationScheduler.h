@@ -0,0 +1,55 @@
+#pragma once
+#include <GLM/glm.hpp>
+#include <GLM/gtc/quaternion.hpp>
+#include <Scene.h>
+#include <Transform.h>
+
+//Remembers where an object was on the last two simulation steps so rendering can blend between them
+//*Add this to anything that moves during the simulation
+struct InterpolatedTransform
+{
+	glm::vec3 PreviousPosition = glm::vec3(0.0f);
+	glm::quat PreviousRotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	glm::vec3 CurrentPosition = glm::vec3(0.0f);
+	glm::quat CurrentRotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	//Nothing to blend from until the first step has run
+	bool HasPrevious = false;
+};
+
+//Runs the simulation at a fixed rate no matter how fast we render
+//*Frame time goes into an accumulator and is spent in fixed sized steps
+//*Whatever is left over becomes the blend factor between the last two steps
+class SimulationScheduler
+{
+public:
+	SimulationScheduler(float fixedStep = 1.0f / 60.0f, int maxStepsPerFrame = 5);
+
+	//Adds the time the last frame took, returns how many fixed steps to run this frame
+	int Advance(float frameTime);
+	//How far we are between the last step and the next one (0 to 1)
+	float GetAlpha() const;
+	//Steps run on the last call to Advance
+	int GetStepsThisFrame() const;
+	//Total steps run so far
+	long long GetTotalSteps() const;
+	//Simulated time dropped because we couldn't keep up (in seconds)
+	double GetDroppedTime() const;
+
+	//Call before every step, stores where things were before the step moves them
+	static void BeginStep(entt::registry& registry);
+	//Call before rendering, moves everything to its blended position
+	static void ApplyInterpolation(entt::registry& registry, float alpha);
+	//Call after rendering, puts everything back where the simulation left it
+	static void RestoreSimulation(entt::registry& registry);
+
+	//Length of a simulation step (in seconds)
+	float FixedStep;
+	//Most steps we'll run in one frame, stops a slow frame from snowballing
+	int MaxStepsPerFrame;
+
+private:
+	double _accumulator = 0.0;
+	int _stepsThisFrame = 0;
+	long long _totalSteps = 0;
+	double _droppedTime = 0.0;
+};
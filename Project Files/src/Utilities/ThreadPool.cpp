@@ -0,0 +1,146 @@
+#include "ThreadPool.h"
+
+//Which pool and queue the current thread works for, lets jobs queue more jobs on their own worker
+static thread_local ThreadPool* t_pool = nullptr;
+static thread_local unsigned t_queue = 0;
+
+ThreadPool::ThreadPool(unsigned numThreads)
+	: _nextQueue(0), _queued(0), _busy(0), _stolen(0)
+{
+	//Leave a core for the main thread
+	if (numThreads == 0)
+	{
+		unsigned hardware = std::thread::hardware_concurrency();
+		numThreads = hardware > 1 ? hardware - 1 : 1;
+	}
+
+	//Every queue has to exist before any worker starts looking through them
+	for (unsigned i = 0; i < numThreads; i++)
+		_queues.push_back(std::make_unique<WorkerQueue>());
+	for (unsigned i = 0; i < numThreads; i++)
+		_workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_jobAdded.notify_all();
+
+	for (int i = 0; i < _workers.size(); i++)
+		_workers[i].join();
+}
+
+void ThreadPool::Enqueue(Job job)
+{
+	unsigned index = t_pool == this ? t_queue : _nextQueue++ % unsigned(_queues.size());
+
+	_busy++;
+	{
+		std::lock_guard<std::mutex> lock(_queues[index]->mutex);
+		_queues[index]->jobs.push_back(std::move(job));
+		_queued++;
+	}
+
+	//Taking the lock means a worker can't miss this between checking for work and going to sleep
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+	}
+	_jobAdded.notify_one();
+}
+
+void ThreadPool::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_idle.wait(lock, [this]() { return _busy == 0; });
+}
+
+void ThreadPool::WaitBelow(int count)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_idle.wait(lock, [this, count]() { return _busy < count; });
+}
+
+int ThreadPool::GetQueuedCount() const
+{
+	return _queued;
+}
+
+int ThreadPool::GetBusyCount() const
+{
+	return _busy;
+}
+
+int ThreadPool::GetStolenCount() const
+{
+	return _stolen;
+}
+
+unsigned ThreadPool::GetThreadCount() const
+{
+	return unsigned(_workers.size());
+}
+
+bool ThreadPool::TakeJob(unsigned index, Job& job)
+{
+	//Newest off our own queue
+	{
+		WorkerQueue& own = *_queues[index];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.jobs.empty())
+		{
+			job = std::move(own.jobs.back());
+			own.jobs.pop_back();
+			_queued--;
+			return true;
+		}
+	}
+
+	//Oldest off someone else's, starting with our neighbour so the workers don't all pile onto the same queue
+	for (unsigned i = 1; i < _queues.size(); i++)
+	{
+		WorkerQueue& other = *_queues[(index + i) % _queues.size()];
+		std::lock_guard<std::mutex> lock(other.mutex);
+		if (!other.jobs.empty())
+		{
+			job = std::move(other.jobs.front());
+			other.jobs.pop_front();
+			_queued--;
+			_stolen++;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::WorkerLoop(unsigned index)
+{
+	t_pool = this;
+	t_queue = index;
+
+	while (true)
+	{
+		Job job;
+		if (!TakeJob(index, job))
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_jobAdded.wait(lock, [this]() { return _stopping || _queued > 0; });
+
+			//Only leave once everything queued has been run
+			if (_stopping && _queued == 0)
+				return;
+			continue;
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_busy--;
+		}
+		_idle.notify_all();
+	}
+}
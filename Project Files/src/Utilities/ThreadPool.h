@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+//A fixed set of worker threads that run queued jobs
+//*Every worker has its own queue, idle workers steal from the front of everyone else's
+//*Jobs queued from inside a job go on that worker's own queue and run newest first (while their data is still in cache)
+//*Jobs must not touch OpenGL, the context only lives on the main thread
+class ThreadPool
+{
+public:
+	typedef std::function<void()> Job;
+
+	//Starts the workers (zero picks one less than the number of hardware threads)
+	ThreadPool(unsigned numThreads = 0);
+	//Finishes every queued job then joins the workers
+	~ThreadPool();
+
+	//Queues a job, from outside the pool jobs are handed out to the workers in turn
+	void Enqueue(Job job);
+	//Blocks until every queued job has finished
+	//*Don't call this (or WaitBelow) from inside a job, the worker would be waiting on itself
+	void WaitIdle();
+	//Blocks until fewer than count jobs are queued or running
+	void WaitBelow(int count);
+
+	//Jobs waiting for a worker
+	int GetQueuedCount() const;
+	//Jobs waiting for a worker or being run
+	int GetBusyCount() const;
+	//Jobs a worker took from another worker's queue
+	int GetStolenCount() const;
+	//Number of worker threads
+	unsigned GetThreadCount() const;
+
+private:
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	//What every worker runs until the pool shuts down
+	void WorkerLoop(unsigned index);
+	//Takes the newest job off our own queue, or the oldest off someone else's
+	bool TakeJob(unsigned index, Job& job);
+
+	std::vector<std::thread> _workers;
+	std::vector<std::unique_ptr<WorkerQueue>> _queues;
+	//Which queue the next job from outside the pool goes on
+	std::atomic<unsigned> _nextQueue;
+
+	//Only used for sleeping and waking, the queues have their own locks
+	std::mutex _mutex;
+	//Wakes workers when there's a job (or we're shutting down)
+	std::condition_variable _jobAdded;
+	//Wakes WaitIdle and WaitBelow when a job finishes
+	std::condition_variable _idle;
+
+	std::atomic<int> _queued;
+	std::atomic<int> _busy;
+	std::atomic<int> _stolen;
+	bool _stopping = false;
+};
@@ -8,6 +8,24 @@ bool Util::Init()
     return true;
 }
 
+bool Util::Init(unsigned int seed)
+{
+    //Seeds random with the seed we were given
+    srand(seed);
+
+    return true;
+}
+
+unsigned long long Util::Hash(const std::string& data, unsigned long long hash)
+{
+    for (unsigned char c : data)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
 bool Util::CheckNumBetween(int num, int min, int max)
 {
     //Is the num greater than the minimum
@@ -2,10 +2,13 @@
 #include <GLM/glm.hpp>
 #include <time.h>
 #include <vector>
+#include <string>
 
 namespace Util
 {
 	bool Init();
+	//Seeds random with a fixed seed so runs can be reproduced
+	bool Init(unsigned int seed);
 
 	//Find templated type in vector
 	template <typename T>
@@ -23,6 +26,10 @@ namespace Util
 		}
 	}
 
+	//FNV-1a, what the disk caches name and check their files with
+	//*Pass the hash of something else in to hash the two together
+	unsigned long long Hash(const std::string& data, unsigned long long hash = 14695981039346656037ull);
+
 	//Check if the your num is within a specific range
 	bool CheckNumBetween(int num, int min, int max);
 	bool CheckNumBetween(float num, float min, float max);
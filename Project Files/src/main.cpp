@@ -4,6 +4,7 @@
 #include <filesystem>
 #include <json.hpp>
 #include <fstream>
+#include <unordered_map>
 
 #include <Texture2D.h>
 #include <Texture2DData.h>
@@ -29,14 +30,24 @@
 bool lightState = true;
 bool defaultCube = true;
 
-int main() {
+int main(int argc, char** argv) {
 	int frameIx = 0;
 	float fpsBuffer[128];
 	float minFps, maxFps, avgFps;
 	int selectedVao = 0; // select cube by default
 	std::vector<GameObject> controllables;
 
-	BackendHandler::InitAll();
+	if (!BackendHandler::ParseArguments(argc, argv))
+		return 1;
+
+	// Benchmarks that don't need a window run before we make one
+	if (BackendHandler::benchmark == "patrol") {
+		PatrolSystem::RunBenchmark();
+		return 0;
+	}
+
+	if (!BackendHandler::InitAll())
+		return 1;
 
 	// Let OpenGL know that we want debug output, and route it to our handler function
 	glEnable(GL_DEBUG_OUTPUT);
@@ -47,60 +58,194 @@ int main() {
 
 	// Push another scope so most memory should be freed *before* we exit the app
 	{
+		// Screenshots and recordings of the final frame (also used to write out headless runs)
+		CaptureRecorder recorder;
+		int screenshotCount = 0;
+		int recordingCount = 0;
+		int recordFormat = int(BackendHandler::captureFormat);
+
+		// Runs behaviours and movement at a fixed rate, independent of how fast we render
+		SimulationScheduler simulation;
+		float simulationRate = 60.0f;
+		bool uncappedRendering = false;
+
+		// Moves everything that walks a fixed route
+		PatrolSystem patrols;
+
+		#pragma region Asset Loading
+
+		// Everything is decoded on worker threads, then uploaded to the GPU here on the main thread
+		AssetLoader loader;
+
+		// Shaders
+		Shader::sptr passthroughShader, shader, skybox;
+		loader.LoadShader("Passthrough Shader", passthroughShader, "shaders/passthrough_vert.glsl", "shaders/passthrough_frag.glsl");
+		// The lit shader comes in variants (SIN_WAVE ripples the grass), only the plain one is built up front
+		ShaderVariants::sptr phongVariants = ShaderVariants::Create("shaders/vertex_shader.glsl", "shaders/frag_phong.glsl");
+		int shaderId = loader.Add("Phong Shader", [=]() { phongVariants->ReadSource(); }, [&]() { shader = phongVariants->Get("", false); });
+		int skyboxId = loader.LoadShader("Skybox Shader", skybox, "shaders/skybox-shader.vert.glsl", "shaders/skybox-shader.frag.glsl");
+
+		// Textures
+		Texture2D::sptr sandStone, sandStoneSpec, stone, stoneSpec, grass, grassSpec, box, boxSpec, bone, boneSpec;
+		int sandStoneId = loader.LoadTexture("images/Stone_001_Diffuse.png", sandStone);
+		int sandStoneSpecId = loader.LoadTexture("images/Stone_001_Specular.png", sandStoneSpec);
+		int stoneId = loader.LoadTexture("images/stone.jpg", stone);
+		int stoneSpecId = loader.LoadTexture("images/stoneSpec.jpg", stoneSpec);
+		int grassId = loader.LoadTexture("images/grass.jpg", grass);
+		int grassSpecId = loader.LoadTexture("images/grassSpec.png", grassSpec);
+		int boxId = loader.LoadTexture("images/box.bmp", box);
+		int boxSpecId = loader.LoadTexture("images/box-reflections.bmp", boxSpec);
+		int boneId = loader.LoadTexture("images/bone.jpg", bone);
+		int boneSpecId = loader.LoadTexture("images/boneSpec.png", boneSpec);
+
+		// LUTs
+		LUT3D cube, nuetralCube, warmCube, coolCube, customCube;
+		loader.LoadLUT("cubes/NeutralLUT.cube", cube);
+		loader.LoadLUT("cubes/NeutralLUT.cube", nuetralCube);
+		loader.LoadLUT("cubes/WarmLUT.cube", warmCube);
+		loader.LoadLUT("cubes/CoolLUT.cube", coolCube);
+		loader.LoadLUT("cubes/CustomLUT.cube", customCube);
+
+		// Load the cube map
+		// The sky plus the reflection and irradiance cubes baked from it, lit surfaces take their ambient from those
+		EnvironmentMaps environment;
+		//loader.LoadEnvironment("images/cubemaps/skybox/sample.jpg", environment);
+		int environmentMapId = loader.LoadEnvironment("images/cubemaps/skybox/ToonSky.jpg", environment);
+		// The sky is stood up, the lighting has to be turned the same way
+		glm::mat3 environmentRotation = glm::mat3(glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1, 0, 0)));
+
+		// Meshes (the monkeys all share one)
+		VertexArrayObject::sptr planeVao, chestVao, monkeyVao, skeletonVao, rockVao;
+		loader.LoadMesh("models/plane.obj", planeVao);
+		loader.LoadMesh("models/treasureChest.obj", chestVao);
+		loader.LoadMesh("models/monkey_quads.obj", monkeyVao);
+		loader.LoadMesh("models/skeleton.obj", skeletonVao);
+		loader.LoadMesh("models/simpleRock.obj", rockVao);
+
+		// Materials go together as soon as their shader and textures are up
+		ShaderMaterial::sptr sandStoneMat, stoneMat, grassMat, boxMat, boneMat, skyboxMat;
+		// Every lit material is made the same way, the batcher reads the textures and shininess from this list too
+		struct LitMaterial
+		{
+			ShaderMaterial::sptr* Material;
+			Texture2D::sptr* Diffuse;
+			Texture2D::sptr* Specular;
+			float Shininess;
+		};
+		std::vector<LitMaterial> litMaterials;
+		auto addLitMaterial = [&](const std::string& name, ShaderMaterial::sptr& material, Texture2D::sptr& diffuse, Texture2D::sptr& specular,
+			float shininess, const std::vector<int>& dependencies) {
+			litMaterials.push_back({ &material, &diffuse, &specular, shininess });
+			loader.Add(name, nullptr, [&, shininess]() {
+				material = ShaderMaterial::Create();
+				material->Shader = shader;
+				material->Set("s_Diffuse", diffuse);
+				material->Set("s_Specular", specular);
+				material->Set("u_Shininess", shininess);
+				material->Set("u_TextureMix", 0.0f);
+			}, dependencies);
+		};
+		addLitMaterial("Sand Stone Material", sandStoneMat, sandStone, sandStoneSpec, 2.0f, { shaderId, sandStoneId, sandStoneSpecId });
+		addLitMaterial("Stone Material", stoneMat, stone, stoneSpec, 2.0f, { shaderId, stoneId, stoneSpecId });
+		addLitMaterial("Grass Material", grassMat, grass, grassSpec, 2.0f, { shaderId, grassId, grassSpecId });
+		addLitMaterial("Box Material", boxMat, box, boxSpec, 8.0f, { shaderId, boxId, boxSpecId });
+		addLitMaterial("Bone Material", boneMat, bone, boneSpec, 8.0f, { shaderId, boneId, boneSpecId });
+
+		loader.Add("Skybox Material", nullptr, [&]() {
+			skyboxMat = ShaderMaterial::Create();
+			skyboxMat->Shader = skybox;
+			skyboxMat->Set("s_Environment", environment.Sky);
+			skyboxMat->Set("u_EnvironmentRotation", environmentRotation);
+		}, { skyboxId, environmentMapId });
+
+		loader.Finish();
+		loader.PrintReport();
+		// The loader only started the shader compiles, make sure they all worked
+		ShaderManager::Finish();
+
+		#pragma endregion
+
 		#pragma region Shader and ImGui
-		Shader::sptr passthroughShader = Shader::Create();
-		passthroughShader->LoadShaderPartFromFile("shaders/passthrough_vert.glsl", GL_VERTEX_SHADER);
-		passthroughShader->LoadShaderPartFromFile("shaders/passthrough_frag.glsl", GL_FRAGMENT_SHADER);
-		passthroughShader->Link();
-
-		Shader::sptr colorCorrectionShader = Shader::Create();
-		colorCorrectionShader->LoadShaderPartFromFile("shaders/passthrough_vert.glsl", GL_VERTEX_SHADER);
-		colorCorrectionShader->LoadShaderPartFromFile("shaders/Post/color_correction_frag.glsl", GL_FRAGMENT_SHADER);
-		colorCorrectionShader->Link();
-
-		// Load our shaders
-		Shader::sptr shader = Shader::Create();
-		shader->LoadShaderPartFromFile("shaders/vertex_shader.glsl", GL_VERTEX_SHADER);
-		shader->LoadShaderPartFromFile("shaders/frag_phong.glsl", GL_FRAGMENT_SHADER);
-		shader->Link();
-
-		Shader::sptr sinShader = Shader::Create();
-		sinShader->LoadShaderPartFromFile("shaders/vertex_sin.glsl", GL_VERTEX_SHADER);
-		sinShader->LoadShaderPartFromFile("shaders/frag_phong.glsl", GL_FRAGMENT_SHADER);
-		sinShader->Link();
-
-		float	  effectState = 0.0;
+		bool      sinWave = false;
+		bool      deferredShading = false;
+		GBuffer*  gBuffer = nullptr;
+		// The scene is lit into this one, its color format can be switched to an HDR one from the Renderer panel
+		Framebuffer* colorCorrect = nullptr;
+		const std::pair<GLenum, const char*> sceneFormats[] = {
+			{ GL_RGBA8, "RGBA8" }, { GL_RGBA16F, "RGBA16F" }, { GL_R11F_G11F_B10F, "R11G11B10F" }
+		};
 		glm::vec3 lightPos = glm::vec3(0.0f, 0.0f, 10.0f);
 		glm::vec3 lightCol = glm::vec3(0.9f, 0.85f, 0.5f);
 		float     lightAmbientPow = 0.05f;
 		float     lightSpecularPow = 1.0f;
 		glm::vec3 ambientCol = glm::vec3(1.0f);
 		float     ambientPow = 0.1f;
+		// How much of the ambient comes from the environment instead of the fixed color, none unless the slider asks for it
+		float     environmentLighting = 0.0f;
 		float     lightLinearFalloff = 0.09f;
 		float     lightQuadraticFalloff = 0.032f;
 
-		// These are our application / scene level uniforms that don't necessarily update
-		// every frame
-		shader->SetUniform("u_LightPos", lightPos);
-		shader->SetUniform("u_LightCol", lightCol);
-		shader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
-		shader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
-		shader->SetUniform("u_AmbientCol", ambientCol);
-		shader->SetUniform("u_AmbientStrength", ambientPow);
-		shader->SetUniform("u_LightAttenuationConstant", 1.0f);
-		shader->SetUniform("u_LightAttenuationLinear", lightLinearFalloff);
-		shader->SetUniform("u_LightAttenuationQuadratic", lightQuadraticFalloff);
-
-		sinShader->SetUniform("effectState", effectState);
-		sinShader->SetUniform("u_LightPos", lightPos);
-		sinShader->SetUniform("u_LightCol", lightCol);
-		sinShader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
-		sinShader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
-		sinShader->SetUniform("u_AmbientCol", ambientCol);
-		sinShader->SetUniform("u_AmbientStrength", ambientPow);
-		sinShader->SetUniform("u_LightAttenuationConstant", 1.0f);
-		sinShader->SetUniform("u_LightAttenuationLinear", lightLinearFalloff);
-		sinShader->SetUniform("u_LightAttenuationQuadratic", lightQuadraticFalloff);
+		// These are our application / scene level uniforms, every lit shader reads them from one uniform buffer
+		// that's filled once a frame, so the controls below only have to change the values
+		LightingBuffer lighting;
+		lighting.Init();
+
+		// Shadows from the scene light, the static half is only redrawn when the light moves or the environment changes
+		ShadowAtlas shadows;
+		shadows.Init();
+
+		// Lots of small point lights scattered around the environment, shaded through a cluster grid
+		ClusteredLighting clusters;
+		clusters.Init();
+		// None by default so the scene looks as it did with just the one light, the slider and --benchmark lights add them
+		int pointLightCount = 0;
+		bool animateLights = true;
+		std::vector<glm::vec3> lightOrigins;
+		std::vector<float> lightPhases;
+		auto spawnLights = [&](int count) {
+			clusters.Lights.resize(count);
+			lightOrigins.resize(count);
+			lightPhases.resize(count);
+			for (int i = 0; i < count; i++) {
+				lightOrigins[i] = Util::GetRandomNumberBetween(glm::vec3(-19.0f, -19.0f, 0.3f), glm::vec3(19.0f, 19.0f, 2.0f));
+				lightPhases[i] = Util::GetRandomNumberBetween(0.0f, 6.28f);
+				clusters.Lights[i].Position = lightOrigins[i];
+				clusters.Lights[i].Radius = Util::GetRandomNumberBetween(2.0f, 4.0f);
+				clusters.Lights[i].Color = Util::GetRandomNumberBetween(glm::vec3(0.2f), glm::vec3(1.0f));
+				clusters.Lights[i].Intensity = 1.0f;
+			}
+		};
+		spawnLights(pointLightCount);
+
+		// Lays down the depth of the lit surfaces first so each pixel is only shaded once
+		DepthPrepass prepass;
+		prepass.Init(phongVariants);
+
+		// Packs the lit materials' textures into arrays, so drawing one after another doesn't bind anything
+		MaterialBatcher batcher;
+		batcher.Init();
+		for (const LitMaterial& lit : litMaterials)
+			batcher.Add(*lit.Material, *lit.Diffuse, *lit.Specular, lit.Shininess);
+		batcher.Build();
+		// Built up front so the first frame doesn't stop to compile it
+		phongVariants->Get("MATERIAL_ARRAYS");
+		// Materials that still had to be applied last frame
+		int materialApplies = 0;
+		int lastMaterialApplies = 0;
+
+		// Skips objects that are hidden behind something else, retesting the hidden ones against each frame's depth
+		OcclusionCuller culler;
+		culler.Init();
+
+		// Sets the exposure from a histogram of the lit scene, the color correction picks it up without it coming back to the CPU
+		AutoExposure autoExposure;
+		autoExposure.Init();
+
+		// Draws the scene at a lower resolution when the GPU can't keep up, the color correction stretches it back out
+		DynamicResolution dynamicResolution;
+		// Software contexts crawl through compute, binning a small read back with SIMD is cheaper there
+		if (BackendHandler::headless)
+			autoExposure.UseCompute = false;
 
 		// We'll add some ImGui controls to control our shader
 		BackendHandler::imGuiCallbacks.push_back([&]() {
@@ -113,32 +258,30 @@ int main() {
 			}
 			if (ImGui::CollapsingHeader("Scene Level Lighting Settings"))
 			{
-				if (ImGui::ColorPicker3("Ambient Color", glm::value_ptr(ambientCol))) {
-					shader->SetUniform("u_AmbientCol", ambientCol);
-				}
-				if (ImGui::SliderFloat("Fixed Ambient Power", &ambientPow, 0.01f, 1.0f)) {
-					shader->SetUniform("u_AmbientStrength", ambientPow);
-				}
+				ImGui::ColorPicker3("Ambient Color", glm::value_ptr(ambientCol));
+				ImGui::SliderFloat("Fixed Ambient Power", &ambientPow, 0.01f, 1.0f);
+				if (environment.Irradiance != nullptr)
+					ImGui::SliderFloat("Environment Lighting", &environmentLighting, 0.0f, 1.0f);
 			}
 			if (ImGui::CollapsingHeader("Light Level Lighting Settings"))
 			{
-				if (ImGui::DragFloat3("Light Pos", glm::value_ptr(lightPos), 0.01f, -10.0f, 10.0f)) {
-					shader->SetUniform("u_LightPos", lightPos);
-				}
-				if (ImGui::ColorPicker3("Light Col", glm::value_ptr(lightCol))) {
-					shader->SetUniform("u_LightCol", lightCol);
-				}
-				if (ImGui::SliderFloat("Light Ambient Power", &lightAmbientPow, 0.0f, 1.0f)) {
-					shader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
-				}
-				if (ImGui::SliderFloat("Light Specular Power", &lightSpecularPow, 0.0f, 1.0f)) {
-					shader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
-				}
-				if (ImGui::DragFloat("Light Linear Falloff", &lightLinearFalloff, 0.01f, 0.0f, 1.0f)) {
-					shader->SetUniform("u_LightAttenuationLinear", lightLinearFalloff);
-				}
-				if (ImGui::DragFloat("Light Quadratic Falloff", &lightQuadraticFalloff, 0.01f, 0.0f, 1.0f)) {
-					shader->SetUniform("u_LightAttenuationQuadratic", lightQuadraticFalloff);
+				ImGui::DragFloat3("Light Pos", glm::value_ptr(lightPos), 0.01f, -10.0f, 10.0f);
+				ImGui::ColorPicker3("Light Col", glm::value_ptr(lightCol));
+				ImGui::SliderFloat("Light Ambient Power", &lightAmbientPow, 0.0f, 1.0f);
+				ImGui::SliderFloat("Light Specular Power", &lightSpecularPow, 0.0f, 1.0f);
+				ImGui::DragFloat("Light Linear Falloff", &lightLinearFalloff, 0.01f, 0.0f, 1.0f);
+				ImGui::DragFloat("Light Quadratic Falloff", &lightQuadraticFalloff, 0.01f, 0.0f, 1.0f);
+
+				ImGui::Checkbox("Shadows", &shadows.Enabled);
+				if (shadows.Enabled) {
+					ImGui::SameLine(160.0f);
+					ImGui::Checkbox("Cache Static", &shadows.CacheStatic);
+					ImGui::DragFloat("Shadow Range", &shadows.Range, 0.5f, 5.0f, 200.0f);
+					ImGui::DragFloat("Shadow Bias", &shadows.DepthBias, 0.00005f, 0.0f, 0.01f, "%.5f");
+					ImGui::DragFloat("Normal Offset", &shadows.NormalOffset, 0.005f, 0.0f, 0.5f);
+					ImGui::DragFloat("Slope Bias", &shadows.SlopeBias, 0.1f, 0.0f, 8.0f);
+					ImGui::Text("Shadows: %.3fms, static drawn %d times%s", GpuProfiler::GetTime("Shadows"), shadows.GetStaticRedraws(),
+						shadows.WasStaticRedrawn() ? " (this frame)" : "");
 				}
 			}
 
@@ -159,38 +302,192 @@ int main() {
 			}
 			ImGui::PlotLines("FPS", fpsBuffer, 128);
 			ImGui::Text("MIN: %f MAX: %f AVG: %f", minFps, maxFps, avgFps / 128.0f);
+
+			if (ImGui::CollapsingHeader("Simulation"))
+			{
+				if (ImGui::SliderFloat("Simulation Rate (Hz)", &simulationRate, 10.0f, 240.0f))
+					simulation.FixedStep = 1.0f / simulationRate;
+				if (ImGui::Checkbox("Uncapped Rendering", &uncappedRendering))
+					glfwSwapInterval(uncappedRendering ? 0 : 1);
+				ImGui::Text("Steps this frame: %d (blend %.2f)", simulation.GetStepsThisFrame(), simulation.GetAlpha());
+				ImGui::Text("Total steps: %lld, dropped %.3fs", simulation.GetTotalSteps(), simulation.GetDroppedTime());
+			}
+
+			if (ImGui::CollapsingHeader("Capture"))
+			{
+				ImGui::Combo("Format", &recordFormat, "PNG\0PPM\0RAW\0");
+				if (ImGui::Button("Screenshot (F12)")) {
+					std::filesystem::create_directories("screenshots");
+					recorder.RequestScreenshot("screenshots/screenshot_" + std::to_string(screenshotCount++) +
+						ImageWriter::GetExtension(ImageWriter::Format(recordFormat)), ImageWriter::Format(recordFormat));
+				}
+				ImGui::SameLine();
+				if (ImGui::Button(recorder.IsRecording() ? "Stop Recording (F9)" : "Start Recording (F9)")) {
+					if (recorder.IsRecording())
+						recorder.StopRecording();
+					else
+						recorder.StartRecording("recordings/recording_" + std::to_string(recordingCount++), ImageWriter::Format(recordFormat));
+				}
+
+				const FrameCapture& readback = recorder.GetReadback();
+				ImGui::Text("Reads in flight: %d (mapped %.1f frames late)", readback.GetPendingCount(), readback.GetAverageLatency());
+				ImGui::Text("GPU stalls: %d (%.2fms total)", readback.GetStallCount(), readback.GetStallTime());
+				ImGui::Text("Encoder backlog: %d (peak %d) on %u threads", recorder.GetBacklog(), recorder.GetPeakBacklog(), recorder.GetEncoderCount());
+				ImGui::Text("Encoded: %d Dropped: %d (%.2fms per frame)", recorder.GetEncodedCount(), recorder.GetDroppedCount(), recorder.GetAverageEncodeTime());
+			}
+
+			if (ImGui::CollapsingHeader("Asset Loading"))
+			{
+				ImGui::Text("Loaded in %.2fms (%.2fms one at a time)", loader.GetTotalTime(), loader.GetSerialTime());
+				ImGui::Text("Critical path: %.2fms, peak uploads waiting: %d", loader.GetCriticalPath(), loader.GetPeakPendingUploads());
+				for (const AssetTiming& timing : loader.GetTimings())
+				{
+					ImGui::Text("%-32s %7.2f decode %7.2f upload %7.2f critical%s", timing.Name.c_str(), timing.Decode, timing.Upload,
+						timing.CriticalPath, timing.Failed ? " (failed)" : "");
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Shaders"))
+			{
+				ImGui::Checkbox("Use Program Binary Cache", &ShaderManager::UseDiskCache);
+				ImGui::Text("Programs: %d (%d from disk, %d handed out again)", ShaderManager::GetProgramCount(),
+					ShaderManager::GetCacheHits(), ShaderManager::GetProgramsReused());
+				ImGui::Text("Stages compiled: %d, shared: %d", ShaderManager::GetStagesCompiled(), ShaderManager::GetStagesReused());
+				ImGui::Text("Build time: %.2fms", ShaderManager::GetBuildTime());
+				ImGui::Text("Parallel compile: %s, binary cache: %s", ShaderManager::IsParallelCompileSupported() ? "yes" : "no",
+					ShaderManager::IsBinaryCacheSupported() ? "yes" : "no");
+				ImGui::Text("Phong variants built: %d", phongVariants->GetVariantCount());
+			}
+
+			if (ImGui::CollapsingHeader("Textures"))
+			{
+				if (TextureCache::IsSupported())
+				{
+					ImGui::Checkbox("Use Texture Cache", &TextureCache::UseDiskCache);
+					ImGui::Text("Compressed: %d (%d from disk)", TextureCache::GetCompressed(), TextureCache::GetCacheHits());
+					ImGui::Text("Compress time: %.2fms (over every worker)", TextureCache::GetCompressTime());
+					ImGui::Text("GPU memory: %.1fMB (%.1fMB as RGBA8)", TextureCache::GetMemory() / (1024.0f * 1024.0f),
+						TextureCache::GetUncompressedMemory() / (1024.0f * 1024.0f));
+					ImGui::Text("SIMD mips: %s", TextureCompressor::IsSimdSupported() ? "yes" : "no");
+				}
+				else
+					ImGui::Text("S3TC isn't supported, textures are uncompressed");
+				ImGui::Text("Environments from disk: %d, baking: %.2fms (over every worker)", EnvironmentBaker::GetCacheHits(),
+					EnvironmentBaker::GetBakeTime());
+			}
+
+			if (ImGui::CollapsingHeader("Renderer"))
+			{
+				if (ImGui::RadioButton("Forward", !deferredShading))
+					deferredShading = false;
+				ImGui::SameLine();
+				if (ImGui::RadioButton("Deferred", deferredShading))
+					deferredShading = true;
+				ImGui::Text("G-buffer: %.1fMB", (gBuffer->_width * gBuffer->_height * GBuffer::BYTES_PER_PIXEL) / (1024.0f * 1024.0f));
+				// HDR formats keep lighting over one around until it's tonemapped in the color correction pass
+				GLenum sceneFormat = colorCorrect->GetColorFormat(0);
+				for (const auto& format : sceneFormats)
+				{
+					if (format.first != sceneFormats[0].first)
+						ImGui::SameLine();
+					if (ImGui::RadioButton(format.second, sceneFormat == format.first))
+						colorCorrect->SetColorFormat(0, format.first);
+				}
+				ImGui::Checkbox("Depth Pre-Pass", &prepass.Enabled);
+				ImGui::Checkbox("Show Overdraw", &prepass.ShowOverdraw);
+				if (prepass.ShowOverdraw)
+					ImGui::SliderFloat("Overdraw Scale", &prepass.OverdrawScale, 2.0f, 16.0f);
+				// With the pre-pass on this should sit at about one, everything over that is fragment shading thrown away
+				ImGui::Text("Fragments shaded per pixel: %.2f", prepass.GetFragmentsPerPixel());
+			}
+
+			if (ImGui::CollapsingHeader("Occlusion Culling"))
+			{
+				ImGui::Checkbox("Cull Hidden Objects", &culler.Enabled);
+				ImGui::Text("Hidden: %d of %d tested", culler.GetOccludedCount(), culler.GetTestedCount());
+				// Hidden objects are tested again every frame, these results only pick what's drawn before the test
+				ImGui::Text("Results are %d frames old", culler.GetLatency());
+				ImGui::Text("Tested again this frame: %d", culler.GetRetestedCount());
+			}
+
+			if (ImGui::CollapsingHeader("Material Batching"))
+			{
+				ImGui::Checkbox("Batch Materials", &batcher.Enabled);
+				ImGui::Text("Batched: %d materials in %d arrays (%d textures)", batcher.GetMaterialCount(),
+					batcher.GetArrayCount(), batcher.GetLayerCount());
+				ImGui::Text("Materials applied last frame: %d", lastMaterialApplies);
+			}
+
+			if (ImGui::CollapsingHeader("Point Lights"))
+			{
+				if (ImGui::SliderInt("Light Count", &pointLightCount, 0, 1024))
+					spawnLights(pointLightCount);
+				ImGui::Checkbox("Animate Lights", &animateLights);
+				ImGui::Checkbox("Clustered", &clusters.Clustered);
+				if (ClusteredLighting::IsSimdSupported())
+					ImGui::Checkbox("SIMD Assignment", &clusters.UseSimd);
+				ImGui::Text("Assignment: %.3fms", clusters.GetAssignTime());
+				ImGui::Text("Clusters lit: %d of %d, busiest has %d lights", clusters.GetActiveClusters(),
+					clusters.Clustered ? ClusteredLighting::NUM_CLUSTERS : 1, clusters.GetMaxLightsPerCluster());
+				ImGui::Text("Light indices: %d", clusters.GetIndexCount());
+			}
+
+			if (ImGui::CollapsingHeader("Dynamic Resolution"))
+			{
+				ImGui::Checkbox("Enabled##DynamicResolution", &dynamicResolution.Enabled);
+				ImGui::SliderFloat("GPU Budget (ms)", &dynamicResolution.TargetTime, 2.0f, 33.3f);
+				ImGui::SliderFloat("Min Scale", &dynamicResolution.MinScale, 0.25f, 1.0f);
+				ImGui::SliderFloat("Headroom", &dynamicResolution.Headroom, 0.5f, 1.0f);
+				ImGui::Text("Drawing at %.0f%% (%dx%d), GPU %.2fms smoothed, %d changes", dynamicResolution.GetScale() * 100.0f,
+					colorCorrect->GetRenderWidth(), colorCorrect->GetRenderHeight(), dynamicResolution.GetSmoothedTime(),
+					dynamicResolution.GetChangeCount());
+				const std::vector<float>& scales = dynamicResolution.GetScaleHistory();
+				const std::vector<float>& times = dynamicResolution.GetTimeHistory();
+				ImGui::PlotLines("Scale", scales.data(), int(scales.size()), 0, nullptr, 0.0f, 1.0f, ImVec2(0.0f, 50.0f));
+				ImGui::PlotLines("GPU ms", times.data(), int(times.size()), 0, nullptr, 0.0f, dynamicResolution.TargetTime * 2.0f, ImVec2(0.0f, 50.0f));
+			}
+
+			if (ImGui::CollapsingHeader("GPU Timings"))
+			{
+				ImGui::Checkbox("Profile GPU", &GpuProfiler::Enabled);
+				for (const std::string& scope : GpuProfiler::GetScopeNames())
+					ImGui::Text("%-16s %8.3fms", scope.c_str(), GpuProfiler::GetTime(scope));
+
+				// What the scene target would cost in each format: the clear, every fragment shaded into it and the post pass reading it
+				ImGui::Separator();
+				float pixels = float(colorCorrect->GetRenderWidth() * colorCorrect->GetRenderHeight());
+				float accesses = 2.0f + prepass.GetFragmentsPerPixel();
+				ImGui::Text("Scene target bandwidth (%.2f accesses per pixel)", accesses);
+				for (const auto& format : sceneFormats)
+				{
+					float megabytes = pixels * accesses * Framebuffer::GetBytesPerPixel(format.first) / (1024.0f * 1024.0f);
+					ImGui::Text("%c %-10s %7.1fMB/frame %6.2fGB/s", format.first == colorCorrect->GetColorFormat(0) ? '>' : ' ', format.second,
+						megabytes, megabytes * ImGui::GetIO().Framerate / 1024.0f);
+				}
+			}
+
+			if (ImGui::CollapsingHeader("GL State Cache"))
+			{
+				ImGui::Checkbox("Filter Redundant Calls", &GLStateCache::Enabled);
+				ImGui::Text("Last frame: %d issued, %d skipped", GLStateCache::GetTotalIssuedCalls(), GLStateCache::GetTotalSkippedCalls());
+				for (int i = 0; i < GLStateCache::NUM_CALL_TYPES; i++)
+				{
+					GLStateCache::CallType type = GLStateCache::CallType(i);
+					ImGui::Text("%-18s %5d issued %5d skipped", GLStateCache::GetCallTypeName(type),
+						GLStateCache::GetIssuedCalls(type), GLStateCache::GetSkippedCalls(type));
+				}
+			}
 			});
 
 		#pragma endregion 
 
 		// GL states
-		glEnable(GL_DEPTH_TEST);
-		glEnable(GL_CULL_FACE);
-		glDepthFunc(GL_LEQUAL); // New 
+		GLStateCache::Enable(GL_DEPTH_TEST);
+		GLStateCache::Enable(GL_CULL_FACE);
+		GLStateCache::DepthFunc(GL_LEQUAL); // New 
 
 		#pragma region TEXTURE LOADING
 
-		// Load some textures from files
-		Texture2D::sptr sandStone = Texture2D::LoadFromFile("images/Stone_001_Diffuse.png");
-		Texture2D::sptr sandStoneSpec = Texture2D::LoadFromFile("images/Stone_001_Specular.png");
-		Texture2D::sptr stone = Texture2D::LoadFromFile("images/stone.jpg");
-		Texture2D::sptr stoneSpec = Texture2D::LoadFromFile("images/stoneSpec.jpg");
-		Texture2D::sptr grass = Texture2D::LoadFromFile("images/grass.jpg");
-		Texture2D::sptr grassSpec = Texture2D::LoadFromFile("images/grassSpec.png");
-		Texture2D::sptr box = Texture2D::LoadFromFile("images/box.bmp");
-		Texture2D::sptr boxSpec = Texture2D::LoadFromFile("images/box-reflections.bmp");
-		Texture2D::sptr bone = Texture2D::LoadFromFile("images/bone.jpg");
-		Texture2D::sptr boneSpec = Texture2D::LoadFromFile("images/boneSpec.png");
-		LUT3D cube("cubes/NeutralLUT.cube");
-		LUT3D nuetralCube("cubes/NeutralLUT.cube");
-		LUT3D warmCube("cubes/WarmLUT.cube");
-		LUT3D coolCube("cubes/CoolLUT.cube");
-		LUT3D customCube("cubes/CustomLUT.cube");
-
-		// Load the cube map
-		//TextureCubeMap::sptr environmentMap = TextureCubeMap::LoadFromImages("images/cubemaps/skybox/sample.jpg");
-		TextureCubeMap::sptr environmentMap = TextureCubeMap::LoadFromImages("images/cubemaps/skybox/ToonSky.jpg");
-
 		// Creating an empty texture
 		Texture2DDescription desc = Texture2DDescription();  
 		desc.Width = 1;
@@ -209,6 +506,7 @@ int main() {
 		GameScene::RegisterComponentType<RendererComponent>();
 		GameScene::RegisterComponentType<BehaviourBinding>();
 		GameScene::RegisterComponentType<Camera>();
+		GameScene::RegisterComponentType<InterpolatedTransform>();
 
 		// Create a scene, and set it to be the active scene in the application
 		GameScene::sptr scene = GameScene::Create("test");
@@ -217,93 +515,70 @@ int main() {
 		// We can create a group ahead of time to make iterating on the group faster
 		entt::basic_group<entt::entity, entt::exclude_t<>, entt::get_t<Transform>, RendererComponent> renderGroup =
 			scene->Registry().group<RendererComponent>(entt::get_t<Transform>());
-
-		// Create a material and set some properties for it
-		ShaderMaterial::sptr sandStoneMat = ShaderMaterial::Create();
-		sandStoneMat->Shader = shader;
-		sandStoneMat->Set("s_Diffuse", sandStone);
-		sandStoneMat->Set("s_Specular", sandStoneSpec);
-		sandStoneMat->Set("u_Shininess", 2.0f);
-		sandStoneMat->Set("u_TextureMix", 0.0f);
-
-		ShaderMaterial::sptr stoneMat = ShaderMaterial::Create();
-		stoneMat->Shader = shader;
-		stoneMat->Set("s_Diffuse", stone);
-		stoneMat->Set("s_Specular", stoneSpec);
-		stoneMat->Set("u_Shininess", 2.0f);
-		stoneMat->Set("u_TextureMix", 0.0f);
-
-		ShaderMaterial::sptr grassMat = ShaderMaterial::Create();
-		grassMat->Shader = sinShader;
-		grassMat->Set("s_Diffuse", grass);
-		grassMat->Set("s_Specular", grassSpec);
-		grassMat->Set("u_Shininess", 2.0f);
-		grassMat->Set("u_TextureMix", 0.0f);
-
-		ShaderMaterial::sptr boxMat = ShaderMaterial::Create();
-		boxMat->Shader = shader;
-		boxMat->Set("s_Diffuse", box);
-		boxMat->Set("s_Specular", boxSpec);
-		boxMat->Set("u_Shininess", 8.0f);
-		boxMat->Set("u_TextureMix", 0.0f);
-
-		ShaderMaterial::sptr boneMat = ShaderMaterial::Create();
-		boneMat->Shader = shader;
-		boneMat->Set("s_Diffuse", bone);
-		boneMat->Set("s_Specular", boneSpec);
-		boneMat->Set("u_Shininess", 8.0f);
-		boneMat->Set("u_TextureMix", 0.0f);
+		// What the render group is sorted on, worked out once per renderer each frame instead of on every comparison
+		struct SortKey
+		{
+			const ShaderMaterial* Material;
+			float Depth;
+		};
+		std::unordered_map<entt::entity, SortKey> sortKeys;
 
 		GameObject obj1 = scene->CreateEntity("Ground"); 
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/plane.obj");
-			obj1.emplace<RendererComponent>().SetMesh(vao).SetMaterial(grassMat);
+			obj1.emplace<RendererComponent>().SetMesh(planeVao).SetMaterial(grassMat);
 		}
 
 		GameObject obj2 = scene->CreateEntity("Chest");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/treasureChest.obj");
-			obj2.emplace<RendererComponent>().SetMesh(vao).SetMaterial(boxMat);
+			obj2.emplace<RendererComponent>().SetMesh(chestVao).SetMaterial(boxMat);
 			obj2.get<Transform>().SetLocalPosition(0.0f, 0.0f, 0.0f);
 			obj2.get<Transform>().SetLocalRotation(90.0f, 0.0f, -90.0f);
 			obj2.get<Transform>().SetLocalScale(glm::vec3(2, 2, 2));
 			BehaviourBinding::BindDisabled<SimpleMoveBehaviour>(obj2);
+			obj2.emplace<InterpolatedTransform>();
 		}
 
 		GameObject obj3 = scene->CreateEntity("MonkeOne");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/monkey_quads.obj");
-			obj3.emplace<RendererComponent>().SetMesh(vao).SetMaterial(sandStoneMat);
+			obj3.emplace<RendererComponent>().SetMesh(monkeyVao).SetMaterial(sandStoneMat);
 			obj3.get<Transform>().SetLocalPosition(0.0f, 10.0f, 5.0f);
 			obj3.get<Transform>().SetLocalRotation(0.0f, 0.0f, -90.0f);
-			BehaviourBinding::BindDisabled<SimpleMoveBehaviour>(obj3);
+			obj3.emplace<InterpolatedTransform>();
 		}
 
 		GameObject obj4 = scene->CreateEntity("MonkeTwo");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/monkey_quads.obj");
-			obj4.emplace<RendererComponent>().SetMesh(vao).SetMaterial(sandStoneMat);
+			obj4.emplace<RendererComponent>().SetMesh(monkeyVao).SetMaterial(sandStoneMat);
 			obj4.get<Transform>().SetLocalPosition(0.0f, -10.0f, 5.0f);
 			obj4.get<Transform>().SetLocalRotation(0.0f, 0.0f, 90.0f);
-			BehaviourBinding::BindDisabled<SimpleMoveBehaviour>(obj4);
+			obj4.emplace<InterpolatedTransform>();
 		}
 
 		GameObject obj5 = scene->CreateEntity("MonkeThree");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/monkey_quads.obj");
-			obj5.emplace<RendererComponent>().SetMesh(vao).SetMaterial(sandStoneMat);
+			obj5.emplace<RendererComponent>().SetMesh(monkeyVao).SetMaterial(sandStoneMat);
 			obj5.get<Transform>().SetLocalPosition(10.0f, 0.0f, 5.0f);
 			obj5.get<Transform>().SetLocalRotation(0.0f, 0.0f, 180.0f);
-			BehaviourBinding::BindDisabled<SimpleMoveBehaviour>(obj5);
+			obj5.emplace<InterpolatedTransform>();
 		}
 
 		GameObject obj6 = scene->CreateEntity("MonkeFour");
 		{
-			VertexArrayObject::sptr vao = ObjLoader::LoadFromFile("models/monkey_quads.obj");
-			obj6.emplace<RendererComponent>().SetMesh(vao).SetMaterial(sandStoneMat);
+			obj6.emplace<RendererComponent>().SetMesh(monkeyVao).SetMaterial(sandStoneMat);
 			obj6.get<Transform>().SetLocalPosition(-10.0f, 0.0f, 5.0f);
 			obj6.get<Transform>().SetLocalRotation(0.0f, 0.0f, 0.0f);
-			BehaviourBinding::BindDisabled<SimpleMoveBehaviour>(obj6);
+			obj6.emplace<InterpolatedTransform>();
+		}
+
+		// The monkeys all walk the same square, a quarter of the way round from each other
+		{
+			int square = patrols.AddPath({ glm::vec2(-10.0f, 10.0f), glm::vec2(10.0f, 10.0f), glm::vec2(10.0f, -10.0f), glm::vec2(-10.0f, -10.0f) });
+			// The monkey model faces down +y
+			patrols.FacingOffset = -90.0f;
+			patrols.AddAgent(square, 1.5f, 10.0f, 5.0f, obj3.entity());
+			patrols.AddAgent(square, 1.5f, 50.0f, 5.0f, obj4.entity());
+			patrols.AddAgent(square, 1.5f, 30.0f, 5.0f, obj5.entity());
+			patrols.AddAgent(square, 1.5f, 70.0f, 5.0f, obj6.entity());
 		}
 
 		std::vector<glm::vec2> allAvoidAreasFrom = { glm::vec2(-4.0f, -4.0f) };
@@ -316,9 +591,9 @@ int main() {
 		glm::vec2 spawnFromHere = glm::vec2(-19.0f, -19.0f);
 		glm::vec2 spawnToHere = glm::vec2(19.0f, 19.0f);
 
-		EnvironmentGenerator::AddObjectToGeneration("models/skeleton.obj", boneMat, 150,
+		EnvironmentGenerator::AddObjectToGeneration("models/skeleton.obj", skeletonVao, boneMat, 150,
 			spawnFromHere, spawnToHere, allAvoidAreasFrom, allAvoidAreasTo);
-		EnvironmentGenerator::AddObjectToGeneration("models/simpleRock.obj", stoneMat, 40,
+		EnvironmentGenerator::AddObjectToGeneration("models/simpleRock.obj", rockVao, stoneMat, 40,
 			spawnFromHere, spawnToHere, rockAvoidAreasFrom, rockAvoidAreasTo);
 		EnvironmentGenerator::GenerateEnvironment();
 
@@ -335,19 +610,38 @@ int main() {
 			camera.SetFovDegrees(90.0f); // Set an initial FOV
 			camera.SetOrthoHeight(3.0f);
 			BehaviourBinding::Bind<CameraControlBehaviour>(cameraObject);
+			// The controls move it in the fixed steps, so the view gets blended between steps like everything else
+			cameraObject.emplace<InterpolatedTransform>();
 		}
 
 		int width, height;
 		glfwGetWindowSize(BackendHandler::window, &width, &height);
 
-		Framebuffer* colorCorrect;
 		GameObject colorCorrectionObj = scene->CreateEntity("Color Correct");
 		{
 			colorCorrect = &colorCorrectionObj.emplace<Framebuffer>();
 			colorCorrect->AddColorTarget(GL_RGBA8);
+			// Filtered so it can be stretched back to full size when dynamic resolution draws into part of it
+			colorCorrect->SetFilter(GL_LINEAR);
 			colorCorrect->AddDepthTarget();
 			colorCorrect->Init(width, height);
 		}
+
+		// The deferred renderer draws the scene's surfaces in here before lighting them
+		GameObject gBufferObj = scene->CreateEntity("G-Buffer");
+		{
+			gBuffer = &gBufferObj.emplace<GBuffer>();
+			gBuffer->Init(width, height);
+		}
+
+		// The color corrected result ends up here, so it can be captured as well as shown
+		Framebuffer* finalFrame;
+		GameObject finalFrameObj = scene->CreateEntity("Final Frame");
+		{
+			finalFrame = &finalFrameObj.emplace<Framebuffer>();
+			finalFrame->AddColorTarget(GL_RGBA8);
+			finalFrame->Init(width, height);
+		}
 		
 		PostEffect* basicEffect;
 		GameObject framebufferObject = scene->CreateEntity("Basic Effect");
@@ -369,32 +663,167 @@ int main() {
 			sepiaEffect = &sepiaEffectObject.emplace<SepiaEffect>();
 			sepiaEffect->Init(width, height);
 		}
+
+		// Grades the finished frame through whichever LUT cube is pointing at
+		ColorCorrectionEffect* colorCorrectionEffect;
+		GameObject colorCorrectionEffectObject = scene->CreateEntity("Color Correction Effect");
+		{
+			colorCorrectionEffect = &colorCorrectionEffectObject.emplace<ColorCorrectionEffect>();
+			colorCorrectionEffect->Init(width, height);
+			colorCorrectionEffect->SetLUT(&cube);
+			colorCorrectionEffect->SetAutoExposure(&autoExposure);
+		}
+
+		// Built from the lit scene before post runs, and added on by the color correction rather than in a pass of its own
+		BloomEffect* bloomEffect;
+		GameObject bloomEffectObject = scene->CreateEntity("Bloom Effect");
+		{
+			bloomEffect = &bloomEffectObject.emplace<BloomEffect>();
+			bloomEffect->Init(width, height);
+			bloomEffect->Enabled = false;
+			colorCorrectionEffect->SetBloom(bloomEffect);
+		}
+
+		// Built from the depth once it's down and read by the lighting, so it isn't part of the post chain either
+		AmbientOcclusionEffect* ssaoEffect;
+		GameObject ssaoEffectObject = scene->CreateEntity("Ambient Occlusion Effect");
+		bool showOcclusion = false;
+		// How much of the frame's width is left showing the lit scene next to the occlusion
+		float occlusionSplit = 0.5f;
+		{
+			ssaoEffect = &ssaoEffectObject.emplace<AmbientOcclusionEffect>();
+			ssaoEffect->Init(width, height);
+			ssaoEffect->Enabled = false;
+		}
+
+		// Everything after the scene, each effect can run as a fragment pass or in a shared compute dispatch
+		// The color correction goes first so an HDR scene is exposed and tonemapped before anything is stored in an RGBA8 effect buffer
+		PostChain post;
+		{
+			greyscaleEffect->Enabled = false;
+			sepiaEffect->Enabled = false;
+			post.Add(colorCorrectionEffect);
+			post.Add(greyscaleEffect);
+			post.Add(sepiaEffect);
+		}
+
+		BackendHandler::imGuiCallbacks.push_back([&]() {
+			if (ImGui::CollapsingHeader("Post Processing"))
+			{
+				auto effectControls = [](const char* name, PostEffect* effect) {
+					ImGui::PushID(name);
+					ImGui::Checkbox(name, &effect->Enabled);
+					ImGui::SameLine(160.0f);
+					ImGui::Checkbox("Compute", &effect->UseCompute);
+					// Full, half or quarter resolution
+					ImGui::SameLine(260.0f);
+					int scale = effect->ResolutionDivisor >= 4 ? 2 : effect->ResolutionDivisor - 1;
+					ImGui::PushItemWidth(80.0f);
+					if (ImGui::Combo("Resolution", &scale, "1\0" "1/2\0" "1/4\0"))
+						effect->ResolutionDivisor = 1u << scale;
+					ImGui::PopItemWidth();
+					ImGui::PopID();
+				};
+				effectControls("Color Correction", colorCorrectionEffect);
+				effectControls("Greyscale", greyscaleEffect);
+				effectControls("Sepia", sepiaEffect);
+
+				float greyscaleIntensity = greyscaleEffect->GetIntensity();
+				if (ImGui::SliderFloat("Greyscale Intensity", &greyscaleIntensity, 0.0f, 1.0f))
+					greyscaleEffect->SetIntensity(greyscaleIntensity);
+				float sepiaIntensity = sepiaEffect->GetIntensity();
+				if (ImGui::SliderFloat("Sepia Intensity", &sepiaIntensity, 0.0f, 1.0f))
+					sepiaEffect->SetIntensity(sepiaIntensity);
+
+				// Tonemapping happens as part of the color correction, before the LUT is sampled
+				const char* tonemappers[] = { "None", "Reinhard", "ACES" };
+				int tonemap = colorCorrectionEffect->Tonemap;
+				if (ImGui::Combo("Tonemap", &tonemap, tonemappers, 3))
+					colorCorrectionEffect->Tonemap = ColorCorrectionEffect::Tonemapper(tonemap);
+				ImGui::SliderFloat("Exposure", &colorCorrectionEffect->Exposure, 0.1f, 8.0f);
+
+				// With auto exposure on the slider above is compensation on top of what it picks
+				ImGui::Checkbox("Auto Exposure", &autoExposure.Enabled);
+				if (autoExposure.Enabled) {
+					ImGui::SameLine(160.0f);
+					ImGui::Checkbox("Compute##Exposure", &autoExposure.UseCompute);
+					ImGui::SliderFloat("Key Value", &autoExposure.KeyValue, 0.05f, 0.5f);
+					ImGui::SliderFloat("Adapt Speed", &autoExposure.AdaptSpeed, 0.1f, 10.0f);
+					ImGui::DragFloatRange2("Log Luminance", &autoExposure.MinLogLuminance, &autoExposure.MaxLogLuminance, 0.1f, -16.0f, 16.0f);
+					if (autoExposure.UseCompute)
+						ImGui::Text("Histogram: %.3fms", GpuProfiler::GetTime("Exposure"));
+					else {
+						// The CPU path has the histogram on hand, so we can show it
+						float bins[AutoExposure::NUM_BINS];
+						for (int i = 0; i < AutoExposure::NUM_BINS; i++)
+							bins[i] = float(autoExposure.GetHistogram()[i]);
+						ImGui::PlotHistogram("##Histogram", bins, AutoExposure::NUM_BINS, 0, nullptr, 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
+						ImGui::Text("Exposure %.2f, binned in %.3fms%s", autoExposure.GetExposure(), autoExposure.GetCpuTime(),
+							AutoExposure::IsSimdSupported() ? " (SIMD)" : "");
+					}
+				}
+
+				// Bloom wants an HDR scene target, on RGBA8 nothing gets far past the threshold
+				ImGui::Checkbox("Bloom", &bloomEffect->Enabled);
+				if (bloomEffect->Enabled) {
+					ImGui::SameLine(160.0f);
+					int filter = bloomEffect->Method;
+					ImGui::PushItemWidth(120.0f);
+					if (ImGui::Combo("Filter", &filter, "Dual filter\0" "Gaussian\0"))
+						bloomEffect->Method = BloomEffect::Filter(filter);
+					ImGui::PopItemWidth();
+					ImGui::SliderInt("Levels", &bloomEffect->Levels, 1, BloomEffect::MAX_LEVELS);
+					ImGui::SliderFloat("Threshold", &bloomEffect->Threshold, 0.0f, 4.0f);
+					ImGui::SliderFloat("Knee", &bloomEffect->Knee, 0.0f, 1.0f);
+					ImGui::SliderFloat("Bloom Intensity", &bloomEffect->Intensity, 0.0f, 2.0f);
+					ImGui::Text("Bloom: %.3fms, %.0fpx radius", GpuProfiler::GetTime("Bloom"), bloomEffect->GetRadius(colorCorrect->GetRenderHeight()));
+				}
+
+				// Forward shading only has depth before the lit pass with the pre-pass on, so turning this on turns that on too
+				if (ImGui::Checkbox("Ambient Occlusion", &ssaoEffect->Enabled) && ssaoEffect->Enabled)
+					prepass.Enabled = true;
+				if (ssaoEffect->Enabled) {
+					ImGui::SameLine(160.0f);
+					ImGui::Checkbox("Show##Occlusion", &showOcclusion);
+					if (showOcclusion)
+						ImGui::SliderFloat("Split##Occlusion", &occlusionSplit, 0.0f, 0.9f);
+					ImGui::SliderInt("Samples", &ssaoEffect->Samples, 1, AmbientOcclusionEffect::MAX_SAMPLES);
+					ImGui::SliderFloat("Radius", &ssaoEffect->Radius, 0.05f, 2.0f);
+					ImGui::SliderFloat("Bias", &ssaoEffect->Bias, 0.0f, 0.1f);
+					ImGui::SliderFloat("Occlusion Strength", &ssaoEffect->Strength, 0.0f, 1.0f);
+					ImGui::Checkbox("Temporal", &ssaoEffect->Temporal);
+					if (ssaoEffect->Temporal) {
+						ImGui::SameLine(160.0f);
+						ImGui::PushItemWidth(120.0f);
+						ImGui::SliderFloat("Blend", &ssaoEffect->TemporalBlend, 0.02f, 1.0f);
+						ImGui::PopItemWidth();
+					}
+					ImGui::Checkbox("Blur##Occlusion", &ssaoEffect->Blur);
+					if (ssaoEffect->Blur) {
+						ImGui::SameLine(160.0f);
+						ImGui::PushItemWidth(120.0f);
+						ImGui::SliderFloat("Sharpness", &ssaoEffect->BlurSharpness, 1.0f, 32.0f);
+						ImGui::PopItemWidth();
+					}
+					if (!deferredShading && !prepass.Enabled)
+						ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.2f, 1.0f), "Forward shading needs the depth pre-pass");
+					ImGui::Text("SSAO: %.3fms", GpuProfiler::GetTime("SSAO"));
+				}
+
+				ImGui::Text("%d fragment passes, %d compute dispatches", post.GetFragmentPasses(), post.GetComputeDispatches());
+				ImGui::Text("%d upsamples, %d pooled targets (%.1fMB)", post.GetUpsamples(), RenderTargetPool::GetTargetCount(),
+					RenderTargetPool::GetMemory() / (1024.0f * 1024.0f));
+				ImGui::Text("Post: %.3fms", GpuProfiler::GetTime("Post"));
+			}
+		});
+
+		// Check the post effect shaders (they mostly come from the cache, or are ones we already have)
+		ShaderManager::Finish();
 		#pragma endregion 
 		//////////////////////////////////////////////////////////////////////////////////////////
 
 		/////////////////////////////////// SKYBOX ///////////////////////////////////////////////
-		{
-			// Load our shaders
-			Shader::sptr skybox = std::make_shared<Shader>();
-			skybox->LoadShaderPartFromFile("shaders/skybox-shader.vert.glsl", GL_VERTEX_SHADER);
-			skybox->LoadShaderPartFromFile("shaders/skybox-shader.frag.glsl", GL_FRAGMENT_SHADER);
-			skybox->Link();
-
-			ShaderMaterial::sptr skyboxMat = ShaderMaterial::Create();
-			skyboxMat->Shader = skybox;  
-			skyboxMat->Set("s_Environment", environmentMap);
-			skyboxMat->Set("u_EnvironmentRotation", glm::mat3(glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1, 0, 0))));
-			skyboxMat->RenderLayer = 100;
-
-			MeshBuilder<VertexPosNormTexCol> mesh;
-			MeshFactory::AddIcoSphere(mesh, glm::vec3(0.0f), 1.0f);
-			MeshFactory::InvertFaces(mesh);
-			VertexArrayObject::sptr meshVao = mesh.Bake();
-			
-			GameObject skyboxObj = scene->CreateEntity("skybox");  
-			skyboxObj.get<Transform>().SetLocalPosition(0.0f, 0.0f, 0.0f);
-			skyboxObj.get_or_emplace<RendererComponent>().SetMesh(meshVao).SetMaterial(skyboxMat);
-		}
+		// The shader and material came in with the rest of the assets, the sky is drawn after the scene in its own pass
 		////////////////////////////////////////////////////////////////////////////////////////
 
 
@@ -407,6 +836,18 @@ int main() {
 			// use std::bind
 			keyToggles.emplace_back(GLFW_KEY_T, [&]() { cameraObject.get<Camera>().ToggleOrtho(); });
 
+			keyToggles.emplace_back(GLFW_KEY_F12, [&]() {
+				std::filesystem::create_directories("screenshots");
+				recorder.RequestScreenshot("screenshots/screenshot_" + std::to_string(screenshotCount++) +
+					ImageWriter::GetExtension(ImageWriter::Format(recordFormat)), ImageWriter::Format(recordFormat));
+			});
+			keyToggles.emplace_back(GLFW_KEY_F9, [&]() {
+				if (recorder.IsRecording())
+					recorder.StopRecording();
+				else
+					recorder.StartRecording("recordings/recording_" + std::to_string(recordingCount++), ImageWriter::Format(recordFormat));
+			});
+
 			controllables.push_back(obj2);
 
 			keyToggles.emplace_back(GLFW_KEY_KP_ADD, [&]() {
@@ -432,24 +873,16 @@ int main() {
 			keyToggles.emplace_back(GLFW_KEY_1, [&]() {
 
 				if (lightState) {
-					shader->SetUniform("u_LightPos", glm::vec3(0, 0, -1000));
-					shader->SetUniform("u_LightAttenuationLinear", float(0.019));
-					shader->SetUniform("u_LightAttenuationQuadratic", float(0.5));
-
-					sinShader->SetUniform("u_LightPos", glm::vec3(0, 0, -1000));
-					sinShader->SetUniform("u_LightAttenuationLinear", float(0.019));
-					sinShader->SetUniform("u_LightAttenuationQuadratic", float(0.5));
+					lightPos = glm::vec3(0, 0, -1000);
+					lightLinearFalloff = 0.019f;
+					lightQuadraticFalloff = 0.5f;
 
 					lightState = false;
 				}
 				else {
-					shader->SetUniform("u_LightPos", glm::vec3(0, 0, 10));
-					shader->SetUniform("u_LightAttenuationLinear", float(0.0));
-					shader->SetUniform("u_LightAttenuationQuadratic", float(0.0));
-
-					sinShader->SetUniform("u_LightPos", glm::vec3(0, 0, 10));
-					sinShader->SetUniform("u_LightAttenuationLinear", float(0.0));
-					sinShader->SetUniform("u_LightAttenuationQuadratic", float(0.0));
+					lightPos = glm::vec3(0, 0, 10);
+					lightLinearFalloff = 0.0f;
+					lightQuadraticFalloff = 0.0f;
 
 					lightState = true;
 				}
@@ -460,20 +893,10 @@ int main() {
 				if (lightAmbientPow > 0) {
 					lightAmbientPow = 0;
 					lightSpecularPow = 0;
-					shader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
-					shader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
-
-					sinShader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
-					sinShader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
 				}
 				else {
 					lightAmbientPow = 1;
 					lightSpecularPow = 0;
-					shader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
-					shader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
-
-					sinShader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
-					sinShader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
 				}
 			});
 
@@ -482,20 +905,10 @@ int main() {
 				if (lightSpecularPow > 0) {
 					lightAmbientPow = 0;
 					lightSpecularPow = 0;
-					shader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
-					shader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
-
-					sinShader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
-					sinShader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
 				}
 				else {
 					lightAmbientPow = 0;
 					lightSpecularPow = 1;
-					shader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
-					shader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
-
-					sinShader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
-					sinShader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
 				}
 			});
 
@@ -504,20 +917,10 @@ int main() {
 				if (lightSpecularPow > 0) {
 					lightAmbientPow = 0;
 					lightSpecularPow = 0;
-					shader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
-					shader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
-
-					sinShader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
-					sinShader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
 				}
 				else {
 					lightAmbientPow = 1;
 					lightSpecularPow = 1;
-					shader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
-					shader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
-
-					sinShader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
-					sinShader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
 				}
 			});
 
@@ -526,29 +929,14 @@ int main() {
 				if (lightSpecularPow > 0) {
 					lightAmbientPow = 0;
 					lightSpecularPow = 0;
-					shader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
-					shader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
-
-					sinShader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
-					sinShader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
 				}
 				else {
 					lightAmbientPow = 1;
 					lightSpecularPow = 1;
-					shader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
-					shader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
-
-					sinShader->SetUniform("u_AmbientLightStrength", lightAmbientPow);
-					sinShader->SetUniform("u_SpecularLightStrength", lightSpecularPow);
-				}
-				if (effectState == 0.0) {
-					effectState = 1.0;
-					sinShader->SetUniform("effectState", effectState);
-				}
-				else {
-					effectState = 0.0;
-					sinShader->SetUniform("effectState", effectState);
 				}
+				// The wave is its own program, so swap which one the grass uses rather than branching in the shader
+				sinWave = !sinWave;
+				phongVariants->Apply(grassMat, sinWave ? "SIN_WAVE" : "");
 			});
 			keyToggles.emplace_back(GLFW_KEY_6, [&]() {
 
@@ -595,20 +983,126 @@ int main() {
 		Timing& time = Timing::Instance();
 		time.LastFrame = glfwGetTime();
 
-		bool firstHalf = false;
-		bool secondHalf = true;
 		float sinTime = 0.0;
+		// Rates per second (these used to be per frame, at 60 FPS)
+		const float sinSpeed = 6.0f;
+
+		// Headless runs take exactly one step per frame
+		if (BackendHandler::headless)
+			simulation.FixedStep = BackendHandler::headlessTimestep;
+
+		// --benchmark lights renders the scene with more and more point lights: clustered forward, forward
+		// with every light in every pixel, and clustered deferred
+		FrameBenchmark lightBenchmark("Point lights");
+		if (BackendHandler::benchmark == "lights") {
+			for (int count : { 0, 64, 256, 512, 1024 }) {
+				lightBenchmark.AddCase(std::to_string(count) + " forward", [&, count]() {
+					spawnLights(count);
+					clusters.Clustered = true;
+					deferredShading = false;
+				});
+				lightBenchmark.AddCase(std::to_string(count) + " forward, all", [&, count]() {
+					spawnLights(count);
+					clusters.Clustered = false;
+					deferredShading = false;
+				});
+				lightBenchmark.AddCase(std::to_string(count) + " deferred", [&, count]() {
+					spawnLights(count);
+					clusters.Clustered = true;
+					deferredShading = true;
+				});
+			}
+			lightBenchmark.AddMetric("Scene GPU ms", []() { return GpuProfiler::GetLastTime("Scene"); });
+			lightBenchmark.AddMetric("Assign ms", [&]() { return clusters.GetAssignTime(); });
+			glfwSwapInterval(0);
+		}
+
+		// --benchmark prepass renders the scene with and without the depth pre-pass, forward and deferred
+		FrameBenchmark prepassBenchmark("Depth pre-pass");
+		if (BackendHandler::benchmark == "prepass") {
+			for (bool deferred : { false, true }) {
+				for (bool enabled : { false, true }) {
+					prepassBenchmark.AddCase(std::string(deferred ? "deferred" : "forward") + (enabled ? ", pre-pass" : ""), [&, deferred, enabled]() {
+						deferredShading = deferred;
+						prepass.Enabled = enabled;
+					});
+				}
+			}
+			prepassBenchmark.AddMetric("Scene GPU ms", []() { return GpuProfiler::GetLastTime("Scene"); });
+			prepassBenchmark.AddMetric("Fragments/pixel", [&]() { return prepass.GetFragmentsPerPixel(); });
+			glfwSwapInterval(0);
+		}
+
+		// --benchmark post runs the post effects as fragment passes and as one compute dispatch
+		// (run it again with LIBGL_ALWAYS_SOFTWARE=1 to compare against llvmpipe)
+		FrameBenchmark postBenchmark("Post processing");
+		if (BackendHandler::benchmark == "post") {
+			for (bool chain : { false, true }) {
+				for (bool compute : { false, true }) {
+					postBenchmark.AddCase(std::string(chain ? "3 effects" : "grade only") + (compute ? ", compute" : ", fragment"), [&, chain, compute]() {
+						greyscaleEffect->Enabled = chain;
+						sepiaEffect->Enabled = chain;
+						for (PostEffect* effect : { (PostEffect*)greyscaleEffect, (PostEffect*)sepiaEffect, (PostEffect*)colorCorrectionEffect })
+							effect->UseCompute = compute;
+					});
+				}
+			}
+			postBenchmark.AddMetric("Post GPU ms", []() { return GpuProfiler::GetLastTime("Post"); });
+			glfwSwapInterval(0);
+		}
+
+		// --benchmark bloom builds the bloom with the dual filter chain and with a full resolution Gaussian
+		// of the same radius, with everything resized to each resolution in turn
+		FrameBenchmark bloomBenchmark("Bloom");
+		if (BackendHandler::benchmark == "bloom") {
+			const int resolutions[][2] = { { 1280, 720 }, { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 } };
+			for (const auto& resolution : resolutions) {
+				for (BloomEffect::Filter filter : { BloomEffect::DUAL_FILTER, BloomEffect::GAUSSIAN }) {
+					int resWidth = resolution[0];
+					int resHeight = resolution[1];
+					bloomBenchmark.AddCase(std::to_string(resHeight) + "p" + (filter == BloomEffect::GAUSSIAN ? " gaussian" : " dual filter"),
+						[&, resWidth, resHeight, filter]() {
+						BackendHandler::GlfwWindowResizedCallback(BackendHandler::window, resWidth, resHeight);
+						bloomEffect->Enabled = true;
+						bloomEffect->Method = filter;
+					});
+				}
+			}
+			bloomBenchmark.AddMetric("Bloom GPU ms", []() { return GpuProfiler::GetLastTime("Bloom"); });
+			bloomBenchmark.AddMetric("Post GPU ms", []() { return GpuProfiler::GetLastTime("Post"); });
+			glfwSwapInterval(0);
+		}
+
+		// Headless runs record every frame, and wait on the encoders rather than drop frames
+		if (BackendHandler::headless && BackendHandler::benchmark.empty()) {
+			recorder.DropWhenBehind = false;
+			recorder.StartRecording(BackendHandler::headlessOutput, BackendHandler::captureFormat);
+			LOG_INFO("Rendering {} frames headless into {}", BackendHandler::headlessFrames, BackendHandler::headlessOutput);
+		}
+		double runStart = glfwGetTime();
 
 		///// Game loop /////
-		while (!glfwWindowShouldClose(BackendHandler::window)) {
+		int frameNumber = 0;
+		while (BackendHandler::IsRunning(frameNumber)) {
 			glfwPollEvents();
 
+			// Start a new frame of GL call statistics
+			GLStateCache::NewFrame();
+			GpuProfiler::NewFrame();
+			RenderTargetPool::NewFrame();
+
 			// Update the timing
 			time.CurrentFrame = glfwGetTime();
 			time.DeltaTime = static_cast<float>(time.CurrentFrame - time.LastFrame);
 
 			time.DeltaTime = time.DeltaTime > 1.0f ? 1.0f : time.DeltaTime;
 
+			// Headless runs step a fixed amount every frame so the output is the same on every machine
+			if (BackendHandler::headless) {
+				time.DeltaTime = BackendHandler::headlessTimestep;
+				time.CurrentFrame = time.LastFrame + BackendHandler::headlessTimestep;
+			}
+
 			// Update our FPS tracker data
 			fpsBuffer[frameIx] = 1.0f / time.DeltaTime;
 			frameIx++;
@@ -616,7 +1110,7 @@ int main() {
 				frameIx = 0;
 
 			// We'll make sure our UI isn't focused before we start handling input for our game
-			if (!ImGui::IsAnyWindowFocused()) {
+			if (!BackendHandler::headless && !ImGui::IsAnyWindowFocused()) {
 				// We need to poll our key watchers so they can do their logic with the GLFW state
 				// Note that since we want to make sure we don't copy our key handlers, we need a const
 				// reference!
@@ -625,25 +1119,55 @@ int main() {
 				}
 			}
 
-			// Iterate over all the behaviour binding components
-			scene->Registry().view<BehaviourBinding>().each([&](entt::entity entity, BehaviourBinding& binding) {
-				// Iterate over all the behaviour scripts attached to the entity, and update them in sequence (if enabled)
-				for (const auto& behaviour : binding.Behaviours) {
-					if (behaviour->Enabled) {
-						behaviour->Update(entt::handle(scene->Registry(), entity));
+			// Run as many fixed steps as this frame's time pays for, so the simulation speed doesn't depend on FPS
+			// The steps swap in their own delta, anything per frame (like the exposure adapting) wants the real one
+			float frameTime = time.DeltaTime;
+			int steps = simulation.Advance(frameTime);
+			for (int step = 0; step < steps; step++) {
+				// Remember where everything was so rendering can blend towards where it ends up
+				SimulationScheduler::BeginStep(scene->Registry());
+
+				// Behaviours read their time step from the timing instance
+				time.DeltaTime = simulation.FixedStep;
+
+				// Iterate over all the behaviour binding components
+				scene->Registry().view<BehaviourBinding>().each([&](entt::entity entity, BehaviourBinding& binding) {
+					// Iterate over all the behaviour scripts attached to the entity, and update them in sequence (if enabled)
+					for (const auto& behaviour : binding.Behaviours) {
+						if (behaviour->Enabled) {
+							behaviour->Update(entt::handle(scene->Registry(), entity));
+						}
 					}
-				}
-			});
+				});
+
+				sinTime += sinSpeed * simulation.FixedStep;
+
+				patrols.Update(simulation.FixedStep);
+				patrols.WriteTransforms(scene->Registry());
+			}
+			time.DeltaTime = frameTime;
+
+			// Blend everything that moves between the last two steps
+			SimulationScheduler::ApplyInterpolation(scene->Registry(), simulation.GetAlpha());
+
+			// Pick this frame's resolution from the GPU time of the newest finished frame, the targets stay the same size
+			// and we only draw into the bottom left of them
+			dynamicResolution.Update(GpuProfiler::GetLastTime("Frame"));
+			unsigned renderWidth = dynamicResolution.Scale(colorCorrect->_width);
+			unsigned renderHeight = dynamicResolution.Scale(colorCorrect->_height);
+			colorCorrect->SetRenderSize(renderWidth, renderHeight);
+			gBuffer->SetRenderSize(renderWidth, renderHeight);
+			GpuProfiler::Begin("Frame");
 
 			// Clear the screen
-			basicEffect->Clear();
-			greyscaleEffect->Clear();
-			sepiaEffect->Clear();
+			// Post effect buffers aren't cleared, every pass writes all of their pixels
 			colorCorrect->Clear();
+			if (deferredShading)
+				gBuffer->Clear();
 
-			glClearColor(0.08f, 0.17f, 0.31f, 1.0f);
-			glEnable(GL_DEPTH_TEST);
-			glClearDepth(1.0f);
+			GLStateCache::ClearColor(0.08f, 0.17f, 0.31f, 1.0f);
+			GLStateCache::Enable(GL_DEPTH_TEST);
+			GLStateCache::ClearDepth(1.0f);
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 			// Update all world matrices for this frame
@@ -651,8 +1175,23 @@ int main() {
 				t.UpdateWorldMatrix();
 			});
 
-			sinShader->SetUniform("sinTime", sinTime);
-			sinTime += 0.1;
+			lighting.Values.AmbientCol = ambientCol;
+			lighting.Values.AmbientStrength = ambientPow;
+			lighting.Values.LightPos = lightPos;
+			lighting.Values.AmbientLightStrength = lightAmbientPow;
+			lighting.Values.LightCol = lightCol;
+			lighting.Values.SpecularLightStrength = lightSpecularPow;
+			lighting.Values.AttenuationLinear = lightLinearFalloff;
+			lighting.Values.AttenuationQuadratic = lightQuadraticFalloff;
+			// The occlusion needs depth before the lit surfaces are shaded, forward only has that with the pre-pass
+			bool ambientOcclusion = ssaoEffect->Enabled && (deferredShading || prepass.Enabled);
+			lighting.Values.AmbientOcclusion = ambientOcclusion ? ssaoEffect->Strength : 0.0f;
+			lighting.Values.EnvironmentStrength = environment.Irradiance != nullptr ? environmentLighting : 0.0f;
+			lighting.Values.EnvironmentRotation = glm::mat4(environmentRotation);
+			// Every SIN_WAVE variant (lit, G-buffer, batched, depth only) reads the time from the Lighting block
+			if (sinWave)
+				lighting.Values.WaveTime = sinTime + sinSpeed * simulation.FixedStep * simulation.GetAlpha();
+			lighting.Upload();
 
 			// Grab out camera info from the camera object
 			Transform& camTransform = cameraObject.get<Transform>();
@@ -660,59 +1199,32 @@ int main() {
 			glm::mat4 projection = cameraObject.get<Camera>().GetProjection();
 			glm::mat4 viewProjection = projection * view;
 
-			if (obj3.get<Transform>().GetLocalPosition().x < 10 && secondHalf) {
-				obj3.get<Transform>().SetLocalRotation(0.0f, 0.0f, -90.0f);
-				obj4.get<Transform>().SetLocalRotation(0.0f, 0.0f, 90.0f);
-				obj5.get<Transform>().SetLocalRotation(0.0f, 0.0f, 180.0f);
-				obj6.get<Transform>().SetLocalRotation(0.0f, 0.0f, 0.0f);
-				obj3.get<Transform>().MoveLocalFixed(0.025, 0, 0);
-				obj4.get<Transform>().MoveLocalFixed(-0.025, 0, 0);
-				obj5.get<Transform>().MoveLocalFixed(0, -0.025, 0);
-				obj6.get<Transform>().MoveLocalFixed(0, 0.025, 0);
-			}
-			else if (obj3.get<Transform>().GetLocalPosition().y > -10 && secondHalf) {
-				obj3.get<Transform>().SetLocalRotation(0.0f, 0.0f, 180.0f);
-				obj4.get<Transform>().SetLocalRotation(0.0f, 0.0f, 0.0f);
-				obj5.get<Transform>().SetLocalRotation(0.0f, 0.0f, 90.0f);
-				obj6.get<Transform>().SetLocalRotation(0.0f, 0.0f, -90.0f);
-				obj3.get<Transform>().MoveLocalFixed(0, -0.025, 0);
-				obj4.get<Transform>().MoveLocalFixed(0, 0.025, 0);
-				obj5.get<Transform>().MoveLocalFixed(-0.025, 0, 0);
-				obj6.get<Transform>().MoveLocalFixed(0.025, 0, 0);
-			}
-			else {
-				firstHalf = true;
-				secondHalf = false;
-			}
-
-			if (obj3.get<Transform>().GetLocalPosition().x > -10 && firstHalf) {
-				obj3.get<Transform>().SetLocalRotation(0.0f, 0.0f, 90.0f);
-				obj4.get<Transform>().SetLocalRotation(0.0f, 0.0f, -90.0f);
-				obj5.get<Transform>().SetLocalRotation(0.0f, 0.0f, 0.0f);
-				obj6.get<Transform>().SetLocalRotation(0.0f, 0.0f, 180.0f);
-				obj3.get<Transform>().MoveLocalFixed(-0.025, 0, 0);
-				obj4.get<Transform>().MoveLocalFixed(0.025, 0, 0);
-				obj5.get<Transform>().MoveLocalFixed(0, 0.025, 0);
-				obj6.get<Transform>().MoveLocalFixed(0, -0.025, 0);
-			}
-			else if (obj3.get<Transform>().GetLocalPosition().y < 10 && firstHalf) {
-				obj3.get<Transform>().SetLocalRotation(0.0f, 0.0f, 0.0f);
-				obj4.get<Transform>().SetLocalRotation(0.0f, 0.0f, 180.0f);
-				obj5.get<Transform>().SetLocalRotation(0.0f, 0.0f, -90.0f);
-				obj6.get<Transform>().SetLocalRotation(0.0f, 0.0f, 90.0f);
-				obj3.get<Transform>().MoveLocalFixed(0, 0.025, 0);
-				obj4.get<Transform>().MoveLocalFixed(0, -0.025, 0);
-				obj5.get<Transform>().MoveLocalFixed(0.025, 0, 0);
-				obj6.get<Transform>().MoveLocalFixed(-0.025, 0, 0);
-			}
-			else {
-				secondHalf = true;
-				firstHalf = false;
+			// Move the point lights and sort them into clusters for this camera
+			if (animateLights) {
+				// sinTime is simulated seconds scaled by sinSpeed
+				float lightTime = sinTime / sinSpeed + simulation.FixedStep * simulation.GetAlpha();
+				for (size_t i = 0; i < clusters.Lights.size(); i++)
+					clusters.Lights[i].Position = lightOrigins[i] + glm::vec3(glm::cos(lightTime + lightPhases[i]), glm::sin(lightTime + lightPhases[i]), 0.0f) * 0.75f;
 			}
+			clusters.Update(view, projection, renderWidth, renderHeight);
+
+			// Find out what was hidden the last time a test finished
+			culler.NewFrame();
 
 			// Sort the renderers by shader and material, we will go for a minimizing context switches approach here,
-			// but you could for instance sort front to back to optimize for fill rate if you have intensive fragment shaders
-			renderGroup.sort<RendererComponent>([](const RendererComponent& l, const RendererComponent& r) {
+			// then front to back inside each material so the depth test can throw away hidden fragments before they're shaded
+			// Batched materials don't need switching, so they all count as one and only sort by depth.
+			// The depth is of the object's origin in view space (the camera looks down -z)
+			sortKeys.clear();
+			renderGroup.each([&](entt::entity e, RendererComponent& renderer, Transform& transform) {
+				glm::vec3 p = transform.WorldTransform()[3];
+				const ShaderMaterial* material = batcher.Enabled && batcher.GetIndex(renderer.Material) >= 0 ? nullptr : renderer.Material.get();
+				sortKeys[e] = { material, view[0][2] * p.x + view[1][2] * p.y + view[2][2] * p.z };
+			});
+			renderGroup.sort([&](const entt::entity le, const entt::entity re) {
+				const RendererComponent& l = renderGroup.get<RendererComponent>(le);
+				const RendererComponent& r = renderGroup.get<RendererComponent>(re);
+
 				// Sort by render layer first, higher numbers get drawn last
 				if (l.Material->RenderLayer < r.Material->RenderLayer) return true;
 				if (l.Material->RenderLayer > r.Material->RenderLayer) return false;
@@ -721,49 +1233,264 @@ int main() {
 				if (l.Material->Shader < r.Material->Shader) return true;
 				if (l.Material->Shader > r.Material->Shader) return false;
 
-				// Sort by material pointer last (so we can minimize switching between materials)
-				if (l.Material < r.Material) return true;
-				if (l.Material > r.Material) return false;
-				
-				return false;
+				// Sort by material pointer next (so we can minimize switching between materials), then nearest first
+				const SortKey& lk = sortKeys.at(le);
+				const SortKey& rk = sortKeys.at(re);
+				if (lk.Material < rk.Material) return true;
+				if (lk.Material > rk.Material) return false;
+				return lk.Depth > rk.Depth;
 			});
 
-			// Start by assuming no shader or material is applied
-			Shader::sptr current = nullptr;
-			ShaderMaterial::sptr currentMat = nullptr;
-
-			colorCorrect->Bind();
-
-			// Iterate over the render group components and draw them
-			renderGroup.each( [&](entt::entity e, RendererComponent& renderer, Transform& transform) {
-				// If the shader has changed, set up it's uniforms
-				if (current != renderer.Material->Shader) {
-					current = renderer.Material->Shader;
-					current->Bind();
-					BackendHandler::SetupShaderForFrame(current, view, projection);
+			// Draws the render group, shaderFor picks the shader each material is drawn with (or nullptr to skip it)
+			// Objects the culler had hidden are left out until it has tested them again, then the GPU only draws the ones in view,
+			// hiddenOnly draws just those
+			auto drawRenderers = [&](const std::function<Shader::sptr(const ShaderMaterial::sptr&)>& shaderFor, bool hiddenOnly) {
+				// Start by assuming no shader or material is applied
+				Shader::sptr current = nullptr;
+				ShaderMaterial::sptr currentMat = nullptr;
+				Shader::sptr unbatchedShader = nullptr;
+				Shader::sptr batchedShader = nullptr;
+				std::string key;
+
+				// Iterate over the render group components and draw them
+				renderGroup.each( [&](entt::entity e, RendererComponent& renderer, Transform& transform) {
+					bool retested = !culler.IsVisible(e);
+					if (retested ? !culler.IsRetested(e) : hiddenOnly)
+						return;
+					Shader::sptr shader = shaderFor(renderer.Material);
+					if (shader == nullptr)
+						return;
+					// Batched materials draw with the version of the lit shader that reads them from the arrays
+					int materialIndex = batcher.Enabled ? batcher.GetIndex(renderer.Material) : -1;
+					if (materialIndex >= 0) {
+						if (shader != unbatchedShader) {
+							unbatchedShader = shader;
+							batchedShader = phongVariants->FindKey(shader, key) ? phongVariants->Get(key + " MATERIAL_ARRAYS") : nullptr;
+						}
+						if (batchedShader != nullptr)
+							shader = batchedShader;
+					}
+					// If the shader has changed, set up it's uniforms
+					if (current != shader) {
+						current = shader;
+						BackendHandler::SetupShaderForFrame(current, view, projection);
+					}
+					// Batched materials are never applied, the lit shader finds them by index and the depth only ones don't read them
+					if (materialIndex >= 0) {
+						if (batchedShader != nullptr)
+							shader->SetUniform("u_MaterialIndex", materialIndex);
+					}
+					else if (currentMat != renderer.Material) {
+						currentMat = renderer.Material;
+						materialApplies++;
+						// Materials apply themselves to their own shader, so point them at the one we're drawing with while they do
+						Shader::sptr materialShader = currentMat->Shader;
+						currentMat->Shader = shader;
+						currentMat->Apply();
+						currentMat->Shader = materialShader;
+						// Materials bind their own shader and textures behind the state cache's back
+						GLStateCache::InvalidateProgram();
+						GLStateCache::InvalidateTextures();
+					}
+					// Render the mesh
+					if (retested)
+						culler.BeginRetested(e);
+					BackendHandler::RenderVAO(shader, renderer.Mesh, viewProjection, transform);
+					if (retested)
+						culler.EndRetested();
+				});
+			};
+			auto drawScene = [&](const std::function<Shader::sptr(const ShaderMaterial::sptr&)>& shaderFor) {
+				drawRenderers(shaderFor, false);
+			};
+
+			// Tests everything with a bounding box against the depth drawn into target so far (leaving target bound again),
+			// the objects that were hidden get drawn by every pass after this, and by drawRenderers(shaderFor, true) into this one
+			// The results are read back to pick what's drawn before the test in a few frames
+			auto testHidden = [&](Framebuffer* target) {
+				if (!culler.Enabled)
+					return;
+				GpuProfiler::Begin("Occlusion");
+				renderGroup.each([&](entt::entity e, RendererComponent& renderer, Transform& transform) {
+					glm::vec3 min, max;
+					if (MeshBounds::Get(renderer.Mesh, min, max))
+						culler.AddObject(e, min, max, transform.WorldTransform());
+				});
+				culler.Test(*target, viewProjection);
+				GpuProfiler::End("Occlusion");
+			};
+
+			// Lays the lit surfaces' depth into target before they're shaded, the hidden objects are tested against it
+			// and the ones in view lay theirs down too
+			auto drawDepth = [&](Framebuffer* target) {
+				if (!prepass.Enabled)
+					return;
+				auto depthShader = [&](const ShaderMaterial::sptr& material) { return prepass.GetDepthShader(material); };
+				GpuProfiler::Begin("Depth Pre-Pass");
+				prepass.BeginDepth();
+				drawScene(depthShader);
+				prepass.EndDepth();
+				testHidden(target);
+				prepass.BeginDepth();
+				drawRenderers(depthShader, true);
+				prepass.EndDepth();
+				GpuProfiler::End("Depth Pre-Pass");
+			};
+
+			// Works out the occlusion from the depth in target and binds it for the lit pass, leaving target bound again
+			auto buildOcclusion = [&](Framebuffer* target) {
+				if (!ambientOcclusion)
+					return;
+				target->Unbind();
+				GpuProfiler::Begin("SSAO");
+				ssaoEffect->Build(target, view, projection);
+				GpuProfiler::End("SSAO");
+				ssaoEffect->BindOcclusion(AmbientOcclusionEffect::OCCLUSION_SLOT);
+				target->Bind();
+				target->SetViewport();
+			};
+
+			// The shadow casters are drawn with the pre-pass's depth only programs, anything that isn't lit doesn't cast
+			// Anything the simulation moves, or whose shader moves its vertices, goes in the dynamic atlas
+			auto drawShadowCasters = [&](const glm::mat4& lightViewProjection, bool dynamic) {
+				Shader::sptr current = nullptr;
+				ShaderMaterial::sptr lastMaterial = nullptr;
+				bool animated = false;
+				std::string key;
+				renderGroup.each([&](entt::entity e, RendererComponent& renderer, Transform& transform) {
+					if (renderer.Material != lastMaterial) {
+						lastMaterial = renderer.Material;
+						animated = phongVariants->FindKey(lastMaterial->Shader, key) && key.find("SIN_WAVE") != std::string::npos;
+					}
+					bool moves = animated || scene->Registry().try_get<InterpolatedTransform>(e) != nullptr;
+					if (moves != dynamic)
+						return;
+					Shader::sptr shader = prepass.GetDepthShader(renderer.Material);
+					if (shader == nullptr)
+						return;
+					if (current != shader) {
+						current = shader;
+						GLStateCache::UseProgram(current->GetHandle());
+					}
+					BackendHandler::RenderVAO(shader, renderer.Mesh, lightViewProjection, transform);
+				});
+			};
+
+			GpuProfiler::Begin("Shadows");
+			shadows.Update(lightPos, EnvironmentGenerator::GetGeneration(), drawShadowCasters);
+			GpuProfiler::End("Shadows");
+			if (shadows.Enabled)
+				shadows.Bind();
+
+			lastMaterialApplies = materialApplies;
+			materialApplies = 0;
+			if (batcher.Enabled)
+				batcher.Bind();
+			EnvironmentBaker::Bind(environment);
+
+			GpuProfiler::Begin("Scene");
+			if (deferredShading) {
+				// Lit materials write their surface into the G-buffer with the GBUFFER version of their shader
+				ShaderMaterial::sptr lastMaterial = nullptr;
+				Shader::sptr lastShader = nullptr;
+				std::string key;
+				auto gBufferShader = [&](const ShaderMaterial::sptr& material) {
+					if (material != lastMaterial) {
+						lastMaterial = material;
+						lastShader = phongVariants->FindKey(material->Shader, key) ? phongVariants->Get(key + " GBUFFER") : nullptr;
+					}
+					return lastShader;
+				};
+				gBuffer->Bind();
+				gBuffer->SetViewport();
+				drawDepth(gBuffer);
+				GpuProfiler::Begin("G-Buffer");
+				prepass.BeginShading(renderWidth, renderHeight);
+				drawScene(gBufferShader);
+				prepass.EndShading();
+				// Without the pre-pass the hidden objects are tested against the surfaces instead
+				if (!prepass.Enabled) {
+					testHidden(gBuffer);
+					drawRenderers(gBufferShader, true);
 				}
-				// If the material has changed, apply it
-				if (currentMat != renderer.Material) {
-					currentMat = renderer.Material;
-					currentMat->Apply();
+				GpuProfiler::End("G-Buffer");
+				buildOcclusion(gBuffer);
+				gBuffer->Unbind();
+
+				// Then every pixel is lit exactly once
+				GpuProfiler::Begin("Deferred Lighting");
+				gBuffer->DrawLighting(colorCorrect, view, projection);
+				GpuProfiler::End("Deferred Lighting");
+
+				// Anything that isn't lit is drawn forward on top
+				colorCorrect->Bind();
+				drawScene([&](const ShaderMaterial::sptr& material) {
+					return phongVariants->Contains(material->Shader) ? nullptr : material->Shader;
+				});
+			}
+			else {
+				auto litShader = [](const ShaderMaterial::sptr& material) { return material->Shader; };
+				colorCorrect->Bind();
+				colorCorrect->SetViewport();
+				drawDepth(colorCorrect);
+				buildOcclusion(colorCorrect);
+				prepass.BeginShading(renderWidth, renderHeight);
+				drawScene(litShader);
+				prepass.EndShading();
+				if (!prepass.Enabled) {
+					testHidden(colorCorrect);
+					drawRenderers(litShader, true);
 				}
-				// Render the mesh
-				BackendHandler::RenderVAO(renderer.Material->Shader, renderer.Mesh, viewProjection, transform);
-			});
-
+			}
+			if (ambientOcclusion)
+				ssaoEffect->UnbindOcclusion(AmbientOcclusionEffect::OCCLUSION_SLOT);
+			if (shadows.Enabled)
+				shadows.Unbind();
+
+			// The sky fills whatever the scene didn't cover
+			GpuProfiler::Begin("Sky");
+			SkyPass::Draw(skyboxMat, view, projection);
+			GpuProfiler::End("Sky");
+			GpuProfiler::End("Scene");
 			colorCorrect->Unbind();
 
-			colorCorrectionShader->Bind();
+			// Draw the lit surfaces again, counting every fragment that gets shaded in each pixel
+			if (prepass.ShowOverdraw)
+				prepass.DrawCounts(colorCorrect->_width, colorCorrect->_height, drawScene);
 
-			colorCorrect->BindColorAsTexture(0, 0);
-			cube.bind(30);
+			// Put everything back where the simulation has it before the next step runs
+			SimulationScheduler::RestoreSimulation(scene->Registry());
 
-			colorCorrect->DrawFullscreenQuad();
+			if (autoExposure.Enabled) {
+				GpuProfiler::Begin("Exposure");
+				autoExposure.Update(*colorCorrect, frameTime);
+				GpuProfiler::End("Exposure");
+			}
 
-			cube.unbind(30);
-			colorCorrect->UnbindTexture(0);
+			if (bloomEffect->Enabled) {
+				GpuProfiler::Begin("Bloom");
+				bloomEffect->Build(colorCorrect);
+				GpuProfiler::End("Bloom");
+			}
+
+			GpuProfiler::Begin("Post");
+			post.SetDepth(colorCorrect, projection);
+			post.Apply(colorCorrect, finalFrame);
+			GpuProfiler::End("Post");
+			bloomEffect->Release();
+
+			// The heat map replaces the frame, so it's what gets shown and captured
+			if (prepass.ShowOverdraw)
+				prepass.DrawOverdraw(finalFrame);
+			else if (ambientOcclusion && showOcclusion)
+				ssaoEffect->DrawOcclusion(finalFrame, occlusionSplit);
+			GpuProfiler::End("Frame");
 
-			colorCorrectionShader->UnBind();
+			// Queue this frame if we're capturing it, and hand any older frames the GPU has finished to the encoders
+			recorder.EndFrame(finalFrame);
+
+			if (!BackendHandler::headless)
+				finalFrame->DrawToBackbuffer();
 
 			/*sepiaEffect->ApplyEffect(basicEffect);
 
@@ -773,8 +1500,48 @@ int main() {
 			BackendHandler::RenderImGui();
 
 			scene->Poll();
-			glfwSwapBuffers(BackendHandler::window);
+			if (!BackendHandler::headless)
+				glfwSwapBuffers(BackendHandler::window);
 			time.LastFrame = time.CurrentFrame;
+			frameNumber++;
+
+			if (BackendHandler::benchmark == "lights" && !lightBenchmark.EndFrame()) {
+				lightBenchmark.PrintReport();
+				break;
+			}
+			if (BackendHandler::benchmark == "prepass" && !prepassBenchmark.EndFrame()) {
+				prepassBenchmark.PrintReport();
+				break;
+			}
+			if (BackendHandler::benchmark == "post" && !postBenchmark.EndFrame()) {
+				postBenchmark.PrintReport();
+				break;
+			}
+			if (BackendHandler::benchmark == "bloom" && !bloomBenchmark.EndFrame()) {
+				bloomBenchmark.PrintReport();
+				break;
+			}
+		}
+
+		// Write out whatever is still in flight
+		recorder.Unload();
+
+		// Let go of the lighting buffers, timer queries and shared shader stages
+		lighting.Unload();
+		shadows.Unload();
+		clusters.Unload();
+		prepass.Unload();
+		culler.Unload();
+		MeshBounds::Clear();
+		batcher.Unload();
+		autoExposure.Unload();
+		RenderTargetPool::Unload();
+		GpuProfiler::Unload();
+		ShaderManager::Unload();
+
+		if (BackendHandler::headless) {
+			double runTime = glfwGetTime() - runStart;
+			LOG_INFO("Rendered {} frames in {:.3f}s ({:.3f}ms per frame)", frameNumber, runTime, (runTime * 1000.0) / std::max(frameNumber, 1));
 		}
 
 		// Nullify scene so that we can release references